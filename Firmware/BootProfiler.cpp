@@ -0,0 +1,144 @@
+// Pinscape Pico - Startup timing profiler
+// Copyright 2024, 2025 Michael J Roberts / BSD-3-Clause license / NO WARRANTY
+
+// standard library headers
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+// Pico SDK headers
+#include <pico/stdlib.h>
+#include <pico/time.h>
+
+// project headers
+#include "BootProfiler.h"
+#include "CommandConsole.h"
+#include "../USBProtocol/VendorIfcProtocol.h"
+
+// global singleton
+BootProfiler bootProfiler;
+
+void BootProfiler::Init()
+{
+    // note the program entry time
+    tMain = time_us_64();
+
+    // set up our console command
+    CommandConsole::AddCommand(
+        "boottime", "show startup timing trace",
+        "boottime  (no options)\n",
+        Command_boottime);
+}
+
+void BootProfiler::Begin(const char *name)
+{
+    // ignore new spans after the main loop starts
+    if (finished)
+        return;
+
+    // add the span if there's room, otherwise count it as dropped
+    int index = -1;
+    if (nSpans < MAX_SPANS)
+    {
+        index = nSpans++;
+        spans[index] = { name, time_us_64(), 0, static_cast<uint8_t>(depth) };
+    }
+    else
+        nDropped += 1;
+
+    // push it on the open span stack
+    if (depth < MAX_DEPTH)
+        stack[depth] = index;
+    depth += 1;
+}
+
+void BootProfiler::End()
+{
+    // ignore unbalanced End() calls
+    if (finished || depth == 0)
+        return;
+
+    // pop the innermost open span and set its end time
+    depth -= 1;
+    if (depth < MAX_DEPTH && stack[depth] >= 0)
+        spans[stack[depth]].tEnd = time_us_64();
+}
+
+void BootProfiler::Finish()
+{
+    // close any spans still open
+    while (depth != 0)
+        End();
+
+    // note the main loop start time, and stop recording
+    tMainLoop = time_us_64();
+    finished = true;
+}
+
+size_t BootProfiler::Query(uint8_t *buf, size_t bufSize) const
+{
+    // make sure there's room
+    size_t xferSize = sizeof(PinscapePico::BootTraceList) + nSpans*sizeof(PinscapePico::BootTraceSpan);
+    if (xferSize > bufSize)
+        return 0;
+
+    // populate the list header
+    memset(buf, 0, xferSize);
+    auto *hdr = reinterpret_cast<PinscapePico::BootTraceList*>(buf);
+    hdr->cb = sizeof(PinscapePico::BootTraceList);
+    hdr->cbSpan = sizeof(PinscapePico::BootTraceSpan);
+    hdr->numSpans = static_cast<uint16_t>(nSpans);
+    hdr->numDropped = static_cast<uint16_t>(nDropped);
+    hdr->tMain = tMain;
+    hdr->tMainLoop = tMainLoop;
+
+    // populate the spans
+    auto *dst = reinterpret_cast<PinscapePico::BootTraceSpan*>(hdr + 1);
+    for (int i = 0 ; i < nSpans ; ++i, ++dst)
+    {
+        const auto &src = spans[i];
+        dst->tStart = src.tStart;
+        dst->tEnd = src.tEnd;
+        dst->depth = src.depth;
+        strncpy(dst->name, src.name, sizeof(dst->name) - 1);
+    }
+
+    // return the populated size
+    return xferSize;
+}
+
+// console command handler
+void BootProfiler::Command_boottime(const ConsoleCommandContext *c)
+{
+    if (c->argc != 1)
+        return c->Usage();
+
+    const auto &b = bootProfiler;
+    if (!b.finished)
+        return c->Print("Startup trace not available (startup still in progress)\n");
+
+    // show the overall times
+    c->Printf(
+        "Startup timing trace (times in ms since CPU reset):\n"
+        "  Program entry:     %8.3f\n"
+        "  Main loop started: %8.3f  (%.3f ms after program entry)\n"
+        "\n"
+        "     Start    Elapsed   Step\n",
+        static_cast<float>(b.tMain) / 1000.0f,
+        static_cast<float>(b.tMainLoop) / 1000.0f,
+        static_cast<float>(b.tMainLoop - b.tMain) / 1000.0f);
+
+    // show the spans, indented by nesting level
+    for (int i = 0 ; i < b.nSpans ; ++i)
+    {
+        const auto &s = b.spans[i];
+        c->Printf("  %8.3f  %9.3f   %*s%s\n",
+            static_cast<float>(s.tStart) / 1000.0f,
+            static_cast<float>(s.tEnd - s.tStart) / 1000.0f,
+            s.depth*2, "", s.name);
+    }
+
+    // note any dropped spans
+    if (b.nDropped != 0)
+        c->Printf("  (%d span%s dropped; trace buffer full)\n", b.nDropped, b.nDropped == 1 ? "" : "s");
+}
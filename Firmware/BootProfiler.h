@@ -0,0 +1,93 @@
+// Pinscape Pico - Startup timing profiler
+// Copyright 2024, 2025 Michael J Roberts / BSD-3-Clause license / NO WARRANTY
+//
+// The boot profiler records a trace of the initialization steps that run
+// between program entry and the start of the main loop, as a list of
+// named, timestamped spans.  Startup time matters in a pin cab, since
+// the cabinet is usually powered on as a unit, and the Pico has to be
+// up and running its USB interfaces before the PC finishes booting.
+// The trace shows where the startup time goes, so that we know which
+// steps are worth optimizing.
+//
+// The trace uses a fixed-size array, so recording a span is just a
+// timer read and a few stores, with no memory allocation.  Span names
+// must be string constants (or otherwise have static storage duration),
+// since we only store the pointers.
+//
+// Recording stops when the main loop starts.  The trace can be viewed
+// with the 'boottime' console command, and retrieved via the vendor
+// interface with CMD_STATS + SUBCMD_STATS_QUERY_BOOT_TRACE.
+
+#pragma once
+#include <stdlib.h>
+#include <stdint.h>
+
+// external declarations
+class ConsoleCommandContext;
+
+class BootProfiler
+{
+public:
+    // Initialize.  The main program calls this as its first step, to
+    // record the program entry time.
+    void Init();
+
+    // Begin a span.  Spans nest: a span begun while another is open
+    // is recorded as a child of the open span.
+    void Begin(const char *name);
+
+    // End the innermost open span
+    void End();
+
+    // End the innermost open span and begin a new one at the same
+    // level.  This is convenient for instrumenting a series of steps.
+    void Next(const char *name) { End(); Begin(name); }
+
+    // Mark the start of the main loop.  This closes any spans still
+    // open, and stops recording.
+    void Finish();
+
+    // Populate a vendor interface BootTraceList struct plus the span
+    // array in the given buffer.  Returns the size of the populated
+    // data, or 0 if the buffer is too small.
+    size_t Query(uint8_t *buf, size_t bufSize) const;
+
+    // maximum number of spans we can record
+    static const int MAX_SPANS = 64;
+
+    // maximum nesting depth
+    static const int MAX_DEPTH = 8;
+
+protected:
+    // console command handler
+    static void Command_boottime(const ConsoleCommandContext *c);
+
+    // recorded span
+    struct Span
+    {
+        const char *name;
+        uint64_t tStart;
+        uint64_t tEnd;
+        uint8_t depth;
+    };
+    Span spans[MAX_SPANS];
+    int nSpans = 0;
+
+    // number of spans dropped due to a full buffer
+    int nDropped = 0;
+
+    // Open span stack.  Each entry is the index in spans[] of the open
+    // span at that nesting level, or -1 if the span was dropped.
+    int stack[MAX_DEPTH];
+    int depth = 0;
+
+    // program entry and main loop start times
+    uint64_t tMain = 0;
+    uint64_t tMainLoop = 0;
+
+    // recording finished
+    bool finished = false;
+};
+
+// global singleton
+extern BootProfiler bootProfiler;
@@ -2210,7 +2210,7 @@ void Button::SecondCoreDebouncedSource::SecondCorePoll()
     // if the new state differs from the last physical state, mark the edge time
     uint64_t now = time_us_64();
     if (live != lastPhysicalState)
-        tEdge = now;
+        tEdge = PhysicalEdgeTime(now);
 
     // record the new physical state for next time
     lastPhysicalState = live;
@@ -2226,7 +2226,16 @@ void Button::SecondCoreDebouncedSource::SecondCorePoll()
             // for at least the hold time before we can recognize the change
             if (now - tLastDebouncedStateChange >= (debouncedPhysicalState == activeHigh ? dtOn : dtOff))
             {
-                // update the state and record the new time
+                // Update the state and record the new time.  Note that we
+                // use the current time here, NOT the physical edge time,
+                // even when the source provides hardware edge timestamps.
+                // The hold filter guarantees a minimum interval between
+                // the changes we report, and we report this change now,
+                // so that's where the interval has to start.  Measuring
+                // from the edge time would let a change that we were
+                // late in recognizing shorten the hold period for the
+                // next one.  The edge time only applies to the low-pass
+                // filter above, which measures the physical input.
                 debouncedPhysicalState = live;
                 tLastDebouncedStateChange = now;
                 
@@ -2514,6 +2523,12 @@ bool Button::C74HC165Source::PollPhysical()
     return chain->Get(port);
 }
 
+uint64_t Button::C74HC165Source::PhysicalEdgeTime(uint64_t now)
+{
+    // in edge capture mode, the chain timestamps each change as it's scanned
+    return chain->GetEdgeTime(port, now);
+}
+
 // ---------------------------------------------------------------------------
 //
 // IR Receiver Source
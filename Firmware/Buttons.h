@@ -329,6 +329,12 @@ public:
         // poll the physical hardware source (runs on second-core thread)
         virtual bool PollPhysical() = 0;
 
+        // Get the time of the physical edge that PollPhysical() just
+        // reported, given the current time.  Sources that timestamp their
+        // edges in hardware can override this to report the actual edge
+        // time; by default, the edge is taken to occur at the poll.
+        virtual uint64_t PhysicalEdgeTime(uint64_t now) { return now; }
+
         // Process a change to the debounced state (runs on second-core thread).
         // Does nothing by default.  This is provided primarily as a hook for
         // event logging in the GPIO button handler.
@@ -554,6 +560,9 @@ public:
         
         virtual bool PollPhysical() override;
 
+        // get the edge time from the chain's edge capture data
+        virtual uint64_t PhysicalEdgeTime(uint64_t now) override;
+
         virtual const char *FullName(char *buf, size_t buflen) const override;
 
         // populate a vendor interface button descriptor
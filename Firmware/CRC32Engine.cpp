@@ -0,0 +1,136 @@
+// Pinscape Pico - CRC-32 engine
+// Copyright 2024, 2025 Michael J Roberts / BSD-3-Clause license / NO WARRANTY
+
+// standard library headers
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+// Pico SDK headers
+#ifdef PICO_FIRMWARE_BUILD
+#include <pico/stdlib.h>
+#include <hardware/dma.h>
+#include <hardware/sync.h>
+#endif
+
+// project headers
+#include "CRC32Engine.h"
+
+// global singleton
+CRC32Engine crc32Engine;
+
+// Slice-by-8 lookup tables.  Table 0 is the conventional byte-at-a-time
+// table for the reflected polynomial; table k gives the CRC contribution
+// of a byte followed by k zero bytes.  The tables are generated at
+// compile time, so they live in flash on the Pico.
+namespace {
+    struct SliceTables
+    {
+        uint32_t t[8][256];
+    };
+
+    constexpr SliceTables MakeSliceTables()
+    {
+        SliceTables s{ };
+        for (uint32_t i = 0 ; i < 256 ; ++i)
+        {
+            uint32_t c = i;
+            for (int j = 0 ; j < 8 ; ++j)
+                c = (c & 1) != 0 ? (c >> 1) ^ 0xEDB88320 : (c >> 1);
+            s.t[0][i] = c;
+        }
+        for (int k = 1 ; k < 8 ; ++k)
+        {
+            for (int i = 0 ; i < 256 ; ++i)
+                s.t[k][i] = (s.t[k-1][i] >> 8) ^ s.t[0][s.t[k-1][i] & 0xFF];
+        }
+        return s;
+    }
+
+    constexpr SliceTables sliceTables = MakeSliceTables();
+}
+
+uint32_t CRC32Engine::CalcSoftware(const void *data, size_t len, uint32_t crc)
+{
+    const auto &t = sliceTables.t;
+    const uint8_t *p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+
+    // process leading bytes up to a word boundary
+    for ( ; len != 0 && (reinterpret_cast<uintptr_t>(p) & 3) != 0 ; --len)
+        crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+    // process eight bytes at a time (this assumes little-endian byte order,
+    // which holds on the Pico and on all of our host platforms)
+    for ( ; len >= 8 ; len -= 8, p += 8)
+    {
+        uint32_t a, b;
+        memcpy(&a, p, 4);
+        memcpy(&b, p + 4, 4);
+        a ^= crc;
+        crc = t[7][a & 0xFF] ^ t[6][(a >> 8) & 0xFF] ^ t[5][(a >> 16) & 0xFF] ^ t[4][a >> 24]
+            ^ t[3][b & 0xFF] ^ t[2][(b >> 8) & 0xFF] ^ t[1][(b >> 16) & 0xFF] ^ t[0][b >> 24];
+    }
+
+    // process the remaining bytes
+    for ( ; len != 0 ; --len)
+        crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+#ifdef PICO_FIRMWARE_BUILD
+
+void CRC32Engine::Init()
+{
+    // claim a DMA channel; if none are available, we'll just use the
+    // software backend for everything
+    dmaChannel = dma_claim_unused_channel(false);
+}
+
+uint32_t CRC32Engine::Calc(const void *data, size_t len, uint32_t crc)
+{
+    // Use the software backend for short buffers, if we don't have a
+    // DMA channel, and on the second core.  The sniffer is a single
+    // shared resource, so we reserve it for the main core, where all of
+    // the large CRC calculations happen.
+    if (len < DMA_MIN_LEN || dmaChannel < 0 || get_core_num() != 0)
+        return CalcSoftware(data, len, crc);
+
+    // Set up the sniffer for CRC-32 with bit-reversed input, which
+    // corresponds to the reflected input of the standard CRC-32, with
+    // the output bit-reversed and inverted to match the reflected output
+    // and final XOR.  The output transforms only apply when reading the
+    // accumulator, so the seed is the raw internal state: the inverted
+    // and bit-reversed previous result.
+    dma_sniffer_enable(dmaChannel, DMA_SNIFF_CTRL_CALC_VALUE_CRC32R, true);
+    dma_sniffer_set_output_reverse_enabled(true);
+    dma_sniffer_set_output_invert_enabled(true);
+    dma_sniffer_set_data_accumulator(SnifferSeed(crc));
+
+    // Run a byte-wide transfer from the buffer into a dummy destination
+    // byte, with the sniffer attached.  Byte transfers handle any buffer
+    // alignment, and the DMA moves one transfer per clock regardless of
+    // the transfer width, so we don't lose anything by not using words.
+    static volatile uint8_t dummy;
+    dma_channel_config cfg = dma_channel_get_default_config(dmaChannel);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_8);
+    channel_config_set_read_increment(&cfg, true);
+    channel_config_set_write_increment(&cfg, false);
+    channel_config_set_sniff_enable(&cfg, true);
+    dma_channel_configure(dmaChannel, &cfg, &dummy, data, len, true);
+    dma_channel_wait_for_finish_blocking(dmaChannel);
+
+    // read the result and release the sniffer
+    uint32_t result = dma_sniffer_get_data_accumulator();
+    dma_sniffer_disable();
+    return result;
+}
+
+#else // PICO_FIRMWARE_BUILD
+
+// host build - software backend only
+void CRC32Engine::Init() { }
+uint32_t CRC32Engine::Calc(const void *data, size_t len, uint32_t crc) { return CalcSoftware(data, len, crc); }
+
+#endif // PICO_FIRMWARE_BUILD
@@ -0,0 +1,81 @@
+// Pinscape Pico - CRC-32 engine
+// Copyright 2024, 2025 Michael J Roberts / BSD-3-Clause license / NO WARRANTY
+//
+// Computes the standard CRC-32 (IEEE 802.3, reflected, as used by zlib,
+// Ethernet, and CRC::CRC_32() in crc32.h), with two backends:
+//
+// - The RP2040 DMA sniffer.  The DMA controller can compute a CRC-32
+//   over the data passing through a DMA channel, in hardware, at the
+//   full DMA rate of one byte per system clock.  We run a memory-to-
+//   memory transfer from the source buffer into a dummy destination
+//   byte, with the sniffer attached, and read back the result.  This
+//   is many times faster than any software implementation on the M0+,
+//   which matters for the large buffers we check at boot (the config
+//   file, the flash file system directory) and during config and
+//   firmware transfers over the vendor interface.
+//
+// - A slice-by-8 software implementation, which processes eight bytes
+//   per step using eight 256-entry lookup tables.  This is used for short
+//   buffers (where the DMA setup overhead dominates), when the DMA
+//   channel isn't available, on the second core (since the sniffer is a
+//   single shared resource), and in host builds, where the DMA backend
+//   is simply compiled out.
+//
+// Both backends produce identical results to CRC::Calculate(data, len,
+// CRC::CRC_32(), crc), including the chaining convention: pass the result
+// of a previous call as 'crc' to continue a CRC across multiple buffers.
+//
+// The CRC::Calculate() call with the bare CRC_32() parameters, which
+// this replaces, computes the CRC bit-by-bit, so even the software
+// fallback here is a large improvement.
+
+#pragma once
+#include <stdlib.h>
+#include <stdint.h>
+
+class CRC32Engine
+{
+public:
+    // Initialize.  Claims a DMA channel for the sniffer backend; if none
+    // is available, all calculations use the software backend.
+    void Init();
+
+    // Calculate a CRC-32 over a buffer, using the fastest available
+    // backend.  'crc' is the result of a previous call, to continue the
+    // calculation across multiple buffers, or 0 to start a new CRC.
+    uint32_t Calc(const void *data, size_t len, uint32_t crc = 0);
+
+    // Calculate a CRC-32 using the slice-by-8 software backend
+    static uint32_t CalcSoftware(const void *data, size_t len, uint32_t crc = 0);
+
+    // DMA sniffer state conversions.  The sniffer's CRC32R mode runs the
+    // non-reflected CRC-32 over bit-reversed data, so its internal state is
+    // the bit-reversed, inverted form of a standard CRC-32 result.
+    // SnifferSeed() converts a previous result into the accumulator seed
+    // that continues it; SnifferResult() is the transform the sniffer's
+    // output-reverse and output-invert options apply when the accumulator
+    // is read.
+    static uint32_t SnifferSeed(uint32_t crc) { return BitReverse32(~crc); }
+    static uint32_t SnifferResult(uint32_t acc) { return ~BitReverse32(acc); }
+
+    // bit-reverse a 32-bit value (the M0+ has no RBIT instruction)
+    static uint32_t BitReverse32(uint32_t x)
+    {
+        x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+        x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+        x = ((x >> 4) & 0x0F0F0F0F) | ((x & 0x0F0F0F0F) << 4);
+        x = ((x >> 8) & 0x00FF00FF) | ((x & 0x00FF00FF) << 8);
+        return (x >> 16) | (x << 16);
+    }
+
+protected:
+    // DMA channel for the sniffer backend, or -1 if not available
+    int dmaChannel = -1;
+
+    // Minimum buffer size for the DMA backend.  Below this, the software
+    // backend is faster, since it doesn't have to set up the DMA channel.
+    static const size_t DMA_MIN_LEN = 64;
+};
+
+// global singleton
+extern CRC32Engine crc32Engine;
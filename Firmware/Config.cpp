@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <memory.h>
+#include <vector>
 
 // Pico SDK headers
 #include <pico/stdlib.h>
@@ -25,9 +26,11 @@
 #include "Pinscape.h"
 #include "Main.h"
 #include "FlashStorage.h"
+#include "SettingsStore.h"
 #include "Config.h"
 #include "JSON.h"
-#include "crc32.h"
+#include "ConfigImage.h"
+#include "CRC32Engine.h"
 #include "Logger.h"
 #include "Watchdog.h"
 #include "Reset.h"
@@ -64,6 +67,8 @@ bool Config::Load(PicoReset::BootMode bootMode, JSONParser &json)
     const char *effectiveConfig = factoryConfig;
     size_t effectiveConfigSize = factoryConfigSize;
     const char *configFileName = nullptr;
+    const char *imageFileName = nullptr;
+    uint32_t configCRC = 0;
 
     // check the boot mode
     switch (bootMode)
@@ -79,6 +84,7 @@ bool Config::Load(PicoReset::BootMode bootMode, JSONParser &json)
         // user's Safe Mode configuration file instead, if one is
         // provided.
         configFileName = SAFE_MODE_CONFIG_FILE_NAME;
+        imageFileName = SAFE_MODE_IMAGE_FILE_NAME;
         isSafeMode = true;
         break;
 
@@ -86,6 +92,7 @@ bool Config::Load(PicoReset::BootMode bootMode, JSONParser &json)
         // Normal mode or Uknown mode - the current boot wasn't caused by
         // an early watchdog crash, so load the full config file as normal.
         configFileName = CONFIG_FILE_NAME;
+        imageFileName = CONFIG_IMAGE_FILE_NAME;
         break;
     }
 
@@ -94,9 +101,12 @@ bool Config::Load(PicoReset::BootMode bootMode, JSONParser &json)
         // open the config file in the flash storage system
         do
         {
-            // try opening the file
+            // Try opening the file.  Skip the file system's CRC check;
+            // we validate the text against our own CRC footer below if we
+            // actually need to parse it, and we don't need to scan the
+            // text at all if we can use the compiled image instead.
             FlashStorage::FileInfo fi;
-            if (auto openStat = flashStorage.OpenRead(configFileName, fi); openStat != FlashStorage::OpenStatus::OK)
+            if (auto openStat = flashStorage.OpenRead(configFileName, fi, false); openStat != FlashStorage::OpenStatus::OK)
             {
                 Log(LOG_INFO, "Config file (%s) not found in flash (status %d); using factory defaults\n",
                     configFileName, static_cast<int>(openStat));
@@ -118,8 +128,17 @@ bool Config::Load(PicoReset::BootMode bootMode, JSONParser &json)
             uint32_t crcStored;
             memcpy(&crcStored, stream + streamSize, sizeof(crcStored));
 
+            // If we have a compiled image of this exact text, load the
+            // image instead of parsing the text.
+            if (LoadImage(imageFileName, crcStored, streamSize, json))
+            {
+                isConfigValid = true;
+                isFactorySettings = false;
+                return true;
+            }
+
             // compute the actual CRC of the stored text, and test for a match
-            uint32_t crcComputed = CRC::Calculate(stream, streamSize, CRC::CRC_32());
+            uint32_t crcComputed = crc32Engine.Calc(stream, streamSize);
             if (crcComputed != crcStored)
             {
                 Log(LOG_ERROR, "Config file integrity check failed (%s, %u bytes, checksum stored %08lx, computed %08lx)\n",
@@ -130,6 +149,7 @@ bool Config::Load(PicoReset::BootMode bootMode, JSONParser &json)
             // Successfully loaded - use the loaded file
             effectiveConfig = stream;
             effectiveConfigSize = streamSize;
+            configCRC = crcStored;
 
             // mark the configuration as valid and using user settings (not factory settings)
             isConfigValid = true;
@@ -141,10 +161,69 @@ bool Config::Load(PicoReset::BootMode bootMode, JSONParser &json)
     // Parse the JSON text contents of the config data
     json.Parse(effectiveConfig, effectiveConfigSize);
 
+    // If we parsed a stored config file without errors, compile it into
+    // an image, so that subsequent boots can skip the parsing step.  We
+    // only get here with a stored file when the image is missing or out
+    // of date, which normally only happens on the first boot after the
+    // host sends a new config file.  Don't bother compiling files with
+    // errors, so that the errors are logged again on each boot.
+    if (!isFactorySettings && json.errors.size() == 0)
+        SaveImage(imageFileName, configCRC, effectiveConfigSize, json);
+
     // success
     return !isFactorySettings;
 }
 
+// Load a compiled config image
+bool Config::LoadImage(const char *imageFileName, uint32_t sourceCRC, uint32_t sourceSize, JSONParser &json)
+{
+    // open the image file; this verifies the file system CRC over the image
+    FlashStorage::FileInfo fi;
+    if (flashStorage.OpenRead(imageFileName, fi) != FlashStorage::OpenStatus::OK)
+        return false;
+
+    // make sure it's a current image for the JSON text
+    uint64_t t0 = time_us_64();
+    if (!ConfigImage::IsCurrent(fi.data, fi.size, sourceCRC, sourceSize))
+    {
+        Log(LOG_INFO, "Config: compiled image (%s) is out of date; parsing JSON source\n", imageFileName);
+        return false;
+    }
+
+    // load it
+    if (!ConfigImage::Load(fi.data, fi.size, sourceCRC, sourceSize, json))
+    {
+        Log(LOG_ERROR, "Config: compiled image (%s) is invalid; parsing JSON source\n", imageFileName);
+        return false;
+    }
+
+    // success
+    Log(LOG_CONFIG, "Config: loaded compiled image (%s, %lu bytes), %llu us\n",
+        imageFileName, fi.size, time_us_64() - t0);
+    return true;
+}
+
+// Compile and save a config image
+bool Config::SaveImage(const char *imageFileName, uint32_t sourceCRC, uint32_t sourceSize, const JSONParser &json)
+{
+    // compile the image
+    std::vector<uint8_t> image;
+    ConfigImage::Compile(json.rootValue, sourceCRC, sourceSize, image);
+
+    // Queue it as a background write, so that we don't stall startup
+    // on the flash operations.  Reserve space for the image plus 25%
+    // headroom, rounded up to a whole sector, so that a modest edit to
+    // the config can usually rewrite the image in place.
+    size_t reserveSize = image.size() + image.size()/4;
+    reserveSize = (reserveSize + FLASH_SECTOR_SIZE - 1) & ~(FLASH_SECTOR_SIZE - 1);
+    if (!SaveStructAsync(imageFileName, image.data(), image.size(), reserveSize))
+        return false;
+
+    // success
+    Log(LOG_CONFIG, "Config: queued compiled image save (%s, %u bytes)\n", imageFileName, image.size());
+    return true;
+}
+
 // ---------------------------------------------------------------------------
 //
 // Get the stored config file checksum.  The checksum is stored as a 32-bit
@@ -202,7 +281,7 @@ bool Config::IsConfigFileValid(uint8_t fileID, uint32_t *pChecksum)
     memcpy(&crcStored, fi.data + textSize, sizeof(crcStored));
 
     // compute the checksum over the stored data
-    uint32_t crcComputed = CRC::Calculate(fi.data, textSize, CRC::CRC_32());
+    uint32_t crcComputed = crc32Engine.Calc(fi.data, textSize);
 
     // if desired, pass back the computed checksum
     if (pChecksum != nullptr)
@@ -402,6 +481,8 @@ bool Config::EraseConfig(uint8_t fileID)
         // wasn't there to start with.
         bool ok = flashStorage.Remove(CONFIG_FILE_NAME, true);
         ok = flashStorage.Remove(SAFE_MODE_CONFIG_FILE_NAME, true) && ok;
+        ok = flashStorage.Remove(CONFIG_IMAGE_FILE_NAME, true) && ok;
+        ok = flashStorage.Remove(SAFE_MODE_IMAGE_FILE_NAME, true) && ok;
         return ok;
     }
 
@@ -413,6 +494,12 @@ bool Config::EraseConfig(uint8_t fileID)
     // discard the file from cache
     readCache.Clear(filename);
 
+    // delete the compiled image along with the source, since it's useless
+    // without the source
+    const char *imageFileName = (fileID == PinscapePico::VendorRequest::CONFIG_FILE_SAFE_MODE ?
+        SAFE_MODE_IMAGE_FILE_NAME : CONFIG_IMAGE_FILE_NAME);
+    flashStorage.Remove(imageFileName, true);
+
     // delete the file, using "silent" mode (no error if it doesn't already exist)
     return flashStorage.Remove(filename, true);
 }
@@ -428,7 +515,7 @@ bool Config::FactoryReset()
 
     // Reformat and remount the FlashStorage file system
     bool ok = flashStorage.Format(FLASHSTORAGE_CENTRAL_DIRECTORY_SIZE);
-    if (!flashStorage.Mount(FLASHSTORAGE_CENTRAL_DIRECTORY_SIZE))
+    if (!flashStorage.Mount(FLASHSTORAGE_CENTRAL_DIRECTORY_SIZE) || !settingsStore.Mount())
         ok = false;
 
     // still alive
@@ -479,6 +566,45 @@ bool Config::SaveStruct(const char *name, const void *src, size_t sizeofStruct,
     return ok;
 }
 
+bool Config::SaveStructAsync(const char *name, const void *src, size_t sizeofStruct, size_t reserveSize)
+{
+    // queue the write, using the larger of the struct size or reserve size
+    // as the allocation size, as in SaveStruct()
+    if (!flashStorage.QueueWrite(name, src, sizeofStruct, std::max(sizeofStruct, reserveSize)))
+    {
+        Log(LOG_ERROR, "Error saving struct '%s': unable to queue background write\n", name);
+        return false;
+    }
+
+    // success
+    return true;
+}
+
+bool Config::SaveSettings(const char *name, const void *src, size_t sizeofStruct)
+{
+    // save to the settings store if possible
+    if (settingsStore.Put(name, src, sizeofStruct))
+        return true;
+
+    // fall back on a struct file
+    Log(LOG_WARNING, "Settings store unavailable for '%s'; saving as a struct file\n", name);
+    return SaveStructAsync(name, src, sizeofStruct, FLASH_SECTOR_SIZE);
+}
+
+bool Config::LoadSettings(const char *name, void *dst, size_t sizeofStruct, bool *fileExists)
+{
+    // try the settings store first
+    if (settingsStore.Get(name, dst, sizeofStruct))
+    {
+        if (fileExists != nullptr)
+            *fileExists = true;
+        return true;
+    }
+
+    // not in the store - try a struct file from an older firmware version
+    return LoadStruct(name, dst, sizeofStruct, fileExists);
+}
+
 bool Config::LoadStruct(const char *name, void *dst, size_t sizeofStruct, bool *fileExists)
 {
     // Zero the caller's struct.  This guarantees that fields we don't
@@ -226,6 +226,28 @@ public:
     bool LoadStruct(const char *name, void *dst, size_t sizeofStruct, bool *fileExists = nullptr);
     bool SaveStruct(const char *name, const void *src, size_t sizeofStruct, size_t reserveSize);
 
+    // Save a struct as a background flash write.  This works like
+    // SaveStruct(), but the write is carried out incrementally from the
+    // main loop (see FlashStorage::QueueWrite()), so the caller doesn't
+    // stall for the duration of the flash operations.  The struct is
+    // copied, so the caller's copy can be modified immediately.  Returns
+    // true if the write was queued; errors that occur during the write
+    // itself are logged.  This is intended for settings that can be
+    // committed while the device is in use, such as calibration data.
+    bool SaveStructAsync(const char *name, const void *src, size_t sizeofStruct, size_t reserveSize);
+
+    // Save/load a frequently committed settings struct.  These work like
+    // SaveStruct() and LoadStruct(), but store the struct as a record in
+    // the wear-levelled settings store (see SettingsStore.h), which turns
+    // each commit into a page program rather than a sector erase, and
+    // can't lose the previous copy if the write is interrupted.  If the
+    // settings store isn't available, these fall back on the regular
+    // struct files.  On load, if the store doesn't have a record for
+    // the name yet, we look for a struct file saved by an older firmware
+    // version, so that existing settings carry over after an update.
+    bool LoadSettings(const char *name, void *dst, size_t sizeofStruct, bool *fileExists = nullptr);
+    bool SaveSettings(const char *name, const void *src, size_t sizeofStruct);
+
 protected:
     // Is the configuration existant and valid?
     bool isConfigValid = false;
@@ -250,6 +272,22 @@ protected:
     constexpr static const char *CONFIG_FILE_NAME = "config.json";
     constexpr static const char *SAFE_MODE_CONFIG_FILE_NAME = "safemode.json";
 
+    // Compiled config image file names - normal and safe mode.  These
+    // hold the ConfigImage binary form of the corresponding JSON file,
+    // generated automatically on the first boot after the JSON file
+    // changes.  See ConfigImage.h.
+    constexpr static const char *CONFIG_IMAGE_FILE_NAME = "config.img";
+    constexpr static const char *SAFE_MODE_IMAGE_FILE_NAME = "safemode.img";
+
+    // Try loading the compiled image for a config file.  Returns true
+    // if the image exists, is valid, and matches the JSON source text
+    // identified by the CRC and size.
+    bool LoadImage(const char *imageFileName, uint32_t sourceCRC, uint32_t sourceSize, JSONParser &json);
+
+    // Compile the parsed config and save it as an image file.  The save
+    // is queued as a background flash write, so it doesn't hold up boot.
+    bool SaveImage(const char *imageFileName, uint32_t sourceCRC, uint32_t sourceSize, const JSONParser &json);
+
     // Last config file requested through GetConfigFileText().  We use
     // this to cache an 'open'.  Since opens are stateless in the mini
     // file system, it doesn't cost anything to keep the last open file
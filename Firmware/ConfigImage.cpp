@@ -0,0 +1,339 @@
+// Pinscape Pico - Compiled configuration image
+// Copyright 2024, 2025 Michael J Roberts / BSD-3-Clause license / NO WARRANTY
+//
+
+// standard library headers
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unordered_map>
+#include <vector>
+
+// local project headers
+#include "JSON.h"
+#include "ConfigImage.h"
+
+// ---------------------------------------------------------------------------
+//
+// Compiler
+//
+
+struct ConfigImage::Compiler
+{
+    Compiler(std::vector<uint8_t> &image) : image(image) { }
+
+    // output image
+    std::vector<uint8_t> &image;
+
+    // Interned strings, keyed by string text.  The keys point into
+    // the parse tree's string storage, which remains valid for the
+    // duration of the compilation.
+    using StringWithLen = JSONParser::Value::StringWithLen;
+    std::unordered_map<StringWithLen, uint32_t, StringWithLen::HashFunc, StringWithLen::EqualsFunc> strings;
+
+    // number of value nodes emitted
+    uint32_t nValues = 0;
+
+    // current output offset
+    uint32_t Offset() const { return static_cast<uint32_t>(image.size()); }
+
+    // append bytes, padding to a 4-byte boundary
+    void Put(const void *data, size_t len)
+    {
+        const uint8_t *p = reinterpret_cast<const uint8_t*>(data);
+        image.insert(image.end(), p, p + len);
+        while ((image.size() & 3) != 0)
+            image.push_back(0);
+    }
+
+    // append a 32-bit word
+    void Put32(uint32_t w) { Put(&w, sizeof(w)); }
+
+    // append a tag word, returning the node offset
+    uint32_t PutTag(uint8_t type, uint32_t count)
+    {
+        uint32_t ofs = Offset();
+        Put32((count << 8) | type);
+        return ofs;
+    }
+
+    // emit a string node, or find the existing interned copy
+    uint32_t EmitString(const StringWithLen &s)
+    {
+        if (auto it = strings.find(s); it != strings.end())
+            return it->second;
+
+        uint32_t ofs = PutTag(NodeString, static_cast<uint32_t>(s.len));
+        Put(s.txt, s.len);
+        strings.emplace(s, ofs);
+        return ofs;
+    }
+
+    // Emit a value node.  Child nodes are always emitted before their
+    // parent, so every child offset in the image is lower than the
+    // offset of the node that refers to it.  The loader relies on this
+    // to guarantee termination even on a corrupted image.
+    uint32_t EmitValue(const JSONParser::Value &v)
+    {
+        using Type = JSONParser::Value::Type;
+        nValues += 1;
+        switch (v.type)
+        {
+        case Type::Null:
+            return PutTag(NodeNull, 0);
+
+        case Type::True:
+            return PutTag(NodeTrue, 0);
+
+        case Type::False:
+            return PutTag(NodeFalse, 0);
+
+        case Type::Number:
+            {
+                uint32_t ofs = PutTag(NodeNumber, 0);
+                Put(&v.number, sizeof(v.number));
+                return ofs;
+            }
+
+        case Type::String:
+            return EmitString(v.string);
+
+        case Type::Array:
+            {
+                // emit the elements first, collecting their offsets
+                std::vector<uint32_t> eles;
+                eles.reserve(v.Length());
+                v.ForEach([this, &eles](int, const JSONParser::Value *ele) { eles.push_back(EmitValue(*ele)); });
+
+                // now emit the array node with the element list
+                uint32_t ofs = PutTag(NodeArray, static_cast<uint32_t>(eles.size()));
+                Put(eles.data(), eles.size() * sizeof(uint32_t));
+                return ofs;
+            }
+
+        case Type::Object:
+            {
+                // The property map is a linked list in reverse order of
+                // definition, so gather the list and emit it backwards.
+                // This stores properties in source order, which the loader
+                // re-reverses as it rebuilds the list, so the loaded tree
+                // iterates in exactly the same order as a parsed tree.
+                std::vector<const JSONParser::PropMap::Prop*> props;
+                for (auto *prop = v.object->props ; prop != nullptr ; prop = prop->nxt)
+                    props.push_back(prop);
+
+                std::vector<uint32_t> pairs;
+                pairs.reserve(props.size() * 2);
+                for (auto it = props.rbegin() ; it != props.rend() ; ++it)
+                {
+                    pairs.push_back(EmitString((*it)->name));
+                    pairs.push_back(EmitValue((*it)->val));
+                }
+
+                uint32_t ofs = PutTag(NodeObject, static_cast<uint32_t>(props.size()));
+                Put(pairs.data(), pairs.size() * sizeof(uint32_t));
+                return ofs;
+            }
+
+        default:
+            return PutTag(NodeUndefined, 0);
+        }
+    }
+};
+
+void ConfigImage::Compile(const JSONParser::Value &root, uint32_t sourceCRC, uint32_t sourceSize, std::vector<uint8_t> &image)
+{
+    // start with a placeholder header
+    Header hdr{ 0 };
+    image.clear();
+    image.resize(sizeof(Header));
+
+    // emit the tree
+    Compiler c(image);
+    uint32_t rootOffset = c.EmitValue(root);
+
+    // fill in the real header
+    hdr.magic = Header::MAGIC;
+    hdr.version = Header::VERSION;
+    hdr.headerSize = sizeof(Header);
+    hdr.sourceCRC = sourceCRC;
+    hdr.sourceSize = sourceSize;
+    hdr.imageSize = static_cast<uint32_t>(image.size());
+    hdr.nValues = c.nValues;
+    hdr.rootOffset = rootOffset;
+    memcpy(image.data(), &hdr, sizeof(hdr));
+}
+
+// ---------------------------------------------------------------------------
+//
+// Loader
+//
+
+bool ConfigImage::IsCurrent(const void *image, size_t imageSize, uint32_t sourceCRC, uint32_t sourceSize)
+{
+    // the image has to be big enough for the header
+    if (image == nullptr || imageSize < sizeof(Header))
+        return false;
+
+    // check the header fields
+    Header hdr;
+    memcpy(&hdr, image, sizeof(hdr));
+    return hdr.magic == Header::MAGIC
+        && hdr.version == Header::VERSION
+        && hdr.headerSize == sizeof(Header)
+        && hdr.imageSize == imageSize
+        && hdr.rootOffset >= sizeof(Header)
+        && hdr.rootOffset < imageSize
+        && hdr.sourceCRC == sourceCRC
+        && hdr.sourceSize == sourceSize;
+}
+
+bool ConfigImage::Load(const void *image, size_t imageSize, uint32_t sourceCRC, uint32_t sourceSize, JSONParser &json)
+{
+    // clear any existing tree
+    json.rootValue.Reset();
+
+    // validate the header
+    if (!IsCurrent(image, imageSize, sourceCRC, sourceSize))
+        return false;
+
+    // load the tree, starting at the root node
+    Header hdr;
+    memcpy(&hdr, image, sizeof(hdr));
+    Loader loader(reinterpret_cast<const uint8_t*>(image), imageSize, json);
+    if (!loader.LoadValue(hdr.rootOffset, json.rootValue))
+    {
+        json.rootValue.Reset();
+        return false;
+    }
+
+    // success
+    return true;
+}
+
+bool ConfigImage::Loader::Word(uint32_t ofs, uint32_t &w) const
+{
+    if ((ofs & 3) != 0 || ofs + sizeof(uint32_t) > size)
+        return false;
+
+    memcpy(&w, base + ofs, sizeof(w));
+    return true;
+}
+
+bool ConfigImage::Loader::LoadString(uint32_t ofs, const char* &txt, size_t &len) const
+{
+    uint32_t tag;
+    if (!Word(ofs, tag) || (tag & 0xFF) != NodeString || ofs + 4 + (tag >> 8) > size)
+        return false;
+
+    txt = reinterpret_cast<const char*>(base + ofs + 4);
+    len = tag >> 8;
+    return true;
+}
+
+bool ConfigImage::Loader::LoadValue(uint32_t ofs, JSONParser::Value &value)
+{
+    using Type = JSONParser::Value::Type;
+
+    // read the tag
+    uint32_t tag;
+    if (!Word(ofs, tag))
+        return false;
+
+    uint32_t count = tag >> 8;
+    switch (tag & 0xFF)
+    {
+    case NodeUndefined:
+        value.Set(Type::Undefined);
+        return true;
+
+    case NodeNull:
+        value.Set(Type::Null);
+        return true;
+
+    case NodeTrue:
+        value.Set(Type::True);
+        return true;
+
+    case NodeFalse:
+        value.Set(Type::False);
+        return true;
+
+    case NodeNumber:
+        {
+            double d;
+            if (ofs + 4 + sizeof(d) > size)
+                return false;
+
+            memcpy(&d, base + ofs + 4, sizeof(d));
+            value.Set(d);
+            return true;
+        }
+
+    case NodeString:
+        {
+            const char *txt;
+            size_t len;
+            if (!LoadString(ofs, txt, len))
+                return false;
+
+            value.Set(txt, len);
+            return true;
+        }
+
+    case NodeArray:
+        {
+            // make sure the element list fits
+            if (ofs + 4 + count*4 > size)
+                return false;
+
+            // load the elements
+            if (!json.InitArray(value, count))
+                return false;
+            for (uint32_t i = 0 ; i < count ; ++i)
+            {
+                // Children always precede their parents in a well-formed
+                // image, which rules out cycles in a corrupted one.
+                uint32_t eleOfs;
+                Word(ofs + 4 + i*4, eleOfs);
+                if (eleOfs >= ofs)
+                    return false;
+
+                if (!LoadValue(eleOfs, *value.array->Ele(i)))
+                    return false;
+            }
+            return true;
+        }
+
+    case NodeObject:
+        {
+            // make sure the property list fits
+            if (ofs + 4 + count*8 > size)
+                return false;
+
+            // load the properties
+            if (!json.InitObject(value))
+                return false;
+            for (uint32_t i = 0 ; i < count ; ++i)
+            {
+                uint32_t nameOfs, valOfs;
+                Word(ofs + 4 + i*8, nameOfs);
+                Word(ofs + 8 + i*8, valOfs);
+                const char *name;
+                size_t nameLen;
+                if (nameOfs >= ofs || valOfs >= ofs || !LoadString(nameOfs, name, nameLen))
+                    return false;
+
+                JSONParser::Token tok;
+                auto *prop = value.object->emplace(&json, JSONParser::Value::StringWithLen(name, nameLen), tok, Type::Undefined);
+                if (prop == nullptr || !LoadValue(valOfs, prop->val))
+                    return false;
+            }
+            return true;
+        }
+
+    default:
+        // unknown node type
+        return false;
+    }
+}
@@ -0,0 +1,144 @@
+// Pinscape Pico - Compiled configuration image
+// Copyright 2024, 2025 Michael J Roberts / BSD-3-Clause license / NO WARRANTY
+//
+// A compiled configuration image is a binary snapshot of a parsed JSON
+// configuration file.  It contains the same value tree that the JSON
+// parser produces, but in a typed, offset-indexed binary form that can
+// be loaded without any text processing: no tokenizing, no comment
+// skipping, no number parsing, and no string escape expansion.  Strings
+// and property names in the loaded tree point directly into the image,
+// so when the image is stored in flash, the loaded tree references the
+// text through the XIP (execute-in-place) memory window rather than
+// making RAM copies.
+//
+// The JSON text remains the source of truth.  The image is strictly a
+// cache: it records the CRC-32 and size of the JSON text it was compiled
+// from, and the loader only accepts it if those match the current JSON
+// file.  Any change to the JSON file thus invalidates the image, and the
+// next boot falls back on parsing the text, and then compiles a fresh
+// image for subsequent boots.
+//
+// This module has no Pico SDK dependencies, so the compiler can also be
+// used on the host side, to produce an image alongside a JSON file.
+//
+// Image layout
+//
+// The image starts with a Header struct.  Everything after the header
+// is a series of nodes, each aligned on a 4-byte boundary and identified
+// by its byte offset from the start of the image.  Each node starts with
+// a 32-bit tag word, with the value type in the low 8 bits, and a count
+// in the high 24 bits.  The count's meaning depends on the type:
+//
+//   Undefined, Null, True, False - no count, no payload
+//   Number  - payload is an 8-byte IEEE double
+//   String  - count = length in bytes; payload is the string bytes,
+//             padded to a 4-byte boundary
+//   Array   - count = number of elements; payload is an array of
+//             uint32_t node offsets, one per element
+//   Object  - count = number of properties; payload is an array of
+//             uint32_t pairs, { name string node offset, value node offset }
+//
+// Strings (both values and property names) are interned at compile time,
+// so each distinct string appears in the image only once.  That makes the
+// image considerably more compact than the source text, since property
+// names such as "type" and "gpio" repeat throughout a typical file.
+//
+
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+#include "JSON.h"
+
+class ConfigImage
+{
+public:
+    // image header
+    struct Header
+    {
+        // signature - identifies the data as a configuration image
+        uint32_t magic;
+        static const uint32_t MAGIC = 0x4D494350;  // "PCIM" in little-endian byte order
+
+        // format version; bump this on any incompatible layout change
+        uint16_t version;
+        static const uint16_t VERSION = 1;
+
+        // size of this header struct, for forward compatibility
+        uint16_t headerSize;
+
+        // CRC-32 and size of the JSON source text the image was compiled
+        // from (excluding the CRC footer that Config appends to the file)
+        uint32_t sourceCRC;
+        uint32_t sourceSize;
+
+        // total image size, including this header
+        uint32_t imageSize;
+
+        // total number of value nodes in the tree
+        uint32_t nValues;
+
+        // offset of the root value node
+        uint32_t rootOffset;
+    };
+
+    // Compile a parsed JSON value tree into an image.  sourceCRC and
+    // sourceSize identify the JSON text the tree was parsed from; the
+    // loader uses these to determine whether the image is current.
+    // Replaces the contents of 'image'.
+    static void Compile(const JSONParser::Value &root, uint32_t sourceCRC, uint32_t sourceSize, std::vector<uint8_t> &image);
+
+    // Check an image header for validity against the given source text
+    // CRC and size.  Returns true if the image appears to be a well-formed
+    // image compiled from the specified source.
+    static bool IsCurrent(const void *image, size_t imageSize, uint32_t sourceCRC, uint32_t sourceSize);
+
+    // Load an image into a JSON parser object, replacing any existing
+    // parse tree.  The loaded tree contains pointers into the image, so
+    // the image memory must remain valid for the lifetime of the tree;
+    // this is the same rule that applies to source text passed to
+    // JSONParser::Parse().  Returns true on success, false if the image
+    // is stale or invalid, in which case the parser is left with an
+    // empty tree.
+    static bool Load(const void *image, size_t imageSize, uint32_t sourceCRC, uint32_t sourceSize, JSONParser &json);
+
+protected:
+    // node type codes, stored in the low byte of the tag word
+    enum NodeType : uint8_t
+    {
+        NodeUndefined = 0,
+        NodeNull = 1,
+        NodeTrue = 2,
+        NodeFalse = 3,
+        NodeNumber = 4,
+        NodeString = 5,
+        NodeArray = 6,
+        NodeObject = 7,
+    };
+
+    // compiler context
+    struct Compiler;
+
+    // Loader context
+    struct Loader
+    {
+        Loader(const uint8_t *base, size_t size, JSONParser &json) : base(base), size(size), json(json) { }
+
+        // image base pointer and size
+        const uint8_t *base;
+        size_t size;
+
+        // target parser
+        JSONParser &json;
+
+        // read a word at a given offset; returns false if out of bounds
+        bool Word(uint32_t ofs, uint32_t &w) const;
+
+        // load a value node into a parser value
+        bool LoadValue(uint32_t ofs, JSONParser::Value &value);
+
+        // load a string node, returning pointer and length
+        bool LoadString(uint32_t ofs, const char* &txt, size_t &len) const;
+    };
+};
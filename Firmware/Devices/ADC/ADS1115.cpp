@@ -52,6 +52,8 @@ static int FormatBinary(int val, int shift, int bits)
 //   ready: <gpNumber>,   // GPIO port connected to ALERT/RDY pin; optional, can be shared by multiple chips
 //   channel: 0,          // input channel number, AINx (0 = AIN0 through 3 = AIN3), or a list of channels to read from
 //   sampleRate: 860,     // sampling rate, in samples per second
+//   streaming: true,     // use RDY-driven streaming mode when ALERT/RDY is connected (default false)
+//   average: 1,          // number of recent samples to average for each reading, 1 to 16 (default 1 = no averaging)
 // }
 //
 // 'channel' can be set to a single channel number or a list of channel
@@ -76,6 +78,22 @@ static int FormatBinary(int val, int shift, int bits)
 // 128, 250, 474, 860).  The actual rate will be set to the allowed rate
 // that's closest to the requested rate.
 //
+// Streaming mode requires the ALERT/RDY pin to be connected to a GPIO
+// that isn't shared with another ADS1115, since we have to be able to
+// attribute each RDY edge to this chip alone.  In streaming mode, the
+// RDY edge raises a priority I2C request, and we read the result
+// directly, without polling the config register.  A single-channel
+// configuration runs the chip in continuous conversion mode; a
+// multi-channel scan rotates the MUX and starts the next conversion in
+// the same transaction that reads the result.  Streaming is off by
+// default, so it has to be enabled with streaming:true.  If it's not
+// enabled, or the pin is shared or not connected, we poll the config
+// register for conversion completion as before.
+//
+// 'average' reports each reading as the average of the most recent N
+// samples on the channel, from a per-channel sample ring.  The reading's
+// timestamp is the midpoint of the averaged samples' timestamps.
+//
 void ADS1115::Configure(JSONParser &json)
 {
     if (auto *val = json.Get("ads1115") ; !val->IsUndefined())
@@ -101,11 +119,19 @@ void ADS1115::Configure(JSONParser &json)
             // get the READY port and sample rate
             int gpReady = value->Get("ready")->Int(-1);
             int sampleRate = value->Get("sampleRate")->Int(860);
+            bool streaming = value->Get("streaming")->Bool(false);
+            int nAverage = value->Get("average")->Int(1);
+            if (nAverage < 1 || nAverage > LogicalChannel::RING_SIZE)
+            {
+                Log(LOG_ERROR, "ads1115[%d]: invalid 'average' value %d; must be 1 to %d\n", index, nAverage, LogicalChannel::RING_SIZE);
+                return;
+            }
 
             // create the new chip object (tentatively - we could still fail)
             std::unique_ptr<ADS1115> chipHolder(new ADS1115(index, addr, gpReady));
             ADS1115 *chip = chipHolder.get();
             chip->desiredSamplesPerSecond = sampleRate;
+            chip->nAverage = nAverage;
 
             // look up the sampling rate to get the DR bits in the config register
             static int availableSpeeds[] = { 8, 16, 32, 64, 128, 250, 474, 860 };
@@ -125,6 +151,9 @@ void ADS1115::Configure(JSONParser &json)
                 // the config register
                 chip->drBits = best;
                 chip->samplesPerSecond = availableSpeeds[best];
+
+                // set the streaming timeout to several conversion periods
+                chip->streamTimeout = 4000000 / chip->samplesPerSecond + 10000;
             }
 
             // get the channel number or list
@@ -268,6 +297,24 @@ void ADS1115::Configure(JSONParser &json)
                 gpio_add_raw_irq_handler(gpReady, thunkManager.Create(&ADS1115::IRQ, chip));
                 gpio_set_irq_enabled(gpReady, GPIO_IRQ_EDGE_FALL, true);
                 irq_set_enabled(IO_IRQ_BANK0, true);
+
+                // Streaming mode requires a dedicated RDY line, since a shared
+                // line doesn't tell us which chip finished.  If another chip
+                // already uses this line, disable streaming on both.  (Sampling
+                // doesn't start until after configuration, so it's not too late
+                // to change the earlier chip's mode.)
+                chip->streaming = streaming;
+                for (int i = 0 ; i < nChipsConfigured ; ++i)
+                {
+                    if (chips[i] != nullptr && chips[i]->gpAlertRdy == gpReady)
+                    {
+                        if (chips[i]->streaming || streaming)
+                            Log(LOG_WARNING, "ads1115[%d]: ALERT/RDY GP%d is shared with ads1115[%d]; streaming mode disabled on both chips\n", index, gpReady, i);
+
+                        chips[i]->streaming = false;
+                        chip->streaming = false;
+                    }
+                }
             }
 
             // looks good - add the chip to the ADC manager's list
@@ -287,10 +334,11 @@ void ADS1115::Configure(JSONParser &json)
             char readyTxt[20];
             sprintf(readyTxt, gpReady >= 0 ? "GP%d" : "not connected", gpReady);
             Log(LOG_CONFIG, "ADS1115[%d] configured on I2C%d addr 0x%02X, ALERT/READY %s, %d samples/second (DR=%03d), "
-                "full-scale voltage range +/- %.3fV (PGA=%03d)\n",
+                "full-scale voltage range +/- %.3fV (PGA=%03d), %s mode, averaging %d\n",
                 index, bus, addr, readyTxt,
                 chip->samplesPerSecond, FormatBinary(chip->drBits, 0, 3),
-                pgaVoltages[chip->pga], FormatBinary(chip->pga, 0, 3));
+                pgaVoltages[chip->pga], FormatBinary(chip->pga, 0, 3),
+                chip->streaming ? "streaming" : "polling", chip->nAverage);
 
         }, true);
 
@@ -460,12 +508,28 @@ void ADS1115::EnableSampling()
         configHi &= ~MUX_MASK;
         configHi |= (logicalChannel[0].mux << 4);
         
+        // Select the conversion mode.  In streaming mode with a single
+        // channel, the chip free-runs in continuous conversion mode, since
+        // there's never a MUX change to synchronize with.  Otherwise, we
+        // run single-shot conversions, so that we know exactly which MUX
+        // setting each result comes from.
+        if (streaming && nLogicalChannels == 1)
+            configHi &= ~MODE_BIT;
+        else
+            configHi |= MODE_BIT;
+
         // start the first single-shot sample by writing OS (bit 0x80) to Config High
+        // (this has no effect in continuous mode, where writing the register is
+        // sufficient to start conversions)
         configHi |= OS_BIT;
 
         // schedule a register update at the next I2C bus access opening
         configChangePending = true;
 
+        // discard any stale RDY signal and pending streaming read
+        alertReadyFlag = false;
+        streamReadChannel = -1;
+
         // reset sampling statistics
         tStatsReset = time_us_64();
         for (int i = 0 ; i < nLogicalChannels ; ++i)
@@ -476,11 +540,28 @@ void ADS1115::EnableSampling()
 // Read the latest sample in native units
 ADC::Sample ADS1115::ReadNative(int ch)
 {
-    // return the latest sample from the selected channel, if valid
-    if (ch >= 0 && ch < nLogicalChannels)
-        return logicalChannel[ch].raw;
-    else
+    // validate the channel
+    if (ch < 0 || ch >= nLogicalChannels)
         return { 0, 0 };
+
+    // if averaging is disabled, or we don't have any samples yet, return the latest sample
+    auto &lc = logicalChannel[ch];
+    int n = std::min(nAverage, lc.ringCount);
+    if (n <= 1)
+        return lc.raw;
+
+    // average the most recent N samples from the ring, and use the midpoint
+    // of the oldest and newest timestamps as the timestamp for the average
+    int32_t sum = 0;
+    int idx = lc.ringWrite;
+    for (int i = 0 ; i < n ; ++i)
+    {
+        idx = (idx + LogicalChannel::RING_SIZE - 1) % LogicalChannel::RING_SIZE;
+        sum += lc.ring[idx].sample;
+    }
+    uint64_t tNewest = lc.raw.timestamp;
+    uint64_t tOldest = lc.ring[idx].timestamp;
+    return { sum / n, tOldest + (tNewest - tOldest)/2 };
 }
 
 // Read the latest sample in normalized UINT16 units (0..65535)
@@ -491,7 +572,7 @@ ADC::Sample ADS1115::ReadNorm(int ch)
     {
         // valid - the native range is -32768..+32767, so we simply
         // shift the range up to normalize it to 0..65535
-        auto &r = logicalChannel[ch].raw;
+        auto r = ReadNative(ch);
         return { r.sample + 32768, r.timestamp };
     }
     else
@@ -516,6 +597,12 @@ void ADS1115::IRQ()
         if (curSamplingChannel >= 0)
             logicalChannel[curSamplingChannel].stats.tConvToIrqSum += t - tCurSampleStarted;
 
+        // in streaming mode, request the bus ahead of the normal rotation,
+        // so that we read the result (and start the next conversion, in a
+        // multi-channel scan) as quickly as possible
+        if (streaming)
+            i2cPriorityRequest = true;
+
         // acknowledge the interrupt
         gpio_acknowledge_irq(gpAlertRdy, GPIO_IRQ_EDGE_FALL);
     }
@@ -542,6 +629,81 @@ bool ADS1115::OnI2CReady(I2CX *i2c)
         configChangePending = false;
     }
 
+    // Streaming mode: the RDY edge tells us that a new result is ready,
+    // so read it directly, without checking the config register
+    if (streaming)
+    {
+        uint64_t now = time_us_64();
+        if (alertReadyFlag && curSamplingChannel >= 0)
+        {
+            // clear the alert/ready flag
+            alertReadyFlag = false;
+
+            // note the channel and completion time of the result we're reading
+            auto *ch = &logicalChannel[curSamplingChannel];
+            streamReadChannel = curSamplingChannel;
+            tStreamReadIRQ = irqStats.tIRQ;
+            streamConvTime = tStreamReadIRQ - tCurSampleStarted;
+            ch->stats.AddPoll(now - tStreamReadIRQ);
+
+            // read the conversion register - register 0x00, receive length 2 bytes
+            uint8_t buf[] = { CONV_REG_ADDR };
+            b.AddRead(buf, _countof(buf), 2);
+
+            if (nLogicalChannels > 1)
+            {
+                // Multi-channel scan: rotate the MUX to the next logical channel
+                // and start its single-shot conversion in the same transaction.
+                // The conversion register holds the result we just read until
+                // the new conversion completes, so the read above gets the
+                // current channel's result regardless of write timing.
+                if (++ch, ++curSamplingChannel >= nLogicalChannels)
+                    curSamplingChannel = 0, ch = &logicalChannel[0];
+
+                configHi &= ~MUX_MASK;
+                configHi |= (ch->mux << 4) | OS_BIT;
+                uint8_t cfg[] = { CONFIG_REG_ADDR, configHi, configLo };
+                b.AddWrite(cfg, _countof(cfg));
+
+                // the config write supersedes any pending change
+                configChangePending = false;
+
+                // the next conversion starts when this transaction completes
+                tCurSampleStarted = now;
+            }
+            else
+            {
+                // continuous mode - the next conversion started at the RDY edge
+                tCurSampleStarted = tStreamReadIRQ;
+            }
+        }
+        else if (curSamplingChannel >= 0 && b.n == 0 && now - tCurSampleStarted > streamTimeout)
+        {
+            // No RDY edge within the timeout.  Rewrite the config register to
+            // restart the conversion cycle, in case a transaction was lost.
+            // Skip this if we already queued a config write on this pass,
+            // since that restarts the cycle anyway; this includes the
+            // initial config write after sampling is enabled, before
+            // tCurSampleStarted has been set.
+            uint8_t cfg[] = { CONFIG_REG_ADDR, configHi, configLo };
+            b.AddWrite(cfg, _countof(cfg));
+            tCurSampleStarted = now;
+            ++streamTimeouts;
+        }
+
+        // note the start time when sending the initial config
+        if (b.n != 0 && streamReadChannel < 0)
+            tCurSampleStarted = now;
+
+        // if we queued any work, fire off the transaction batch
+        if (b.n != 0)
+        {
+            i2c->MultiReadWrite(b);
+            return true;
+        }
+        return false;
+    }
+
     // Check to see if a sample is ready.
     //
     // If ALERT/RDY is connected to a GPIO, we can use the ALERT/RDY
@@ -592,6 +754,21 @@ bool ADS1115::OnI2CReceive(const uint8_t *data, size_t len, I2CX *i2c)
     // note the time the sample was received
     uint64_t tReceived = time_us_64();
 
+    // Streaming mode reads just the conversion register.  The result
+    // belongs to the channel noted when we queued the read, and its
+    // timestamp is the RDY edge time, which marks the end of the
+    // conversion more precisely than our receive time.
+    if (streaming)
+    {
+        if (len != 2 || streamReadChannel < 0)
+            return false;
+
+        auto *ch = &logicalChannel[streamReadChannel];
+        ch->AddSample({ static_cast<int16_t>((static_cast<uint16_t>(data[0]) << 8) | data[1]), tStreamReadIRQ });
+        ch->stats.AddConv(streamConvTime, tReceived - tStreamReadIRQ);
+        return false;
+    }
+
     // We always do a batch read, with the config register followed by
     // the conversion register, two bytes each.
     if (len != 4)
@@ -610,7 +787,7 @@ bool ADS1115::OnI2CReceive(const uint8_t *data, size_t len, I2CX *i2c)
         // so we have to take care with the order of casting to ensure
         // that the value is sign-extended before widening.
         auto *ch = &logicalChannel[curSamplingChannel];
-        ch->raw = { static_cast<int16_t>((static_cast<uint16_t>(data[2]) << 8) | data[3]), tReceived };
+        ch->AddSample({ static_cast<int16_t>((static_cast<uint16_t>(data[2]) << 8) | data[3]), tReceived });
 
         // count the sample time
         ch->stats.AddConv(tReceived - tCurSampleStarted, tReceived - irqStats.tIRQ);
@@ -679,6 +856,8 @@ void ADS1115::Command_main(const ConsoleCommandContext *c)
                 "ADS1115 chip #%d (I2C addr 0x%02X)\n"
                 "Config reg sent:        %02X%02X (OS=%d, MUX=%03d, PGA=%03d, MODE=%d, DR=%02d, COMP_MODE=%d, COMP_POL=%d, COMP_LAT=%d, COMP_QUE=%02d)\n"
                 "Alert/Ready:            %s\n"
+                "Mode:                   %s\n"
+                "Averaging:              %d sample%s\n"
                 "Logical channels:       %d\n"
                 "Current scan channel:   %d\n"
                 "I2CReady passes:        %llu\n"
@@ -688,7 +867,10 @@ void ADS1115::Command_main(const ConsoleCommandContext *c)
                 FormatBinary(configHi, 7, 1), FormatBinary(configHi, 4, 3), FormatBinary(configHi, 1, 3), FormatBinary(configHi, 0, 1),
                 FormatBinary(configLo, 5, 3), FormatBinary(configLo, 4, 1), FormatBinary(configLo, 3, 1), FormatBinary(configLo, 2, 1),
                 FormatBinary(configLo, 0, 2),
-                readyTxt, nLogicalChannels, curSamplingChannel,
+                readyTxt,
+                !streaming ? "Polling" : nLogicalChannels == 1 ? "Streaming (continuous)" : "Streaming (single-shot scan)",
+                nAverage, nAverage == 1 ? "" : "s",
+                nLogicalChannels, curSamplingChannel,
                 nI2CReady, (time_us_64() - tStatsReset) / nI2CReady);
             
             if (gpAlertRdy >= 0)
@@ -698,6 +880,13 @@ void ADS1115::Command_main(const ConsoleCommandContext *c)
                     irqStats.n);
             }
 
+            if (streaming)
+            {
+                c->Printf(
+                    "Stream timeouts:        %llu\n",
+                    streamTimeouts);
+            }
+
             LogicalChannel *ch = &logicalChannel[0];
             uint64_t dt = time_us_64() - tStatsReset;
             for (int i = 0 ; i < nLogicalChannels ; ++i, ++ch)
@@ -739,6 +928,7 @@ void ADS1115::Command_main(const ConsoleCommandContext *c)
             tStatsReset = time_us_64();
             nI2CReady = 0;
             irqStats.Reset();
+            streamTimeouts = 0;
             for (int i = 0 ; i < nLogicalChannels ; ++i)
                 logicalChannel[i].stats.Reset();
 
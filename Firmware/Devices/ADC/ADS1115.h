@@ -82,6 +82,40 @@ protected:
     // flag: ALERT/RDY signal received in interrupt handler
     volatile bool alertReadyFlag = false;
 
+    // Streaming mode.  This is enabled when ALERT/RDY is connected to a
+    // GPIO that's not shared with any other ADS1115, so that each RDY
+    // edge identifies a completed conversion on this chip.  Each RDY
+    // edge raises a priority I2C request, and the service transaction
+    // reads the conversion register directly, without polling the
+    // config register first.  With a single channel, the chip runs in
+    // continuous conversion mode; with multiple channels, the same
+    // transaction that reads the result writes the config register to
+    // rotate the MUX to the next channel and start its conversion.
+    bool streaming = false;
+
+    // Logical channel whose result the pending streaming read will
+    // return, and the RDY time for that result.  In a multi-channel
+    // scan, curSamplingChannel advances when we queue the read, since
+    // the same transaction starts the next channel's conversion.
+    int streamReadChannel = -1;
+    uint64_t tStreamReadIRQ = 0;
+
+    // conversion time of the result the pending streaming read will return
+    uint64_t streamConvTime = 0;
+
+    // number of streaming timeouts since the last statistics reset
+    uint64_t streamTimeouts = 0;
+
+    // Timeout for a streaming sample, in microseconds.  If no RDY edge
+    // arrives within this time, we rewrite the config register to
+    // restart the conversion cycle, in case a transaction was lost to
+    // a bus error.
+    uint32_t streamTimeout = 100000;
+
+    // Number of samples to average for each reading, from the
+    // per-channel sample ring.  1 disables averaging.
+    int nAverage = 1;
+
     // Logical channels.  The public interface works in terms of logical
     // channels numbers.  A logical channel number is an index into this
     // array, which maps the logical channel number to a physical input
@@ -108,6 +142,24 @@ protected:
         // latest raw sample
         ADC::Sample raw{ 0, 0 };
 
+        // Recent sample ring, for averaging.  ringWrite is the index of
+        // the next slot to write; ringCount is the number of valid
+        // entries (up to the ring size).
+        static const int RING_SIZE = 16;
+        ADC::Sample ring[RING_SIZE];
+        int ringWrite = 0;
+        int ringCount = 0;
+
+        // add a sample to the ring, and make it the latest raw sample
+        void AddSample(const ADC::Sample &s)
+        {
+            raw = s;
+            ring[ringWrite] = s;
+            ringWrite = (ringWrite + 1) % RING_SIZE;
+            if (ringCount < RING_SIZE)
+                ++ringCount;
+        }
+
         // sample collection statistics
         struct Stats
         {
@@ -233,6 +285,7 @@ protected:
     // config high register bits
     static const uint8_t MUX_MASK = 0x70;
     static const uint8_t OS_BIT = 0x80;
+    static const uint8_t MODE_BIT = 0x01;
 
     // command-line tools
     static void Command_main_S(const ConsoleCommandContext *ctx);
@@ -15,8 +15,16 @@
 // which works out to exactly 2us with a 48MHz clock).  Unfortunately, it
 // doesn't have a native averaging mode, so it's up to client software to
 // implement oversampling.  We do, by continuously collecting samples into
-// a ring buffer, and computing an average over the most recent segment
-// of the buffer whenever a client asks to read a sample.
+// a ring buffer via DMA, and running a boxcar decimation filter over each
+// block of samples as it completes: the filter sums the block's samples
+// for each channel, and stores the sum (scaled to the configured output
+// resolution) as the channel's latest filtered sample.  This happens in
+// the DMA completion interrupt, once per block, so reading a sample is a
+// constant-time operation that just returns the latest filter output,
+// no matter how many raw samples go into each average.  Averaging N
+// samples also reduces the random noise by a factor of sqrt(N), which
+// gives us some effective resolution beyond the ADC's native 12 bits, so
+// the filter can optionally keep some of the low-order bits of the sum.
 //
 // The 2us ADC cycle is too fast to collect samples with an IRQ handler.
 // We'd spend about 50% of CPU time in the IRQ handler, and we'd *still*
@@ -29,11 +37,15 @@
 // the upper half of the buffer.  We still need an IRQ handler, but the
 // IRQ handler is for DMA completion rather than ADC completion, so it
 // only fires once ever N/2 samples (where N is the buffer size in
-// samples).  If we make N = 1024, this gives us 512*2us = 1ms between
-// interrupts, which (a) reduces interrupt overhead to negligible levels,
-// and (b) gives us an extremely long latency cushion to respond to
-// interrupts, since we only have to response to the Channel A interrupt
-// before Channel B finishes 1ms later, and vice versa.  This gives us
+// samples).  Each half of the buffer is one decimation block, so with
+// the default averaging count of 256 samples, this gives us 256*2us =
+// 512us between interrupts (per channel sampled), which (a) keeps the
+// interrupt overhead low, and (b) gives us a long latency cushion to
+// respond to interrupts, since we only have to response to the Channel
+// A interrupt before Channel B finishes 512us later, and vice versa.
+// It also gives the filter a stable block to work on: the channel that
+// just finished won't write into its half again until the other channel
+// finishes.  This gives us
 // essentially deterministic timing that ensures we never miss a single
 // sample.  That's only a nice-to-have when reading a single channel,
 // where a missed sample (or even a large number of missed samples) will
@@ -63,6 +75,8 @@ PicoADC *PicoADC::inst = nullptr;
 // pico_adc: {
 //   gpio: 26,           // GPIO pin used for input; must be one of the ADC-capable ports, 26..30
 //                       // Port 30 is the Pico's internal temperature sensor on ADC channel 4
+//   averaging: 256,     // number of raw samples averaged into each reading; power of two, 64..1024
+//   resolution: 12,     // reading resolution in bits, 12..16
 // }
 //
 // The GPIO port can be specified as a single port number, or as a list
@@ -127,6 +141,33 @@ void PicoADC::Configure(JSONParser &json)
 
         // set the channel count
         inst->numChannels = static_cast<int>(inst->gpios.size());
+        if (inst->numChannels > MAX_CHANNELS)
+        {
+            Log(LOG_ERROR, "Pico ADC: too many GPIOs assigned (maximum %d); ADC not configured\n", MAX_CHANNELS);
+            inst->gpios.clear();
+            return;
+        }
+
+        // get the averaging count, which must be a power of two
+        int averaging = val->Get("averaging")->Int(256);
+        if (averaging < 64 || averaging > 1024 || (averaging & (averaging - 1)) != 0)
+        {
+            Log(LOG_ERROR, "Pico ADC: invalid 'averaging' value %d; must be a power of two from 64 to 1024; using default 256\n", averaging);
+            averaging = 256;
+        }
+        inst->averaging = averaging;
+        inst->averagingBits = __builtin_ctz(averaging);
+
+        // Get the output resolution.  Each extra bit over the ADC's native
+        // 12 bits doubles the native scale, so set the native range to match.
+        int resolution = val->Get("resolution")->Int(12);
+        if (resolution < 12 || resolution > 16)
+        {
+            Log(LOG_ERROR, "Pico ADC: invalid 'resolution' value %d; must be 12 to 16; using default 12\n", resolution);
+            resolution = 12;
+        }
+        inst->resolution = resolution;
+        inst->nativeMax = 4095 << (resolution - 12);
 
         // add it to the ADC manager's available device list
         adcManager.Add(inst);
@@ -139,8 +180,8 @@ void PicoADC::Configure(JSONParser &json)
             snprintf(p, sizeof(buf) - (p - buf), "%d,", gpio);
         }
         const char *s = inst->numChannels == 1 ? "" : "s";
-        Log(LOG_CONFIG, "Pico ADC configured; %d channel%s, GPIO%s %s\n",
-            inst->numChannels, s, s, buf);
+        Log(LOG_CONFIG, "Pico ADC configured; %d channel%s, GPIO%s %s averaging %d, %d-bit resolution\n",
+            inst->numChannels, s, s, buf, inst->averaging, inst->resolution);
     }
 }
 
@@ -160,10 +201,10 @@ void PicoADC::EnableSampling()
         // mark it as initialized
         inited = true;
 
-        // allocate the DMA buffer as a multiple of the channel count, so
-        // that we'll always be aligned with a full block of N channels
-        // when the buffer wraps
-        dmaBufCount = numChannels * 1024;
+        // Allocate the DMA buffer as two decimation blocks, each holding
+        // 'averaging' samples for each channel.  This keeps us aligned with
+        // a full block of N channels at the start of each half.
+        dmaBufCount = numChannels * averaging * 2;
         dmaBuf.reset(new (std::nothrow) uint16_t[dmaBufCount]);
         if (dmaBuf == nullptr)
         {
@@ -202,6 +243,9 @@ void PicoADC::EnableSampling()
         float clkdiv = (rawSampleTime_us * 48.0f) - 1.0f;
         adc_set_clkdiv(clkdiv);
 
+        // figure the time per decimation block
+        blockTime_us = rawSampleTime_us * averaging * numChannels;
+
         // Start the DMA loop
         StartDMALoop();
 
@@ -315,74 +359,11 @@ ADC::Sample PicoADC::ReadNative(int channel)
     if (channel < 0 || channel >= numChannels)
         return { 0, 0 };
 
-    // Get the current asynchronous DMA write position.  Turn off
-    // interrupts while getting the pointer so that the IRQ handler can't
-    // sneak in and reset the outgoing channel to the start of the buffer,
-    // which it could do if the active channel happens to finish just as
-    // we're checking.
-    //
-    // Blocking interrupts doesn't stop the DMA write address register
-    // from changing, since the DMA controller can update that at any time
-    // regardless of interrupt status.  But that's okay, because the DMA
-    // controller will only INCREASE the write address.  Since we're
-    // explicitly setting up to read OLDER samples, it doesn't matter if
-    // newer samples come in while we're working, and so it doesn't matter
-    // if the write pointer moves ahead.
-    //
-    // The reason we have to block interrupts is that the IRQ handler will
-    // do two things when a DMA channel completes: first, it'll update
-    // dmaChannelCur to reflect that the other channel is running, and
-    // second, it'll reset the finishing channels write_addr to the start
-    // of its buffer segment.  So if we didn't turn off interrupts, we
-    // could read dmaChannelCur just before an interrupt, and then get the
-    // recycled write_addr after the interrupt returns, which would be
-    // wrong.  Blocking interrupts ensures that we can't get a recycled
-    // write_addr - we get a write_addr that can only move forward, since
-    // only the DMA hardware can update it after we check dmaChannelCur.
-    // So we safely get a pointer to the end of a recent section of the
-    // buffer.
-    const uint16_t *p;
-    {
-        IRQDisabler irqd;
-        p = reinterpret_cast<const uint16_t*>(dma_channel_hw_addr(dmaChannelCur)->write_addr);
-    }
-
-    // Work backwards from the write position to the base of the current
-    // round-robin block.  Index [0] is channel 0, [1] is channel 1, [N-1]
-    // is channel N-1, [N] is channel 0, [N+1] is channel 1, etc.  So if
-    // we take (index/N)*N, we always get a channel 0 sample, and the
-    // corresponding sample for channel n is at (index/N)*N+n.
-    int32_t index = (p - dmaBuf.get());
-    int32_t baseIndex = (index / numChannels) * numChannels;
-    int32_t channelIndex = baseIndex + channel;
-
-    // Since the write pointer could be in the middle of an N-block, back
-    // off by one whole block, wrapping at the bottom of the array.
-    channelIndex -= numChannels;
-    if (channelIndex < 0)
-        channelIndex += dmaBufCount;
-
-    // now take an average over recent samples
-    static const int AverageCount = 256;
-    int32_t sum = 0;
-    p = dmaBuf.get() + channelIndex;
-    for (int i = 0 ; i < AverageCount ; ++i)
-    {
-        // add it to the total
-        sum += *p;
-
-        // back up one N-block
-        channelIndex -= numChannels;
-        p -= numChannels;
-        if (channelIndex < 0)
-        {
-            channelIndex += dmaBufCount;
-            p += dmaBufCount;
-        }
-    }
-
-    // return the average
-    return { sum / AverageCount, time_us_64() };
+    // Return the latest filtered sample.  Disable interrupts while
+    // reading, so that the DMA IRQ handler can't update the sample
+    // between reading the value and its timestamp.
+    IRQDisabler irqd;
+    return { filtered[channel], filteredTime };
 }
 
 // Read the latest sample in normalized UINT16 units
@@ -391,14 +372,16 @@ ADC::Sample PicoADC::ReadNorm(int channel)
     // read the sample in native units
     Sample s = ReadNative(channel);
 
-    // The Pico ADC produces native unsigned 12-bit samples.  Normalize to
-    // UINT16 using the "shift-and-fill" algorithm: shift left to the
-    // desired width, and fill the vacated low-order bits with the same
-    // number of bits from the high-order end.  This algorithm produces
-    // results within +/-1 of the equivalent floating-point scaling
-    // operation across the whole range, and is much faster (since it only
-    // requires two bits shifts and an OR).
-    s.sample = (s.sample << 4) | (s.sample >> 8);
+    // The filter produces unsigned samples on a scale of 0 to 4095 << E,
+    // where E is the number of extra bits of resolution beyond the ADC's
+    // native 12 bits.  Normalize to UINT16 using the "shift-and-fill"
+    // algorithm: shift left to the desired width, and fill the vacated
+    // low-order bits with the high-order bits of the 12-bit equivalent
+    // value.  This algorithm produces results within +/-1 of the
+    // equivalent floating-point scaling operation across the whole range,
+    // and is much faster (since it only requires two bits shifts and an
+    // add).  With E = 0, this is the usual (s << 4) | (s >> 8).
+    s.sample = (s.sample << (16 - resolution)) + (s.sample >> (resolution - 4));
     return s;
 }
 
@@ -437,11 +420,39 @@ void __not_in_flash("IRQ") PicoADC::DMAIRQCheckChannel(int channel, int otherCha
         // so disable Self->Other
         DisableDMAChainTo(channel);
 
+        // Run the decimation filter over the block this channel just
+        // completed.  The channel won't write into this half again until
+        // the other channel completes, so the block is stable for a full
+        // block time.
+        FilterBlock(bufBase);
+
         // update the interrupt time
         dmaLoopTimeout = time_us_64() + 1000000;
     }
 }
 
+// Decimation filter for one completed block
+void __not_in_flash("IRQ") PicoADC::FilterBlock(const uint16_t *block)
+{
+    // The block contains 'averaging' round-robin groups of 'numChannels'
+    // samples each.  Sum each channel's samples, then scale the sum to the
+    // output resolution.  The sum of N 12-bit samples has 12+log2(N) bits,
+    // so we shift out the bits beyond the output resolution.
+    int shift = averagingBits + 12 - resolution;
+    for (int ch = 0 ; ch < numChannels ; ++ch)
+    {
+        int32_t sum = 0;
+        const uint16_t *p = block + ch;
+        for (int i = 0 ; i < averaging ; ++i, p += numChannels)
+            sum += *p;
+
+        filtered[ch] = sum >> shift;
+    }
+
+    // timestamp the results at the midpoint of the block
+    filteredTime = time_us_64() - blockTime_us/2;
+}
+
 
 // ADC DMA IRQ handler
 void __not_in_flash("IRQ") PicoADC::DMAIRQ()
@@ -74,11 +74,38 @@ protected:
     void DMAIRQ();
     void DMAIRQCheckChannel(int channel, int otherChannel, uint16_t *bufBase);
 
-    // DMA buffer.  We continuously collect samples here in a ring.
-    // Readers take an average of recent samples on demand.
+    // Decimation filter.  Called from the DMA IRQ handler when a DMA
+    // channel completes its half of the ring, to reduce the completed
+    // block to one filtered output sample per logical channel.
+    void FilterBlock(const uint16_t *block);
+
+    // DMA buffer.  We continuously collect samples here in a ring.  Each
+    // half of the ring is one decimation block, holding 'averaging'
+    // samples for each logical channel.
     int dmaBufCount = 0;
     std::unique_ptr<uint16_t> dmaBuf;
 
+    // Number of raw samples per channel averaged into each filtered
+    // output sample.  This is always a power of two.
+    int averaging = 256;
+    int averagingBits = 8;
+
+    // Output resolution, in bits.  The filter sums 'averaging' 12-bit
+    // samples, and then shifts the sum right to this many bits, so
+    // resolutions above 12 bits keep some of the extra precision that
+    // the averaging provides.
+    int resolution = 12;
+
+    // Latest filtered output sample for each logical channel, with its
+    // timestamp (the midpoint of the block it was computed from).  The
+    // DMA IRQ handler updates these as each block completes.
+    static const int MAX_CHANNELS = 5;
+    volatile int32_t filtered[MAX_CHANNELS]{ 0 };
+    volatile uint64_t filteredTime = 0;
+
+    // duration of one decimation block, in microseconds
+    uint32_t blockTime_us = 0;
+
     // DMA channels
     int dmaChannelA = -1;
     int dmaChannelB = -1;
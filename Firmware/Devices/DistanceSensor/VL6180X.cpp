@@ -40,6 +40,7 @@ VL6180X::VL6180X(int gpCE, int gpInt) :
 //   i2c: <number>,          // I2C bus number (0 or 1) (note: no I2C address is needed, since VL6180X has a fixed address, 0x29)
 //   chipEnable: <gpio>,     // Pico GPIO port of Chip Enable connection (VL6180X "GPIO0/CE" pin); optional, omit if not connected
 //   interrupt: <gpio>,      // Pico GPIO port number of interrupt input (from VL6180X "GPIO1/INT" pin); optional, omit if not connected
+//   pipelined: <bool>,      // trigger single-shot measurements back to back (true), or use continuous ranging mode (false, default)
 // }
 //
 void VL6180X::Configure(JSONParser &json)
@@ -90,6 +91,7 @@ void VL6180X::Configure(JSONParser &json)
 
         // create the singleton
         vl6180x = new VL6180X(gpCE, gpInt);
+        vl6180x->pipelined = val->Get("pipelined")->Bool(false);
         
         // Initialize our GPIO IRQ handler.  The IRQ line is pulled low
         // when an interrupt is asserted.  Respond to the falling edge
@@ -132,6 +134,10 @@ void VL6180X::IRQ()
     // remember the sample arrival time
     vl6180x->tInterrupt = time_us_64();
 
+    // ask the I2C manager to give us the bus ahead of the round-robin
+    // order, to minimize the latency reading the new sample
+    vl6180x->i2cPriorityRequest = true;
+
     // acknowledge the IRQ
     gpio_acknowledge_irq(vl6180x->gpInt, GPIO_IRQ_EDGE_FALL);
 }
@@ -256,7 +262,8 @@ void VL6180X::Init(int bus)
         "vl6180x", "vl6180x diagnostics",
         "vl6180x [options]\n"
         "options:\n"
-        "  -s, --status    show status\n",
+        "  -s, --status    show status\n"
+        "  --reset-stats   reset sample rate and latency statistics\n",
         [](const ConsoleCommandContext *c){ vl6180x->Command_main(c); });
 
     // send initialization commands
@@ -363,10 +370,21 @@ void VL6180X::SendInitCommands(i2c_inst_t *i2c)
     {
         // The chip didn't go through a hardware reset, so CE must not be wired,
         // and we must have only reset the Pico without power-cycling the whole
-        // system.  In this case, we must have left the chip in continuous ranging
-        // mode.  Deactivate continuous mode so that we can update the parameter
-        // registers.  To deactivate continuous mode, write bit 0x01 in the
-        // SYSRANGE_START register, which toggles the run/stop state.
+        // system.  In this case, we might have left the chip in continuous ranging
+        // mode, if that's what the last session used.  The mode select bit
+        // (0x02) in SYSRANGE_START retains the last mode written, so check it.
+        // If it's set, deactivate continuous mode so that we can update the
+        // parameter registers.  To deactivate continuous mode, write bit 0x01
+        // in the SYSRANGE_START register, which toggles the run/stop state.
+        // In single-shot mode, the last measurement stops on its own.
+        uint8_t rangeStart = 0x00;
+        {
+            uint8_t buf[] = { SYSRANGE_START };
+            if (i2c_write_timeout_us(i2c, i2cAddr, buf, _countof(buf), true, 1000) != _countof(buf)
+                || i2c_read_timeout_us(i2c, i2cAddr, &rangeStart, 1, false, 1000) != 1)
+                ok = false;
+        }
+        if ((rangeStart & 0x02) != 0)
         {
             static const uint8_t buf[] = { SYSRANGE_START, 0x03 };
             if (i2c_write_timeout_us(i2c, i2cAddr, buf, _countof(buf), false, 1000) != _countof(buf))
@@ -478,19 +496,24 @@ void VL6180X::SendInitCommands(i2c_inst_t *i2c)
             Log(LOG_WARNING, "VL6180X device model ID read as 0x%02X - should be 0xB4\n", id.model);
     }
 
-    // set continuous ranging mode (bit 0x02), and toggle the mode on (bit 0x01)
+    // In pipelined mode, start the first single-shot measurement (mode
+    // bit 0x02 clear, start bit 0x01 set).  Otherwise, set continuous
+    // ranging mode (bit 0x02), and toggle the mode on (bit 0x01).
     {
-        static const uint8_t buf[] = { SYSRANGE_START, 0x03 };
+        const uint8_t buf[] = { SYSRANGE_START, static_cast<uint8_t>(pipelined ? 0x01 : 0x03) };
         if (i2c_write_timeout_us(i2c, i2cAddr, buf, _countof(buf), false, 1000) != _countof(buf))
             ok = false;
     }
 
-    // note the continuous-mode start time
-    continuousModeStartTime = time_us_64();
+    // note the sampling start time
+    continuousModeStartTime = tTrigger = tPollNotReady = time_us_64();
+    sampleReadCount = 0;
+    latencySum = 0;
+    latencyMax = 0;
 
     // report the result
-    Log(ok ? LOG_CONFIG : LOG_ERROR, "VL6180X device initialization %s; product ID 0x%02X, rev %d.%d, module rev %d.%d, manuf %02d/%02d/xxx%d %02d:%02d:%02d\n",
-        ok ? "OK" : "failed", id.model, id.modelRevMajor, id.modelRevMinor, id.moduleRevMajor, id.moduleRevMinor,
+    Log(ok ? LOG_CONFIG : LOG_ERROR, "VL6180X device initialization %s; %s mode; product ID 0x%02X, rev %d.%d, module rev %d.%d, manuf %02d/%02d/xxx%d %02d:%02d:%02d\n",
+        ok ? "OK" : "failed", pipelined ? "pipelined" : "continuous", id.model, id.modelRevMajor, id.modelRevMinor, id.moduleRevMajor, id.moduleRevMinor,
         id.manufDate.month, id.manufDate.day, id.manufDate.year, id.manufDate.hh, id.manufDate.mm, id.manufDate.ss);
 }
 
@@ -508,8 +531,59 @@ bool VL6180X::Read(uint32_t &distance, uint64_t &timestamp)
     return ret;
 }
 
+// get the average time between samples
+uint32_t VL6180X::GetAvgSampleTime() const
+{
+    return sampleReadCount != 0 ? static_cast<uint32_t>((time_us_64() - continuousModeStartTime) / sampleReadCount) : 0;
+}
+
+void VL6180X::ReadResult(I2CX *i2c)
+{
+    // Read the range value, clear the interrupt status, and, in pipelined
+    // mode, start the next measurement, all in one bus transaction.  The
+    // result register holds the value we just read until the next
+    // measurement completes, so it's safe to start the next one right away.
+    I2C::TXRXBuilder<3, 8> b;
+    const uint8_t rangeVal[] = { RESULT_RANGE_VAL };
+    const uint8_t clear[] = { SYSTEM_INTERRUPT_CLEAR, 0x07 };
+    const uint8_t start[] = { SYSRANGE_START, 0x01 };
+    b.AddRead(rangeVal, _countof(rangeVal), 1);
+    b.AddWrite(clear, _countof(clear));
+    if (pipelined)
+        b.AddWrite(start, _countof(start));
+    i2c->MultiReadWrite(b);
+    readMode = ReadMode::Value;
+
+    // the next sample can't complete until after this point
+    tTrigger = tPollNotReady = time_us_64();
+}
+
+void VL6180X::ClearAndTrigger(I2CX *i2c)
+{
+    // clear the interrupt status, and start the next measurement in pipelined mode
+    I2C::TXRXBuilder<2, 8> b;
+    const uint8_t clear[] = { SYSTEM_INTERRUPT_CLEAR, 0x07 };
+    const uint8_t start[] = { SYSRANGE_START, 0x01 };
+    b.AddWrite(clear, _countof(clear));
+    if (pipelined)
+        b.AddWrite(start, _countof(start));
+    i2c->MultiReadWrite(b);
+    readMode = ReadMode::None;
+    tTrigger = tPollNotReady = time_us_64();
+}
+
 bool VL6180X::OnI2CReady(I2CX *i2c)
 {
+    // In pipelined mode, if the current measurement hasn't produced a
+    // result within a generous timeout (several times the maximum
+    // ranging time), the trigger command or the interrupt clear might
+    // have been lost to a bus error, so start over with a new trigger.
+    if (pipelined && time_us_64() - tTrigger > 100000)
+    {
+        ClearAndTrigger(i2c);
+        return true;
+    }
+
     // check if the interrupt signal is connected
     if (gpInt >= 0)
     {
@@ -519,9 +593,7 @@ bool VL6180X::OnI2CReady(I2CX *i2c)
         if (!gpio_get(gpInt))
         {
             // a sample is available - read the result register
-            uint8_t buf[] = { RESULT_RANGE_VAL };
-            i2c->Read(buf, 2, 1);
-            readMode = ReadMode::Value;
+            ReadResult(i2c);
             return true;
         }
     }
@@ -549,20 +621,29 @@ bool VL6180X::OnI2CReceive(const uint8_t *data, size_t len, I2CX *i2c)
         // big 0x01 -> range result ready
         if ((data[0] & 0xC0) != 0)
         {
-            // error detected - count it and clear the interrupt status
+            // error detected - count it, clear the interrupt status, and
+            // start a new measurement if pipelining
             resultErrorCount += 1;
-            uint8_t buf[] = { SYSTEM_INTERRUPT_CLEAR, 0x07 };
-            i2c->Write(buf, _countof(buf));
+            ClearAndTrigger(i2c);
             return true;
         }
         else if ((data[0] & 0x07) == 0x04)
         {
-            // input ready
-            uint8_t buf[] = { RESULT_RANGE_VAL };
-            i2c->Read(buf, 2, 1);
-            readMode = ReadMode::Value;
+            // Input ready.  The measurement completed some time between
+            // the last poll that found it not ready and this one, so take
+            // the midpoint as the best estimate of the completion time.
+            uint64_t now = time_us_64();
+            tPollCompletionEst = tPollNotReady + (now - tPollNotReady)/2;
+
+            // read the result
+            ReadResult(i2c);
             return true;
         }
+        else
+        {
+            // not ready yet - note the time
+            tPollNotReady = time_us_64();
+        }
         break;
 
     case ReadMode::Value:
@@ -570,31 +651,29 @@ bool VL6180X::OnI2CReceive(const uint8_t *data, size_t len, I2CX *i2c)
         readMode = ReadMode::None;
         sample = data[0];
 
-        // Record the time we obtained the sample.  If we have an
+        // Record the measurement completion time.  If we have an
         // interrupt input, use the time of the last interrupt, since
         // that records precisely when the chip signaled that a new
-        // sample was ready.  Otherwise, we don't know when the sample
-        // actually arrived at the chip, so the best we can is record
-        // the time we read it, which is less precise since the sample
-        // could have been sitting there for up to a full cycle (4ms at
-        // the maximum 250/s sampling rate).
-        tSample = (gpInt >= 0) ? tInterrupt : time_us_64();
+        // sample was ready.  Otherwise, use the estimate from the
+        // status polling, which is precise to within half of the
+        // polling interval.
+        tSample = (gpInt >= 0) ? tInterrupt : tPollCompletionEst;
 
         // flag that a new sample is available for reading at the
         // programmatic interface
         isSampleReady = true;
 
-        // count the sample
+        // count the sample, and collect latency statistics
         sampleReadCount += 1;
-
-        // clear the interupt status
         {
-            uint8_t buf[] = { SYSTEM_INTERRUPT_CLEAR, 0x07 };
-            i2c->Write(buf, _countof(buf));
-            return true;
+            uint32_t latency = static_cast<uint32_t>(time_us_64() - tSample);
+            latencySum += latency;
+            if (latency > latencyMax)
+                latencyMax = latency;
         }
 
-        // done
+        // done - the result read transaction already cleared the interrupt
+        // status (and started the next measurement, in pipelined mode)
         break;
     }
 
@@ -618,16 +697,29 @@ void VL6180X::Command_main(const ConsoleCommandContext *c)
         {
             c->Printf(
                 "VL6180X status:\n"
+                "  Sampling mode:    %s\n"
                 "  Interrupt status: %s\n"
                 "  Num samples read: %llu\n"
                 "  Avg sample time:  %.2f ms\n"
+                "  Avg latency:      %lu us\n"
+                "  Max latency:      %lu us\n"
                 "  Errors:           %llu\n"
                 "  Last sample:      %d\n",
+                pipelined ? "Pipelined" : "Continuous",
                 gpInt >= 0 ? (gpio_get(gpInt) ? "Asserted" : "Not asserted") : "Not connected",
                 sampleReadCount,
-                static_cast<float>((time_us_64() - continuousModeStartTime)/sampleReadCount) / 1000.0f,
+                static_cast<float>(GetAvgSampleTime()) / 1000.0f,
+                GetAvgLatency(), latencyMax,
                 resultErrorCount, sample);
         }
+        else if (strcmp(a, "--reset-stats") == 0)
+        {
+            sampleReadCount = 0;
+            latencySum = 0;
+            latencyMax = 0;
+            continuousModeStartTime = time_us_64();
+            c->Printf("VL6180X statistics reset\n");
+        }
         else
         {
             // invalid syntax
@@ -37,6 +37,15 @@
 // for demonstration and experimentation purposes than for serious use
 // in pin cab depoyments.
 //
+// Sampling modes: by default, we use the sensor's own continuous ranging
+// mode.  Set pipelined:true in the config to use "pipelined" mode
+// instead, where we trigger each measurement as a single-shot range
+// operation, in the same I2C transaction that reads the result of the
+// previous measurement and clears its interrupt.  This runs measurements
+// back to back, so the sample rate is limited only by the actual ranging
+// time, rather than the sensor's fixed continuous-mode measurement
+// period (10ms at the minimum setting).
+//
 
 #pragma once
 
@@ -87,6 +96,13 @@ public:
     // call and returns false;
     bool Read(uint32_t &millimeters, uint64_t &timestamp);
 
+    // Get the average time between samples, in microseconds, and the
+    // average latency from measurement completion to our reading the
+    // result, in microseconds.  These are for diagnostics and status
+    // reporting.
+    uint32_t GetAvgSampleTime() const;
+    uint32_t GetAvgLatency() const { return sampleReadCount != 0 ? static_cast<uint32_t>(latencySum / sampleReadCount) : 0; }
+
     // I2C device interface
     virtual const char *I2CDeviceName() const override { return "VL6180X"; }
     virtual void I2CReinitDevice(I2C *i2c) override;
@@ -110,6 +126,34 @@ protected:
     // GPIO port connected to sensor interrupt output (GPIO1/INT); -1 if not connected
     int gpInt = -1;
 
+    // Pipelined mode.  If set, we trigger single-shot measurements back
+    // to back; otherwise we use the sensor's continuous ranging mode.
+    bool pipelined = false;
+
+    // Time we triggered the current single-shot measurement, in
+    // pipelined mode.  We use this to re-trigger the measurement if the
+    // result never arrives, which could happen if the trigger command
+    // was lost to a bus error.
+    uint64_t tTrigger = 0;
+
+    // Time of the last status poll that found no sample ready.  In
+    // polling mode, the measurement completed some time between this
+    // poll and the poll that finds the sample ready, so we timestamp
+    // the sample at the midpoint.
+    uint64_t tPollNotReady = 0;
+
+    // estimated completion time of the sample we're reading, in polling mode
+    uint64_t tPollCompletionEst = 0;
+
+    // Build the result-read transaction: read the range value, clear
+    // the interrupt status, and, in pipelined mode, trigger the next
+    // measurement.
+    void ReadResult(I2CX *i2c);
+
+    // Build a transaction to clear the interrupt status, and trigger the
+    // next measurement in pipelined mode
+    void ClearAndTrigger(I2CX *i2c);
+
     // last reading and timestamp
     uint32_t sample = 0;
     uint64_t tSample = 0;
@@ -127,7 +171,12 @@ protected:
     // sample read count
     uint64_t sampleReadCount = 0;
 
-    // starting time of continuous sampling mode
+    // latency statistics - time from measurement completion to reading
+    // the result, in microseconds
+    uint64_t latencySum = 0;
+    uint32_t latencyMax = 0;
+
+    // starting time of continuous or pipelined sampling
     uint64_t continuousModeStartTime = 0;
 
     // read mode
@@ -11,6 +11,7 @@
 #include <ctype.h>
 #include <math.h>
 #include <list>
+#include <algorithm>
 
 // Pico SDK headers
 #include <pico/stdlib.h>
@@ -30,6 +31,7 @@
 #include "JSON.h"
 #include "Logger.h"
 #include "GPIOManager.h"
+#include "CommandConsole.h"
 #include "../USBProtocol/VendorIfcProtocol.h"
 
 // global chip list
@@ -41,7 +43,8 @@ std::list<PCA9555> PCA9555::chips;
 //   {
 //     i2c: <number>,        // Pico I2C bus number (0 or 1)
 //     addr: <number>,       // I2C address in 7-bit format
-//     interrupt: <number>   // optional GPIO number where interrupt signal from chip is connected
+//     interrupt: <number>,  // optional GPIO number where interrupt signal from chip is connected
+//     heartbeat: <number>,  // optional heartbeat read interval in milliseconds, when using the interrupt; default 50
 //   },
 //   { ... },
 // ]
@@ -87,6 +90,9 @@ void PCA9555::Configure(JSONParser &json)
             // create the chip instance
             auto &chip = chips.emplace_back(index, bus, addr, intr);
 
+            // set the heartbeat interval
+            chip.heartbeat_us = std::max<uint32_t>(value->Get("heartbeat")->UInt32(50), 1) * 1000;
+
             // add it to its bus manager
             I2C::GetInstance(bus, false)->Add(&chip);
 
@@ -119,9 +125,40 @@ void PCA9555::Configure(JSONParser &json)
     else if (!cfg->IsUndefined())
         Log(LOG_ERROR, "Config: 'pca9555' key must be an object or array\n");
 
-    // initialize the chips
+    // initialize the chips, and collect the interrupt GPIOs
+    uint32_t intrMask = 0;
     for (auto &chip : chips)
+    {
         chip.Init();
+        if (chip.gpInterrupt != -1)
+            intrMask |= (1UL << chip.gpInterrupt);
+    }
+
+    // Set up the interrupt IRQ, if any chips have interrupt inputs.  We
+    // use one handler for all of the chips, since multiple chips can
+    // share one interrupt line.
+    if (intrMask != 0)
+    {
+        gpio_add_raw_irq_handler_masked(intrMask, &PCA9555::IRQ);
+        for (int gp = 0 ; gp < 32 ; ++gp)
+        {
+            if ((intrMask & (1UL << gp)) != 0)
+                gpio_set_irq_enabled(gp, GPIO_IRQ_EDGE_FALL, true);
+        }
+        irq_set_enabled(IO_IRQ_BANK0, true);
+    }
+
+    // add a console command if we configured any chips
+    if (chips.size() != 0)
+    {
+        CommandConsole::AddCommand(
+            "pca9555", "PCA9555 GPIO extender chip diagnostics",
+            "pca9555 <options>\n"
+            "options:\n"
+            "  --stats, -s       show statistics for all chips\n"
+            "  --reset-stats     reset statistics\n",
+            &Command_main);
+    }
 }
 
 PCA9555 *PCA9555::Get(int chipNum)
@@ -147,15 +184,16 @@ PCA9555::PCA9555(int chipNumber, uint8_t i2cBus, uint8_t i2cAddr, int gpInterrup
     // If a GPIO was specified for the interrupt input signal from the
     // chip, configure the GP as an input with a pull-up.
     //
-    // Note that the signal is nominally an interrupt, per the data
-    // sheet's terminology, but we don't literally wire it to an IRQ.
-    // There's no point in doing that because we're not allowed to
-    // access the I2C bus at just any time - we have to wait our turn
-    // through the I2C bus manager object.  So we can simply check the
-    // interrupt signal state when it's our turn on the I2C bus.  The
-    // chip holds the signal low when it has a change to send, and keeps
-    // holding it low until the host gets around to actually doing the
-    // read, so the signal will patiently wait for us to get to it.
+    // We can't access the I2C bus at just any time - we have to wait
+    // our turn through the I2C bus manager object - so the main test
+    // for pending input is to check the interrupt signal state when
+    // it's our turn on the bus.  The chip holds the signal low when it
+    // has a change to send, and keeps holding it low until the host
+    // gets around to actually doing the read, so the signal will
+    // patiently wait for us to get to it.  We also attach a GPIO IRQ
+    // to the falling edge, though, which asks the bus manager for a
+    // priority turn, so that we get to the read as soon as the bus is
+    // free, rather than waiting for the other devices to take turns.
     //
     // The interrupt signal may be shared among multiple PCA9555 chips.
     // It's physically implemented as an open-drain output on the chip,
@@ -237,6 +275,9 @@ void PCA9555::SendInitCommands()
         portBits = inbuf[0] | (static_cast<uint16_t>(inbuf[1]) << 8);
     }
 
+    // if all went well, the register pointer is now at INPUT0
+    inputPtrCached = ok;
+
     // log status
     Log(ok ? LOG_CONFIG : LOG_ERROR, "PCA9555(i2c addr 0x%02x) device initialization %s\n", i2cAddr, ok ? "OK" : "failed");
 }
@@ -451,7 +492,25 @@ bool PCA9555::OnI2CReceive(const uint8_t *data, size_t len, I2CX *i2cx)
     // we expect two bytes, which contain the INPUT0 and INPUT1
     // register values, with the input port bits
     if (len == 2)
-        portBits = data[0] | (static_cast<uint16_t>(data[1]) << 8);
+    {
+        uint16_t newBits = data[0] | (static_cast<uint16_t>(data[1]) << 8);
+        if (newBits != portBits)
+            readStats.nChanges += 1;
+        portBits = newBits;
+
+        // if this read was triggered by an interrupt edge, collect the
+        // edge-to-data latency
+        if (tReadIntr != 0)
+        {
+            uint32_t dt = static_cast<uint32_t>(time_us_64() - tReadIntr);
+            auto &st = readStats;
+            st.nLatency += 1;
+            st.latencySum += dt;
+            st.latencyMin = std::min(st.latencyMin, dt);
+            st.latencyMax = std::max(st.latencyMax, dt);
+            tReadIntr = 0;
+        }
+    }
 
     // no more transactions needed
     return false;
@@ -489,21 +548,151 @@ void PCA9555::BuildPortRead(I2C::TXRXBuilderBase &b)
     // of the other chips also [or only] has changes to read.  But
     // that's okay, because the I2C manager schedules bus time
     // round-robin, so the next time we get back here, all of the other
-    // chip drivers will have had a chance to read their chips.)
+    // chip drivers will have had a chance to read their chips.)  We
+    // also read on a slow heartbeat, in case the signal is missed.
     //
     // If there's no interrupt input, simply poll
-    bool read = gpInterrupt != -1 ?
-                !gpio_get(gpInterrupt) :
-                time_us_64() >= tRead;
+    uint64_t now = time_us_64();
+    bool intr = gpInterrupt != -1 && !gpio_get(gpInterrupt);
+    bool read = intr || now >= tRead;
 
     // if we decided to proceed with the read, queue the I2C transaction
     if (read)
     {
-        // kick off a read for two bytes from INPUT0
+        // If the register pointer is still at INPUT0 from the last read,
+        // and we haven't queued any register writes ahead of the read in
+        // this batch, we can skip the command byte and just read the two
+        // bytes.  Otherwise, write the INPUT0 command byte first.
         uint8_t buf[1] = { REG_INPUT0 };
-        b.AddRead(buf, _countof(buf), 2);
+        if (inputPtrCached && b.n == 0)
+        {
+            b.AddRead(buf, 0, 2);
+            readStats.nCachedPtrReads += 1;
+        }
+        else
+            b.AddRead(buf, _countof(buf), 2);
+
+        // the read leaves the register pointer at INPUT0
+        inputPtrCached = true;
+
+        // note the interrupt edge time for latency statistics, and clear
+        // the pending edge
+        {
+            IRQDisabler irqd;
+            tReadIntr = tIntr;
+            tIntr = 0;
+        }
+
+        // count statistics
+        readStats.nReads += 1;
+        if (intr)
+            readStats.nIntrReads += 1;
+        else
+            readStats.nTimedReads += 1;
+
+        // Set the next timed read.  With an interrupt input, this is
+        // just the heartbeat; otherwise it's the polling interval.
+        tRead = now + (gpInterrupt != -1 ? heartbeat_us : 1000);
+    }
+    else if (b.n != 0)
+    {
+        // we're writing registers without a read, which moves the
+        // chip's register pointer away from INPUT0
+        inputPtrCached = false;
+    }
+}
 
-        // set the next read time
-        tRead = time_us_64() + 1000;
+// I2C error handler
+void PCA9555::OnI2CError()
+{
+    // we don't know how far the transaction got, so we no longer know
+    // where the register pointer is
+    inputPtrCached = false;
+
+    // if a read failed, keep its interrupt time pending for the retry
+    if (tReadIntr != 0)
+    {
+        IRQDisabler irqd;
+        if (tIntr == 0)
+            tIntr = tReadIntr;
+        tReadIntr = 0;
+    }
+}
+
+// GPIO IRQ handler for the interrupt inputs
+void PCA9555::IRQ()
+{
+    // Check each chip's interrupt line for a falling edge.  Several chips
+    // can share a line, so collect the lines to acknowledge, and only
+    // clear the events after visiting all of the chips.
+    uint64_t now = time_us_64();
+    uint32_t ack = 0;
+    for (auto &chip : chips)
+    {
+        int gp = chip.gpInterrupt;
+        if (gp != -1 && ((ack & (1UL << gp)) != 0 || (gpio_get_irq_event_mask(gp) & GPIO_IRQ_EDGE_FALL) != 0))
+        {
+            // note the first edge time, and request priority bus access
+            if (chip.tIntr == 0)
+                chip.tIntr = now;
+            chip.i2cPriorityRequest = true;
+            ack |= (1UL << gp);
+        }
+    }
+
+    // acknowledge the edges
+    for (int gp = 0 ; ack != 0 ; ++gp, ack >>= 1)
+    {
+        if ((ack & 1) != 0)
+            gpio_acknowledge_irq(gp, GPIO_IRQ_EDGE_FALL);
+    }
+}
+
+// console command handler
+void PCA9555::Command_main(const ConsoleCommandContext *c)
+{
+    if (c->argc <= 1)
+        return c->Usage();
+
+    for (int i = 1 ; i < c->argc ; ++i)
+    {
+        const char *a = c->argv[i];
+        if (strcmp(a, "-s") == 0 || strcmp(a, "--stats") == 0)
+        {
+            for (auto &chip : chips)
+            {
+                const auto &st = chip.readStats;
+                char mode[32] = "polling";
+                if (chip.gpInterrupt != -1)
+                    snprintf(mode, sizeof(mode), "interrupt on GP%d", chip.gpInterrupt);
+                c->Printf(
+                    "PCA9555[%d] (I2C%d addr 0x%02x), %s\n"
+                    "  Port reads:          %llu\n"
+                    "    Interrupt:         %llu\n"
+                    "    %-18s %llu\n"
+                    "    Cached pointer:    %llu\n"
+                    "  Reads with changes:  %llu\n",
+                    chip.chipNumber, i2c_hw_index(chip.i2c), chip.i2cAddr,
+                    mode,
+                    st.nReads, st.nIntrReads, chip.gpInterrupt != -1 ? "Heartbeat:" : "Polled:",
+                    st.nTimedReads, st.nCachedPtrReads, st.nChanges);
+                if (st.nLatency != 0)
+                {
+                    c->Printf("  Interrupt latency:   %llu samples, avg %llu us, min %lu us, max %lu us\n",
+                        st.nLatency, st.latencySum / st.nLatency, st.latencyMin, st.latencyMax);
+                }
+                chip.i2cStats.Print(c);
+            }
+        }
+        else if (strcmp(a, "--reset-stats") == 0)
+        {
+            for (auto &chip : chips)
+                chip.readStats = ReadStats();
+            c->Print("PCA9555 statistics reset\n");
+        }
+        else
+        {
+            return c->Printf("pca9555: unknown option \"%s\"\n", a);
+        }
     }
 }
@@ -43,6 +43,17 @@
 // interrupt signal, which does require one dedicated GPIO if used,
 // but this software makes it optional, as we can use polling instead.
 //
+// When the interrupt signal is connected, we only read the chip when
+// the signal indicates that an input has changed, plus a slow heartbeat
+// read as a backstop against missed signals.  A falling edge on the
+// signal fires a GPIO IRQ that requests priority access to the I2C bus,
+// so the read happens on the very next bus cycle instead of waiting for
+// our turn in the round-robin rotation.  When we're reading the chip
+// repeatedly without any intervening register writes, we also skip the
+// register-pointer write that normally precedes the read, since the chip
+// retains its command byte between transactions; that cuts each read to
+// a bare two-byte receive.
+//
 // Our public interface numbers the chip's output ports consecutively
 // from 0 to 15.  the data sheet labels the ports in two banks, IO0
 // and IO1, each with 8 ports numbered IOx_0 to IOx_7.  We map the
@@ -75,6 +86,7 @@
 
 // external classes
 class JSONParser;
+class ConsoleCommandContext;
 namespace PinscapePico {
     struct ButtonDevice;
     struct OutputDevDesc;
@@ -138,6 +150,8 @@ public:
     virtual bool OnI2CReady(I2CX *i2c) override;
     virtual bool OnI2CReceive(const uint8_t *data, size_t len, I2CX *i2c) override;
     virtual bool OnI2CWriteComplete(I2CX *i2c) override { return false; }
+    virtual void OnI2CTimeout() override { OnI2CError(); }
+    virtual void OnI2CAbort() override { OnI2CError(); }
 
     // Populate a Vendor Interface button query result buffer with
     // ButtonDevice structs representing the configured PCA9555 chips.
@@ -174,6 +188,15 @@ public:
 protected:
     // send initialization commands
     void SendInitCommands();
+
+    // I2C timeout/abort handler
+    void OnI2CError();
+
+    // GPIO IRQ handler for the interrupt inputs, shared among all chips
+    static void IRQ();
+
+    // console command handler
+    static void Command_main(const ConsoleCommandContext *c);
     
     // Register addresses
     static const uint8_t REG_INPUT0 = 0;    // input port 0
@@ -199,6 +222,39 @@ protected:
     // when we're ready to poll the device again.
     uint64_t tRead = 0;
 
+    // Heartbeat read interval, in microseconds, when the interrupt input
+    // is connected.  We normally only read the chip when it signals a
+    // change, but we also read it periodically in case a signal is missed.
+    uint32_t heartbeat_us = 50000;
+
+    // Time of the first interrupt signal edge since the last read, on
+    // the system clock, or 0 if no edge is pending.  Set by the IRQ.
+    volatile uint64_t tIntr = 0;
+
+    // Interrupt edge time for the read in progress, for latency statistics
+    uint64_t tReadIntr = 0;
+
+    // Is the chip's register pointer known to be at INPUT0?  The chip
+    // retains the command byte between transactions, so after a read
+    // from INPUT0, we can read the inputs again without re-sending the
+    // command byte, as long as no register writes intervene.
+    bool inputPtrCached = false;
+
+    // Port read statistics
+    struct ReadStats
+    {
+        uint64_t nReads = 0;            // total port reads
+        uint64_t nIntrReads = 0;        // reads triggered by the interrupt signal
+        uint64_t nTimedReads = 0;       // timed reads (polling or heartbeat)
+        uint64_t nCachedPtrReads = 0;   // reads that skipped the register pointer write
+        uint64_t nChanges = 0;          // reads that found changed input bits
+        uint64_t nLatency = 0;          // number of latency samples
+        uint64_t latencySum = 0;        // sum of interrupt-to-data latencies, in microseconds
+        uint32_t latencyMin = 0xFFFFFFFF;
+        uint32_t latencyMax = 0;
+    };
+    ReadStats readStats;
+
     // Last input port values, one bit per port; bit 0x0001 is PORT0 #0,
     // 0x0002 is PORT0 #1, etc.  The high byte contains the PORT1 bits.
     uint16_t portBits = 0;
@@ -143,8 +143,18 @@ void PWMWorker::Configure(JSONParser &json)
 
             virtual bool IsValidInstance(int instance) const { return instance >= 0 && instance < units.size() && units[instance] != nullptr; }
             virtual void ShowStats(const ConsoleCommandContext *c, int instance) const {
-                c->Printf("WorkerPico[%d] I2C statistics:\n");
+                c->Printf("WorkerPico[%d] I2C statistics:\n", instance);
                 units[instance]->i2cStats.Print(c);
+
+                // show the level update encoding statistics
+                const auto &st = units[instance]->levelUpdateStats;
+                c->Printf(
+                    "Level updates:\n"
+                    "  Updates sent:          %llu (%llu as BURST)\n"
+                    "  Bytes sent:            %llu\n"
+                    "  Bytes as ranges only:  %llu (%s)\n",
+                    st.nUpdates, st.nBursts, st.txBytes, st.rangeBytes,
+                    units[instance]->version >= VERSION_BURST ? "BURST enabled" : "BURST not supported by device firmware");
             }
             virtual int GetNumPorts(int instance) const { return 24; }
             virtual bool IsValidPort(int instance, int port) const { return port >= 0 && port <= 23; }
@@ -240,6 +250,7 @@ void PWMWorker::Init()
         }
         else if (buf[1] == WHOAMI_ID)
         {
+            version = buf[0];
             sprintf(verInfo, ", WHOAMI=0x%02X (OK), Ver %d", buf[1], buf[0]);
         }
         else
@@ -296,6 +307,28 @@ void PWMWorker::ConfigureFlipperLogic(int port, uint8_t limitLevel, uint16_t tim
         Log(LOG_ERROR, "WorkerPico[%d]: I2C error writing LIMITn, TIMELIMITn for port %d\n", configIndex, port);
 }
 
+void PWMWorker::ConfigureFade(int port, uint16_t fadeTime)
+{
+    // the fade registers were added in firmware version 2
+    if (version < VERSION_FADE)
+    {
+        Log(LOG_ERROR, "WorkerPico[%d]: port %d fade time requires PWMWorker firmware version %d or later (device reports %d)\n",
+            configIndex, port, VERSION_FADE, version);
+        return;
+    }
+
+    // build the transaction buffer
+    uint8_t buf[] = {
+        static_cast<uint8_t>(REG_FADETIME(port)),      // starting address = FADETIME<n>
+        static_cast<uint8_t>(fadeTime & 0xFF),         // FADETIME<n> low byte
+        static_cast<uint8_t>((fadeTime >> 8) & 0xFF),  // FADETIME<n> high byte
+    };
+
+    // send the command
+    if (i2c_write_timeout_us(i2c, i2cAddr, buf, _countof(buf), false, 1000) != _countof(buf))
+        Log(LOG_ERROR, "WorkerPico[%d]: I2C error writing FADETIMEn for port %d\n", configIndex, port);
+}
+
 void PWMWorker::I2CReinitDevice(I2C *)
 {
     Init();
@@ -446,69 +479,81 @@ bool PWMWorker::OnI2CReady(I2CX *i2cx)
     {
         // We have at least one port that needs updating.
         //
-        // Generate a command to send the minimal number of bytes
-        // that accomplishes an update of all of the dirty ports
-        // as a single contiguous command.  This is just a matter
-        // of finding the first and last changed elements, in LEDn
-        // order, and transmitting a command to set that range.
-        uint32_t bit = 0x0001;
-        for (uint8_t regno = REG_LED0 ; regno < REG_LED0+24 ; ++regno, bit <<= 1)
+        // There are two ways to send the update.  The basic way is a
+        // contiguous write to the LEVELn registers, from the first
+        // dirty port to the last, which has to include any unchanged
+        // ports in between.  The other way (on firmware that supports
+        // it) is a BURST write, which sends a 24-bit port mask followed
+        // by the levels for only the ports in the mask.  The burst form
+        // costs three extra mask bytes, but saves a byte for each clean
+        // port inside the range, so it wins whenever the dirty ports are
+        // scattered.  Figure both sizes and send the shorter one.
+        int idx0 = __builtin_ctz(dirty);
+        int idx1 = 31 - __builtin_clz(dirty);
+        int n = idx1 - idx0 + 1;
+        int nDirty = __builtin_popcount(dirty);
+        bool burst = version >= VERSION_BURST && 3 + nDirty < n;
+
+        // Build the command buffer.  The longest possible command is
+        // 25 bytes (register address byte plus 24 LED level bytes), since
+        // we only use the burst form when it's shorter than that.
+        uint8_t buf[25];
+        int len;
+        if (burst)
         {
-            // look for the first dirty bit
-            if ((dirty & bit) != 0)
-            {
-                // this is the first dirty bit
-                int first = regno;
+            // BURST register address, the port mask (little-endian), and
+            // the dirty port levels in port order
+            buf[0] = REG_BURST;
+            buf[1] = static_cast<uint8_t>(dirty & 0xFF);
+            buf[2] = static_cast<uint8_t>((dirty >> 8) & 0xFF);
+            buf[3] = static_cast<uint8_t>((dirty >> 16) & 0xFF);
+            len = 4;
+            for (uint32_t m = dirty ; m != 0 ; m &= m - 1)
+                buf[len++] = level[__builtin_ctz(m)];
+        }
+        else
+        {
+            // starting LEVELn register address, and the range of levels
+            buf[0] = static_cast<uint8_t>(REG_LED0 + idx0);
+            memcpy(&buf[1], &level[idx0], n);
+            len = n + 1;
+        }
 
-                // scan for the last dirty bit
-                int last = regno;
-                for (++regno, bit <<= 1 ; regno < REG_LED0+24 ; ++regno, bit <<= 1)
-                {
-                    if ((dirty & bit) != 0)
-                        last = regno;
-                }
+        // Update our internal record of the last transmitted state.  We
+        // can copy the whole range either way, since the clean ports in
+        // the range already match the transmitted levels.
+        memcpy(&txLevel[idx0], &level[idx0], n * sizeof(txLevel[0]));
 
-                // update our internal record of the last transmitted state
-                int n = last - first + 1;
-                int idx0 = first - REG_LED0;
-                memcpy(&txLevel[idx0], &level[idx0], n * sizeof(txLevel[0]));
-
-                // Build the command buffer to send the LEDn register
-                // updates, including only the stretch from first to
-                // last dirty elements.  The longest possible command is
-                // 25 bytes (register address byte plus 24 LED level
-                // bytes).  The starting address register is 'first'.
-                uint8_t buf[25] = { static_cast<uint8_t>(first) };
-                uint8_t *dst = &buf[1];
-                const uint8_t *src = &level[idx0];
-                for (int i = 0 ; i < n ; ++i)
-                    *dst++ = *src++;
+        // collect statistics
+        auto &st = levelUpdateStats;
+        st.nUpdates += 1;
+        st.nBursts += burst ? 1 : 0;
+        st.txBytes += len;
+        st.rangeBytes += n + 1;
 
 #if 0 // Low-level debug instrumentation - disable by default
-                {
-                    char hexBytes[26*3+1];
-                    char *ph = hexBytes;
-                    for (int i = 0 ; i < n + 1 ; ++i)
-                    {
-                        uint8_t b = buf[i];
-                        uint8_t bl = b & 0x0F;
-                        uint8_t bh = (b >> 4) & 0x0F;
-                        *ph++ = bh + (bh < 10 ? '0' : 'A' - 10);
-                        *ph++ = bl + (bl < 10 ? '0' : 'A' - 10);
-                        *ph++ = ' ';
-                    }
-                    *(ph-1) = 0;
-                    Log(LOG_DEBUG, "Worker[%d]: dirty %06lx, sending LED%d n=%d [%s]\n", configIndex, dirty, idx0, n, hexBytes);
-                }
+        {
+            char hexBytes[26*3+1];
+            char *ph = hexBytes;
+            for (int i = 0 ; i < len ; ++i)
+            {
+                uint8_t b = buf[i];
+                uint8_t bl = b & 0x0F;
+                uint8_t bh = (b >> 4) & 0x0F;
+                *ph++ = bh + (bh < 10 ? '0' : 'A' - 10);
+                *ph++ = bl + (bl < 10 ? '0' : 'A' - 10);
+                *ph++ = ' ';
+            }
+            *(ph-1) = 0;
+            Log(LOG_DEBUG, "Worker[%d]: dirty %06lx, sending %s n=%d [%s]\n", configIndex, dirty, burst ? "BURST" : "LEVELn", len, hexBytes);
+        }
 #endif // end debug
 
-                // add the transaction to the builder
-                txb.AddWrite(buf, n + 1);
+        // add the transaction to the builder
+        txb.AddWrite(buf, len);
 
-                // txLevel is now up to date with level
-                dirty = 0;
-            }
-        }
+        // txLevel is now up to date with level
+        dirty = 0;
     }
 
     // if there's any I2C work to send, start it
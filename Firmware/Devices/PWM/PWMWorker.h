@@ -72,6 +72,13 @@ public:
     // Startup-only port configuratiojn - configure flipper logic
     void ConfigureFlipperLogic(int portNum, uint8_t limitLevel, uint16_t timeout);
 
+    // Startup-only port configuration - set the device-side fade time,
+    // in milliseconds.  With a non-zero fade time, the worker treats each
+    // level update as a fade target, and fades the port to the new level
+    // over the fade time locally, so a fade only takes one I2C write.
+    // Requires PWMWorker firmware version 2 or later.
+    void ConfigureFade(int portNum, uint16_t fadeTime_ms);
+
     // global instances, built from the configuration data
     static std::vector<std::unique_ptr<PWMWorker>> units;
 
@@ -146,16 +153,25 @@ protected:
     static const int REG_CONF_OFS = 0;      // offset of CONF register in LEDn configuration group
     static const int REG_LIMIT_OFS = 1;     // offset of LIMIT register in LEDn configuration group
     static const int REG_TIMELIMIT_OFS = 2; // offset of TIMELIMIT register in LEDn configuration group
+    static const int REG_FADETIME0 = 0x80;  // fade time register for LED0 (16 bits; LED1-LED23 sequentially follow)
+    static const int REG_BURST = 0xB0;      // burst level update (24-bit port mask + changed levels)
     static const int REG_SWRESET = 0xDD;    // SWRESET register
 
     // Get the port register indices for a given port
     static inline int REG_CONF(int port) { return REG_CONF0_BASE + (port * REG_CONFBLK_SIZE); }
     static inline int REG_LIMIT(int port) { return REG_CONF(port) + REG_LIMIT_OFS; }
     static inline int REG_TIMELIMIT(int port) { return REG_CONF(port) + REG_TIMELIMIT_OFS; }
+    static inline int REG_FADETIME(int port) { return REG_FADETIME0 + (port * 2); }
 
     // WHOAMI register value
     const uint8_t WHOAMI_ID = 0x24;   // arbitrary value to sanity-check the device type
 
+    // minimum VERSION register value for the fade time registers
+    static const uint8_t VERSION_FADE = 0x02;
+
+    // minimum VERSION register value for the BURST register
+    static const uint8_t VERSION_BURST = 0x03;
+
     // REG_CTRL0 global configuration register bits
     static const uint8_t CTRL0_ENABLE_OUTPUTS = 0x01;   // enable outputs (ports are in high-impedance state when not enabled)
     static const uint8_t CTRL0_HWRESET = 0x40;          // hardware reset flag; set by the hardware after a CPU reset
@@ -182,6 +198,9 @@ protected:
     // initialization timeout, in microseconds
     uint32_t initTimeout = 20000;
 
+    // device firmware version, from the VERSION register; 0 if unknown
+    uint8_t version = 0;
+
     // Current/pending register.  The I2C service routine checks for
     // changes since the last update and transmits as needed.
     struct ChipReg
@@ -215,4 +234,18 @@ protected:
 
     // Last port levels transmitted to the chip.
     uint8_t txLevel[nPorts]{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    // Level update byte counts, for comparing the burst and contiguous
+    // range encodings.  txBytes counts the bytes actually sent for level
+    // updates (including the register address byte); rangeBytes counts
+    // the bytes that the same updates would have taken as contiguous
+    // range writes only.
+    struct LevelUpdateStats
+    {
+        uint64_t nUpdates = 0;     // number of level update transactions
+        uint64_t nBursts = 0;      // number of updates sent as BURST writes
+        uint64_t txBytes = 0;      // bytes sent
+        uint64_t rangeBytes = 0;   // bytes that range-only encoding would have sent
+    };
+    LevelUpdateStats levelUpdateStats;
 };
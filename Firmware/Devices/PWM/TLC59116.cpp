@@ -109,6 +109,8 @@ void TLC59116::DisableAllCall(int bus)
 //     i2c: <number>,          // I2C bus number (0 or 1)
 //     addr: <number>,         // I2C bus address for this chip, 7-bit notation
 //     reset: <gpNumber>,      // GPIO port connected to hardware /RESET line (can be shared by multiple chips)
+//     dither: <bool>,         // enable temporal dithering for 12-bit effective resolution; default false
+//     ditherInterval: <ms>,   // dithering frame interval in milliseconds, default 2
 //   },
 //   // TLC59116 chip #1, ...
 // ]
@@ -132,6 +134,16 @@ void TLC59116::DisableAllCall(int bus)
 // take control of the ports, with time limiters as needed, it takes
 // over by driving the GPIO high.
 //
+// The TLC59116 has 8-bit PWM resolution, which leaves very few distinct
+// steps at the low end of the brightness range after gamma correction.
+// The 'dither' option compensates by carrying the level at 12-bit
+// resolution, and rendering the extra 4 bits through error diffusion
+// across update frames: each frame sends the 8-bit level nearest the
+// target plus the error accumulated from previous frames, so the
+// average over 16 frames matches the 12-bit level.  This costs an I2C
+// update on every frame for ports with fractional levels, so the
+// frame interval is configurable to trade smoothness for bus time.
+//
 void TLC59116::Configure(JSONParser &json)
 {
     // set the native chip array size to match the JSON array
@@ -172,16 +184,25 @@ void TLC59116::Configure(JSONParser &json)
                 return;
             }
 
+            // get the dithering options
+            bool dither = value->Get("dither")->Bool(false);
+            int ditherInterval = value->Get("ditherInterval")->Int(2);
+            if (ditherInterval < 1 || ditherInterval > 100)
+            {
+                Log(LOG_WARNING, "tlc59116[%d]: ditherInterval must be 1 to 100 ms; using 2 ms\n", index);
+                ditherInterval = 2;
+            }
+
             // create the instance and enroll it in the chip list at the same index
             // as the JSON source data
-            auto *chip = new TLC59116(index, i2c_get_instance(bus), addr, gpReset);
+            auto *chip = new TLC59116(index, i2c_get_instance(bus), addr, gpReset, dither, ditherInterval * 1000);
             chips[index].reset(chip);
 
             // add it to the I2C bus manager for the selected bus
             I2C::GetInstance(bus, false)->Add(chip);
 
             // success
-            Log(LOG_CONFIG, "tlc59116[%d] configured on I2C%d addr 0x%02x\n", index, bus, addr);
+            Log(LOG_CONFIG, "tlc59116[%d] configured on I2C%d addr 0x%02x%s\n", index, bus, addr, dither ? ", dithering enabled" : "");
         }, true);
     }
     else if (!cfg->IsUndefined())
@@ -261,8 +282,12 @@ void TLC59116::Configure(JSONParser &json)
 
             virtual bool IsValidInstance(int instance) const { return instance >= 0 && instance < chips.size() && chips[instance] != nullptr; }
             virtual void ShowStats(const ConsoleCommandContext *c, int instance) const {
-                c->Printf("TLC59116[%d] I2C statistics:\n");
-                chips[instance]->i2cStats.Print(c);
+                auto *chip = chips[instance].get();
+                c->Printf("TLC59116[%d] I2C statistics:\n", instance);
+                chip->i2cStats.Print(c);
+                if (chip->dither)
+                    c->Printf("\nDithering:      %lu ms frames, %lu frames computed\n",
+                        static_cast<unsigned long>(chip->ditherInterval / 1000), static_cast<unsigned long>(chip->nDitherFrames));
             }
             virtual int GetNumPorts(int instance) const { return 16; }
             virtual bool IsValidPort(int instance, int port) const { return port >= 0 && port < 16; }
@@ -326,22 +351,88 @@ void TLC59116::Set(int port, uint8_t newLevel)
 {
     if (port >= 0 && port < nPorts)
     {
+        // If dithering, set the target to the exact 8-bit level, with
+        // no fraction, keeping the accumulated error.  Ignore repeated
+        // settings of the current target, so that we don't undo the
+        // level staged by the last dithering frame.
+        if (dither)
+        {
+            uint16_t target = static_cast<uint16_t>(newLevel) << 4;
+            if ((ditherState[port] >> 4) == target)
+                return;
+            ditherState[port] = (target << 4) | (ditherState[port] & 0x000F);
+        }
+
         // stage the change
-        level[port] = newLevel;
-
-        // Set or clear the dirty bit for this output.  Note that it's
-        // possible for an output to be changed and then reverted back
-        // to the last transmitted state in the span between chip updates,
-        // so we explicitly clear the dirty bit here if the new level is
-        // the same as the transmitted level.
-        uint16_t bit = (1 << port);
-        if (newLevel != txLevel[port])
-            dirty |= bit;
-        else
-            dirty &= ~bit;
+        StageLevel(port, newLevel);
+    }
+}
+
+// set a port level on the 12-bit scale
+void TLC59116::Set12(int port, uint16_t newLevel)
+{
+    if (port >= 0 && port < nPorts)
+    {
+        // If dithering, set the new target, keeping the accumulated
+        // error.  As in Set(), ignore repeated settings of the current
+        // target, so that we don't undo the last dithering frame.
+        newLevel = std::min(newLevel, static_cast<uint16_t>(4095));
+        if (dither)
+        {
+            if ((ditherState[port] >> 4) == newLevel)
+                return;
+            ditherState[port] = (newLevel << 4) | (ditherState[port] & 0x000F);
+        }
+
+        // Stage the integer part of the level immediately, so that level
+        // changes take effect without waiting for the next frame.  When
+        // dithering, the next frame will apply the fraction.
+        StageLevel(port, static_cast<uint8_t>(newLevel >> 4));
     }
 }
 
+// stage a new level for the next chip update
+void TLC59116::StageLevel(int port, uint8_t newLevel)
+{
+    // stage the change
+    level[port] = newLevel;
+
+    // Set or clear the dirty bit for this output.  Note that it's
+    // possible for an output to be changed and then reverted back
+    // to the last transmitted state in the span between chip updates,
+    // so we explicitly clear the dirty bit here if the new level is
+    // the same as the transmitted level.
+    uint16_t bit = (1 << port);
+    if (newLevel != txLevel[port])
+        dirty |= bit;
+    else
+        dirty &= ~bit;
+}
+
+// calculate a dithering frame
+void TLC59116::DitherFrame()
+{
+    // Run one step of first-order error diffusion on each port: add the
+    // error left over from the last frame to the 12-bit target, send the
+    // integer (high 8 bits) part of the sum, and carry the remainder (low
+    // 4 bits) forward to the next frame.  Ports with no fractional part
+    // in the target always yield the plain 8-bit level, so skip them.
+    uint16_t *state = ditherState;
+    for (int port = 0 ; port < nPorts ; ++port, ++state)
+    {
+        uint16_t s = *state;
+        if ((s & 0x00F0) != 0)
+        {
+            unsigned int sum = (s >> 4) + (s & 0x000F);
+            *state = (s & 0xFFF0) | (sum & 0x000F);
+            StageLevel(port, static_cast<uint8_t>(std::min(sum >> 4, 255U)));
+        }
+    }
+
+    // count it
+    ++nDitherFrames;
+}
+
 // get a port level
 uint8_t TLC59116::Get(int port) const
 {
@@ -400,6 +491,16 @@ void TLC59116::PopulateLevels(PinscapePico::OutputDevLevel* &levels)
 // our turn to use the bus.
 bool TLC59116::OnI2CReady(I2CX *i2cx)
 {
+    // if dithering is enabled, compute a new frame when it's time
+    if (dither)
+    {
+        if (uint64_t now = time_us_64(); now >= tNextDitherFrame)
+        {
+            DitherFrame();
+            tNextDitherFrame = now + ditherInterval;
+        }
+    }
+
     // check for work to do
     if (dirty != 0)
     {
@@ -86,8 +86,8 @@ public:
     int GetConfigIndex() const { return configIndex; }
 
     // construction
-    TLC59116(int configIndex, i2c_inst_t *i2c, uint16_t addr, int gpReset) :
-        configIndex(configIndex), I2CDevice(addr), i2c(i2c), gpReset(gpReset) { }
+    TLC59116(int configIndex, i2c_inst_t *i2c, uint16_t addr, int gpReset, bool dither, uint32_t ditherInterval) :
+        configIndex(configIndex), I2CDevice(addr), i2c(i2c), gpReset(gpReset), dither(dither), ditherInterval(ditherInterval) { }
 
     // Initialize.  Sets up the initial chip register configuration.
     void Init();
@@ -96,6 +96,17 @@ public:
     void Set(int port, uint8_t level);
     uint8_t Get(int port) const;
 
+    // Is temporal dithering enabled?  If so, the output manager sets
+    // levels through Set12() instead of Set(), so that gamma correction
+    // is applied at 12-bit resolution, and the fractional part of the
+    // level is rendered by dithering.
+    bool IsDithered() const { return dither; }
+
+    // Set an output level on the 12-bit scale, 0..4095.  With dithering
+    // enabled, the low 4 bits are rendered by error diffusion across
+    // update frames; otherwise this just reduces the level to 8 bits.
+    void Set12(int port, uint16_t level);
+
     // is the given port number valid?
     bool IsValidPort(int port) const { return port >= 0 && port <= 15; }
 
@@ -115,6 +126,14 @@ public:
     virtual bool OnI2CReceive(const uint8_t *data, size_t len, I2CX *i2c) override;
 
 protected:
+    // stage a new level for transmission to the chip
+    void StageLevel(int port, uint8_t level);
+
+    // Calculate a dithering frame.  This advances the error diffusion
+    // for each port with a fractional level, and stages the resulting
+    // 8-bit levels for the next chip update.
+    void DitherFrame();
+
     // register addresses
     static const uint8_t REG_MODE1 = 0x00;         // MODE1
     static const uint8_t REG_MODE2 = 0x01;         // MODE2
@@ -191,4 +210,23 @@ protected:
 
     // Last port levels transmitted to the chip.
     uint8_t txLevel[nPorts]{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    // Temporal dithering enabled
+    bool dither = false;
+
+    // Dithering frame interval, in microseconds, and the time of the
+    // next frame.  Each frame generally requires an I2C update for the
+    // ports with fractional levels, so this sets the bus load that the
+    // dithering adds.
+    uint32_t ditherInterval = 2000;
+    uint64_t tNextDitherFrame = 0;
+
+    // Dithering state, one 16-bit word per port.  The high 12 bits are
+    // the target level on the 12-bit scale, which is the 8-bit chip
+    // level with a 4-bit fraction; the low 4 bits are the accumulated
+    // error from previous frames.
+    uint16_t ditherState[nPorts]{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    // number of dithering frames computed, for statistics
+    uint32_t nDitherFrames = 0;
 };
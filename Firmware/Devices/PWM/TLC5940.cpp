@@ -125,6 +125,8 @@ TLC5940 *TLC5940::GetChain(int n)
 //   sin: <gpNumber>,        // GPIO for SIN pin connection
 //   blank: <gpNumber>,      // GPIO for BLANK pin connection  }  MUST be adjacent GPIO pins
 //   xlat: <gpNumber>,       // GPIO for XLAT pin connection   }    in order BLANK, XLAT
+//   changeOnly: <bool>,     // send grayscale data only when a port level changes; default false
+//   refreshInterval: <number>,  // in changeOnly mode, resend unchanged data at this interval in milliseconds; 0 disables; default 1000
 //
 //   // Optional elements for Dot Correct register programming.
 //   // If provided, the firmware will send the dot correct data
@@ -168,6 +170,16 @@ TLC5940 *TLC5940::GetChain(int n)
 // GSCLK must be on GP5.  This is required because of the way the pins
 // are mapped to the PIO.
 //
+// In the default mode, we send the full grayscale data to the chain on
+// every PWM cycle, whether or not anything has changed.  With
+// changeOnly set, we only start a DMA transfer when a port has changed
+// since the last transfer; on other cycles, the PIO program runs an
+// idle cycle that keeps GSCLK and BLANK going without clocking any
+// data, so the chips keep displaying the last data sent.  This frees
+// up DMA and PIO bandwidth on long chains.  refreshInterval sets an
+// optional periodic resend of the unchanged data, as a safety measure
+// in case the chips lose their shift register contents to a glitch.
+//
 // The dot correct settings - dcprg, vprg, dcData - can be omitted if
 // not needed.  If these aren't used, the physical DCPRG and VPRG pins
 // on the chip should be wired to GND, which will select the chip's
@@ -201,6 +213,8 @@ void TLC5940::Configure(JSONParser &json)
         int dcprg = value->Get("dcprg")->Int(-1);
         int vprg = value->Get("vprg")->Int(-1);
         uint32_t pwmFreq = value->Get("pwmFreq")->UInt32(200);
+        bool changeOnly = value->Get("changeOnly")->Bool(false);
+        uint32_t refreshInterval = value->Get("refreshInterval")->UInt32(1000);
         if (!IsValidGP(blank) || !IsValidGP(gsclk) || !IsValidGP(sclk) || !IsValidGP(xlat) || !IsValidGP(sin)
             || (vprg != -1 && !IsValidGP(vprg))
             || (dcprg != -1 && !IsValidGP(dcprg)))
@@ -243,6 +257,8 @@ void TLC5940::Configure(JSONParser &json)
         // create the device
         auto *chain = new TLC5940(index, nChips, sin, sclk, gsclk, blank, xlat, dcprg, vprg, pwmFreq);
         chains[index].reset(chain);
+        chain->changeOnly = changeOnly;
+        chain->refreshInterval = refreshInterval * 1000;
 
         // check for DC data
         std::unique_ptr<uint8_t> dcData;
@@ -302,7 +318,8 @@ void TLC5940::Configure(JSONParser &json)
 // Construction
 TLC5940::TLC5940(int chainNum, int nChips, int gpSIN, int gpSClk, int gpGSClk, int gpBlank, int gpXlat, int gpDCPRG, int gpVPRG, int pwmFreq) :
     chainNum(chainNum), nChips(nChips), nPorts(nChips*16), gpSClk(gpSClk), gpSIN(gpSIN), gpGSClk(gpGSClk),
-    gpBlank(gpBlank), gpXlat(gpXlat), gpDCPRG(gpDCPRG), gpVPRG(gpVPRG), pwmFreq(pwmFreq)
+    gpBlank(gpBlank), gpXlat(gpXlat), gpDCPRG(gpDCPRG), gpVPRG(gpVPRG), pwmFreq(pwmFreq),
+    cycleTime(1000000 / pwmFreq)
 {
     // allocate space for the current level array
     level = new uint16_t[nPorts];
@@ -542,14 +559,14 @@ bool TLC5940::Init(const uint8_t *dcData)
     //
     // The PIO loop consists of 2 instructions per grayscale count
     // (fixed at 4096 by the chip design), plus (in the current PIO
-    // program implementation) 8 cycles in loop setup and blanking
-    // interval, for a total of 4096*2 + 8 = 8200 cycles.  Therefore:
+    // program implementation) 10 cycles in loop setup and blanking
+    // interval, for a total of 4096*2 + 10 = 8202 cycles.  Therefore:
     //
-    //    8200 / PIOFREQ = 1 / PWMFREQ
-    //    PIOFREQ = 8200 * PWMFREQ
+    //    8202 / PIOFREQ = 1 / PWMFREQ
+    //    PIOFREQ = 8202 * PWMFREQ
     //
     uint32_t sysFreq = clock_get_hz(clk_sys);
-    uint32_t pioFreq = pwmFreq * (8192 + 8);
+    uint32_t pioFreq = pwmFreq * (8192 + 10);
     float pioClockDiv = static_cast<float>(sysFreq) / static_cast<float>(pioFreq);
 
     // Configure the PIO state machine
@@ -559,6 +576,7 @@ bool TLC5940::Init(const uint8_t *dcData)
     sm_config_set_set_pins(&piocfg, gpBlank, 2);        // two SET pins: gpBlank, gpXlat
     sm_config_set_sideset_pins(&piocfg, gpSClk);        // two sideset pins: gpSClk, gpGSClk
     sm_config_set_out_shift(&piocfg, false, true, 12);  // false=shift LEFT (MSB first), true=autoshift ON, 12=bit refill threshold
+    sm_config_set_mov_status(&piocfg, STATUS_TX_LESSTHAN, 1);  // MOV STATUS = all ones when TX FIFO is empty (idle cycle test)
     sm_config_set_clkdiv(&piocfg, pioClockDiv);         // PIO clock divider (see above)
     pio_sm_init(pio, piosm, pioOffset, &piocfg);        // initialize with the configuration and starting program offset
 
@@ -589,10 +607,8 @@ bool TLC5940::Init(const uint8_t *dcData)
     pio_gpio_init(pio, gpSClk);
     pio_gpio_init(pio, gpSIN);
 
-    // Start the PIO running.  Note that the first thing it's going to
-    // do is PULL from the FIFO, which is currently empty, so it'll
-    // block on the first instruction.  The actual start of execution
-    // will occur when we start our first DMA update.
+    // Start the PIO running.  The TX FIFO is currently empty, so it'll
+    // run idle cycles until we start our first DMA update.
     pio_sm_set_enabled(pio, piosm, true);
 
     // Map PIO interrupt flag 0 (INTR register bit SM0, set from our PIO
@@ -661,20 +677,35 @@ void TLC5940::PIO_IRQ()
     // update, the main program will have set dmaNxt to the new buffer.
     // If it's the same as the current buffer, there haven't been any
     // changes, so we can just re-transmit the current buffer.
+    uint64_t now = time_us_64();
     if (dmaNxt != dmaCur)
     {
         // There's new data.  Take ownership of the new buffer by
         // making it current.
         dmaCur = dmaNxt;
     }
+    else if (changeOnly && (refreshInterval == 0 || now - tLastSend < refreshInterval))
+    {
+        // Nothing has changed, and no refresh is due, so skip the
+        // transmission; the PIO will run an idle cycle.  Since our DMA
+        // channel stays idle, we can't use its status to screen out
+        // interrupts from other state machines sharing the IRQ, so only
+        // count one skip per PWM cycle.
+        if (now - tLastCycle >= cycleTime/2)
+        {
+            tLastCycle = now;
+            stats.nSkips += 1;
+        }
+        return;
+    }
 
     // set up the new transmission
     StartDMASend();
+    tLastSend = tLastCycle = now;
 
     // collect statistics
     stats.nSends += 1;
     stats.avgWindow.n += 1;
-    uint64_t now = time_us_64();
     if (stats.avgWindow.n > 1000)
     {
         stats.avgSendTime = static_cast<float>(now - stats.avgWindow.t0) / 1000000.0 / static_cast<float>(stats.avgWindow.n);
@@ -746,11 +777,14 @@ void TLC5940::Diagnostics(const ConsoleCommandContext *c)
     auto &irqStats = PIOHelper::For(pio)->stats;
     c->Printf(
         "TLC5940 chain #%d:\n"
+        "  Refresh mode:     %s\n"
         "  Number of sends:  %lld\n"
+        "  Skipped cycles:   %lld\n"
         "  DMA status:       %s\n"
         "  Sends per second: %.1f (%.2lf ms per send)\n"
         "  Avg time in ISR:  %.2f us (%lld us over %lld calls)\n",
-        chainNum, stats.nSends, dma_channel_is_busy(dmaChannelTx) ? "Busy" : "Idle",
+        chainNum, changeOnly ? "Change-only" : "Continuous",
+        stats.nSends, stats.nSkips, dma_channel_is_busy(dmaChannelTx) ? "Busy" : "Idle",
         1.0f / stats.avgSendTime, stats.avgSendTime * 1000.0f,
         irqStats.AvgTime(), irqStats.t, irqStats.n);
 }
@@ -161,6 +161,8 @@ TLC5947 *TLC5947::GetChain(int n)
 //   sin: <gpNumber>,        // GPIO for SIN pin connection
 //   blank: <gpNumber>,      // GPIO for BLANK pin connection  }  MUST be adjacent GPIO pins
 //   xlat: <gpNumber>,       // GPIO for XLAT pin connection   }    in order BLANK, XLAT
+//   changeOnly: <bool>,     // send grayscale data only when a port level changes; default false
+//   refreshInterval: <number>,  // in changeOnly mode, resend unchanged data at this interval in milliseconds; 0 disables; default 1000
 // }
 //
 // --- OR ---
@@ -189,6 +191,14 @@ TLC5947 *TLC5947::GetChain(int n)
 // in turn keep the TLC5947 output ports in high-Z state.  This should
 // prevent connected devices from spuriously activating during power-up.
 //
+// In the default mode, we send the full grayscale data to the chain on
+// every PWM cycle, whether or not anything has changed.  With
+// changeOnly set, we only start a DMA transfer when a port has changed
+// since the last transfer; on other cycles, the PIO program runs an
+// idle cycle without clocking any data, so the chips keep displaying
+// the last data sent.  refreshInterval sets an optional periodic
+// resend of the unchanged data, as a safety measure.
+//
 // Note the requirements for the BLANK/XLAT outputs to be assigned to
 // CONSECUTIVE GPIO PINS, with XLAT at the higher GP number.  For
 // example, if BLANK is on GP10, XLAT must be on GP11.  This is required
@@ -204,6 +214,8 @@ void TLC5947::Configure(JSONParser &json)
         uint8_t sclk = value->Get("sclk")->UInt8(255);
         uint8_t sin = value->Get("sin")->UInt8(255);
         uint8_t xlat = value->Get("xlat")->UInt8(255);
+        bool changeOnly = value->Get("changeOnly")->Bool(false);
+        uint32_t refreshInterval = value->Get("refreshInterval")->UInt32(1000);
         if (!IsValidGP(blank) || !IsValidGP(sclk) || !IsValidGP(xlat) || !IsValidGP(sin))
         {
             Log(LOG_ERROR, "tlc5947[%d]: one or more invalid/undefined GPIO pins (blank, gsclk, sclk, xlat, sin, dcprg, vprg)\n", index);
@@ -260,6 +272,8 @@ void TLC5947::Configure(JSONParser &json)
         // create the device
         auto *chain = new TLC5947(index, nChips, sin, sclk, blank, xlat);
         chains[index].reset(chain);
+        chain->changeOnly = changeOnly;
+        chain->refreshInterval = refreshInterval * 1000;
 
         // initialize
         chain->Init();
@@ -509,6 +523,7 @@ bool TLC5947::Init()
     sm_config_set_set_pins(&piocfg, gpBlank, 2);        // two SET pins: gpBlank, gpXlat
     sm_config_set_sideset_pins(&piocfg, gpSClk);        // one sideset pins: gpSClk
     sm_config_set_out_shift(&piocfg, false, true, 12);  // false=shift LEFT (MSB first), true=autoshift ON, 12=bit refill threshold
+    sm_config_set_mov_status(&piocfg, STATUS_TX_LESSTHAN, 1);  // MOV STATUS = all ones when TX FIFO is empty (idle cycle test)
     sm_config_set_clkdiv(&piocfg, pioClockDiv);         // PIO clock divider (see above)
     pio_sm_init(pio, piosm, pioOffset, &piocfg);        // initialize with the configuration and starting program offset
 
@@ -520,7 +535,7 @@ bool TLC5947::Init()
 
     // Pre-load the post-data-transfer wait time into Y.  See the PIO program
     // for details.
-    pio_sm_put_blocking(pio, piosm, 2*(15*1024 - 12*nPorts) + 29);
+    pio_sm_put_blocking(pio, piosm, 2*(15*1024 - 12*nPorts) + 27);
     pio_sm_exec(pio, piosm, pio_encode_pull(false, true));     // PULL (if-empty no, blocking yes)
     pio_sm_exec(pio, piosm, pio_encode_mov(pio_y, pio_osr));   // MOV Y, OSR
     pio_sm_exec(pio, piosm, pio_encode_out(pio_null, 12));     // OUT NULL, 12 (empty OSR)
@@ -537,10 +552,8 @@ bool TLC5947::Init()
     pio_gpio_init(pio, gpSClk);
     pio_gpio_init(pio, gpSIN);
 
-    // Start the PIO running.  Note that the first thing it's going to
-    // do is PULL from the FIFO, which is currently empty, so it'll
-    // block on the first instruction.  The actual start of execution
-    // will occur when we start our first DMA update.
+    // Start the PIO running.  The TX FIFO is currently empty, so it'll
+    // run idle cycles until we start our first DMA update.
     pio_sm_set_enabled(pio, piosm, true);
 
     // Map PIO interrupt flag 0 (INTR register bit SM0, set from our PIO
@@ -613,20 +626,35 @@ void TLC5947::PIO_IRQ()
     // update, the main program will have set dmaNxt to the new buffer.
     // If it's the same as the current buffer, there haven't been any
     // changes, so we can just re-transmit the current buffer.
+    uint64_t now = time_us_64();
     if (dmaNxt != dmaCur)
     {
         // There's new data.  Take ownership of the new buffer by
         // making it current.
         dmaCur = dmaNxt;
     }
+    else if (changeOnly && (refreshInterval == 0 || now - tLastSend < refreshInterval))
+    {
+        // Nothing has changed, and no refresh is due, so skip the
+        // transmission; the PIO will run an idle cycle.  Our DMA channel
+        // stays idle, so its status doesn't screen out interrupts from
+        // other state machines sharing the IRQ; count at most one skip
+        // per PWM cycle (fixed at 1024us on this chip).
+        if (now - tLastCycle >= 512)
+        {
+            tLastCycle = now;
+            stats.nSkips += 1;
+        }
+        return;
+    }
 
     // set up the new transmission
     StartDMASend();
+    tLastSend = tLastCycle = now;
 
     // collect statistics
     stats.nSends += 1;
     stats.avgWindow.n += 1;
-    uint64_t now = time_us_64();
     if (stats.avgWindow.n > 1000)
     {
         stats.avgSendTime = static_cast<float>(now - stats.avgWindow.t0) / 1000000.0 / static_cast<float>(stats.avgWindow.n);
@@ -698,11 +726,14 @@ void TLC5947::Diagnostics(const ConsoleCommandContext *c)
     auto &irqStats = PIOHelper::For(pio)->stats;
     c->Printf(
         "TLC5947 chain #%d:\n"
+        "  Refresh mode:     %s\n"
         "  Number of sends:  %lld\n"
+        "  Skipped cycles:   %lld\n"
         "  DMA status:       %s\n"
         "  Sends per second: %.1f (%.2lf ms per send)\n"
         "  Avg time in ISR:  %.2f us (%lld us over %lld calls)\n",
-        chainNum, stats.nSends, dma_channel_is_busy(dmaChannelTx) ? "Busy" : "Idle",
+        chainNum, changeOnly ? "Change-only" : "Continuous",
+        stats.nSends, stats.nSkips, dma_channel_is_busy(dmaChannelTx) ? "Busy" : "Idle",
         1.0f / stats.avgSendTime, stats.avgSendTime * 1000.0f,
         irqStats.AvgTime(), irqStats.t, irqStats.n);
 }
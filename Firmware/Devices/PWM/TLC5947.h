@@ -120,6 +120,22 @@ protected:
     int gpBlank;    // BLANK
     int gpXlat;     // XLAT
 
+    // Change-only mode.  If set, we only start a DMA transmission when
+    // the grayscale data has changed since the last transmission (or
+    // when the periodic safety refresh is due), and let the PIO run
+    // idle cycles in between.  Otherwise, we resend the data on every
+    // PWM cycle.
+    bool changeOnly = false;
+
+    // Safety refresh interval in change-only mode, in microseconds; 0
+    // disables periodic refreshes
+    uint32_t refreshInterval = 1000000;
+
+    // time of last DMA transmission start, and last PWM cycle counted
+    // in the IRQ handler
+    uint64_t tLastSend = 0;
+    uint64_t tLastCycle = 0;
+
     // DMA channel for PIO transmissions
     int dmaChannelTx = -1;
     dma_channel_config configTx;
@@ -158,6 +174,10 @@ protected:
         // Number of DMA transmissions started
         uint64_t nSends = 0;
 
+        // Number of PWM cycles where we skipped the transmission
+        // because nothing changed (change-only mode)
+        uint64_t nSkips = 0;
+
         // send time averaging - we count sends over a time window
         // to calculate the average rate over that window
         struct
@@ -38,6 +38,7 @@ VCNL4010::VCNL4010(int iredCurrent, int gpInt) :
 //   i2c: <number>,          // I2C bus number (0 or 1) (note: no I2C address is needed, since VCNL4010 has a fixed address, 0x13)
 //   iredCurrent: <number>,  // IR emitter current in milliamps, 10 to 200, in 10mA increments; default is 200
 //   interrupt: <gpio>,      // GPIO port number of interrupt input; optional, omit if interrupt pin isn't connected
+//   pipelined: <bool>,      // trigger on-demand measurements back to back (true), or use self-timed mode (false, default)
 // }
 //
 void VCNL4010::Configure(JSONParser &json)
@@ -82,6 +83,9 @@ void VCNL4010::Configure(JSONParser &json)
         // set the polling flag
         if (val->Get("poll")->Bool(false))
             vcnl4010->forcePolling = true;
+
+        // set the sampling mode
+        vcnl4010->pipelined = val->Get("pipelined")->Bool(false);
         
         // Initialize our GPIO IRQ handler.  The IRQ line is pulled low
         // when an interrupt is asserted.  Respond to the falling edge
@@ -220,21 +224,28 @@ void VCNL4010::SendInitCommands(i2c_inst_t *i2c)
         }
     }
 
-    // enable self-timed proximity measurements
-    // (prox_en [0x02] | selftimed_en [0x01] in command register 0x80)
+    // In pipelined mode, start the first on-demand proximity measurement
+    // (prox_od [0x08] in command register 0x80).  Otherwise, enable
+    // self-timed proximity measurements (prox_en [0x02] | selftimed_en
+    // [0x01]).
     {
-        static const uint8_t buf[] = { 0x80, 0x03 };
+        const uint8_t buf[] = { 0x80, static_cast<uint8_t>(pipelined ? 0x08 : 0x03) };
         int result = i2c_write_timeout_us(i2c, i2cAddr, buf, _countof(buf), false, 1000);
         if (result != _countof(buf))
         {
-            Log(LOG_DEBUG, "VCNL4010 PROX_EN register (0x80) write failed\n");
+            Log(LOG_DEBUG, "VCNL4010 command register (0x80) write failed\n");
             ok = false;
         }
     }
 
+    // note the sampling start time
+    tStatsStart = tTrigger = tPollNotReady = time_us_64();
+    sampleReadCount = 0;
+    latencySum = 0;
+
     // report the result
-    Log(ok ? LOG_CONFIG : LOG_ERROR, "VCNL4010 device initialization %s; I2C%d addr 0x%02x, Product ID %d, Rev %d, IR current %d mA\n",
-        ok ? "OK" : "failed",
+    Log(ok ? LOG_CONFIG : LOG_ERROR, "VCNL4010 device initialization %s; %s mode; I2C%d addr 0x%02x, Product ID %d, Rev %d, IR current %d mA\n",
+        ok ? "OK" : "failed", pipelined ? "pipelined" : "self-timed",
         i2c_hw_index(i2c), i2cAddr,
         prodIdRev >> 4, prodIdRev & 0x0F, curRegByte*10);
 }
@@ -254,6 +265,10 @@ void VCNL4010::IRQ()
     // remember the sample arrival time
     vcnl4010->tInterrupt = time_us_64();
 
+    // ask the I2C manager to give us the bus ahead of the round-robin
+    // order, to minimize the latency reading the new sample
+    vcnl4010->i2cPriorityRequest = true;
+
     // acknowledge the IRQ
     gpio_acknowledge_irq(vcnl4010->gpInt, GPIO_IRQ_EDGE_FALL);
 }
@@ -272,8 +287,64 @@ bool VCNL4010::Read(uint16_t &proxCount, uint64_t &timestamp)
     return ret;
 }
 
+// get the average time between samples
+uint32_t VCNL4010::GetAvgSampleTime() const
+{
+    return sampleReadCount != 0 ? static_cast<uint32_t>((time_us_64() - tStatsStart) / sampleReadCount) : 0;
+}
+
+void VCNL4010::ReadResult(I2CX *i2c)
+{
+    // Read the proximity result registers (0x87 = MSB, 0x88 = LSB),
+    // clear the interrupt status bits if we're using interrupts, and
+    // trigger the next on-demand measurement if pipelining, all in one
+    // bus transaction.  The result registers hold the value we're
+    // reading until the next measurement completes, so it's safe to
+    // start the next one right away.
+    I2C::TXRXBuilder<3, 8> b;
+    static const uint8_t result[] = { 0x87 };
+    static const uint8_t clear[] = { 0x8E, 0x0F };
+    static const uint8_t start[] = { 0x80, 0x08 };
+    b.AddRead(result, _countof(result), 2);
+    if (gpInt >= 0)
+        b.AddWrite(clear, _countof(clear));
+    if (pipelined)
+        b.AddWrite(start, _countof(start));
+    i2c->MultiReadWrite(b);
+    readReg = 0x87;
+
+    // the next sample can't complete until after this point
+    tTrigger = tPollNotReady = time_us_64();
+    if (pipelined)
+        tNextSampleEst = tTrigger + ON_DEMAND_TIME_US;
+}
+
+void VCNL4010::ClearAndTrigger(I2CX *i2c)
+{
+    // clear the interrupt status bits and start a new on-demand measurement
+    I2C::TXRXBuilder<2, 4> b;
+    static const uint8_t clear[] = { 0x8E, 0x0F };
+    static const uint8_t start[] = { 0x80, 0x08 };
+    b.AddWrite(clear, _countof(clear));
+    b.AddWrite(start, _countof(start));
+    i2c->MultiReadWrite(b);
+    readReg = 0x00;
+    tTrigger = tPollNotReady = time_us_64();
+    tNextSampleEst = tTrigger + ON_DEMAND_TIME_US;
+}
+
 bool VCNL4010::OnI2CReady(I2CX *i2c)
 {
+    // In pipelined mode, if the current measurement hasn't produced a
+    // result within a generous timeout, the trigger or the interrupt
+    // clear might have been lost to a bus error, so start over.
+    uint64_t now = time_us_64();
+    if (pipelined && now - tTrigger > 50000)
+    {
+        ClearAndTrigger(i2c);
+        return true;
+    }
+
     // check if the interrupt signal is connected
     if (gpInt >= 0 && !forcePolling)
     {
@@ -282,21 +353,21 @@ bool VCNL4010::OnI2CReady(I2CX *i2c)
         // available, there's no need for an I2C transaction on this round.
         if (!gpio_get(gpInt))
         {
-            // a sample is available - read the proximity result registers
-            // (0x87 = MSB, 0x88 = LSB)
-            readReg = 0x87;
-            i2c->Read(&readReg, 1, 2);
+            // a sample is available - read it
+            ReadResult(i2c);
             return true;
         }
     }
     else
     {
         // We don't have an interrupt line, so we have to poll for input.
-        // Don't poll until we reach the estimated time for the next sample;
-        // the sensor collects samples automatically at a fixed pace, so
-        // there's no point in checking until the next sample interval
-        // elapses.
-        if (time_us_64() > tNextSampleEst)
+        // Don't poll until we reach the estimated time for the next
+        // sample, so that we don't tie up the bus with polls that can't
+        // succeed.  In self-timed mode, the sensor collects samples at a
+        // fixed pace, so the estimate is one sample interval after the
+        // last sample.  In pipelined mode, it's the minimum on-demand
+        // measurement time after the trigger.
+        if (now > tNextSampleEst)
         {
             readReg = 0x80;
             i2c->Read(&readReg, 1, 1);
@@ -319,11 +390,18 @@ bool VCNL4010::OnI2CReceive(const uint8_t *data, size_t len, I2CX *i2c)
         // is available in the prox result registers (0x87, 0x88).
         if ((data[0] & 0x20) != 0)
         {
-            // input ready - read it from registers 0x87-0x88
-            readReg = 0x87;
-            i2c->Read(&readReg, 1, 2);
+            // Input ready.  Estimate the completion time as the midpoint
+            // between the last poll that found it not ready and now.
+            uint64_t now = time_us_64();
+            tPollCompletionEst = tPollNotReady + (now - tPollNotReady)/2;
+
+            // read it from registers 0x87-0x88
+            ReadResult(i2c);
             return true;
         }
+
+        // not ready yet - note the time
+        tPollNotReady = time_us_64();
         break;
 
     case 0x8E:
@@ -332,8 +410,7 @@ bool VCNL4010::OnI2CReceive(const uint8_t *data, size_t len, I2CX *i2c)
         // available.
         if ((data[0] & 0x08) != 0)
         {
-            readReg = 0x87;
-            i2c->Read(&readReg, 1, 2);
+            ReadResult(i2c);
             return true;
         }
         break;
@@ -346,38 +423,37 @@ bool VCNL4010::OnI2CReceive(const uint8_t *data, size_t len, I2CX *i2c)
             // register 0x88 (result low byte).
             lastProxCount = (static_cast<uint16_t>(data[0]) << 8) | data[1];
 
-            // Record the time we obtained the sample.  If we have an
+            // Record the measurement completion time.  If we have an
             // interrupt input, use the time of the last interrupt, since
             // that records precisely when the chip signaled that a new
-            // sample was ready.  Otherwise, we don't know when the sample
-            // actually arrived at the chip, so the best we can is record
-            // the time we read it, which is less precise since the sample
-            // could have been sitting there for up to a full cycle (4ms at
-            // the maximum 250/s sampling rate).
-            tLastSample = (gpInt >= 0) ? tInterrupt : time_us_64();
-
-            // Set the estimated next sample time.  We program the sensor
-            // for 250 sample/second, so we expect a new sample in about
-            // 4ms.  This is only used when we're in polling mode, to
-            // minimize unnecessary I2C bus usage.  In interrupt mode, we
-            // can efficiently determine when there's a sample available
-            // without any I2C traffic, by checking the interrupt GPIO.
-            tNextSampleEst = tLastSample + 4000;
+            // sample was ready.  Otherwise, use the estimate from the
+            // status polling, which is precise to within half of the
+            // polling interval.
+            uint64_t now = time_us_64();
+            tLastSample = (gpInt >= 0 && !forcePolling) ? tInterrupt : tPollCompletionEst;
+
+            // Set the estimated next sample time.  In self-timed mode, we
+            // program the sensor for 250 sample/second, so we expect a
+            // new sample in about 4ms.  This is only used when we're in
+            // polling mode, to minimize unnecessary I2C bus usage.  In
+            // interrupt mode, we can efficiently determine when there's a
+            // sample available without any I2C traffic, by checking the
+            // interrupt GPIO.  In pipelined mode, the result read set the
+            // estimate when it triggered the next measurement.
+            if (!pipelined)
+                tNextSampleEst = tLastSample + 4000;
 
             // flag that a new sample is available for reading at the
             // programmatic interface
             isSampleReady = true;
 
-            // If we're using interrupts, explicitly clear the interrupt
-            // status bit (bit 0x08 in register 0x8E) on the device.  For
-            // good measure, just clear all of the interrupt status bits, by
-            // writing '1' bits to each position with an assigned meaning.
-            if (gpInt >= 0)
-            {
-                uint8_t buf[] = { 0x8E, 0x0F };
-                i2c->Write(buf, _countof(buf));
-                return true;
-            }
+            // collect statistics
+            sampleReadCount += 1;
+            latencySum += now - tLastSample;
+
+            // The result read transaction already cleared the interrupt
+            // status bits, if we're using interrupts, and started the next
+            // measurement, if we're pipelining.
         }
 
         // done
@@ -387,4 +463,3 @@ bool VCNL4010::OnI2CReceive(const uint8_t *data, size_t len, I2CX *i2c)
     // no further operation requested
     return false;
 }
-
@@ -18,6 +18,14 @@
 // without any software changes.  However, note that the PCB footprints of the
 // '10 and '20 iterations are different, so they're not interchangeable at the
 // hardware level.
+//
+// Sampling modes: by default, we use the chip's self-timed mode, which
+// tops out at 250 samples per second.  Set pipelined:true in the config
+// to use "pipelined" mode instead, where we trigger each proximity
+// measurement on demand, in the same I2C transaction that reads the
+// result of the previous measurement.  An on-demand measurement is much
+// shorter than the self-timed sampling period, so this runs the sensor
+// as fast as the I2C bus can keep up with it.
 
 #pragma once
 
@@ -81,6 +89,12 @@ public:
     // at the receiver.
     bool Read(uint16_t &proxCount, uint64_t &timestamp);
 
+    // Get the average time between samples, in microseconds, and the
+    // average latency from measurement completion to our reading the
+    // result, in microseconds, for diagnostics and status reporting
+    uint32_t GetAvgSampleTime() const;
+    uint32_t GetAvgLatency() const { return sampleReadCount != 0 ? static_cast<uint32_t>(latencySum / sampleReadCount) : 0; }
+
     // I2C device interface
     virtual const char *I2CDeviceName() const override { return "VCNL4010"; }
     virtual void I2CReinitDevice(I2C *i2c) override;
@@ -108,13 +122,51 @@ protected:
     // use polling even if interrupt pin is configured - for debugging
     bool forcePolling = false;
 
+    // Pipelined mode: trigger on-demand measurements back to back, rather
+    // than using the chip's self-timed mode
+    bool pipelined = false;
+
+    // Minimum time for an on-demand measurement, in microseconds.  In
+    // pipelined polling mode, we don't start polling for the result until
+    // this much time has elapsed since the trigger.
+    static const uint32_t ON_DEMAND_TIME_US = 250;
+
+    // Time we triggered the current on-demand measurement, in pipelined
+    // mode.  We use this to re-trigger if the result never arrives, which
+    // could happen if the trigger command was lost to a bus error.
+    uint64_t tTrigger = 0;
+
+    // Time of the last status poll that found no sample ready, and the
+    // estimated completion time of the sample we're reading, in polling
+    // mode.  The measurement completed some time between the last poll
+    // that found it not ready and the poll that found it ready, so we
+    // take the midpoint as the completion time.
+    uint64_t tPollNotReady = 0;
+    uint64_t tPollCompletionEst = 0;
+
+    // Build the result-read transaction: read the proximity result
+    // registers, clear the interrupt status, and, in pipelined mode,
+    // trigger the next measurement.
+    void ReadResult(I2CX *i2c);
+
+    // Build a transaction to clear the interrupt status and trigger a new
+    // on-demand measurement, to restart the pipeline
+    void ClearAndTrigger(I2CX *i2c);
+
+    // statistics: samples read, starting time, and latency from
+    // measurement completion to reading the result
+    uint64_t sampleReadCount = 0;
+    uint64_t tStatsStart = 0;
+    uint64_t latencySum = 0;
+
     // time we retrieved the last sample
     uint64_t tLastSample = 0;
 
     // Estimated time of next sample.  When we're in polling mode, we use this
     // to wait to poll the device until enough time has elapsed for a sample to
     // be ready.  The device has a fairly predictable time between samples, so
-    // this lets us minimize unnecessary bus traffic.
+    // this lets us minimize unnecessary bus traffic.  In pipelined mode, this
+    // is the earliest time the triggered measurement could complete.
     uint64_t tNextSampleEst = 0;
 
     // time of last Sample Ready interrupt (used only if the interrupt GPIO is configured)
@@ -39,6 +39,7 @@ std::unique_ptr<AEDR8300> aedr8300;
 // aedr8300: {
 //    channelA: <number>,      // GPIO port number for encoder channel A connection
 //    channelB: <number>,      // GPIO port number for encoder channel B connection
+//    pio: <bool>,             // decode in a PIO state machine (channelB must be channelA+1)
 // }
 //
 void AEDR8300::Configure(JSONParser &json)
@@ -53,7 +54,8 @@ void AEDR8300::Configure(JSONParser &json)
             return;
 
         // success - make the device available through the global singleton
-        Log(LOG_CONFIG, "aedr8300 configured; chA=GP%d, chB=GP%d\n", dev->gpA, dev->gpB);
+        Log(LOG_CONFIG, "aedr8300 configured; chA=GP%d, chB=GP%d, %s decoding\n",
+            dev->gpA, dev->gpB, dev->IsPIOMode() ? "PIO" : "interrupt");
         aedr8300.reset(dev.release());
     }
 }
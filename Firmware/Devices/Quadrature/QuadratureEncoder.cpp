@@ -5,10 +5,13 @@
 // standard library headers
 #include <stdio.h>
 #include <stdint.h>
+#include <algorithm>
 
 // Pico SDK headers
 #include <pico/stdlib.h>
 #include <pico/time.h>
+#include <hardware/pio.h>
+#include <hardware/clocks.h>
 
 // local project headers
 #include "Pinscape.h"
@@ -18,6 +21,7 @@
 #include "GPIOManager.h"
 #include "ThunkManager.h"
 #include "QuadratureEncoder.h"
+#include "QuadratureEncoder_pio.pio.h"
 
 // reset the counter to zero
 void QuadratureEncoder::ZeroCounter()
@@ -25,6 +29,14 @@ void QuadratureEncoder::ZeroCounter()
     // Note that it's not necessary to disable IRQs here, even though
     // the interrupt handlers also access the count, because a single
     // memory write is inherently atomic with respect to interrupts.
+    //
+    // In PIO mode, the running count lives in the state machine, so
+    // fold the current count into the zero offset instead.
+    if (pio != nullptr)
+    {
+        ReadPIOCount();
+        pioZero += count;
+    }
     count = 0;
 }
 
@@ -47,10 +59,14 @@ bool QuadratureEncoder::ConfigureBase(const char *name, const JSONParser::Value
         || !gpioManager.ClaimSharedInput(Format("%s (ChB)", name), b, false, false, true))
         return false;
 
-    // set the GP ports in the chip
+    // set the GP ports in the chip, and remember the name for logging
+    this->name = name;
     this->gpA = a;
     this->gpB = b;
 
+    // note if PIO decoding is requested
+    this->usePIO = val->Get("pio")->Bool(false);
+
     // successful configuration - initialize the device and return the result
     return Init();
 }
@@ -58,6 +74,11 @@ bool QuadratureEncoder::ConfigureBase(const char *name, const JSONParser::Value
 // Initialize
 bool QuadratureEncoder::Init()
 {
+    // if PIO decoding is requested, try setting it up; if that fails,
+    // fall back on interrupts
+    if (usePIO && InitPIO())
+        return true;
+
     // Set up interrupt handlers on the A and B channels.  Set these to
     // the highest priority among GPIO handlers, since the quadrature
     // interrupts are extremely sensitive to latency when used with a
@@ -121,3 +142,129 @@ void __not_in_flash_func(QuadratureEncoder::IRQ)()
     gpio_acknowledge_irq(gpA, maskA);
     gpio_acknowledge_irq(gpB, maskB);
 }
+
+// Set up the PIO decoder
+bool QuadratureEncoder::InitPIO()
+{
+    // The PIO reads the A/B inputs as a two-bit group starting at the
+    // IN base pin, so channel B has to be the next GPIO after channel A
+    if (gpB != gpA + 1)
+        return Log(LOG_ERROR, "%s: PIO decoding requires channelB to be the next GPIO after channelA (GP%d); "
+            "using GPIO interrupts\n", name, gpA + 1), false;
+
+    // Try loading the program into each PIO in turn.  The program uses
+    // computed jumps through a table at the start of instruction memory,
+    // so it must be loaded at offset zero, which the program's .origin
+    // directive tells the SDK to enforce.  Note that the program takes
+    // up nearly all of a PIO's 32-instruction memory, so it can only
+    // load into a PIO that no other device has claimed, and it leaves
+    // almost no room for other devices' programs in that PIO.
+    auto TryClaimPIO = [this](PIO pio)
+    {
+        // make sure we can add our program to the PIO
+        if (!pio_can_add_program(pio, &QuadratureEncoder_program))
+            return false;
+
+        // try claiming a state machine on this PIO
+        this->piosm = pio_claim_unused_sm(pio, false);
+        if (this->piosm < 0)
+            return false;
+
+        // success - add the program
+        this->pioOffset = pio_add_program(pio, &QuadratureEncoder_program);
+        this->pio = pio;
+        return true;
+    };
+    if (!TryClaimPIO(pio0) && !TryClaimPIO(pio1))
+    {
+        return Log(LOG_ERROR, "%s: insufficient PIO resources for PIO decoding (the decoder program needs %d of the 32 "
+            "instruction slots, starting at offset 0, in a PIO not used by other devices); using GPIO interrupts\n",
+            name, static_cast<int>(QuadratureEncoder_program.length)), false;
+    }
+
+    // Configure the state machine.  As with other PIO inputs, we don't
+    // need to assign the GPIOs to the PIO, since a PIO can read any GPIO
+    // input regardless of its function selection; leaving them as plain
+    // GPIO inputs keeps them readable by the other shared-input users.
+    // Run at the full system clock speed, for the fastest sampling.
+    pio_sm_set_enabled(pio, piosm, false);
+    auto piocfg = QuadratureEncoder_program_get_default_config(pioOffset);
+    sm_config_set_in_pins(&piocfg, gpA);                 // IN base pin: channel A (channel B is base+1)
+    sm_config_set_in_shift(&piocfg, false, false, 32);   // false=shift LEFT, false=auto-push OFF
+    sm_config_set_out_shift(&piocfg, true, false, 32);   // true=shift RIGHT, false=auto-pull OFF
+    sm_config_set_fifo_join(&piocfg, PIO_FIFO_JOIN_RX);  // use the TX FIFO space to extend the RX FIFO
+    sm_config_set_clkdiv(&piocfg, 1.0f);                 // full system clock speed
+    pio_sm_init(pio, piosm, pioOffset + QuadratureEncoder_offset_update, &piocfg);
+
+    // Note the system clock speed in MHz, for converting the state
+    // machine's pass counter to elapsed time
+    pioClockMHz = std::max(clock_get_hz(clk_sys) / 1000000U, 1U);
+
+    // pre-load Y with the zero count, X with the zero pass counter, and
+    // OSR with the current pin state
+    pio_sm_exec(pio, piosm, pio_encode_set(pio_y, 0));
+    pio_sm_exec(pio, piosm, pio_encode_set(pio_x, 0));
+    pio_sm_exec(pio, piosm, pio_encode_in(pio_pins, 2));
+    pio_sm_exec(pio, piosm, pio_encode_mov(pio_osr, pio_isr));
+
+    // start the state machine
+    pio_sm_set_enabled(pio, piosm, true);
+
+    // success
+    return true;
+}
+
+// Read the latest count from the PIO decoder
+void QuadratureEncoder::ReadPIOCount()
+{
+    // The state machine pushes its status on every loop pass without
+    // blocking, so the FIFO is normally full, and its contents date from
+    // whenever it last filled up - which could be long ago.  So discard
+    // everything currently in the FIFO, and wait for the next push, which
+    // arrives within a few PIO cycles.  The spin limit only guards against
+    // a stopped state machine, which should never happen; if it does, the
+    // count stays at its last value, so count and log the stale read.
+    pio_sm_clear_fifos(pio, piosm);
+    for (int spins = 0 ; pio_sm_is_rx_fifo_empty(pio, piosm) ; )
+    {
+        if (++spins > 100)
+        {
+            if (pioStaleReads++ % 1000 == 0)
+                Log(LOG_ERROR, "%s: PIO decoder not responding; count is stale (%lu stale reads)\n", name, pioStaleReads);
+            return;
+        }
+    }
+    uint64_t now = time_us_64();
+    uint32_t status = pio_sm_get(pio, piosm);
+
+    // The status word holds the low 16 bits of the count in the high
+    // half, and the low 16 bits of the pass counter in the low half (see
+    // the .pio file).  Extend the count to 32 bits by adding the change
+    // since the last read.  The state machine keeps the count negated,
+    // so the change is the old raw value minus the new one.
+    uint16_t rawCount = static_cast<uint16_t>(status >> 16);
+    pioCount += static_cast<int16_t>(pioRawCount - rawCount);
+    pioRawCount = rawCount;
+
+    // apply the zero offset
+    int32_t newCount = pioCount - pioZero;
+
+    // If the count changed, figure the time of the edge.  The pass
+    // counter is zeroed on each transition and decremented on each loop
+    // pass after that, and each pass without a transition takes exactly
+    // PIO_PASS_CYCLES system clocks, so the negated counter gives the
+    // time since the edge.  The counter wraps at 16 bits (about 4.7ms at
+    // 125 MHz), so it's only exact if the previous read was more recent
+    // than that; in any case, the edge came after the previous read,
+    // since that read saw the old count.
+    if (newCount != count)
+    {
+        uint32_t passes = static_cast<uint16_t>(0x10000 - (status & 0xFFFF));
+        uint64_t dt = passes * PIO_PASS_CYCLES / pioClockMHz;
+        tCount = std::max(now - dt, tPioRead);
+        count = newCount;
+    }
+
+    // note the read time
+    tPioRead = now;
+}
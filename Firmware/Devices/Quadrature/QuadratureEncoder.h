@@ -6,8 +6,26 @@
 // representing the states of the two channels, which can be interpreted
 // as a two-bit Gray code that encodes one step of relative motion, plus
 // or minus, on each state transition.  This base class handles the GPIO
-// inputs with interrupt handlers, and keeps a running position counter
-// based on detected transitions.
+// inputs, and keeps a running position counter based on detected
+// transitions.
+//
+// The base class can decode the channel inputs in either of two ways:
+//
+// - GPIO interrupts (the default).  Each edge on either channel fires an
+//   interrupt, and the handler applies the state transition to the count.
+//   This costs CPU time per edge, and can miss edges if the interrupt is
+//   held off by other interrupt handlers or critical sections while the
+//   encoder is moving quickly.
+//
+// - PIO decoding (enabled with the 'pio' configuration key).  A PIO state
+//   machine samples the pins and counts transitions in hardware, so the
+//   CPU isn't involved at all per edge, and the count can't fall behind
+//   no matter what the CPU is doing.  The host reads the count from the
+//   PIO RX FIFO on demand.  This requires the channel B GPIO to be the
+//   next consecutive GPIO after channel A, since the PIO reads the two
+//   pins as a group, and it requires a free state machine and room at
+//   offset zero in the PIO instruction memory.  If any of these aren't
+//   available, we fall back on interrupt mode.
 
 #pragma once
 
@@ -19,6 +37,7 @@
 #include <pico/stdlib.h>
 #include <pico/time.h>
 #include <hardware/gpio.h>
+#include <hardware/pio.h>
 
 // local project headers
 #include "Pinscape.h"
@@ -38,6 +57,7 @@ public:
     //
     //   channelA: <number>,       // GPIO port for channel A input from the sensor
     //   channelB: <number>,       // GPIO port for channel B input from the sensor
+    //   pio: <bool>,              // decode in a PIO state machine instead of via GPIO interrupts
     //
     // Upon successful configuration, we'll call Init() and return true.  On
     // error, logs an error message and returns false.
@@ -57,18 +77,30 @@ public:
     // helpful for the user in logged errors.
     bool ConfigureBase(const char *name, const JSONParser::Value *key);
 
-    // Get the current count
-    int GetCount() const { return count; }
+    // Get the current count.  In PIO mode, this reads the latest count
+    // from the state machine.
+    int GetCount() { if (pio != nullptr) ReadPIOCount(); return count; }
 
     // Get the current instantaneous channel A/B status.  Returns the
     // channel status encoded in the two low bits of an int (0x0001 for
-    // channel A, 0x0002 for channel B).
-    unsigned int GetChannelState() const { return state; }
+    // channel A, 0x0002 for channel B).  In PIO mode, the state is only
+    // tracked inside the state machine, so we read the pins directly.
+    unsigned int GetChannelState() const {
+        return pio == nullptr ? state : (gpio_get(gpA) ? 0x01 : 0x00) | (gpio_get(gpB) ? 0x02 : 0x00);
+    }
 
     // Get the time of the last count change, as a tick count on the Pico's
-    // system clock (microseconds since reset)
+    // system clock (microseconds since reset).  In interrupt mode, this is
+    // the time of the interrupt for the last edge that changed the count.
+    // In PIO mode, the state machine has no access to the system clock, so
+    // it counts its loop passes since the last edge instead, and the first
+    // GetCount() call that observes the new count works back from that to
+    // the time of the edge.
     uint64_t GetCountTime() const { return tCount; }
 
+    // is the PIO decoder active?
+    bool IsPIOMode() const { return pio != nullptr; }
+
     // Reset the counter to zero
     void ZeroCounter();
 
@@ -81,6 +113,14 @@ protected:
     // true on success; on failure, logs an error and returns false.
     virtual bool Init();
 
+    // Set up the PIO decoder.  Returns true on success; if the PIO
+    // resources aren't available, logs a message and returns false, in
+    // which case the caller falls back on interrupt mode.
+    bool InitPIO();
+
+    // Read the latest count from the PIO decoder
+    void ReadPIOCount();
+
     // Interrupt handler for the GPIO interrupt for the A and B
     // channel signals.  (The Pico only has a single hardware-level
     // IRQ for the GPIOs, so there's no point in using separate A and
@@ -123,7 +163,11 @@ protected:
             1,     // 11 -> 10
             0,     // 11 -> 11  (No change)
         };
-        count += delta[(state << 2) | newState];
+        if (int d = delta[(state << 2) | newState]; d != 0)
+        {
+            count += d;
+            tCount = time_us_64();
+        }
         state = newState;
     }
 
@@ -132,6 +176,9 @@ protected:
     // For most encoders, this is a fixed feature of the device.
     int lpi;
 
+    // device name, for log messages
+    const char *name = "quadrature";
+
     // GPIO connections for the two input channels
     int gpA = -1;
     int gpB = -1;
@@ -146,4 +193,36 @@ protected:
 
     // last count change time
     uint64_t tCount = 0;
+
+    // Use the PIO decoder, per the configuration
+    bool usePIO = false;
+
+    // PIO decoder resources, if in PIO mode; pio is null in interrupt mode
+    PIO pio = nullptr;
+    int piosm = -1;
+    uint pioOffset = 0;
+
+    // PIO count at the last ZeroCounter() call.  The state machine's
+    // count register can only be set by stopping the state machine, so
+    // we zero the counter by subtracting out this offset instead.
+    int32_t pioZero = 0;
+
+    // Full PIO count, extended from the 16-bit count in the state
+    // machine's status word, and the raw 16-bit value at the last read
+    int32_t pioCount = 0;
+    uint16_t pioRawCount = 0;
+
+    // time of the last PIO read
+    uint64_t tPioRead = 0;
+
+    // System clock cycles per state machine loop pass without a
+    // transition, and the system clock speed in MHz, for converting the
+    // pass counter to elapsed time
+    static const uint32_t PIO_PASS_CYCLES = 9;
+    uint32_t pioClockMHz = 125;
+
+    // Number of PIO reads that timed out waiting for the state machine,
+    // leaving the count stale.  This should never happen, since the
+    // state machine pushes a new status word every few cycles.
+    uint32_t pioStaleReads = 0;
 };
@@ -50,6 +50,8 @@
 #include <pico/stdlib.h>
 #include <hardware/pio.h>
 #include <hardware/clocks.h>
+#include <hardware/dma.h>
+#include <hardware/timer.h>
 
 // project headers
 #include "Pinscape.h"
@@ -61,6 +63,7 @@
 #include "../USBProtocol/VendorIfcProtocol.h"
 #include "74HC165.h"
 #include "74HC165_pio.pio.h"
+#include "74HC165_edge_pio.pio.h"
 
 // global list of active chains
 std::vector<std::unique_ptr<C74HC165>> C74HC165::chains;
@@ -78,6 +81,7 @@ std::vector<std::unique_ptr<C74HC165>> C74HC165::chains;
 //   load: <gpio>,              // GPIO port number for Shift/Load (SH/LD) pin
 //   loadPolarity: <bool>,      // logic level of SH/LD pin for LOAD mode; use false for 74HC165 (default is false)
 //   shiftClockFreq: <number>,  // desired shift clock frequency, in Hz (default 6000000)
+//   edgeCapture: <bool>,       // use edge capture mode if the chain has 32 ports or fewer (default false)
 // }
 //
 // Hardware design note: CLK INH (clock inhibit) should be hard-wired to
@@ -99,6 +103,16 @@ std::vector<std::unique_ptr<C74HC165>> C74HC165::chains;
 // know for sure exists with some similar chips, we include the option
 // just in case it's enough for compatibility.
 //
+// Edge capture mode: for chains of up to four chips (32 ports), we use
+// a PIO program that scans the chain continuously and only reports
+// changes, timestamping each change via DMA from the system timer (see
+// 74HC165_edge_pio.pio).  That gives the button debouncer the actual
+// physical edge time, rather than the time the second core got around
+// to noticing the change.  Longer chains always use the basic snapshot
+// mode, where the second core initiates each read cycle.  Edge capture
+// is off by default; set edgeCapture to true to enable it on a short
+// chain.
+//
 void C74HC165::Configure(JSONParser &json)
 {
     // parse callback
@@ -112,6 +126,7 @@ void C74HC165::Configure(JSONParser &json)
         int qh = value->Get("data")->Int(-1);
         bool loadPolarity = value->Get("loadPolarity")->Bool(false);;
         int shiftClockFreq = value->Get("shiftClockFreq")->Int(6000000);
+        bool edgeCapture = value->Get("edgeCapture")->Bool(false);
         if (!IsValidGP(shld) || !IsValidGP(clk) || !IsValidGP(qh))
         {
             Log(LOG_ERROR, "74hc165[%d]: one or more invalid/undefined GPIO pins (shift, data, load)\n", index);
@@ -133,7 +148,7 @@ void C74HC165::Configure(JSONParser &json)
             return;
 
         // create the device
-        auto *chain = new C74HC165(index, nChips, shld, clk, qh, loadPolarity, shiftClockFreq);
+        auto *chain = new C74HC165(index, nChips, shld, clk, qh, loadPolarity, shiftClockFreq, edgeCapture);
         chains[index].reset(chain);
 
         // initialize
@@ -173,20 +188,27 @@ void C74HC165::Configure(JSONParser &json)
             "  --dma-off         disable DMA (to allow --bitbang and --dma-once transfer tests)\n"
             "  --dma-on          re-enable DMA\n"
             "  --dma-once        execute one PIO DMA cycle (--dma-off mode only)\n"
-            "  --bitbang         clock data in directly from GPIOs (--dma-off mode only)\n",
+            "  --bitbang         clock data in directly from GPIOs (--dma-off mode only)\n"
+            "\n"
+            "The DMA and bit-bang test options are only available in snapshot mode, not\n"
+            "in edge capture mode.\n",
             &Command_main_S);
     }
 }
 
-C74HC165::C74HC165(int chainNum, int nChips, int shld, int clk, int qh, bool loadPolarity, int shiftClockFreq) :
+C74HC165::C74HC165(int chainNum, int nChips, int shld, int clk, int qh, bool loadPolarity, int shiftClockFreq, bool edgeCapture) :
     chainNum(chainNum), nChips(nChips), nPorts(nChips*8),
-    gpSHLD(shld), gpClk(clk), gpQH(qh), loadPolarity(loadPolarity), shiftClockFreq(shiftClockFreq)
+    gpSHLD(shld), gpClk(clk), gpQH(qh), loadPolarity(loadPolarity), edgeCapture(edgeCapture), shiftClockFreq(shiftClockFreq)
 {
     // Allocate the chip data array.  Allocate at double size -
     // one block for the "real" DMA buffer, a second for the scratch
     // (debug transfer) buffer.
     data = new uint8_t[nChips*2];
     scratchData = &data[nChips];
+
+    // clear the edge times
+    for (auto &t : edgeTime)
+        t = 0;
 }
 
 C74HC165::~C74HC165()
@@ -211,6 +233,20 @@ bool C74HC165::Get(int port)
     return false;
 }
 
+// get the last edge time on a port
+uint64_t C74HC165::GetEdgeTime(int port, uint64_t now) const
+{
+    // we only have edge times in edge capture mode
+    if (!IsEdgeCaptureMode() || port < 0 || port >= nPorts)
+        return now;
+
+    // The edge time is the low 32 bits of the system timer, so figure
+    // the full time by backing up from 'now' by the elapsed time.  The
+    // caller asks right after detecting the change, so the elapsed time
+    // is always far less than the 32-bit wraparound period.
+    return now - static_cast<uint32_t>(static_cast<uint32_t>(now) - edgeTime[port]);
+}
+
 // Populate a Vendor Interface button query result buffer with
 // ButtonDevice structs representing the configured 74HC165 chips.  The
 // caller is responsible for providing enough buffer space; we require
@@ -283,6 +319,14 @@ void C74HC165::SecondCoreChainTask()
     // reset statistics if desired
     stats.CheckResetRequest();
 
+    // in edge capture mode, the PIO runs on its own, so we just have to
+    // process the changes it's captured
+    if (IsEdgeCaptureMode())
+    {
+        ProcessEdgeCaptures();
+        return;
+    }
+
     // if the DMA channel isn't busy, start a new transfer
     if (!dma_channel_is_busy(dmaChan) && dmaEnabled)
     {
@@ -303,6 +347,58 @@ void C74HC165::StartTransfer(volatile uint8_t *destBuf)
     dma_channel_transfer_to_buffer_now(dmaChan, destBuf, nChips);
 }
 
+void C74HC165::ProcessEdgeCaptures()
+{
+    // The timestamp DMA channel writes its entry after the change word
+    // channel, so its write pointer marks the end of the complete entries.
+    uintptr_t writeAddr = dma_channel_hw_addr(dmaTimeChan)->write_addr;
+    int writeIndex = static_cast<int>((writeAddr - reinterpret_cast<uintptr_t>(timeRing)) / sizeof(uint32_t)) & (EDGE_RING_SIZE - 1);
+
+    // Check for a ring overrun.  The DMA channels wrap around the rings
+    // without regard to our read position, so if we fall a full ring
+    // behind, the DMA laps us, and the write pointer alone can't show it,
+    // since it just looks like a smaller backlog.  But a lap always
+    // overwrites the last entry we processed, so check that its timestamp
+    // is still there.  If it isn't, the changes recorded in the entries
+    // the DMA overwrote are lost.  Count the overrun, and recover by
+    // processing the whole ring, starting at the write pointer, which is
+    // the oldest entry still in the ring.
+    int backlog;
+    if (timeRing[(edgeRingRead - 1) & (EDGE_RING_SIZE - 1)] != edgeRingLastTime)
+    {
+        stats.AddRingOverrun();
+        edgeRingRead = writeIndex;
+        backlog = EDGE_RING_SIZE;
+    }
+    else if ((backlog = (writeIndex - edgeRingRead) & (EDGE_RING_SIZE - 1)) == 0)
+        return;
+
+    // process the new entries
+    uint32_t now = timer_hw->timerawl;
+    for (int i = 0 ; i < backlog ; ++i, edgeRingRead = (edgeRingRead + 1) & (EDGE_RING_SIZE - 1))
+    {
+        uint32_t word = edgeRing[edgeRingRead];
+        uint32_t t = timeRing[edgeRingRead];
+
+        // Record the edge time for each port that changed.  The last chip
+        // in the chain is in the low byte of the word (see the PIO program).
+        for (uint32_t changed = word ^ edgeWord ; changed != 0 ; changed &= changed - 1)
+        {
+            int bit = __builtin_ctz(changed);
+            edgeTime[(nChips - 1 - (bit >> 3))*8 + (bit & 7)] = t;
+        }
+
+        // this is now the current state
+        edgeWord = word;
+        edgeRingLastTime = t;
+        stats.AddEdgeWord(now - t, backlog);
+    }
+
+    // update the client data bytes from the latest word
+    for (int i = 0 ; i < nChips ; ++i)
+        data[i] = static_cast<uint8_t>(edgeWord >> ((nChips - 1 - i)*8));
+}
+
 // initialization
 bool C74HC165::Init()
 {
@@ -310,17 +406,27 @@ bool C74HC165::Init()
     if ((dmaChan = dma_claim_unused_channel(false)) < 0)
         return Log(LOG_ERROR, "74H165[%d]: insufficient DMA channels\n", chainNum), false;
 
+    // Use edge capture mode if enabled and the chain fits in one PIO word.
+    // This requires a second DMA channel for the timestamps; if we can't
+    // set that up, fall back on snapshot mode.
+    if (edgeCapture && nPorts <= 32 && !InitEdgeCapture())
+        Log(LOG_WARNING, "74HC165[%d]: unable to set up edge capture mode; using snapshot mode\n", chainNum);
+
+    // select the PIO program for the mode
+    const pio_program_t *program = IsEdgeCaptureMode() ? &C74HC165_edge_program : &C74HC165_program;
+
     // Use a previously loaded copy of the PIO program, if a state
     // machine is available on the same PIO where it's loaded.
     for (auto &other : chains)
     {
         // check to see if this chain has loaded the program and has an SM available
-        if (other != nullptr && other->pio != nullptr
+        if (other != nullptr && other->pio != nullptr && other->pioProgram == program
             && (this->piosm = pio_claim_unused_sm(other->pio, false)) >= 0)
         {
             // got it - attach to the same PIO
             this->pio = other->pio;
             this->pioOffset = other->pioOffset;
+            this->pioProgram = program;
             
             // we can stop looking
             break;
@@ -332,10 +438,10 @@ bool C74HC165::Init()
     if (this->piosm < 0)
     {
         // try one PIO
-        auto TryClaimPIO = [this](PIO pio)
+        auto TryClaimPIO = [this, program](PIO pio)
         {
             // make sure we can add our program to the PIO
-            if (!pio_can_add_program(pio, &C74HC165_program))
+            if (!pio_can_add_program(pio, program))
                 return false;
 
             // try claiming a state machine on this PIO
@@ -344,7 +450,8 @@ bool C74HC165::Init()
                 return false;
             
             // success - add the program
-            this->pioOffset = pio_add_program(pio, &C74HC165_program);
+            this->pioOffset = pio_add_program(pio, program);
+            this->pioProgram = program;
             this->pio = pio;
             return true;
         };
@@ -413,15 +520,45 @@ bool C74HC165::Init()
     }
 
     // Configure the PIO state machine
-    pio_sm_set_enabled(pio, piosm, false);    
-    auto piocfg = C74HC165_program_get_default_config(pioOffset);
-    sm_config_set_in_pins(&piocfg, gpQH);               // IN pin: QH
-    sm_config_set_out_pins(&piocfg, gpSHLD, 1);         // OUT pin: SH/LD
-    sm_config_set_sideset_pins(&piocfg, gpClk);         // one sideset pin: CLK
-    sm_config_set_out_shift(&piocfg, true, true, 32);   // true=shift RIGHT (LSB first), true=auto-pull ON, 32=bit refill threshold
-    sm_config_set_in_shift(&piocfg, false, true, 8);    // true=shift LEFT (LSB first), true=auto-push ON, 8-bit flush threshold
-    sm_config_set_clkdiv(&piocfg, pioClockDiv);         // PIO clock divider (see above)
-    pio_sm_init(pio, piosm, pioOffset, &piocfg);        // initialize with the configuration and starting program offset
+    pio_sm_set_enabled(pio, piosm, false);
+    if (IsEdgeCaptureMode())
+    {
+        auto piocfg = C74HC165_edge_program_get_default_config(pioOffset);
+        sm_config_set_in_pins(&piocfg, gpQH);               // IN pin: QH
+        sm_config_set_set_pins(&piocfg, gpSHLD, 1);         // SET pin: SH/LD
+        sm_config_set_sideset_pins(&piocfg, gpClk);         // one sideset pin: CLK
+        sm_config_set_out_shift(&piocfg, true, false, 32);  // true=shift RIGHT, false=auto-pull OFF (the OSR holds the port count)
+        sm_config_set_in_shift(&piocfg, false, false, 32);  // false=shift LEFT, false=auto-push OFF (the program pushes changes explicitly)
+        sm_config_set_clkdiv(&piocfg, pioClockDiv);         // PIO clock divider (see above)
+        pio_sm_init(pio, piosm, pioOffset + C74HC165_edge_offset_start, &piocfg);
+
+        // Pre-load the OSR with the port count, and Y with the initial
+        // port state (all zeroes, matching our initial data bytes).  This
+        // must happen before we join the FIFOs, since the join disables
+        // the TX FIFO, which would silently drop the count and leave the
+        // PULL stalled forever.
+        pio_sm_put(pio, piosm, nPorts - 1);
+        pio_sm_exec(pio, piosm, pio_encode_pull(false, true));
+        pio_sm_exec(pio, piosm, pio_encode_set(pio_y, 0));
+
+        // The program never reads the TX FIFO after the initial count, so
+        // join the FIFOs to give RX the full 8-word depth.  This only
+        // updates the configuration registers, so the OSR and Y keep the
+        // values we just loaded.
+        sm_config_set_fifo_join(&piocfg, PIO_FIFO_JOIN_RX);
+        pio_sm_set_config(pio, piosm, &piocfg);
+    }
+    else
+    {
+        auto piocfg = C74HC165_program_get_default_config(pioOffset);
+        sm_config_set_in_pins(&piocfg, gpQH);               // IN pin: QH
+        sm_config_set_out_pins(&piocfg, gpSHLD, 1);         // OUT pin: SH/LD
+        sm_config_set_sideset_pins(&piocfg, gpClk);         // one sideset pin: CLK
+        sm_config_set_out_shift(&piocfg, true, true, 32);   // true=shift RIGHT (LSB first), true=auto-pull ON, 32=bit refill threshold
+        sm_config_set_in_shift(&piocfg, false, true, 8);    // true=shift LEFT (LSB first), true=auto-push ON, 8-bit flush threshold
+        sm_config_set_clkdiv(&piocfg, pioClockDiv);         // PIO clock divider (see above)
+        pio_sm_init(pio, piosm, pioOffset, &piocfg);        // initialize with the configuration and starting program offset
+    }
 
     // Assign the pins to the PIO
     pio_gpio_init(pio, gpClk);
@@ -433,33 +570,106 @@ bool C74HC165::Init()
     pio_sm_set_consecutive_pindirs(pio, piosm, gpClk, 1, true);
     pio_sm_set_consecutive_pindirs(pio, piosm, gpSHLD, 1, true);
 
-    // pre-load Y with the SH/LD bit for LOAD mode
-    pio_sm_exec(pio, piosm, pio_encode_set(pio_y, loadPolarity ? 1 : 0));
-
-    // Start the PIO running.  Note that the first thing it's going to
-    // do is PULL from the FIFO, which is currently empty, so it'll
-    // block on the first instruction.  It'll start executing for real
-    // when we send our first transmission from Task().
-    pio_sm_set_enabled(pio, piosm, true);
-
-    // configure the DMA channel for PIO IN port source, memory output with increment, 8-bit transfers
-    auto dmaConf = dma_channel_get_default_config(dmaChan);
-    channel_config_set_read_increment(&dmaConf, false);
-    channel_config_set_write_increment(&dmaConf, true);
-    channel_config_set_transfer_data_size(&dmaConf, DMA_SIZE_8);
-    channel_config_set_dreq(&dmaConf, pio_get_dreq(pio, piosm, false));
-    dma_channel_configure(dmaChan, &dmaConf, nullptr, &pio->rxf[piosm], nChips, false);
+    if (IsEdgeCaptureMode())
+    {
+        // The edge program always writes 0 to SH/LD for LOAD mode, so
+        // invert the pin at the GPIO output if LOAD is active-high
+        gpio_set_outover(gpSHLD, loadPolarity ? GPIO_OVERRIDE_INVERT : GPIO_OVERRIDE_NORMAL);
+
+        // start with all ports off, matching the initial Y value in the PIO
+        for (int i = 0 ; i < nChips ; ++i)
+            data[i] = 0;
+
+        // Set up the DMA pair.  The timestamp channel copies the low 32
+        // bits of the system timer into the time ring, unpaced, so it runs
+        // immediately when triggered; it chains back to the data channel
+        // to re-arm it for the next word.  Configure it first, without
+        // starting it, since the data channel triggers it.
+        auto timeConf = dma_channel_get_default_config(dmaTimeChan);
+        channel_config_set_read_increment(&timeConf, false);
+        channel_config_set_write_increment(&timeConf, true);
+        channel_config_set_transfer_data_size(&timeConf, DMA_SIZE_32);
+        channel_config_set_ring(&timeConf, true, EDGE_RING_BITS);
+        channel_config_set_chain_to(&timeConf, dmaChan);
+        dma_channel_configure(dmaTimeChan, &timeConf, timeRing, &timer_hw->timerawl, 1, false);
+
+        // The data channel copies each change word from the PIO RX FIFO
+        // into the edge ring, and chains to the timestamp channel.
+        auto dmaConf = dma_channel_get_default_config(dmaChan);
+        channel_config_set_read_increment(&dmaConf, false);
+        channel_config_set_write_increment(&dmaConf, true);
+        channel_config_set_transfer_data_size(&dmaConf, DMA_SIZE_32);
+        channel_config_set_ring(&dmaConf, true, EDGE_RING_BITS);
+        channel_config_set_dreq(&dmaConf, pio_get_dreq(pio, piosm, false));
+        channel_config_set_chain_to(&dmaConf, dmaTimeChan);
+        dma_channel_configure(dmaChan, &dmaConf, edgeRing, &pio->rxf[piosm], 1, true);
+
+        // start the PIO scanning
+        pio_sm_set_enabled(pio, piosm, true);
+    }
+    else
+    {
+        // pre-load Y with the SH/LD bit for LOAD mode
+        pio_sm_exec(pio, piosm, pio_encode_set(pio_y, loadPolarity ? 1 : 0));
+
+        // Start the PIO running.  Note that the first thing it's going to
+        // do is PULL from the FIFO, which is currently empty, so it'll
+        // block on the first instruction.  It'll start executing for real
+        // when we send our first transmission from Task().
+        pio_sm_set_enabled(pio, piosm, true);
+
+        // configure the DMA channel for PIO IN port source, memory output with increment, 8-bit transfers
+        auto dmaConf = dma_channel_get_default_config(dmaChan);
+        channel_config_set_read_increment(&dmaConf, false);
+        channel_config_set_write_increment(&dmaConf, true);
+        channel_config_set_transfer_data_size(&dmaConf, DMA_SIZE_8);
+        channel_config_set_dreq(&dmaConf, pio_get_dreq(pio, piosm, false));
+        dma_channel_configure(dmaChan, &dmaConf, nullptr, &pio->rxf[piosm], nChips, false);
+    }
 
     // flag a statistics reset, to set the start time of the first transfer
     stats.RequestReset();
 
     // success
-    Log(LOG_CONFIG, "74HC165[%d] initialized, CLK=GP%d, QH=GP%d, SH/LD=GP%d (LD is active %s); DMA ch %d; PIO %d.%d@%u, clock divider=%.3lf\n",
-        chainNum, gpClk, gpQH, gpSHLD, loadPolarity ? "high" : "low", dmaChan,
+    Log(LOG_CONFIG, "74HC165[%d] initialized, CLK=GP%d, QH=GP%d, SH/LD=GP%d (LD is active %s); %s mode; DMA ch %d; PIO %d.%d@%u, clock divider=%.3lf\n",
+        chainNum, gpClk, gpQH, gpSHLD, loadPolarity ? "high" : "low",
+        IsEdgeCaptureMode() ? "edge capture" : "snapshot", dmaChan,
         pio_get_index(pio), piosm, pioOffset, pioClockDiv);
     return true;
 }
 
+// set up edge capture mode resources
+bool C74HC165::InitEdgeCapture()
+{
+    // claim the timestamp DMA channel
+    if ((dmaTimeChan = dma_claim_unused_channel(false)) < 0)
+        return false;
+
+    // Allocate the change word and timestamp rings.  The DMA ring wrap
+    // requires each ring to be aligned on its own size, so allocate both
+    // rings as one block aligned at double the ring size; the time ring
+    // is the upper half.
+    const size_t ringBytes = 1 << EDGE_RING_BITS;
+    auto *rings = static_cast<volatile uint32_t*>(aligned_alloc(ringBytes*2, ringBytes*2));
+    if (rings == nullptr)
+    {
+        dma_channel_unclaim(dmaTimeChan);
+        dmaTimeChan = -1;
+        return false;
+    }
+
+    // Clear the rings.  This makes the slot before the initial read
+    // position match the initial last-processed timestamp of zero, for
+    // the overrun check in ProcessEdgeCaptures().
+    for (size_t i = 0 ; i < EDGE_RING_SIZE*2 ; ++i)
+        rings[i] = 0;
+
+    // success
+    edgeRing = rings;
+    timeRing = rings + EDGE_RING_SIZE;
+    return true;
+}
+
 // Console command handler - main static entrypoint
 void C74HC165::Command_main_S(const ConsoleCommandContext *c)
 {
@@ -544,14 +754,36 @@ void C74HC165::Command_main(const ConsoleCommandContext *c, int specifiedChipNum
         const char *a = c->argv[argi];
         if (strcmp(a, "-s") == 0 || strcmp(a, "--stats") == 0)
         {
-            c->Printf(
-                "74hc165 - chain #%d\n"
-                "  DMA cycles:         %llu\n"
-                "  Average DMA cycle:  %.2f us\n"
-                "  Last data bytes:    ",
-                chainNum,
-                stats.nDMACycles,
-                stats.nDMACycles != 0 ? static_cast<float>((time_us_64() - stats.t0)*1000ULL / stats.nDMACycles)/1000.0f : 0.0f);
+            if (IsEdgeCaptureMode())
+            {
+                c->Printf(
+                    "74hc165 - chain #%d\n"
+                    "  Mode:               edge capture\n"
+                    "  Change words:       %llu\n"
+                    "  Average latency:    %.2f us\n"
+                    "  Max latency:        %lu us\n"
+                    "  Max ring backlog:   %d\n"
+                    "  Ring overruns:      %lu\n"
+                    "  Last data bytes:    ",
+                    chainNum,
+                    stats.nEdgeWords,
+                    stats.nEdgeWords != 0 ? static_cast<float>(stats.latencySum*1000ULL / stats.nEdgeWords)/1000.0f : 0.0f,
+                    static_cast<unsigned long>(stats.latencyMax),
+                    stats.maxBacklog,
+                    static_cast<unsigned long>(stats.nRingOverruns));
+            }
+            else
+            {
+                c->Printf(
+                    "74hc165 - chain #%d\n"
+                    "  Mode:               snapshot\n"
+                    "  DMA cycles:         %llu\n"
+                    "  Average DMA cycle:  %.2f us\n"
+                    "  Last data bytes:    ",
+                    chainNum,
+                    stats.nDMACycles,
+                    stats.nDMACycles != 0 ? static_cast<float>((time_us_64() - stats.t0)*1000ULL / stats.nDMACycles)/1000.0f : 0.0f);
+            }
             for (int i = 0 ; i < nChips ; ++i)
                 c->Printf("%02X%c", data[i], i + 1 < nChips ? ' ' : '\n');
         }
@@ -575,6 +807,13 @@ void C74HC165::Command_main(const ConsoleCommandContext *c, int specifiedChipNum
                     c->Printf("  %c: %s\n", j + 'A', Get(i*8 + j) ? "HIGH" : "LOW");
             }
         }
+        else if ((strcmp(a, "--dma-off") == 0 || strcmp(a, "--dma-on") == 0
+                  || strcmp(a, "--dma-once") == 0 || strcmp(a, "--bitbang") == 0)
+                 && IsEdgeCaptureMode())
+        {
+            // the PIO runs continuously in edge capture mode, so the DMA tests don't apply
+            c->Printf("%s is not available in edge capture mode\n", a);
+        }
         else if (strcmp(a, "--dma-off") == 0)
         {
             // disable second-core DMA initiation
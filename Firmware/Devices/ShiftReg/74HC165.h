@@ -62,7 +62,7 @@ public:
     static int CountConfigurations() { return static_cast<int>(chains.size()); }
 
     // construction/destruction
-    C74HC165(int chainNum, int nChips, int gpSHLD, int gpClk, int gpQH, bool loadPolarity, int shiftClockFreq);
+    C74HC165(int chainNum, int nChips, int gpSHLD, int gpClk, int gpQH, bool loadPolarity, int shiftClockFreq, bool edgeCapture);
     ~C74HC165();
 
     // get my config index
@@ -72,6 +72,17 @@ public:
     // level read during a polling cycle.
     bool Get(int port);
 
+    // Get the time of the last change on a port, as a system clock time
+    // (microseconds since reset).  In edge capture mode, this is the
+    // capture time of the scan that detected the change.  In snapshot
+    // mode, we don't track edge times, so this simply returns 'now', the
+    // caller's current time, since the caller is the one detecting the
+    // edge in that case.  (Call from the second core only.)
+    uint64_t GetEdgeTime(int port, uint64_t now) const;
+
+    // is edge capture mode active?
+    bool IsEdgeCaptureMode() const { return edgeRing != nullptr; }
+
     // is the given port number valid?
     bool IsValidPort(int port) const { return port >= 0 && port < nPorts; }
 
@@ -102,6 +113,14 @@ protected:
     // start a DMA transfer from the PIO to the data buffer
     void StartTransfer(volatile uint8_t *destBuf);
 
+    // Set up edge capture mode.  Returns true on success.  On failure,
+    // returns false, in which case the caller falls back on snapshot
+    // mode.
+    bool InitEdgeCapture();
+
+    // Process new entries in the edge capture ring (second core)
+    void ProcessEdgeCaptures();
+
     // my chain number in the configuration
     int chainNum;
 
@@ -123,6 +142,31 @@ protected:
     // DMA enabled (can be disabled for debugging)
     volatile bool dmaEnabled = true;
 
+    // Edge capture mode.  For chains of up to 32 ports, we can use a PIO
+    // program that scans the chain continuously and only sends back words
+    // that changed since the last scan (see 74HC165_edge_pio.pio).  The
+    // changes go into a DMA ring, and a second DMA channel, chained to the
+    // first, copies the system timer's low 32 bits into a parallel ring
+    // immediately after each change word, to timestamp the change.  The
+    // rings are null in snapshot mode.
+    bool edgeCapture;
+    static const int EDGE_RING_BITS = 8;
+    static const int EDGE_RING_SIZE = (1 << EDGE_RING_BITS) / sizeof(uint32_t);
+    volatile uint32_t *edgeRing = nullptr;
+    volatile uint32_t *timeRing = nullptr;
+    int edgeRingRead = 0;
+    int dmaTimeChan = -1;
+
+    // timestamp of the last ring entry processed, for overrun detection
+    uint32_t edgeRingLastTime = 0;
+
+    // last port state word processed from the edge ring
+    uint32_t edgeWord = 0;
+
+    // Last edge time per port, as the low 32 bits of the system timer.
+    // Updated on the second core as we process the ring.
+    uint32_t edgeTime[32];
+
     // Desired shift clock (CLK) frequency
     int shiftClockFreq = 6000000;
 
@@ -149,8 +193,9 @@ protected:
     PIO pio = nullptr;
     int piosm = -1;
 
-    // PIO program load offset
+    // PIO program load offset, and the program loaded there
     uint pioOffset = 0;
+    const pio_program_t *pioProgram = nullptr;
 
     // Current pin state data, one byte per chip in daisy-chain order,
     // with the bits encoded in serial order.  The DMA transfer writes
@@ -171,9 +216,32 @@ protected:
                 resetRequested = false;
                 t0 = time_us_64();
                 nDMACycles = 0;
+                nEdgeWords = 0;
+                latencySum = 0;
+                latencyMax = 0;
+                maxBacklog = 0;
+                nRingOverruns = 0;
             }
         }
 
+        // count an edge capture word, with the delay between its capture
+        // and our processing, and the ring backlog at the time
+        void AddEdgeWord(uint32_t latency, int backlog)
+        {
+            nEdgeWords += 1;
+            latencySum += latency;
+            if (latency > latencyMax)
+                latencyMax = latency;
+            if (backlog > maxBacklog)
+                maxBacklog = backlog;
+        }
+
+        // count an edge ring overrun
+        void AddRingOverrun()
+        {
+            nRingOverruns += 1;
+        }
+
         // count a DMA cycle
         void AddDMACycle()
         {
@@ -186,6 +254,18 @@ protected:
         // number of DMA cycles
         uint64_t nDMACycles = 0;
 
+        // Edge capture mode statistics: number of change words captured;
+        // capture-to-processing latency, in microseconds; and the maximum
+        // number of entries waiting in the ring when we checked it
+        uint64_t nEdgeWords = 0;
+        uint64_t latencySum = 0;
+        uint32_t latencyMax = 0;
+        int maxBacklog = 0;
+
+        // number of times the DMA lapped our read position in the edge
+        // ring, losing the changes in the overwritten entries
+        uint32_t nRingOverruns = 0;
+
         // Reset requested.  The main core thread sets this when it
         // wants to reset the statistics; the second core thread applies
         // it during polling..
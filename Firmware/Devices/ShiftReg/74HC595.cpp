@@ -33,6 +33,7 @@
 #include "../USBProtocol/VendorIfcProtocol.h"
 #include "CommandConsole.h"
 #include "74HC595.h"
+#include "74HC595_BitPlanes.h"
 #include "74HC595_pwm_pio.pio.h"
 #include "74HC595_dig_pio.pio.h"
 
@@ -145,10 +146,18 @@ void C74HC595::Configure(JSONParser &json)
         // get the PWM mode
         bool pwm = value->Get("pwm")->Bool(false);
 
+        // get the BCM resolution for PWM mode
+        int bcmBits = value->Get("bcmBits")->Int(8);
+        if (bcmBits != 8 && bcmBits != 10 && bcmBits != 12)
+        {
+            Log(LOG_ERROR, "74hc595[%d]: invalid 'bcmBits' value %d; must be 8, 10, or 12; using 8\n", index, bcmBits);
+            bcmBits = 8;
+        }
+
         // create the device
         C74HC595 *chain;
         if (pwm)
-            chain = new PWM74HC595(index, nChips, shift, data, latch, enablePort.release(), shiftClockFreq);
+            chain = new PWM74HC595(index, nChips, shift, data, latch, enablePort.release(), shiftClockFreq, bcmBits);
         else
             chain = new Digital74HC595(index, nChips, shift, data, latch, enablePort.release(), shiftClockFreq);
 
@@ -774,8 +783,8 @@ void Digital74HC595::Command_main(const ConsoleCommandContext *c, int specifiedC
 //
 
 PWM74HC595::PWM74HC595(
-    int chainNum, int nChips, int gpShift, int gpData, int gpLatch, OutputManager::Device *enablePort, int shiftClockFreq) :
-    C74HC595(chainNum, nChips, gpShift, gpData, gpLatch, enablePort, shiftClockFreq)
+    int chainNum, int nChips, int gpShift, int gpData, int gpLatch, OutputManager::Device *enablePort, int shiftClockFreq, int bcmBits) :
+    C74HC595(chainNum, nChips, gpShift, gpData, gpLatch, enablePort, shiftClockFreq), bcmBits(bcmBits)
 {
     // Figure the number of ports to send to the PIO program on each
     // cycle.  This is the number of actual ports, rounded up to the
@@ -789,29 +798,51 @@ PWM74HC595::PWM74HC595(
     level = new uint8_t[nPioPorts];
     memset(level, 0, nPioPorts * sizeof(level[0]));
 
-    // Allocate the TX buffers: 8 x (port bits + footer)
-    //
-    //   port bits = 1 word per 2 PIO chips
-    //   footer (delayCount) = 1 word
-    //
-    txBufCount = 8*(nPioChips/2 + 1);
+    // allocate the low-order level bits array for wide modes
+    if (bcmBits > 8)
+    {
+        levelLow = new uint8_t[nPioPorts];
+        memset(levelLow, 0, nPioPorts * sizeof(levelLow[0]));
+    }
+
+    // Lay out the TX buffer segments.  Each segment consists of the port
+    // bits (1 word per 2 PIO chips) plus a footer word with the delay
+    // count.  Each plane normally takes one segment; split planes whose
+    // delay count won't fit in the 16-bit footer.
+    const int nPortWords = nPioChips/2;
+    int ofs = 0;
+    for (int plane = 0 ; plane < bcmBits ; ++plane)
+    {
+        int pulseLength = 1 << plane;
+        int nSegs = 1;
+        while ((pulseLength/nSegs - 1)*nPioPorts - 1 > 0xFFFF)
+            nSegs *= 2;
+
+        for (int i = 0 ; i < nSegs ; ++i, ofs += nPortWords + 1)
+            segments.push_back({ plane, ofs });
+    }
+
+    // allocate the TX buffers
+    txBufCount = ofs;
     txBuf[0].buf = new uint16_t[txBufCount];
     txBuf[1].buf = new uint16_t[txBufCount];
 
-    // Pre-populate the TX buffers with the fixed parts.  The header and
-    // footer elements of the buffer never change, so we can fill these
-    // in once in advance, to reduce the work we have to do every time
-    // through PrepareTX().  See the PIO program for the buffer layout.
+    // Pre-populate the TX buffers with the fixed parts.  The footer
+    // elements of the buffer never change, so we can fill these in once
+    // in advance, to reduce the work we have to do every time through
+    // PrepareTX().  See the PIO program for the buffer layout.
     for (int i = 0 ; i < 2 ; ++i)
     {
-        uint16_t *dst = txBuf[i].buf;
-        for (int plane = 0, pulseLength = 1 ; plane < 8 ; ++plane, pulseLength *= 2)
+        for (size_t j = 0 ; j < segments.size() ; ++j)
         {
-            // this is where the bit plane data for this plane goes
-            dst += nPioChips/2;
-            
-            // Footer: delay count for this plane
-            *dst++ =  pulseLength == 1 ? 0 : static_cast<uint16_t>((pulseLength - 1)*nPioPorts - 1);
+            // figure this segment's pulse length: the plane's full pulse
+            // length, divided among the plane's segments
+            const auto &seg = segments[j];
+            int nSegs = static_cast<int>(std::count_if(segments.begin(), segments.end(), [&seg](const Segment &s) { return s.plane == seg.plane; }));
+            int pulseLength = (1 << seg.plane) / nSegs;
+
+            // Footer: delay count for this segment
+            txBuf[i].buf[seg.offset + nPortWords] = pulseLength == 1 ? 0 : static_cast<uint16_t>((pulseLength - 1)*nPioPorts - 1);
         }
     }
 }
@@ -819,6 +850,7 @@ PWM74HC595::PWM74HC595(
 PWM74HC595::~PWM74HC595()
 {
     delete[] level;
+    delete[] levelLow;
     delete[] txBuf[0].buf;
     delete[] txBuf[1].buf;
 }
@@ -826,19 +858,53 @@ PWM74HC595::~PWM74HC595()
 // update a port
 void PWM74HC595::Set(int port, uint8_t val)
 {
-    if (port >= 0 && port < nPorts && level[port] != val)
+    if (port >= 0 && port < nPorts)
+    {
+        // In wide mode, fill the low-order bits from the high-order bits
+        // of the new value, which rescales the 8-bit level linearly to the
+        // full wide range (the same shift-and-fill approach as
+        // OutputManager::Device::Rescale12()).
+        uint8_t lo = levelLow != nullptr ? static_cast<uint8_t>(val >> (16 - bcmBits)) : 0;
+        if (level[port] != val || (levelLow != nullptr && levelLow[port] != lo))
+        {
+            // set the internal level memory, mark the port list dirty
+            level[port] = val;
+            if (levelLow != nullptr)
+                levelLow[port] = lo;
+            dirty = true;
+        }
+    }
+}
+
+// update a port with a 12-bit level
+void PWM74HC595::Set12(int port, uint16_t val)
+{
+    // in 8-bit mode, just use the high 8 bits
+    if (levelLow == nullptr)
+        return Set(port, static_cast<uint8_t>(val >> 4));
+
+    if (port >= 0 && port < nPorts)
     {
-        // set the internal level memory, mark the port list dirty
-        level[port] = val;
-        dirty = true;
+        // reduce the level to our BCM resolution, and split it into the
+        // high 8 bits and the remaining low-order bits
+        uint16_t wide = val >> (12 - bcmBits);
+        uint8_t hi = static_cast<uint8_t>(wide >> (bcmBits - 8));
+        uint8_t lo = static_cast<uint8_t>(wide & ((1 << (bcmBits - 8)) - 1));
+        if (level[port] != hi || levelLow[port] != lo)
+        {
+            level[port] = hi;
+            levelLow[port] = lo;
+            dirty = true;
+        }
     }
 }
 
 // Get the DOF level for a port
 uint8_t PWM74HC595::GetDOFLevel(int port) const
 {
-    // we use the same 8-bit scale as DOF internally, so simply return
-    // the internal level value
+    // the level[] array always holds the high 8 bits of the level, which
+    // is the same 8-bit scale DOF uses, so simply return the internal
+    // level value
     return (port >= 0 && port < nPorts) ? level[port] : 0;
 }
 
@@ -1039,8 +1105,8 @@ bool PWM74HC595::Init()
     stats.t0DMA = time_us_64();
 
     // success
-    Log(LOG_CONFIG, "74HC595[%d] initialized; PWM mode; data=GP%d, shift=GP%d, latch=GP%d; PIO %d.%d@%u, clock divider=%.3lf; DMA channel %d\n",
-        chainNum, gpData, gpShift, gpLatch, pio_get_index(pio), piosm, pioOffset, pioClockDiv, dmaChan);
+    Log(LOG_CONFIG, "74HC595[%d] initialized; PWM mode, %d-bit BCM; data=GP%d, shift=GP%d, latch=GP%d; PIO %d.%d@%u, clock divider=%.3lf; DMA channel %d\n",
+        chainNum, bcmBits, gpData, gpShift, gpLatch, pio_get_index(pio), piosm, pioOffset, pioClockDiv, dmaChan);
     return true;
 }
 
@@ -1070,54 +1136,33 @@ void __not_in_flash_func(PWM74HC595::PrepareTX)(TXBuf *tx)
     // note the starting time
     uint64_t t0 = time_us_64();
 
-    // Loop over the 8 bit planes of the BCM encoding
-    uint16_t *p = tx->buf;
-    for (int plane = 0, pwmBit = 0x01 ; plane < 8 ; ++plane, pwmBit <<= 1)
+    // Number of low-order planes from the levelLow[] array.  The level[]
+    // array supplies the 8 planes above these.
+    const int nLowPlanes = bcmBits - 8;
+
+    // Build the data words for each group of 16 ports.  The first bit out
+    // goes to the end of the daisy chain, and the PIO clocks out bits
+    // starting at the LSB of the first word we send, so the first word
+    // of each plane covers the last 16 ports, with the last port in the
+    // LSB.  nPioPorts is guaranteed to be a multiple of 16 (per the
+    // constructor).
+    uint16_t *buf = tx->buf;
+    const int nPortWords = nPioChips/2;
+    for (int word = 0 ; word < nPortWords ; ++word)
     {
-        // Write the data bits.  The first bit out goes to the end of
-        // the daisy chain, and the PIO clocks out bits starting at the
-        // LSB of the first word we send, so first LSB = last chip QH.
-        // Each subsequent bit works goes to the next previous port in
-        // the daisy chain.
-        const uint8_t *plevel = &level[nPioPorts];
-        for (int port = nPioPorts ; ; )
-        {
-            // Write 16 bits.  This could obviously be expressed more
-            // compactly as a loop, but it's about 50% faster to unroll
-            // it like this, probably because it eliminates a looping
-            // variable for the BCM plane bit (the bit accumulated into
-            // 'acc' on each step). The reason we can do this is that
-            // nPioPorts is guaranteed to be a multiple of 16 (per the
-            // constructor).
-            int acc = 0;
-            plevel -= 16;
-            if ((plevel[15] & pwmBit) != 0) acc |= 0x0001;
-            if ((plevel[14] & pwmBit) != 0) acc |= 0x0002;
-            if ((plevel[13] & pwmBit) != 0) acc |= 0x0004;
-            if ((plevel[12] & pwmBit) != 0) acc |= 0x0008;
-            if ((plevel[11] & pwmBit) != 0) acc |= 0x0010;
-            if ((plevel[10] & pwmBit) != 0) acc |= 0x0020;
-            if ((plevel[9]  & pwmBit) != 0) acc |= 0x0040;
-            if ((plevel[8]  & pwmBit) != 0) acc |= 0x0080;
-            if ((plevel[7]  & pwmBit) != 0) acc |= 0x0100;
-            if ((plevel[6]  & pwmBit) != 0) acc |= 0x0200;
-            if ((plevel[5]  & pwmBit) != 0) acc |= 0x0400;
-            if ((plevel[4]  & pwmBit) != 0) acc |= 0x0800;
-            if ((plevel[3]  & pwmBit) != 0) acc |= 0x1000;
-            if ((plevel[2]  & pwmBit) != 0) acc |= 0x2000;
-            if ((plevel[1]  & pwmBit) != 0) acc |= 0x4000;
-            if ((plevel[0]  & pwmBit) != 0) acc |= 0x8000;
-            *p++ = static_cast<uint16_t>(acc);
-
-            // advance by 16 ports
-            port -= 16;
-            if (port <= 0)
-                break;
-        }
-
-        // Skip the footer word.  This is prepopulated at initialization
-        // and never changes, so we don't have to update it on each prepare.
-        p += 1;
+        // Build the 16-bit plane words for the group (see BCMBitPlanes).
+        // In wide mode, the low-order planes come from levelLow[]; only
+        // the first nLowPlanes of its planes are populated, and the high
+        // planes that follow overwrite the rest.
+        uint16_t planeWords[16];
+        int portIndex = nPioPorts - 16*(word + 1);
+        if (levelLow != nullptr)
+            BCMBitPlanes::Build16(&levelLow[portIndex], &planeWords[0]);
+        BCMBitPlanes::Build16(&level[portIndex], &planeWords[nLowPlanes]);
+
+        // store the words into each segment
+        for (auto &seg : segments)
+            buf[seg.offset + word] = planeWords[seg.plane];
     }
 
     // collect statistics
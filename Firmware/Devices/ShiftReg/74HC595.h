@@ -40,6 +40,12 @@
 // translate to mechanical vibrations that manifest as acoustic noise,
 // which is readily audible to humans in this frequency range.
 //
+// The PWM mode can optionally run at 10- or 12-bit BCM resolution, by
+// adding low-order bit planes.  This gives smoother low-end gamma fades
+// (the output manager applies gamma at 12 bits for these chains, as it
+// does for TLC5940 chips), at the cost of a 4X or 16X longer refresh
+// cycle, which limits the higher resolutions to short chains.
+//
 // We do our best to minimize the resource impact of the PWM mode, but
 // it inherently loads the Pico more than the digital mode does.  PWM
 // mode needs a bit more memory and a bit more CPU time.  Both modes
@@ -130,6 +136,15 @@ public:
     // Set an output level, port 0..nPorts-1 (port 0 = QA on first chip on chain).
     virtual void Set(int port, uint8_t level) = 0;
 
+    // Does this chain use more than 8 bits of duty cycle resolution?  If
+    // so, the output manager sets levels through Set12() instead of Set(),
+    // so that gamma correction is applied at the higher resolution.
+    virtual bool IsWide() const { return false; }
+
+    // Set an output level on the 12-bit scale, 0..4095.  By default, this
+    // just reduces the level to 8 bits.
+    virtual void Set12(int port, uint16_t level) { Set(port, static_cast<uint8_t>(level >> 4)); }
+
     // Get an output level in DOF units, 0-255
     virtual uint8_t GetDOFLevel(int port) const = 0;
 
@@ -289,7 +304,7 @@ public:
     // construction/destruction
     PWM74HC595(
         int chainNum, int nChips, int gpShift, int gpData, int gpLatch,
-        OutputManager::Device *enablePort, int shiftClockFreq);
+        OutputManager::Device *enablePort, int shiftClockFreq, int bcmBits);
 
     ~PWM74HC595();
 
@@ -299,6 +314,10 @@ public:
     // Set an output level, port 0..nPorts-1 (port 0 = QA on first chip on chain).
     virtual void Set(int port, uint8_t level) override;
 
+    // wide (10- or 12-bit BCM) mode
+    virtual bool IsWide() const override { return bcmBits > 8; }
+    virtual void Set12(int port, uint16_t level) override;
+
     // Get an output level.  Reports true for ON, false for OFF.
     virtual uint8_t GetDOFLevel(int port) const override;
     virtual uint8_t GetNativeLevel(int port) const override { return GetDOFLevel(port); }
@@ -326,6 +345,30 @@ protected:
     int nPioChips;
     int nPioPorts;
 
+    // BCM resolution, in bits: 8 (the default), 10, or 12.  Each extra bit
+    // adds a bit plane, and doubles the BCM refresh cycle time.
+    int bcmBits = 8;
+
+    // Low-order level bits, for 10- and 12-bit BCM modes.  In these modes,
+    // the level[] array holds the high 8 bits of each port's level, which
+    // keeps it on the DOF scale, and levelLow[] holds the remaining low
+    // (bcmBits - 8) bits, right-aligned.  Null in 8-bit mode.
+    uint8_t *levelLow = nullptr;
+
+    // TX buffer segments.  Each BCM bit plane is sent as one or more
+    // segments, each consisting of the port bits for the plane plus a
+    // delay count footer.  The PIO program reads the delay count as a
+    // 16-bit value, so a plane whose pulse time won't fit is split into
+    // several shorter segments with identical port bits.  This only
+    // happens for the highest planes in 10- and 12-bit modes on longer
+    // chains.
+    struct Segment
+    {
+        int plane;          // BCM bit plane
+        int offset;         // offset of the segment's port bits in the TX buffer
+    };
+    std::vector<Segment> segments;
+
     // PIO transmit buffers.  We use double-buffering: at any given time, one
     // buffer is in flight through DMA, and the other is staged awaiting the
     // next transmission.  On each DMA-completion interrupt, we kick off the
@@ -0,0 +1,89 @@
+// Pinscape Pico - 74HC595 BCM bit plane construction
+// Copyright 2024, 2025 Michael J Roberts / BSD-3-Clause license / NO WARRANTY
+//
+// Converts the per-port levels for a group of 16 ports into the 16-bit
+// bit plane words that the 74HC595 PWM PIO program shifts out to the
+// chain.  This is separate from the driver so that the host tests can
+// check it against a straightforward per-bit reference.
+//
+// The functions are force-inlined, so that they run from RAM along with
+// the driver's PrepareTX() routine that calls them.
+
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <pico/platform.h>
+
+struct BCMBitPlanes
+{
+    // Transpose an 8x8 bit matrix.  Takes the levels for 8 consecutive
+    // ports, and returns the 8 bit planes, packed one plane per byte,
+    // with planes 0-3 in planes03 and planes 4-7 in planes47, lowest
+    // plane in the low byte.  Within each plane byte, the first port is
+    // in the high bit, which matches the order in which the PIO program
+    // shifts the bits out to the chain.
+    //
+    // This is the branch-free shift-and-mask transpose from Hacker's
+    // Delight (section 7-3), using two 32-bit registers, since the M0+
+    // doesn't have 64-bit registers.  Each step swaps the off-diagonal
+    // blocks of the next smaller block size (1x1 bits, then 2x2, then
+    // 4x4) in parallel across the whole matrix.
+    static __force_inline void Transpose8x8(const uint8_t *levels, uint32_t &planes03, uint32_t &planes47)
+    {
+        // Load the matrix rows, with the first port in the high byte of
+        // x.  memcpy() keeps the loads within the aliasing rules and
+        // allows any alignment; the compiler reduces it to plain word
+        // loads when the pointer is aligned.
+        uint32_t x, y;
+        memcpy(&x, levels, 4);
+        memcpy(&y, levels + 4, 4);
+        x = __builtin_bswap32(x);
+        y = __builtin_bswap32(y);
+
+        // transpose the 1x1 blocks within each 2x2 block
+        uint32_t t = (x ^ (x >> 7)) & 0x00AA00AA;  x ^= t ^ (t << 7);
+        t = (y ^ (y >> 7)) & 0x00AA00AA;  y ^= t ^ (t << 7);
+
+        // transpose the 2x2 blocks within each 4x4 block
+        t = (x ^ (x >> 14)) & 0x0000CCCC;  x ^= t ^ (t << 14);
+        t = (y ^ (y >> 14)) & 0x0000CCCC;  y ^= t ^ (t << 14);
+
+        // transpose the 4x4 blocks
+        t = (x & 0xF0F0F0F0) | ((y >> 4) & 0x0F0F0F0F);
+        y = ((x << 4) & 0xF0F0F0F0) | (y & 0x0F0F0F0F);
+        x = t;
+
+        // Row N of the result is now the bit plane for bit (7-N), so the
+        // low-order planes are in y, with plane 0 in the low byte.
+        planes03 = y;
+        planes47 = x;
+    }
+
+    // Build the 8 plane words for 16 consecutive ports.  planeWords[N]
+    // receives bit plane N, with the first port in the high bit and the
+    // last port in the low bit.  Transposes the two 8-port halves of the
+    // group, and interleaves them into 16-bit plane words: the first 8
+    // ports go in the high byte, the second 8 ports in the low byte.
+    // Each interleave step produces two planes at once, one per 16-bit
+    // half.
+    static __force_inline void Build16(const uint8_t *levels, uint16_t *planeWords)
+    {
+        uint32_t a03, a47, b03, b47;
+        Transpose8x8(levels, a03, a47);
+        Transpose8x8(levels + 8, b03, b47);
+
+        uint32_t even = ((a03 & 0x00FF00FF) << 8) | (b03 & 0x00FF00FF);
+        uint32_t odd = (a03 & 0xFF00FF00) | ((b03 >> 8) & 0x00FF00FF);
+        planeWords[0] = static_cast<uint16_t>(even);
+        planeWords[1] = static_cast<uint16_t>(odd);
+        planeWords[2] = static_cast<uint16_t>(even >> 16);
+        planeWords[3] = static_cast<uint16_t>(odd >> 16);
+
+        even = ((a47 & 0x00FF00FF) << 8) | (b47 & 0x00FF00FF);
+        odd = (a47 & 0xFF00FF00) | ((b47 >> 8) & 0x00FF00FF);
+        planeWords[4] = static_cast<uint16_t>(even);
+        planeWords[5] = static_cast<uint16_t>(odd);
+        planeWords[6] = static_cast<uint16_t>(even >> 16);
+        planeWords[7] = static_cast<uint16_t>(odd >> 16);
+    }
+};
@@ -16,7 +16,7 @@
 
 #include "Pinscape.h"
 #include "Utils.h"
-#include "crc32.h"
+#include "CRC32Engine.h"
 #include "Logger.h"
 #include "CommandConsole.h"
 #include "Watchdog.h"
@@ -39,6 +39,25 @@ FlashStorage flashStorage;
 // to estimate how long the operation will take once started.
 //
 
+// Flash operation statistics.  Each flash-safe operation locks the second
+// core out of flash (and out of execution, since it has to spin in RAM)
+// for the duration of the operation.  We count the operations and track
+// the longest one, so that background jobs can report their worst-case
+// effect on the second core.  The job runner resets these before each
+// job step.
+static struct
+{
+    uint32_t nOps = 0;
+    uint32_t maxTime = 0;
+
+    void AddSample(uint64_t dt)
+    {
+        nOps += 1;
+        if (dt > maxTime)
+            maxTime = static_cast<uint32_t>(dt);
+    }
+} flashOpStats;
+
 // write to flash with dual-core lockout
 static bool FlashSafeWrite(uint32_t flashOffset, const void *data, size_t size, uint32_t timeout, const char *op, const char *filename)
 {
@@ -50,8 +69,10 @@ static bool FlashSafeWrite(uint32_t flashOffset, const void *data, size_t size,
         WatchdogTemporaryExtender wte(timeout + 100 + 10*(size + FLASH_PAGE_SIZE - 1)/FLASH_PAGE_SIZE);
         
         // do the write
+        uint64_t t0 = time_us_64();
         status = FlashSafeExecute([flashOffset, data, size](){
             flash_range_program(flashOffset, reinterpret_cast<const uint8_t*>(data), size); }, timeout);
+        flashOpStats.AddSample(time_us_64() - t0);
     }
 
     // check for errors
@@ -82,6 +103,7 @@ static bool FlashSafeErase(uint32_t flashOffset, size_t size, uint32_t timeout,
 
         // do the erase
         status = FlashSafeExecute([flashOffset, size](){ flash_range_erase(flashOffset, size); }, timeout);
+        flashOpStats.AddSample(time_us_64() - t0);
 
         // log statistics
         Log(LOG_DEBUG, "Flash erase (%s%s): %lx, %u bytes, %llu us\n", op, filename, flashOffset, size, time_us_64() - t0);
@@ -378,7 +400,7 @@ bool FlashStorage::Mount(uint32_t centralDirectorySize)
     // Clear the sector-in-use map, and mark the sectors used by the
     // central directory as used.
     sectorsUsed.reset();
-    for (int i = 0, idx = PICO_FLASH_SIZE_BYTES/FLASH_SECTOR_SIZE ; i < centralDirectorySize/FLASH_SECTOR_SIZE ; ++i)
+    for (uint32_t i = 0, idx = PICO_FLASH_SIZE_BYTES/FLASH_SECTOR_SIZE ; i < centralDirectorySize/FLASH_SECTOR_SIZE ; ++i)
         sectorsUsed[--idx] = 1;
 
     // Extend the watchdog timeout during the scan, since we might have to
@@ -407,6 +429,12 @@ bool FlashStorage::Mount(uint32_t centralDirectorySize)
             return Format(centralDirectorySize);
         }
 
+        // A free entry reclaimed by a directory rebuild keeps its sequence
+        // number, but the rest is erased, so there's nothing more to check
+        // and no space to account for.
+        if (dir->IsFree())
+            continue;
+
         // If the entry wasn't replaced with an all-null filename, check the
         // CRC-32.  Replaced entries don't have valid CRC-32's since they're
         // overwritten in place.
@@ -426,7 +454,7 @@ bool FlashStorage::Mount(uint32_t centralDirectorySize)
             minAllocOffset = dir->flashOffset;
 
         // mark the sectors used
-        for (int i = 0, idx = dir->flashOffset/FLASH_SECTOR_SIZE ; i < dir->maxSize/FLASH_SECTOR_SIZE ; ++i, ++idx)
+        for (uint32_t i = 0, idx = dir->flashOffset/FLASH_SECTOR_SIZE ; i < dir->maxSize/FLASH_SECTOR_SIZE ; ++i, ++idx)
             sectorsUsed[idx] = true;
 
         // tell the watchdog we're still going
@@ -446,6 +474,10 @@ bool FlashStorage::Mount(uint32_t centralDirectorySize)
 // Format a new file system
 bool FlashStorage::Format(uint32_t centralDirectorySize)
 {
+    // finish any background writes, so that none are left in progress
+    // across the format
+    CompleteJobs();
+
     // The central directory size must always be a multiple of the flash
     // sector size.  Round up to the next sector if it's not already a
     // whole multiple.
@@ -454,14 +486,13 @@ bool FlashStorage::Format(uint32_t centralDirectorySize)
     // Clear the sector-in-use map, and mark the sectors used by the
     // central directory as used.
     sectorsUsed.reset();
-    for (int i = 0, idx = PICO_FLASH_SIZE_BYTES/FLASH_SECTOR_SIZE ; i < centralDirectorySize/FLASH_SECTOR_SIZE ; ++i)
+    for (uint32_t i = 0, idx = PICO_FLASH_SIZE_BYTES/FLASH_SECTOR_SIZE ; i < centralDirectorySize/FLASH_SECTOR_SIZE ; ++i)
         sectorsUsed[--idx] = true;
 
     // Get the pointer to the central directory structure.  The directory is
     // aligned at the end of the flash space.
     const uintptr_t XIP_TOP = XIP_BASE + PICO_FLASH_SIZE_BYTES;
     const uintptr_t DIRECTORY_BASE = XIP_TOP - centralDirectorySize;
-    const auto *endOfFlash = reinterpret_cast<DirectoryEntry*>(XIP_TOP);
     const auto *dirBase = reinterpret_cast<DirectoryEntry*>(DIRECTORY_BASE);
 
     // Erase the directory structure in flash.  We've already rounded the
@@ -479,7 +510,7 @@ bool FlashStorage::Format(uint32_t centralDirectorySize)
         DirectoryEntry::SEQUENCE0,     // first sequence number
         { '/', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },  // filename '/'
         0,                             // max size is zero
-        DIRECTORY_BASE - XIP_BASE,     // allocated file location (none -> at directory base)
+        static_cast<uint32_t>(DIRECTORY_BASE - XIP_BASE),     // allocated file location (none -> at directory base)
         0                              // placeholder for CRC, filled in below
     };
     e.crc32 = e.CalculateCRC();
@@ -551,7 +582,7 @@ bool FlashStorage::FileExists(OpenStatus stat)
 }
 
 // open for reading
-FlashStorage::OpenStatus FlashStorage::OpenRead(const char *name, FileInfo &fi)
+FlashStorage::OpenStatus FlashStorage::OpenRead(const char *name, FileInfo &fi, bool verifyCRC)
 {
     // collect timing statistics
     uint64_t t0 = time_us_64();
@@ -560,6 +591,9 @@ FlashStorage::OpenStatus FlashStorage::OpenRead(const char *name, FileInfo &fi)
     if (!IsMounted())
         return OpenStatus::NotMounted;
 
+    // finish any background writes first, so that we see the latest contents
+    CompleteJobs();
+
     // find the file entry
     const auto *dir = FindFileEntry(name, false);
     if (dir == nullptr || !dir->IsAssigned())
@@ -577,6 +611,13 @@ FlashStorage::OpenStatus FlashStorage::OpenRead(const char *name, FileInfo &fi)
         return isDeleted ? OpenStatus::NotFound : OpenStatus::BadDirEntry;
     }
 
+    // if the caller doesn't want the CRC check, we're done
+    if (!verifyCRC)
+    {
+        Log(LOG_DEBUG, "File \"%s\" opened for read (no CRC check), %llu us\n", name, time_us_64() - t0);
+        return OpenStatus::OK;
+    }
+
     // Extend the watchdog timeout during the CRC scan, since this might
     // have to scan a large amount of flash memory, which can be fairly
     // slow to read.  Allow an extra 1ms per 2500 bytes, plus some
@@ -584,7 +625,7 @@ FlashStorage::OpenStatus FlashStorage::OpenRead(const char *name, FileInfo &fi)
     WatchdogTemporaryExtender wte(50 + fi.size/2500);
 
     // check the CRC
-    uint32_t crcComputed = CRC::Calculate(fi.data, fi.size, CRC::CRC_32());
+    uint32_t crcComputed = crc32Engine.Calc(fi.data, fi.size);
     if (crcComputed != fi.crc32)
     {
         Log(LOG_ERROR, "Error opening file \"%s\" for reading: CRC failure (stored %08lx, computed %08lx)\n", name, fi.crc32, crcComputed);
@@ -690,6 +731,9 @@ bool FlashStorage::Remove(const char *filename, bool silent)
         return false;
     }
 
+    // finish any background writes first, so that they can't recreate the file
+    CompleteJobs();
+
     // find the file entry
     const auto *dir = FindFileEntry(filename, false);
     if (dir == nullptr || !dir->IsAssigned())
@@ -722,7 +766,7 @@ int FlashStorage::OpenWrite(const char *name, uint32_t curSize, uint32_t maxSize
 
     // fail if not mounted
     if (!IsMounted())
-        return false;
+        return -1;
 
     // don't allow writing to the special marker file "/"
     if (strcmp(name, "/") == 0)
@@ -731,6 +775,9 @@ int FlashStorage::OpenWrite(const char *name, uint32_t curSize, uint32_t maxSize
         return -1;
     }
 
+    // finish any background writes first, so that writes are applied in order
+    CompleteJobs();
+
     // round the requested maximum size up to a sector boundary
     maxSize = ((maxSize + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE) * FLASH_SECTOR_SIZE;
 
@@ -759,7 +806,7 @@ int FlashStorage::OpenWrite(const char *name, uint32_t curSize, uint32_t maxSize
 
         // update the in-flash data
         if (!UpdateFileEntry(dir, &e, "Expanding[1] file ", name))
-            return false;
+            return -1;
 
         // Now allocate a new free entry for the file.  We can do this
         // simply by looking up the filename in write mode, since the old
@@ -776,12 +823,13 @@ int FlashStorage::OpenWrite(const char *name, uint32_t curSize, uint32_t maxSize
         Log(LOG_ERROR, "Error creating file \"%s\": no more directory entries available\n", name);
         return -1;
     }
-    else if (!dir->IsAssigned())
+    else if (!dir->IsAssigned() || dir->IsFree())
     {
-        // File not found, and we have a free directory entry available.
-        // Create a new entry.
+        // File not found, and we have a free directory entry available
+        // (either never used, or reclaimed by a directory rebuild, which
+        // leaves the sequence number in place).  Create a new entry.
         if (!InitFileEntry(dir, name, maxSize))
-            return false;
+            return -1;
 
         // this is a new file
         isNew = true;
@@ -805,6 +853,8 @@ int FlashStorage::OpenWrite(const char *name, uint32_t curSize, uint32_t maxSize
     wh.bufOffset = 0;
     wh.dirEntry = dir;
     wh.tOpen = t0;
+    wh.closePhase = 0;
+    wh.closeOk = true;
 
     // If the file previously existed, see if there's room to append a new
     // copy of the file into erased space after the end of the current file.
@@ -873,7 +923,7 @@ int FlashStorage::OpenWrite(const char *name, uint32_t curSize, uint32_t maxSize
                     // work in whole page units, round the allocation up to a page boundary.
                     size_t oldContentsSize = nextHeaderOfs - nextHeaderSector;
                     size_t oldContentsBufSize = (oldContentsSize + FLASH_PAGE_SIZE - 1)/FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
-                    std::unique_ptr<uint8_t> oldContents(new (std::nothrow) uint8_t[oldContentsBufSize]);
+                    std::unique_ptr<uint8_t[]> oldContents(new (std::nothrow) uint8_t[oldContentsBufSize]);
                     if (oldContents != nullptr)
                     {
                         // save the old contents
@@ -1004,8 +1054,9 @@ bool FlashStorage::InitFileEntry(const DirectoryEntry *dir, const char *name, ui
         if (minAllocOffset < PROGRAM_IMAGE_END_OFFSET || minAllocOffset - PROGRAM_IMAGE_END_OFFSET < maxSize)
         {
             Log(LOG_ERROR, "Error creating file \"%s\": insufficient flash space available above program image "
-                "(%lu bytes requested, %lu bytes available)\n", maxSize, minAllocOffset - PROGRAM_IMAGE_END_OFFSET);
-            return -1;
+                "(%lu bytes requested, %lu bytes available)\n", name, maxSize,
+                minAllocOffset > PROGRAM_IMAGE_END_OFFSET ? minAllocOffset - PROGRAM_IMAGE_END_OFFSET : 0);
+            return false;
         }
         
         // Allocate the requested space at the bottom of our claimed area
@@ -1014,27 +1065,26 @@ bool FlashStorage::InitFileEntry(const DirectoryEntry *dir, const char *name, ui
     }
         
     // mark the sectors used
-    for (int i = 0, idx = allocOffset/FLASH_SECTOR_SIZE ; i < maxSize/FLASH_SECTOR_SIZE ; ++i, ++idx)
+    for (uint32_t i = 0, idx = allocOffset/FLASH_SECTOR_SIZE ; i < maxSize/FLASH_SECTOR_SIZE ; ++i, ++idx)
         sectorsUsed[idx] = true;
 
     // Set up the new directory entry
     DirectoryEntry e;
-    strncpy(e.filename, name, sizeof(e.filename));
+    // copy the name, zero-padding the unused portion (the field has no
+    // room for a null terminator when the name fills all 16 characters)
+    memset(e.filename, 0, sizeof(e.filename));
+    memcpy(e.filename, name, strnlen(name, sizeof(e.filename)));
     e.maxSize = maxSize;
     e.flashOffset = allocOffset;
     e.crc32 = 0xFFFFFFFF;
 
     // Set the sequence number ONLY IF it's not already set in the entry.
     // If we're using a reclaimed entry, it will already have a sequence
-    // number, so don't overwrite it.
-    if (dir->sequence == 0xFFFFFFFF)
-    {
-        // set the sequence
-        e.sequence = nextSequence++;
-
-        // set the CRC32
-        e.crc32 = e.CalculateCRC();
-    }
+    // number, so keep it.  The CRC-32 covers the sequence number, so
+    // figure it after settling the sequence either way; the CRC field
+    // of a reclaimed entry is erased, so it can take the new value.
+    e.sequence = (dir->sequence == 0xFFFFFFFF) ? nextSequence++ : dir->sequence;
+    e.crc32 = e.CalculateCRC();
 
     // update it
     return UpdateFileEntry(dir, &e, "Creating file ", name);
@@ -1043,7 +1093,7 @@ bool FlashStorage::InitFileEntry(const DirectoryEntry *dir, const char *name, ui
 bool FlashStorage::UpdateFileEntry(const DirectoryEntry *flashPtr, const DirectoryEntry *newData, const char *op, const char *filename)
 {
     // Find the base of the flash page containing the struct
-    uintptr_t dirFlashOffset = reinterpret_cast<uint32_t>(flashPtr) - XIP_BASE;
+    uintptr_t dirFlashOffset = reinterpret_cast<uintptr_t>(flashPtr) - XIP_BASE;
     uintptr_t dirFlashPageBase = (dirFlashOffset / FLASH_PAGE_SIZE) * FLASH_PAGE_SIZE;
 
     // copy the existing page into a local buffer
@@ -1068,7 +1118,7 @@ bool FlashStorage::WriteFile(int handle, const void *data, size_t len)
     uint64_t t0 = time_us_64();
 
     // validate the handle
-    if (handle < 0 || handle >= _countof(writeHandles) || writeHandles[handle].dirEntry == nullptr)
+    if (handle < 0 || handle >= static_cast<int>(_countof(writeHandles)) || writeHandles[handle].dirEntry == nullptr)
     {
         Log(LOG_ERROR, "WriteFile: invalid handle %d\n", handle);
         return false;
@@ -1107,40 +1157,70 @@ bool FlashStorage::WriteFile(int handle, const void *data, size_t len)
 // Close a file opened for writing
 bool FlashStorage::CloseWrite(int handle)
 {
-    // collect timing statistics
-    uint64_t t0 = time_us_64();
-
     // validate the handle
-    if (handle < 0 || handle >= _countof(writeHandles) || writeHandles[handle].dirEntry == nullptr)
+    if (handle < 0 || handle >= static_cast<int>(_countof(writeHandles)) || writeHandles[handle].dirEntry == nullptr)
     {
         Log(LOG_ERROR, "CloseFile: invalid handle %d\n", handle);
         return false;
     }
 
-    // Calculate the final stream size.  This is the size of the committed
-    // data (writeOffset) plus the remaining buffered data, minus the size
-    // of the file header.  The header is stored in the raw stream, so the
-    // write offset is relative to the start of the header, but the stored
-    // file size only includes the size of the caller's payload.
+    // run the close steps until done
+    int stat;
+    while ((stat = CloseWriteStep(handle)) == 0) ;
+    return stat > 0;
+}
+
+// carry out one step of closing a file opened for writing
+int FlashStorage::CloseWriteStep(int handle)
+{
     auto &wh = writeHandles[handle];
     const char *filename = wh.dirEntry->filename;
-    uint32_t streamSize = wh.writeOffset + wh.bufOffset - wh.headerOffset - sizeof(FileHeader);
-
-    // flush the write buffer
-    bool ok = wh.Flush();
-
-    // If this leaves the write offset at a sector boundary, and the next
-    // sector is within the file's allocated region, erase the next sector.
-    // This is required when the stream ends on the sector boundary, since
-    // the next file-open operation will attempt to follow the header list
-    // into the new sector.  The sector must be erased to detect the end
-    // of the header list there.
-    if ((wh.writeOffset % FLASH_SECTOR_SIZE) == 0 && wh.writeOffset < wh.dirEntry->maxSize)
+    switch (wh.closePhase)
     {
-        if (!FlashSafeErase(wh.dirEntry->flashOffset + wh.writeOffset, FLASH_SECTOR_SIZE, 100, "Writing file ", filename))
-            ok = false;
+    case 0:
+        // starting the close - note the time, for statistics
+        wh.tClose = time_us_64();
+        wh.closePhase = 1;
+
+        // Calculate the final stream size.  This is the size of the
+        // committed data (writeOffset) plus the remaining buffered data,
+        // minus the size of the file header.  The header is stored in the
+        // raw stream, so the write offset is relative to the start of the
+        // header, but the stored file size only includes the size of the
+        // caller's payload.  This must be figured before the final flush,
+        // since the flush advances the write offset by a whole page.
+        wh.closeStreamSize = wh.writeOffset + wh.bufOffset - wh.headerOffset - sizeof(FileHeader);
+        [[fallthrough]];
+
+    case 1:
+        // flush the write buffer
+        if (int stat = wh.FlushStep(); stat == 0)
+            return 0;
+        else if (stat < 0)
+            wh.closeOk = false;
+
+        // If this leaves the write offset at a sector boundary, and the next
+        // sector is within the file's allocated region, erase the next sector.
+        // This is required when the stream ends on the sector boundary, since
+        // the next file-open operation will attempt to follow the header list
+        // into the new sector.  The sector must be erased to detect the end
+        // of the header list there.
+        wh.closePhase = 2;
+        if ((wh.writeOffset % FLASH_SECTOR_SIZE) == 0 && wh.writeOffset < wh.dirEntry->maxSize)
+        {
+            if (!FlashSafeErase(wh.dirEntry->flashOffset + wh.writeOffset, FLASH_SECTOR_SIZE, 100, "Writing file ", filename))
+                wh.closeOk = false;
+            return 0;
+        }
+        [[fallthrough]];
+
+    default:
+        break;
     }
 
+    // get the final stream size, from the start of the close
+    uint32_t streamSize = wh.closeStreamSize;
+
     // get a pointer to the file header and content stream in flash
     uint32_t flashHeaderOfs = wh.dirEntry->flashOffset + wh.headerOffset;
     const auto *fileHeaderPtr = reinterpret_cast<const FileHeader*>(flashHeaderOfs + XIP_BASE);
@@ -1150,7 +1230,7 @@ bool FlashStorage::CloseWrite(int handle)
     uint32_t flashHeaderPage = (flashHeaderOfs/FLASH_PAGE_SIZE) * FLASH_PAGE_SIZE;
 
     // calculate the checksum of the stream contents
-    uint32_t crc = CRC::Calculate(streamPtr, streamSize, CRC::CRC_32());    
+    uint32_t crc = crc32Engine.Calc(streamPtr, streamSize);    
 
     // set up the final file header
     FileHeader newHeader{ streamSize, crc };
@@ -1182,7 +1262,7 @@ bool FlashStorage::CloseWrite(int handle)
     // change anything, so we can keep rewriting a section as long as it's
     // still set to 0xFF bytes.
     if (!FlashSafeWrite(flashHeaderPage, buf, writeSize, 100, "Writing file ", filename))
-        ok = false;
+        wh.closeOk = false;
 
     // release the handle by marking the directory entry as null
     wh.dirEntry = nullptr;
@@ -1190,24 +1270,33 @@ bool FlashStorage::CloseWrite(int handle)
     // Debugging - log the timing
     uint64_t now = time_us_64();
     Log(LOG_DEBUG, "CloseWrite \"%s\", %llu us in close, %llu us since open\n",
-        filename, now - t0, now - wh.tOpen);
+        filename, now - wh.tClose, now - wh.tOpen);
 
     // return the result
-    return ok;
+    return wh.closeOk ? 1 : -1;
 }
 
 // flush a file handle buffer
 bool FlashStorage::WriteHandle::Flush()
+{
+    // run flush steps until done
+    int stat;
+    while ((stat = FlushStep()) == 0) ;
+    return stat > 0;
+}
+
+// carry out one step of a buffer flush
+int FlashStorage::WriteHandle::FlushStep()
 {
     // there's nothing to do if the buffer is empty
     if (bufOffset == 0)
-        return true;
+        return 1;
     
     // make sure this doesn't take us over the file limit
     if (writeOffset + bufOffset > dirEntry->maxSize)
     {
         Log(LOG_ERROR, "Writing file \"%s\": maximum size %d exceeded\n", dirEntry->filename, dirEntry->maxSize);
-        return false;
+        return -1;
     }
 
     // fill in any unused portion of the buffer with 0xFF bytes,
@@ -1220,27 +1309,257 @@ bool FlashStorage::WriteHandle::Flush()
     // We're entering a sector if the write offset is exactly on a sector boundary, AND
     // the file itself didn't start at a non-zero offset within this sector.  It's
     // possible for the file to start AFTER the first buffer's write pointer, because we
-    // could be appending the file to existing data in the same sector.
+    // could be appending the file to existing data in the same sector.  The erase is
+    // a separate step; on the next step, the sector will test as erased, so we'll
+    // proceed to the page write.
     uint32_t writeOffsetInFlash = dirEntry->flashOffset + writeOffset;
     uint32_t headerOffsetInFlash = dirEntry->flashOffset + headerOffset;
     if ((writeOffset % FLASH_SECTOR_SIZE) == 0 && headerOffsetInFlash <= writeOffsetInFlash && !IsSectorErased(writeOffsetInFlash))
-    {
-        if (!FlashSafeErase(writeOffsetInFlash, FLASH_SECTOR_SIZE, 100, "Writing file ", dirEntry->filename))
-            return false;
-    }
+        return FlashSafeErase(writeOffsetInFlash, FLASH_SECTOR_SIZE, 100, "Writing file ", dirEntry->filename) ? 0 : -1;
 
     // write out the page
     if (!FlashSafeWrite(dirEntry->flashOffset + writeOffset, buf, sizeof(buf), 100, "Writing file ", dirEntry->filename))
-        return false;
+        return -1;
 
     // bump the write pointer by the buffer size, and reset the buffer pointer
     writeOffset += sizeof(buf);
     bufOffset = 0;
 
     // success
+    return 1;
+}
+
+// ---------------------------------------------------------------------------
+//
+// Raw storage regions
+//
+
+bool FlashStorage::OpenRegion(const char *name, uint32_t clientSize, uint32_t &clientOffset, bool &created)
+{
+    // fail if not mounted
+    created = false;
+    if (!IsMounted())
+        return false;
+
+    // the allocation includes a leading sector for the empty file stream
+    uint32_t allocSize = ((clientSize + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE + 1) * FLASH_SECTOR_SIZE;
+
+    // look for an existing region with a valid file stream and enough space
+    FileInfo fi;
+    bool isDeleted = false;
+    const auto *dir = FindFileEntry(name, false);
+    if (dir == nullptr || !dir->IsAssigned() || dir->maxSize < allocSize || !GetFileStream(dir, fi, isDeleted) || isDeleted)
+    {
+        // Not found - create it as an empty file.  With curSize == 0, the
+        // writer starts over at the beginning of the allocation, so this
+        // only touches the first sector.
+        int h = OpenWrite(name, 0, allocSize);
+        if (h < 0 || !CloseWrite(h))
+        {
+            Log(LOG_ERROR, "Error creating flash region \"%s\"\n", name);
+            return false;
+        }
+
+        // look up the new directory entry
+        if ((dir = FindFileEntry(name, false)) == nullptr || !dir->IsAssigned())
+            return false;
+
+        // note that it's new
+        created = true;
+    }
+
+    // the client area starts at the second sector
+    clientOffset = dir->flashOffset + FLASH_SECTOR_SIZE;
+    return true;
+}
+
+bool FlashStorage::EraseRegionSector(uint32_t flashOffset, const char *name)
+{
+    return FlashSafeErase(flashOffset, FLASH_SECTOR_SIZE, 100, "Erasing region ", name);
+}
+
+bool FlashStorage::ProgramRegion(uint32_t flashOffset, const void *data, size_t size, const char *name)
+{
+    return FlashSafeWrite(flashOffset, data, size, 100, "Writing region ", name);
+}
+
+// ---------------------------------------------------------------------------
+//
+// Background write jobs
+//
+
+FlashStorage::Job::Job(const char *name, const void *data, size_t len, uint32_t maxSize) :
+    data(new uint8_t[len]), len(len), maxSize(maxSize), tQueued(time_us_64())
+{
+    strncpy(filename, name, sizeof(filename) - 1);
+    filename[sizeof(filename) - 1] = 0;
+    memcpy(this->data.get(), data, len);
+}
+
+bool FlashStorage::QueueWrite(const char *name, const void *data, size_t len, uint32_t maxSize)
+{
+    // fail if not mounted
+    if (!IsMounted())
+        return false;
+
+    // If there's already a job for this file that hasn't started yet,
+    // replace its contents.  The new data supersede the old, so there's
+    // no reason to write the old version first.
+    for (auto &job : jobs)
+    {
+        if (job.state == Job::State::Open && strcmp(job.filename, name) == 0)
+        {
+            job.data.reset(new uint8_t[len]);
+            memcpy(job.data.get(), data, len);
+            job.len = len;
+            job.maxSize = maxSize;
+            Log(LOG_DEBUG, "Background write \"%s\": replaced pending job with new contents\n", name);
+            return true;
+        }
+    }
+
+    // add a new job
+    jobs.emplace_back(name, data, len, maxSize);
+    Log(LOG_DEBUG, "Background write \"%s\": queued, %u bytes\n", name, len);
     return true;
 }
 
+void FlashStorage::Task()
+{
+    // run one step of the job at the head of the queue
+    if (jobs.size() != 0 && !inJobStep)
+    {
+        auto &job = jobs.front();
+        if (int stat = JobStep(job); stat != 0)
+            EndJob(stat > 0);
+    }
+}
+
+void FlashStorage::CompleteJobs()
+{
+    // ignore recursive calls from within a job step
+    if (inJobStep)
+        return;
+
+    // run jobs until the queue is empty
+    while (jobs.size() != 0)
+    {
+        // If the next job is waiting for a write handle held by a
+        // synchronous writer, we can't make any more progress until the
+        // writer closes its handle, which can't happen while we're
+        // looping here.  Leave the remaining jobs for Task().
+        auto &job = jobs.front();
+        if (job.state == Job::State::Open && FindFreeHandle() < 0)
+            break;
+
+        if (int stat = JobStep(job); stat != 0)
+            EndJob(stat > 0);
+
+        // make sure we don't time out the watchdog while we're still working
+        watchdog_update();
+    }
+}
+
+int FlashStorage::JobStep(Job &job)
+{
+    // reset the flash operation statistics, so that we can collect
+    // statistics for this step alone
+    flashOpStats.nOps = 0;
+    flashOpStats.maxTime = 0;
+
+    // carry out the next step
+    inJobStep = true;
+    int result = 0;
+    switch (job.state)
+    {
+    case Job::State::Open:
+        // If a synchronous writer currently holds the write handle,
+        // that's a transient condition, so just stay in the Open state
+        // and try again on the next step, after the writer closes its
+        // handle.
+        if (FindFreeHandle() < 0)
+        {
+            if (!job.waitingForHandle)
+                Log(LOG_DEBUG, "Flash background write \"%s\" waiting for the write handle\n", job.filename);
+            job.waitingForHandle = true;
+            break;
+        }
+
+        // Open the file.  This performs at most a directory entry
+        // update in the common cases; the file header is buffered.
+        // Reallocating the file, rebuilding a full directory, or
+        // repairing an interrupted append can take several flash
+        // operations, all within this one step (see QueueWrite()).
+        job.tStarted = time_us_64();
+        if ((job.handle = OpenWrite(job.filename, job.len, job.maxSize)) < 0)
+            result = -1;
+        else
+            job.state = Job::State::Write;
+        break;
+
+    case Job::State::Write:
+        // write the contents
+        {
+            auto &wh = writeHandles[job.handle];
+            if (wh.bufOffset == sizeof(wh.buf))
+            {
+                // the buffer is full - flush it
+                if (wh.FlushStep() < 0)
+                {
+                    wh.dirEntry = nullptr;
+                    result = -1;
+                }
+            }
+            else
+            {
+                // fill the buffer from the remaining data, with no flash
+                // operations on this step
+                size_t copySize = std::min(job.len - job.writeOffset, sizeof(wh.buf) - wh.bufOffset);
+                memcpy(&wh.buf[wh.bufOffset], job.data.get() + job.writeOffset, copySize);
+                job.writeOffset += copySize;
+                wh.bufOffset += copySize;
+
+                // if that's everything, start closing the file
+                if (job.writeOffset == job.len)
+                    job.state = Job::State::Close;
+            }
+        }
+        break;
+
+    case Job::State::Close:
+        // close the file
+        result = CloseWriteStep(job.handle);
+        break;
+    }
+    inJobStep = false;
+
+    // collect statistics
+    job.nFlashOps += flashOpStats.nOps;
+    job.maxLockoutTime = std::max(job.maxLockoutTime, flashOpStats.maxTime);
+
+    // return the step result
+    return result;
+}
+
+void FlashStorage::EndJob(bool ok)
+{
+    // log the results
+    auto &job = jobs.front();
+    uint64_t now = time_us_64();
+    Log(ok ? LOG_INFO : LOG_ERROR, "Background write \"%s\" %s: %u bytes, %lu flash operations, %llu us elapsed, "
+        "max second-core lockout %lu us\n",
+        job.filename, ok ? "completed" : "failed", job.len, job.nFlashOps, now - job.tStarted, job.maxLockoutTime);
+
+    // save the statistics for the console
+    memcpy(lastJob.filename, job.filename, sizeof(lastJob.filename));
+    lastJob.ok = ok;
+    lastJob.nFlashOps = job.nFlashOps;
+    lastJob.maxLockoutTime = job.maxLockoutTime;
+    lastJob.elapsedTime = now - job.tStarted;
+
+    // remove it from the queue
+    jobs.pop_front();
+}
 
 // look up a file by name
 const FlashStorage::DirectoryEntry *FlashStorage::FindFileEntry(const char *name, bool forWriting)
@@ -1316,7 +1635,7 @@ bool FlashStorage::RebuildCentralDirectory(bool &modified)
     modified = false;
     
     // we need memory to hold an in-memory copy of the sector
-    std::unique_ptr<uint8_t> buf(new (std::nothrow) uint8_t[FLASH_SECTOR_SIZE]);
+    std::unique_ptr<uint8_t[]> buf(new (std::nothrow) uint8_t[FLASH_SECTOR_SIZE]);
     if (buf == nullptr)
     {
         Log(LOG_ERROR, "Insufficient memory for flash central directory rebuild\n");
@@ -1337,7 +1656,7 @@ bool FlashStorage::RebuildCentralDirectory(bool &modified)
         // scan for entries we can reclaim
         auto *p = reinterpret_cast<DirectoryEntry*>(buf.get());
         int nReclaimed = 0;
-        for (int i = 0 ; i < FLASH_SECTOR_SIZE / sizeof(DirectoryEntry) ; ++i, ++p)
+        for (size_t i = 0 ; i < FLASH_SECTOR_SIZE / sizeof(DirectoryEntry) ; ++i, ++p)
         {
             // we can reclaim a replaced entry or a deleted file
             if (p->IsReplaced() || p->IsDeleted())
@@ -1360,21 +1679,21 @@ bool FlashStorage::RebuildCentralDirectory(bool &modified)
                 // count the reclaimed entry
                 nReclaimed += 1;
             }
+        }
 
-            // If we found any entries to reclaim, save the updated
-            // directory back to flash.  There's no need to save it if we
-            // didn't reclaim any entries, since we won't have made any
-            // changes in that case.
-            if (nReclaimed != 0)
-            {
-                // erase the sector
-                if (!FlashSafeErase(flashOffset, FLASH_SECTOR_SIZE, 100, "Rebuilding central directory", "")
-                    || !FlashSafeWrite(flashOffset, buf.get(), FLASH_SECTOR_SIZE, 100, "Rebuilding central directory", ""))
-                    return false;
+        // If we found any entries to reclaim, save the updated directory
+        // sector back to flash.  There's no need to save it if we didn't
+        // reclaim any entries, since we won't have made any changes in
+        // that case.
+        if (nReclaimed != 0)
+        {
+            // erase the sector
+            if (!FlashSafeErase(flashOffset, FLASH_SECTOR_SIZE, 100, "Rebuilding central directory", "")
+                || !FlashSafeWrite(flashOffset, buf.get(), FLASH_SECTOR_SIZE, 100, "Rebuilding central directory", ""))
+                return false;
 
-                // we made changes to the directory structure
-                modified = true;
-            }
+            // we made changes to the directory structure
+            modified = true;
         }
     }
 
@@ -1419,7 +1738,7 @@ bool FlashStorage::IsSectorErased(uint32_t sectorOfs)
 int FlashStorage::FindFreeHandle()
 {
     // search for a write handle with no associated directory entry
-    for (int i = 0 ; i < _countof(writeHandles) ; ++i)
+    for (int i = 0 ; i < static_cast<int>(_countof(writeHandles)) ; ++i)
     {
         if (writeHandles[i].dirEntry == nullptr)
             return i;
@@ -1431,12 +1750,12 @@ int FlashStorage::FindFreeHandle()
 
 uint32_t FlashStorage::DirectoryEntry::CalculateCRC() const
 {
-    return CRC::Calculate(this, reinterpret_cast<size_t>(&this->crc32) - reinterpret_cast<size_t>(this), CRC::CRC_32());
+    return crc32Engine.Calc(this, reinterpret_cast<size_t>(&this->crc32) - reinterpret_cast<size_t>(this));
 }
 
 bool FlashStorage::DirectoryEntry::IsDeleted() const
 {
-    return flashOffset != 0 && reinterpret_cast<FileHeader*>(flashOffset + XIP_BASE)->fileSize == 0xFFFFFFFF;
+    return flashOffset != 0 && flashOffset != 0xFFFFFFFF && reinterpret_cast<FileHeader*>(flashOffset + XIP_BASE)->fileSize == 0xFFFFFFFF;
 }
 
 
@@ -1479,6 +1798,20 @@ void FlashStorage::Command_fsck(const ConsoleCommandContext *c)
             nf.Format("%lu", DIRECTORY_BASE - XIP_BASE - flashStorage.minAllocOffset),
             nf.Format("%lu", PROGRAM_IMAGE_END_OFFSET),
             nf.Format("%lu", flashStorage.minAllocOffset - PROGRAM_IMAGE_END_OFFSET));
+
+        // show background write job status
+        const auto &lj = flashStorage.lastJob;
+        c->Printf("  Background writes pending:    %u\n", flashStorage.jobs.size());
+        if (lj.filename[0] != 0)
+        {
+            c->Printf(
+                "  Last background write:        \"%s\", %s\n"
+                "    Flash operations:           %lu\n"
+                "    Elapsed time:               %llu us\n"
+                "    Max second-core lockout:    %lu us\n",
+                lj.filename, lj.ok ? "OK" : "failed",
+                lj.nFlashOps, lj.elapsedTime, lj.maxLockoutTime);
+        }
     }
     else
     {
@@ -1549,7 +1882,7 @@ void FlashStorage::Command_ls(const ConsoleCommandContext *c)
             if (flashStorage.GetFileStream(dir, fi, isDeleted) && !isDeleted)
             {
                 // check the CRC if it's an active file and the size is within range
-                uint32_t crcCalc = CRC::Calculate(fi.data, fi.size, CRC::CRC_32());
+                uint32_t crcCalc = crc32Engine.Calc(fi.data, fi.size);
                 isValid = (crcCalc == fi.crc32);
                 crc = fi.crc32;
                 streamOfs = reinterpret_cast<uintptr_t>(fi.data) - XIP_BASE;
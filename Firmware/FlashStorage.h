@@ -37,6 +37,12 @@
 //  - As an integrity check, the header also contains a checksum of the
 //    file's contents, also programmed when the file is updated.
 //
+//  - Writes can be queued as background jobs, which the main loop carries
+//    out one flash operation at a time (a single sector erase or a single
+//    page program), so that the rest of the system keeps running between
+//    steps.  Opening the file is a single step, which can take several
+//    flash operations in some cases.  See QueueWrite().
+//
 //
 // A note on byte-level flash writes
 //
@@ -64,6 +70,7 @@
 #include <bitset>
 #include <memory>
 #include <vector>
+#include <list>
 #include <pico/stdlib.h>
 #include <hardware/flash.h>
 #include "Pinscape.h"
@@ -106,6 +113,11 @@ public:
     // read dosn't affect the file system state.  It just retrieves the
     // location of the file's flash storage for the caller to access via
     // memory reads.
+    //
+    // If verifyCRC is false, the CRC check of the file contents is
+    // skipped.  Use this when the caller has its own means of validating
+    // the contents, or doesn't need to examine the whole file, since the
+    // CRC scan has to read every byte of the file from flash.
     struct FileInfo
     {
         // pointer to the first byte of the file's contents in flash
@@ -125,7 +137,7 @@ public:
         BadChecksum = -3,   // bad checksum - file data corrupted
         NotMounted = -4,    // file system not mounted
     };
-    OpenStatus OpenRead(const char *name, FileInfo &fi);
+    OpenStatus OpenRead(const char *name, FileInfo &fi, bool verifyCRC = true);
 
     // Test if a file exists.  This returns true if a directory entry
     // is found for the file, whether or not the stored data are valid.
@@ -169,6 +181,73 @@ public:
     // doesn't exist.
     bool Remove(const char *name, bool silent);
 
+    // Raw storage regions.  A region is a file whose allocation is used
+    // directly by a client with its own on-flash format, rather than as
+    // a byte stream.  The first sector of the allocation holds an empty
+    // (zero-length) file stream, which keeps the region visible to the
+    // file system as a valid file, so that its space is never reclaimed;
+    // the client owns the sectors after that.
+    //
+    // OpenRegion() finds the named region, creating it if necessary with
+    // clientSize bytes of client space (rounded up to whole sectors), and
+    // returns the flash offset of the client area.  'created' is set to
+    // true if the region was newly created, in which case the client area
+    // contents are undefined, and the client should erase it before use.
+    bool OpenRegion(const char *name, uint32_t clientSize, uint32_t &clientOffset, bool &created);
+
+    // Erase a sector, or program whole pages, within a region's client
+    // area.  These use the same flash-safe execution context as file
+    // writes.  The erase offset must be sector-aligned; the program offset
+    // must be page-aligned, and the size a multiple of the page size.
+    bool EraseRegionSector(uint32_t flashOffset, const char *name);
+    bool ProgramRegion(uint32_t flashOffset, const void *data, size_t size, const char *name);
+
+    // Queue a background write.  This writes the entire contents of a
+    // file as a background job, which the main loop carries out in small
+    // steps via Task().  Each data write and close step performs at most
+    // one flash operation, either a single sector erase or a single page
+    // program, so the second core is only locked out of flash for the
+    // duration of that one operation, and both cores keep running
+    // normally between steps.
+    //
+    // The exception is the first step, which opens the file with
+    // OpenWrite(), as a single step.  In the common cases (overwriting
+    // or appending to an existing file, or creating a file in a free
+    // directory slot), that's at most one directory page program.  But
+    // it can take several back-to-back flash operations when the file
+    // has to be reallocated at a larger size (two directory updates),
+    // when the directory is full and has to be rebuilt (an erase and
+    // program of each directory sector), or when an interrupted append
+    // left a partially written sector that has to be erased and
+    // restored.  So the open step can stall the main loop for as long
+    // as a synchronous open in those cases.
+    //
+    // In contrast, the synchronous OpenWrite()/WriteFile()/CloseWrite()
+    // sequence carries out all of the flash operations back-to-back,
+    // which stalls the main loop for the entire write, and leaves the
+    // second core with only momentary windows to run between lockouts.
+    //
+    // The data are copied into the job, so the caller's buffer can be
+    // reused immediately.  If a job for the same file is already queued
+    // and hasn't started yet, the new data simply replace the queued
+    // data, so repeated updates to a settings file only write the final
+    // version.  Returns true if the job was queued; errors that occur
+    // while carrying out the job are logged.
+    //
+    // Any synchronous file operation (open for read or write, remove)
+    // first completes all pending jobs, so the file system always
+    // presents a consistent sequential view of the writes.
+    bool QueueWrite(const char *name, const void *data, size_t len, uint32_t maxSize);
+
+    // Run background jobs.  The main loop calls this on each iteration.
+    void Task();
+
+    // Complete all pending background jobs immediately
+    void CompleteJobs();
+
+    // are any background jobs pending?
+    bool IsJobPending() const { return jobs.size() != 0; }
+
     // Populate a PinscapePico::FlashFileSysInfo struct, for the Vendor
     // Interface file system information query command.
     size_t Populate(PinscapePico::FlashFileSysInfo *buf, size_t bufLen);
@@ -430,14 +509,99 @@ protected:
         // Flush the buffer
         bool Flush();
 
+        // Carry out one step of a buffer flush.  This performs at most
+        // one flash operation: erasing the sector that the buffer enters,
+        // or programming the buffer page.  Returns 1 if the flush is
+        // complete, 0 if more steps are required, -1 on error.
+        int FlushStep();
+
         // directory entry pointer
         const DirectoryEntry *dirEntry = nullptr;
 
         // time the handle was opened
         uint64_t tOpen = 0;
+
+        // close progress, for CloseWriteStep(); the stream size is
+        // figured before the final flush, which resets the buffer
+        uint8_t closePhase = 0;
+        bool closeOk = true;
+        uint64_t tClose = 0;
+        uint32_t closeStreamSize = 0;
     };
     WriteHandle writeHandles[1];
 
+    // Carry out one step of closing a write handle.  This performs at
+    // most one flash operation.  Returns 1 if the close is complete and
+    // successful, 0 if more steps are required, -1 if the close is
+    // complete and failed.  The handle is released on completion.
+    int CloseWriteStep(int handle);
+
+    // Background write job
+    struct Job
+    {
+        Job(const char *name, const void *data, size_t len, uint32_t maxSize);
+
+        // filename
+        char filename[17];
+
+        // file contents
+        std::unique_ptr<uint8_t[]> data;
+        size_t len;
+
+        // maximum size, for OpenWrite()
+        uint32_t maxSize;
+
+        // current state
+        enum class State
+        {
+            Open,     // not started; next step opens the file (possibly several flash operations; see QueueWrite())
+            Write,    // writing the file contents
+            Close,    // closing the file
+        };
+        State state = State::Open;
+
+        // write handle, when open
+        int handle = -1;
+
+        // waiting for a synchronous writer to release the write handle
+        bool waitingForHandle = false;
+
+        // number of bytes of 'data' transferred to the write buffer so far
+        size_t writeOffset = 0;
+
+        // statistics: time queued, time started, number of flash
+        // operations, and maximum time for a single flash operation
+        // (which is the longest the second core was locked out)
+        uint64_t tQueued = 0;
+        uint64_t tStarted = 0;
+        uint32_t nFlashOps = 0;
+        uint32_t maxLockoutTime = 0;
+    };
+    std::list<Job> jobs;
+
+    // Carry out one step of a job.  Returns 1 if the job completed
+    // successfully, 0 if more steps are required, -1 if the job failed.
+    int JobStep(Job &job);
+
+    // finish the job at the head of the queue: log the results and
+    // remove it from the queue
+    void EndJob(bool ok);
+
+    // running a job step; used to prevent recursive job processing
+    // when a job step calls into the synchronous file functions
+    bool inJobStep = false;
+
+    // statistics for the last completed job, for the console
+    struct LastJobStats
+    {
+        char filename[17]{ 0 };
+        bool ok = false;
+        uint32_t nFlashOps = 0;
+        uint32_t maxLockoutTime = 0;
+        uint64_t elapsedTime = 0;
+    };
+    LastJobStats lastJob;
+
     // initialization completed?
     bool initialized = false;
 
@@ -0,0 +1,71 @@
+// Pinscape Pico - 74HC595 BCM bit plane tests
+// Copyright 2024, 2025 Michael J Roberts / BSD-3-Clause license / NO WARRANTY
+//
+// Checks the 74HC595 PWM driver's transpose-based bit plane builder
+// against the per-bit loop it replaced, which tested each port's level
+// against the plane bit and accumulated the result, first port in the
+// high bit.  Covers every level at every port position, random groups,
+// and unaligned level pointers.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <initializer_list>
+#include "../Devices/ShiftReg/74HC595_BitPlanes.h"
+#include "HostTest.h"
+
+// reference: the original per-bit plane word loop, for 16 ports
+static uint16_t RefPlaneWord(const uint8_t *plevel, int plane)
+{
+    int pwmBit = 1 << plane;
+    int acc = 0;
+    for (int port = 0 ; port < 16 ; ++port)
+    {
+        if ((plevel[port] & pwmBit) != 0)
+            acc |= 0x8000 >> port;
+    }
+    return static_cast<uint16_t>(acc);
+}
+
+// check one group of 16 ports against the reference
+static void Check(const uint8_t *levels, const char *what, int n)
+{
+    uint16_t planeWords[8];
+    BCMBitPlanes::Build16(levels, planeWords);
+    for (int plane = 0 ; plane < 8 ; ++plane)
+    {
+        uint16_t ref = RefPlaneWord(levels, plane);
+        HT_CHECK(planeWords[plane] == ref, "%s %d, plane %d: %04x, expected %04x", what, n, plane, planeWords[plane], ref);
+    }
+}
+
+int main()
+{
+    // every level at every port position, with the other ports at zero,
+    // then at all ones, to catch bits leaking between ports or planes
+    uint8_t levels[16 + 8];
+    for (int fill : { 0x00, 0xFF })
+    {
+        for (int port = 0 ; port < 16 ; ++port)
+        {
+            for (int level = 0 ; level < 256 ; ++level)
+            {
+                memset(levels, fill, sizeof(levels));
+                levels[port] = static_cast<uint8_t>(level);
+                Check(levels, fill == 0 ? "single port on zeroes" : "single port on ones", port*256 + level);
+            }
+        }
+    }
+
+    // random groups, at every alignment of the level pointer
+    HostTest::Rand rand(595);
+    for (int i = 0 ; i < 100000 ; ++i)
+    {
+        for (auto &l : levels)
+            l = static_cast<uint8_t>(rand.Next());
+        Check(&levels[i % 8], "random group", i);
+    }
+
+    return HostTest::Summary("BitPlanesTest");
+}
@@ -0,0 +1,74 @@
+// Pinscape Pico - CRC-32 engine benchmark
+// Copyright 2024, 2025 Michael J Roberts / BSD-3-Clause license / NO WARRANTY
+//
+// Measures the throughput of the CRC-32 software backend (slice-by-8)
+// against the byte-at-a-time table method and the bit-at-a-time method
+// that CRC::Calculate() uses with the bare CRC_32() parameters, at the
+// buffer sizes the firmware checks: short USB packets, directory
+// entries, config files, and firmware transfer blocks.  The figures are
+// for the host CPU, so only the ratios carry over to the Pico.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+#include "../CRC32Engine.h"
+#include "HostTest.h"
+
+// bit at a time
+static uint32_t BitwiseCRC(const uint8_t *p, size_t len, uint32_t crc = 0)
+{
+    crc = ~crc;
+    for ( ; len != 0 ; --len)
+    {
+        crc ^= *p++;
+        for (int i = 0 ; i < 8 ; ++i)
+            crc = (crc & 1) != 0 ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
+    }
+    return ~crc;
+}
+
+// byte at a time, with one 256-entry table
+static uint32_t table[256];
+static uint32_t BytewiseCRC(const uint8_t *p, size_t len, uint32_t crc = 0)
+{
+    crc = ~crc;
+    for ( ; len != 0 ; --len)
+        crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// keep the compiler from discarding the results
+static volatile uint32_t sink;
+
+int main()
+{
+    for (uint32_t i = 0 ; i < 256 ; ++i)
+    {
+        uint32_t c = i;
+        for (int j = 0 ; j < 8 ; ++j)
+            c = (c & 1) != 0 ? (c >> 1) ^ 0xEDB88320 : (c >> 1);
+        table[i] = c;
+    }
+
+    HostTest::Rand rand(1);
+    std::vector<uint8_t> buf(65536 + 1);
+    for (auto &b : buf)
+        b = static_cast<uint8_t>(rand.Next());
+
+    printf("%8s  %12s  %12s  %12s  %s\n", "bytes", "bitwise", "bytewise", "slice-by-8", "(MB/s)");
+    for (size_t len : { 16, 64, 256, 4096, 65536 })
+    {
+        // run about 4MB per timing run, from an odd address, to include
+        // the alignment prologue
+        int iters = static_cast<int>(std::max<size_t>(4 * 1024 * 1024 / len, 1));
+        const uint8_t *p = &buf[1];
+        double tBit = HostTest::BestTimeNs(3, std::max(iters / 16, 1), [p, len]() { sink = BitwiseCRC(p, len); });
+        double tByte = HostTest::BestTimeNs(5, iters, [p, len]() { sink = BytewiseCRC(p, len); });
+        double tSlice = HostTest::BestTimeNs(5, iters, [p, len]() { sink = CRC32Engine::CalcSoftware(p, len); });
+        auto MBs = [len](double ns) { return static_cast<double>(len) / ns * 1000.0; };
+        printf("%8zu  %12.1f  %12.1f  %12.1f\n", len, MBs(tBit), MBs(tByte), MBs(tSlice));
+    }
+    return 0;
+}
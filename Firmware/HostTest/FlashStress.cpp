@@ -0,0 +1,654 @@
+// Pinscape Pico - flash file system stress test and benchmark
+// Copyright 2024, 2025 Michael J Roberts / BSD-3-Clause license / NO WARRANTY
+//
+// Runs FlashStorage against the NOR flash emulator (NORFlash.cpp), with
+// randomized workloads modeled on the firmware's own use of the file
+// system: small settings structs written synchronously and in the
+// background, large configuration files, removals, and structs that grow
+// across firmware versions.
+//
+// Usage: flashstress [-bench] [-v]
+//
+// Test mode:
+//
+//  - Power failure injection.  Each trial reboots from the current flash
+//    image, runs one random operation with a power failure injected at a
+//    random flash operation within it, reboots again, and checks the
+//    result: the file system must mount; no file may read back as valid
+//    with contents that were never written; every file that wasn't being
+//    written must be intact; and the interrupted operation must succeed
+//    when retried.  Failures that interrupt a central directory update
+//    can legitimately lose the whole directory (Mount() reformats when an
+//    entry fails its integrity checks), so those are counted separately
+//    rather than checked.
+//
+//  - Fragmentation.  A long random workload over a wide set of file
+//    names and allocation sizes, which fills the central directory and
+//    forces rebuilds, with every file checked after every operation.
+//    Reports the allocation failures and the free space fragmentation.
+//
+// In both modes, every flash operation must obey the NOR program rule
+// (bits can only be programmed from 1 to 0) and the SDK's alignment
+// rules.
+//
+// Bench mode:
+//
+//  - Sector erases, page programs, and simulated flash busy time per
+//    commit, for each kind of write the firmware does.
+//
+//  - Mount() and OpenRead() latency at realistic directory sizes.  These
+//    are host CPU times, so only the scaling carries over to the Pico.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <memory>
+#include "../FlashStorage.h"
+#include "../Logger.h"
+#include "../CommandConsole.h"
+#include "../Watchdog.h"
+#include "../MultiCore.h"
+#include "NORFlash.h"
+#include "HostTest.h"
+
+// ---------------------------------------------------------------------------
+//
+// Firmware stubs
+//
+
+uint64_t time_us_64() { return HostTest::NowNs() / 1000; }
+
+static bool verbose = false;
+int Log(int type, const char *f, ...)
+{
+    if (verbose || type == LOG_ERROR)
+    {
+        va_list va;
+        va_start(va, f);
+        vprintf(f, va);
+        va_end(va);
+    }
+    return 0;
+}
+
+// the console commands are registered but never run
+void CommandConsole::AddCommand(const char*, const char*, const char*, ExecFunc*, void*) { }
+void ConsoleCommandContext::Print(const char*) const { }
+void ConsoleCommandContext::Printf(const char*, ...) const { }
+void ConsoleCommandContext::Usage() const { }
+const char *NumberFormatterBase::InsertCommas(char *str) { return str; }
+
+int FlashSafeExecute(std::function<void()> callback, uint32_t) { callback(); return PICO_OK; }
+WatchdogTemporaryExtender::WatchdogTemporaryExtender(int) { }
+WatchdogTemporaryExtender::~WatchdogTemporaryExtender() { }
+
+// ---------------------------------------------------------------------------
+//
+// Test access to the file system internals
+//
+
+class TestFS : public FlashStorage
+{
+public:
+    using FlashStorage::sectorsUsed;
+    using FlashStorage::minAllocOffset;
+    using FlashStorage::centralDirectorySize;
+    using FlashStorage::centralDirectory;
+    using FlashStorage::nextSequence;
+
+    // Count free sectors between the program image and the directory,
+    // and find the longest run of free sectors, which is the largest
+    // file that can still be created
+    void FreeSpace(int &nFree, int &longestRun) const
+    {
+        extern char __flash_binary_end;
+        uint32_t first = (reinterpret_cast<uintptr_t>(&__flash_binary_end) - XIP_BASE + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE;
+        uint32_t end = (PICO_FLASH_SIZE_BYTES - centralDirectorySize) / FLASH_SECTOR_SIZE;
+        nFree = longestRun = 0;
+        for (uint32_t s = first, run = 0 ; s < end ; ++s)
+        {
+            bool used = s >= minAllocOffset / FLASH_SECTOR_SIZE && sectorsUsed[s];
+            run = used ? 0 : run + 1;
+            nFree += used ? 0 : 1;
+            longestRun = std::max(longestRun, static_cast<int>(run));
+        }
+    }
+
+    // Count the sectors still held by replaced entries and deleted files.
+    // These only return to the free pool when a directory rebuild
+    // reclaims their entries.
+    int DeadSectors() const
+    {
+        int n = 0;
+        const DirectoryEntry *dir = centralDirectory;
+        for (uint32_t i = DirectoryEntry::SEQUENCE0 ; i < nextSequence ; ++i, ++dir)
+        {
+            if (dir->flashOffset != 0 && dir->flashOffset != 0xFFFFFFFF && (dir->IsReplaced() || dir->IsDeleted()))
+                n += dir->maxSize / FLASH_SECTOR_SIZE;
+        }
+        return n;
+    }
+};
+
+// boot: create a new file system object and mount the flash image
+static std::unique_ptr<TestFS> Boot(uint32_t dirSize = 4096)
+{
+    std::unique_ptr<TestFS> fs(new TestFS());
+    HT_CHECK(fs->Mount(dirSize), "mount failed");
+    return fs;
+}
+
+// ---------------------------------------------------------------------------
+//
+// Workload
+//
+
+// File operations.  The write types follow the firmware's usage:
+// Config::SaveStruct() (synchronous, exact size known), SaveStructAsync()
+// (background job), and configuration file uploads (synchronous, size
+// known, large reserve).  A write with an unknown size (curSize == 0)
+// forces the full-rewrite path instead of append.
+struct Op
+{
+    enum class Type { WriteSync, WriteUnsized, WriteAsync, Remove };
+    Type type;
+    std::string name;
+    std::vector<uint8_t> data;
+    uint32_t maxSize = 0;
+};
+
+// reference model of the file contents
+using Model = std::map<std::string, std::vector<uint8_t>>;
+
+// Generate a random operation.  In 'wide' mode, the names and sizes are
+// spread out to fill the directory and fragment the free space.
+static Op RandomOp(HostTest::Rand &rand, bool wide)
+{
+    Op op;
+    uint32_t r = rand.Range(100);
+    op.type = r < 50 ? Op::Type::WriteSync : r < 55 ? Op::Type::WriteUnsized : r < 85 ? Op::Type::WriteAsync : Op::Type::Remove;
+
+    char name[17];
+    size_t size;
+    if (wide)
+    {
+        // Many files, 1 to 8 sectors each.  The live files fit in the
+        // available space, but the allocation size changes from write to
+        // write, so files are often expanded into new directory entries.
+        snprintf(name, sizeof(name), "file%02u", rand.Range(60));
+        op.maxSize = (1 + rand.Range(8)) * FLASH_SECTOR_SIZE;
+        size = rand.Range(op.maxSize - 8);
+    }
+    else if (rand.Range(10) == 0)
+    {
+        // configuration file
+        snprintf(name, sizeof(name), "config%u.json", rand.Range(2));
+        op.maxSize = 128*1024;
+        size = 1024 + rand.Range(40*1024);
+    }
+    else
+    {
+        // Settings struct.  Structs occasionally grow in new firmware
+        // versions, which expands the allocation.
+        snprintf(name, sizeof(name), "struct%02u", rand.Range(20));
+        size = 8 + rand.Range(900);
+        op.maxSize = rand.Range(20) == 0 ? 2*FLASH_SECTOR_SIZE : FLASH_SECTOR_SIZE;
+    }
+    op.name = name;
+
+    if (op.type != Op::Type::Remove)
+    {
+        op.data.resize(size);
+        for (auto &b : op.data)
+            b = static_cast<uint8_t>(rand.Next());
+    }
+    return op;
+}
+
+// carry out an operation; returns true on success
+static bool Apply(TestFS &fs, const Op &op)
+{
+    switch (op.type)
+    {
+    case Op::Type::WriteSync:
+    case Op::Type::WriteUnsized:
+        {
+            int h = fs.OpenWrite(op.name.c_str(), op.type == Op::Type::WriteSync ? op.data.size() : 0, op.maxSize);
+            if (h < 0)
+                return false;
+            bool ok = fs.WriteFile(h, op.data.data(), op.data.size());
+            return fs.CloseWrite(h) && ok;
+        }
+
+    case Op::Type::WriteAsync:
+        if (!fs.QueueWrite(op.name.c_str(), op.data.data(), op.data.size(), op.maxSize))
+            return false;
+        while (fs.IsJobPending())
+            fs.Task();
+
+        // the job logs errors rather than returning them, so check the result
+        {
+            FlashStorage::FileInfo fi;
+            return fs.OpenRead(op.name.c_str(), fi) == FlashStorage::OpenStatus::OK
+                && fi.size == op.data.size() && memcmp(fi.data, op.data.data(), fi.size) == 0;
+        }
+
+    case Op::Type::Remove:
+        return fs.Remove(op.name.c_str(), true);
+    }
+    return false;
+}
+
+// update the model for a successful operation
+static void Commit(Model &model, const Op &op)
+{
+    if (op.type == Op::Type::Remove)
+        model.erase(op.name);
+    else
+        model[op.name] = op.data;
+}
+
+// read a file; returns true and fills in 'data' if it opens as valid
+static bool Read(TestFS &fs, const std::string &name, std::vector<uint8_t> &data)
+{
+    FlashStorage::FileInfo fi;
+    if (fs.OpenRead(name.c_str(), fi) != FlashStorage::OpenStatus::OK)
+        return false;
+    data.assign(fi.data, fi.data + fi.size);
+    return true;
+}
+
+// check that every file in the model reads back intact, and that
+// removed files are gone
+static int VerifyAll(TestFS &fs, const Model &model, const std::vector<std::string> &removed, const char *when)
+{
+    int nBad = 0;
+    std::vector<uint8_t> data;
+    for (auto &[name, contents] : model)
+    {
+        bool ok = Read(fs, name, data) && data == contents;
+        HT_CHECK(ok, "%s: \"%s\" doesn't read back", when, name.c_str());
+        nBad += ok ? 0 : 1;
+    }
+    for (auto &name : removed)
+    {
+        if (model.find(name) == model.end())
+            HT_CHECK(!Read(fs, name, data), "%s: removed file \"%s\" still readable", when, name.c_str());
+    }
+    return nBad;
+}
+
+// ---------------------------------------------------------------------------
+//
+// Power failure injection
+//
+
+static void PowerFailTest(int nTrials)
+{
+    norFlash.Reset();
+    auto fs = Boot();
+    Model model;
+    std::vector<std::string> removed;
+    HostTest::Rand rand(12345);
+
+    // Outcomes for the interrupted operation's file: the old contents,
+    // the new contents, or unreadable.  Directory failures are counted
+    // separately, along with the number of those that lost other files.
+    int nOld = 0, nNew = 0, nLost = 0, nDirFail = 0, nDirLoss = 0, nNoOps = 0;
+    std::vector<uint8_t> image, data;
+    for (int trial = 0 ; trial < nTrials ; ++trial)
+    {
+        Op op = RandomOp(rand, false);
+
+        // dry run, to count the flash operations in this operation
+        norFlash.Save(image);
+        fs = Boot();
+        uint64_t ops0 = norFlash.stats.nOps;
+        Apply(*fs, op);
+        uint64_t nOps = norFlash.stats.nOps - ops0;
+        norFlash.Restore(image);
+
+        // reboot, and run it again with a failure at a random operation
+        fs = Boot();
+        if (nOps == 0)
+        {
+            // no flash operations (e.g., removing a file that doesn't exist)
+            if (Apply(*fs, op))
+                Commit(model, op);
+            ++nNoOps;
+            continue;
+        }
+        norFlash.FailAfter(rand.Range(nOps), rand.Next());
+        NORFlash::PowerFail pf{ 0, false };
+        bool failed = false;
+        try
+        {
+            Apply(*fs, op);
+        }
+        catch (NORFlash::PowerFail &e)
+        {
+            pf = e;
+            failed = true;
+        }
+        norFlash.Disarm();
+        HT_CHECK(failed, "trial %d: power failure not triggered", trial);
+
+        // reboot
+        fs = Boot();
+        bool dirFail = pf.flashOffset >= PICO_FLASH_SIZE_BYTES - fs->centralDirectorySize;
+        nDirFail += dirFail ? 1 : 0;
+
+        // Check the interrupted operation's file.  If it reads as valid,
+        // it must have either the old or the new contents.
+        auto it = model.find(op.name);
+        bool hadOld = (it != model.end());
+        if (Read(*fs, op.name, data))
+        {
+            bool isOld = hadOld && data == it->second;
+            bool isNew = op.type != Op::Type::Remove && data == op.data;
+            HT_CHECK(isOld || isNew, "trial %d: \"%s\" reads as valid with contents never written", trial, op.name.c_str());
+            nOld += isOld ? 1 : 0;
+            nNew += isNew && !isOld ? 1 : 0;
+        }
+        else if (op.type != Op::Type::Remove || !hadOld)
+            ++nLost;
+
+        // Check the other files.  After a directory failure, any file
+        // that still reads as valid must have its last contents.
+        bool lostOther = false;
+        for (auto mi = model.begin() ; mi != model.end() ; )
+        {
+            if (mi->first == op.name)
+            {
+                ++mi;
+                continue;
+            }
+            bool ok = Read(*fs, mi->first, data);
+            if (dirFail && !ok)
+            {
+                lostOther = true;
+                mi = model.erase(mi);
+                continue;
+            }
+            HT_CHECK(ok && data == mi->second, "trial %d: \"%s\" damaged by power failure %s at %08x during %s of \"%s\"",
+                trial, mi->first.c_str(), pf.erase ? "erasing" : "programming", pf.flashOffset,
+                op.type == Op::Type::Remove ? "removal" : "write", op.name.c_str());
+            ++mi;
+        }
+        nDirLoss += lostOther ? 1 : 0;
+
+        // retry the operation; it must succeed
+        HT_CHECK(Apply(*fs, op), "trial %d: retry of \"%s\" after power failure failed", trial, op.name.c_str());
+        Commit(model, op);
+        if (op.type == Op::Type::Remove)
+            removed.push_back(op.name);
+
+        // everything must read back after another reboot
+        fs = Boot();
+        VerifyAll(*fs, model, removed, "after power failure recovery");
+    }
+
+    HT_CHECK(norFlash.stats.nRuleViolations == 0, "%llu NOR program rule violations", static_cast<unsigned long long>(norFlash.stats.nRuleViolations));
+    HT_CHECK(norFlash.stats.nAlignmentErrors == 0, "%llu misaligned flash operations", static_cast<unsigned long long>(norFlash.stats.nAlignmentErrors));
+    printf("power failure: %d trials (%d with no flash operations); interrupted file: %d old contents, %d new contents, %d unreadable\n",
+        nTrials, nNoOps, nOld, nNew, nLost);
+    printf("power failure: %d during directory updates, %d of which lost other files (directory reformatted)\n",
+        nDirFail, nDirLoss);
+}
+
+// ---------------------------------------------------------------------------
+//
+// Fragmentation
+//
+
+static void FragmentationTest(int nOps)
+{
+    norFlash.Reset();
+    auto fs = Boot();
+    Model model;
+    std::vector<std::string> removed;
+    HostTest::Rand rand(777);
+    std::vector<uint8_t> data;
+
+    int nAllocFail = 0, firstFail = -1;
+    for (int i = 0 ; i < nOps ; ++i)
+    {
+        // reboot every so often, to exercise the mount-time space accounting
+        if (i % 100 == 99)
+            fs = Boot();
+
+        Op op = RandomOp(rand, true);
+        if (Apply(*fs, op))
+        {
+            Commit(model, op);
+            if (op.type == Op::Type::Remove)
+                removed.push_back(op.name);
+        }
+        else
+        {
+            // A write can fail for lack of space or directory entries.
+            // The file must then read back with its old contents, or not
+            // at all.
+            if (nAllocFail++ == 0)
+                firstFail = i;
+            auto it = model.find(op.name);
+            bool ok = Read(*fs, op.name, data);
+            HT_CHECK(!ok || (it != model.end() && data == it->second), "op %d: failed write of \"%s\" changed its contents", i, op.name.c_str());
+            if (!ok && it != model.end())
+            {
+                model.erase(it);
+                removed.push_back(op.name);
+            }
+        }
+        VerifyAll(*fs, model, removed, "fragmentation");
+    }
+
+    size_t liveBytes = 0;
+    for (auto &[name, contents] : model)
+        liveBytes += contents.size();
+    int nFree, longestRun;
+    fs->FreeSpace(nFree, longestRun);
+    HT_CHECK(norFlash.stats.nRuleViolations == 0, "%llu NOR program rule violations", static_cast<unsigned long long>(norFlash.stats.nRuleViolations));
+    HT_CHECK(norFlash.stats.nAlignmentErrors == 0, "%llu misaligned flash operations", static_cast<unsigned long long>(norFlash.stats.nAlignmentErrors));
+    uint32_t hottest = *std::max_element(norFlash.sectorErases.begin(), norFlash.sectorErases.end());
+    printf("fragmentation: %d operations, %d failed writes (first at operation %d); %zu files, %zu bytes live; "
+        "%d sectors free, longest free run %d sectors; %d sectors held by replaced or deleted entries; "
+        "%llu sector erases, %u on the hottest sector\n",
+        nOps, nAllocFail, firstFail, model.size(), liveBytes, nFree, longestRun, fs->DeadSectors(),
+        static_cast<unsigned long long>(norFlash.stats.nSectorsErased), hottest);
+}
+
+// Directory rebuild.  Creating and removing files until the directory runs
+// out of entries forces a rebuild, which must keep the live files and
+// rewrite each directory sector at most once.
+static void RebuildTest(int nFiles)
+{
+    norFlash.Reset();
+    auto fs = Boot();
+    Model model;
+    std::vector<std::string> removed;
+    std::vector<uint8_t> data;
+
+    Op keep{ Op::Type::WriteSync, "keep", std::vector<uint8_t>(1000, 0xA5), FLASH_SECTOR_SIZE };
+    HT_CHECK(Apply(*fs, keep), "creating \"keep\"");
+    Commit(model, keep);
+
+    uint32_t dirSector = (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE) / FLASH_SECTOR_SIZE;
+    uint32_t dirErases0 = norFlash.sectorErases[dirSector];
+    int nRebuilds = 0;
+    uint32_t maxErasesPerRebuild = 0;
+    for (int i = 0 ; i < nFiles ; ++i)
+    {
+        char name[16];
+        snprintf(name, sizeof(name), "tmp%u", i);
+        Op op{ Op::Type::WriteSync, name, std::vector<uint8_t>(100, static_cast<uint8_t>(i)), FLASH_SECTOR_SIZE };
+
+        uint32_t before = norFlash.sectorErases[dirSector];
+        HT_CHECK(Apply(*fs, op), "creating \"%s\"", name);
+        uint32_t n = norFlash.sectorErases[dirSector] - before;
+        if (n != 0)
+        {
+            ++nRebuilds;
+            maxErasesPerRebuild = std::max(maxErasesPerRebuild, n);
+        }
+
+        op.type = Op::Type::Remove;
+        HT_CHECK(Apply(*fs, op), "removing \"%s\"", name);
+        removed.push_back(name);
+    }
+
+    fs = Boot();
+    VerifyAll(*fs, model, removed, "rebuild");
+    HT_CHECK(nRebuilds != 0, "no directory rebuilds in %d files", nFiles);
+    HT_CHECK(maxErasesPerRebuild <= 1, "directory sector erased %u times in one rebuild", maxErasesPerRebuild);
+    printf("rebuild: %d files created and removed; %d rebuilds, %u directory sector erases\n",
+        nFiles, nRebuilds, norFlash.sectorErases[dirSector] - dirErases0);
+}
+
+// ---------------------------------------------------------------------------
+//
+// Benchmarks
+//
+
+// erase and program counts per commit, for each kind of write
+static void CommitCostBench()
+{
+    struct Case
+    {
+        const char *desc;
+        Op::Type type;
+        const char *name;
+        size_t size;
+        uint32_t maxSize;
+    };
+    static const Case cases[] = {
+        { "struct 64B, sync", Op::Type::WriteSync, "struct", 64, FLASH_SECTOR_SIZE },
+        { "struct 64B, background", Op::Type::WriteAsync, "struct", 64, FLASH_SECTOR_SIZE },
+        { "struct 600B, sync", Op::Type::WriteSync, "struct", 600, FLASH_SECTOR_SIZE },
+        { "struct 600B, unsized", Op::Type::WriteUnsized, "struct", 600, FLASH_SECTOR_SIZE },
+        { "config 24KB, sync", Op::Type::WriteSync, "config.json", 24*1024, 128*1024 },
+        { "config 24KB, background", Op::Type::WriteAsync, "config.json", 24*1024, 128*1024 },
+    };
+
+    printf("%-26s  %12s  %12s  %12s  %14s\n", "commit", "erases", "pages", "busy ms", "hottest sector");
+    HostTest::Rand rand(99);
+    for (auto &c : cases)
+    {
+        // commit the same file repeatedly, alongside a few other files
+        norFlash.Reset();
+        auto fs = Boot();
+        for (int i = 0 ; i < 8 ; ++i)
+        {
+            Op other{ Op::Type::WriteSync, "other" + std::to_string(i), std::vector<uint8_t>(200, static_cast<uint8_t>(i)), FLASH_SECTOR_SIZE };
+            Apply(*fs, other);
+        }
+
+        const int nCommits = 200;
+        Op op{ c.type, c.name, std::vector<uint8_t>(c.size), c.maxSize };
+        auto stats0 = norFlash.stats;
+        std::vector<uint32_t> erases0 = norFlash.sectorErases;
+        for (int i = 0 ; i < nCommits ; ++i)
+        {
+            for (auto &b : op.data)
+                b = static_cast<uint8_t>(rand.Next());
+            HT_CHECK(Apply(*fs, op), "%s: commit %d failed", c.desc, i);
+        }
+
+        // find the most-erased sector over the run
+        uint32_t hottest = 0;
+        for (size_t s = 0 ; s < erases0.size() ; ++s)
+            hottest = std::max(hottest, norFlash.sectorErases[s] - erases0[s]);
+
+        auto &st = norFlash.stats;
+        printf("%-26s  %12.2f  %12.2f  %12.1f  %8.2f/commit\n", c.desc,
+            static_cast<double>(st.nSectorsErased - stats0.nSectorsErased) / nCommits,
+            static_cast<double>(st.nPagesProgrammed - stats0.nPagesProgrammed) / nCommits,
+            static_cast<double>(st.busyTime_us - stats0.busyTime_us) / nCommits / 1000.0,
+            static_cast<double>(hottest) / nCommits);
+    }
+}
+
+// Mount() and OpenRead() latency, by directory size and file count
+static void LatencyBench()
+{
+    printf("\n%-10s  %6s  %12s  %16s  %16s  %16s\n", "directory", "files", "Mount us", "OpenRead us", "no CRC us", "config CRC us");
+    for (uint32_t dirSectors : { 1, 2, 4 })
+    {
+        uint32_t dirSize = dirSectors * FLASH_SECTOR_SIZE;
+        for (int nFiles : { 8, 32, 120, 300 })
+        {
+            // the directory holds the "/" entry, the config file, and the structs
+            if (nFiles + 2 > static_cast<int>(dirSize / 32))
+                continue;
+
+            norFlash.Reset();
+            auto fs = Boot(dirSize);
+            std::vector<uint8_t> config(32*1024, 0x5A);
+            Op op{ Op::Type::WriteSync, "config.json", config, 128*1024 };
+            Apply(*fs, op);
+            std::string last;
+            for (int i = 0 ; i < nFiles ; ++i)
+            {
+                last = "struct" + std::to_string(i);
+                Op s{ Op::Type::WriteSync, last, std::vector<uint8_t>(256, static_cast<uint8_t>(i)), FLASH_SECTOR_SIZE };
+                HT_CHECK(Apply(*fs, s), "creating %s", last.c_str());
+            }
+
+            // time the mount with a fresh object each time, as at boot
+            std::vector<std::unique_ptr<TestFS>> objs;
+            for (int i = 0 ; i < 220 ; ++i)
+            {
+                objs.emplace_back(new TestFS());
+                objs.back()->Initialize();
+            }
+            size_t next = 0;
+            double tMount = HostTest::BestTimeNs(10, 20, [&]() { objs[next++]->Mount(dirSize); });
+
+            // time opening the last file (the longest directory search)
+            FlashStorage::FileInfo fi;
+            double tOpen = HostTest::BestTimeNs(5, 200, [&]() { fs->OpenRead(last.c_str(), fi); });
+            double tOpenNoCRC = HostTest::BestTimeNs(5, 200, [&]() { fs->OpenRead(last.c_str(), fi, false); });
+            double tConfig = HostTest::BestTimeNs(5, 50, [&]() { fs->OpenRead("config.json", fi); });
+
+            char dirDesc[32];
+            snprintf(dirDesc, sizeof(dirDesc), "%u sector%s", dirSectors, dirSectors == 1 ? "" : "s");
+            printf("%-10s  %6d  %12.2f  %16.2f  %16.2f  %16.2f\n", dirDesc, nFiles,
+                tMount / 1000.0, tOpen / 1000.0, tOpenNoCRC / 1000.0, tConfig / 1000.0);
+        }
+    }
+    printf("(host CPU times; the Pico reads flash through the XIP cache, so only the scaling carries over)\n");
+}
+
+int main(int argc, char **argv)
+{
+    bool bench = false;
+    for (int i = 1 ; i < argc ; ++i)
+    {
+        if (strcmp(argv[i], "-bench") == 0)
+            bench = true;
+        else if (strcmp(argv[i], "-v") == 0)
+            verbose = true;
+    }
+
+    if (!norFlash.Init())
+        return 1;
+
+    if (bench)
+    {
+        CommitCostBench();
+        LatencyBench();
+    }
+    else
+    {
+        PowerFailTest(2000);
+        FragmentationTest(3000);
+        RebuildTest(400);
+    }
+
+    return HostTest::Summary("FlashStress");
+}
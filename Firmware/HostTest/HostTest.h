@@ -0,0 +1,74 @@
+// Pinscape Pico - host-side test and benchmark helpers
+// Copyright 2024, 2025 Michael J Roberts / BSD-3-Clause license / NO WARRANTY
+//
+// Minimal support code shared by the Linux host test programs in this
+// directory.  The tests are plain programs that print their results and
+// exit with status 0 on success, 1 on failure, so that they can be run
+// from the Makefile without any test framework.
+
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+namespace HostTest
+{
+    // failure count for the current program
+    inline int failures = 0;
+    inline int checks = 0;
+
+    // Check a condition, logging a failure message if it's false
+    #define HT_CHECK(cond, ...) \
+        do { \
+            ++HostTest::checks; \
+            if (!(cond)) { \
+                ++HostTest::failures; \
+                printf("FAILED: %s:%d: %s: ", __FILE__, __LINE__, #cond); \
+                printf(__VA_ARGS__); \
+                printf("\n"); \
+            } \
+        } while (0)
+
+    // Print the summary, and return the program exit status
+    inline int Summary(const char *name)
+    {
+        printf("%s: %d checks, %d failures\n", name, checks, failures);
+        return failures == 0 ? 0 : 1;
+    }
+
+    // high-resolution monotonic time, in nanoseconds
+    inline uint64_t NowNs()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+    }
+
+    // Run a function repeatedly, and return the best time per call in
+    // nanoseconds.  Taking the best of several runs filters out timer
+    // interrupts and other scheduling noise.
+    template<typename F> double BestTimeNs(int runs, int itersPerRun, F func)
+    {
+        double best = 1e30;
+        for (int r = 0 ; r < runs ; ++r)
+        {
+            uint64_t t0 = NowNs();
+            for (int i = 0 ; i < itersPerRun ; ++i)
+                func();
+            double t = static_cast<double>(NowNs() - t0) / itersPerRun;
+            if (t < best)
+                best = t;
+        }
+        return best;
+    }
+
+    // simple deterministic pseudo-random number generator (xorshift32),
+    // so that randomized tests are repeatable from a seed
+    struct Rand
+    {
+        Rand(uint32_t seed) : s(seed != 0 ? seed : 1) { }
+        uint32_t Next() { s ^= s << 13; s ^= s >> 17; s ^= s << 5; return s; }
+        uint32_t Range(uint32_t n) { return Next() % n; }
+        uint32_t s;
+    };
+}
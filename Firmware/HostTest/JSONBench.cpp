@@ -0,0 +1,215 @@
+// Pinscape Pico - JSON parser benchmark
+// Copyright 2024, 2025 Michael J Roberts / BSD-3-Clause license / NO WARRANTY
+//
+// Compares the JSON parser's heap and arena allocation modes on large
+// config files: parse time, peak memory, and heap fragmentation after
+// the parse tree is discarded.  The Makefile builds this program twice,
+// once in each mode (JSON_ARENA_ALLOCATOR defined or not), since the
+// mode is a compile-time option of the parser.
+//
+// Usage: jsonbench_heap|jsonbench_arena [file.json ...]
+//
+// With no arguments, the benchmark generates synthetic configs modeled
+// on a large Pinscape setup (hundreds of output ports and buttons, with
+// nested device objects, comments, and escaped strings).
+//
+// Fragmentation is measured the way the firmware uses the parser: parse
+// the config, allocate a batch of long-lived "run-time" objects while
+// the tree is still alive (as the subsystems do during configuration),
+// then delete the tree.  The free space left behind below the top of
+// the heap, split into however many free chunks, is space that the
+// run-time objects have pinned in place.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <malloc.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include "../JSON.h"
+#include "HostTest.h"
+
+#ifdef JSON_ARENA_ALLOCATOR
+static const char *modeName = "arena";
+#else
+static const char *modeName = "heap";
+#endif
+
+// ---------------------------------------------------------------------------
+//
+// Allocation tracking.  We interpose malloc and friends, forwarding to
+// the glibc implementations, to track the bytes currently allocated and
+// the peak.  This captures everything, including the C++ library's
+// allocations for the heap-mode containers.
+//
+extern "C" {
+    void *__libc_malloc(size_t);
+    void *__libc_calloc(size_t, size_t);
+    void *__libc_realloc(void*, size_t);
+    void __libc_free(void*);
+}
+
+static size_t curBytes = 0;
+static size_t peakBytes = 0;
+static size_t nAllocs = 0;
+
+static void Track(void *p)
+{
+    if (p != nullptr)
+    {
+        curBytes += malloc_usable_size(p);
+        if (curBytes > peakBytes)
+            peakBytes = curBytes;
+        ++nAllocs;
+    }
+}
+
+extern "C" void *malloc(size_t n)
+{
+    void *p = __libc_malloc(n);
+    Track(p);
+    return p;
+}
+
+extern "C" void *calloc(size_t n, size_t size)
+{
+    void *p = __libc_calloc(n, size);
+    Track(p);
+    return p;
+}
+
+extern "C" void *realloc(void *old, size_t n)
+{
+    if (old != nullptr)
+        curBytes -= malloc_usable_size(old);
+    void *p = __libc_realloc(old, n);
+    Track(p);
+    return p;
+}
+
+extern "C" void free(void *p)
+{
+    if (p != nullptr)
+        curBytes -= malloc_usable_size(p);
+    __libc_free(p);
+}
+
+// ---------------------------------------------------------------------------
+//
+// Synthetic config generator
+//
+static std::string MakeConfig(int nOutputs, int nButtons)
+{
+    std::string s;
+    char buf[512];
+    s += "// synthetic Pinscape Pico configuration for benchmarking\n{\n";
+    s += "  id: { unitNum: 1, unitName: \"Bench\\u00e9 \\\"Pinscape\\\"\", ledWizUnitNum: 1 },\n";
+    s += "  logging: { filter: \"error warning info config\", bufSize: 8192 },\n";
+    s += "  tlc59116: [\n";
+    for (int i = 0 ; i < 8 ; ++i)
+    {
+        snprintf(buf, sizeof(buf), "    { i2c: 0, addr: 0x%02x, reset: 7 },\n", 0x60 + i);
+        s += buf;
+    }
+    s += "  ],\n  outputs: [\n";
+    for (int i = 0 ; i < nOutputs ; ++i)
+    {
+        snprintf(buf, sizeof(buf),
+            "    /* port %d */ { name: \"Output %d\\tport\", device: { type: \"tlc59116\", chip: %d, port: %d }, "
+            "gamma: %s, noisy: %s, timeLimit: %d, powerLimit: %d, coolingTime: %d, source: \"and(blink(250,250), self)\" },\n",
+            i + 1, i + 1, (i / 16) % 8, i % 16, i % 3 == 0 ? "true" : "false", i % 5 == 0 ? "true" : "false",
+            (i % 7) * 100, (i * 13) % 256, (i % 4) * 250);
+        s += buf;
+    }
+    s += "  ],\n  buttons: [\n";
+    for (int i = 0 ; i < nButtons ; ++i)
+    {
+        snprintf(buf, sizeof(buf),
+            "    { name: \"Button %d\", source: { type: \"gpio\", gp: %d, pull: true, debounceTimeOn: 1500, lowPassFilterRiseTime: 0.25 }, "
+            "action: { type: \"key\", key: \"%c\" }, shift: [ 1, 2, 3 ], ir: [ \"03.01.0001\", \"03.01.0002\" ] },\n",
+            i + 1, i % 29, 'a' + (i % 26));
+        s += buf;
+    }
+    s += "  ],\n}\n";
+    return s;
+}
+
+// ---------------------------------------------------------------------------
+//
+// Benchmark one config text
+//
+static void Bench(const char *label, const std::string &text)
+{
+    // time the parse, best of several runs
+    double ns = HostTest::BestTimeNs(5, 4, [&text]() {
+        JSONParser json;
+        json.Parse(text.data(), text.size());
+    });
+
+    // measure memory for a single parse
+    size_t base = curBytes;
+    peakBytes = curBytes;
+    size_t allocs0 = nAllocs;
+    auto *json = new JSONParser();
+    json->Parse(text.data(), text.size());
+    size_t treeBytes = curBytes - base;
+    size_t peak = peakBytes - base;
+    size_t nTreeAllocs = nAllocs - allocs0;
+    size_t nErrors = json->errors.size();
+
+    // allocate the long-lived "run-time" objects while the tree is alive
+    HostTest::Rand rand(12345);
+    std::vector<void*> runtime;
+    for (int i = 0 ; i < 2000 ; ++i)
+        runtime.push_back(::malloc(16 + rand.Range(240)));
+
+    // discard the tree, and measure the free space it left behind
+    delete json;
+    struct mallinfo2 mi = mallinfo2();
+    size_t trapped = mi.fordblks - mi.keepcost;
+
+    printf("%-6s %-22s %8zu bytes  parse %9.1f us  tree %8zu bytes in %6zu allocs  peak %8zu  "
+        "after free: %6zu free chunks, %8zu bytes trapped  (%zu errors)\n",
+        modeName, label, text.size(), ns / 1000.0, treeBytes, nTreeAllocs, peak,
+        static_cast<size_t>(mi.ordblks), trapped, nErrors);
+
+    for (auto *p : runtime)
+        ::free(p);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        // benchmark the named files
+        for (int i = 1 ; i < argc ; ++i)
+        {
+            FILE *fp = fopen(argv[i], "rb");
+            if (fp == nullptr)
+            {
+                printf("%s: unable to open file\n", argv[i]);
+                return 1;
+            }
+            std::string text;
+            char buf[4096];
+            for (size_t n ; (n = fread(buf, 1, sizeof(buf), fp)) != 0 ; )
+                text.append(buf, n);
+            fclose(fp);
+            Bench(argv[i], text);
+        }
+    }
+    else
+    {
+        // synthetic configs of increasing size
+        static const struct { const char *label; int nOutputs; int nButtons; } cases[] = {
+            { "synthetic-small", 32, 32 },
+            { "synthetic-medium", 128, 96 },
+            { "synthetic-large", 512, 256 },
+        };
+        for (auto &c : cases)
+            Bench(c.label, MakeConfig(c.nOutputs, c.nButtons));
+    }
+    return 0;
+}
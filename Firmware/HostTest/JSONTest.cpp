@@ -0,0 +1,131 @@
+// Pinscape Pico - JSON parser arena mode tests
+// Copyright 2024, 2025 Michael J Roberts / BSD-3-Clause license / NO WARRANTY
+//
+// Checks that the arena-mode parser (the firmware configuration) builds
+// the same tree as heap mode, and that it fails cleanly when an arena
+// block allocation fails: no crash, an "out of memory" error, and an
+// undefined root value.  Built with JSON_ARENA_ALLOCATOR defined.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <new>
+#include <string>
+#include "../JSON.h"
+#include "HostTest.h"
+
+#ifndef JSON_ARENA_ALLOCATOR
+#error This test must be built with JSON_ARENA_ALLOCATOR defined
+#endif
+
+// ---------------------------------------------------------------------------
+//
+// Allocation failure injection.  We interpose malloc, and fail the Nth
+// allocation of arena block size or larger, which targets the arena's
+// block allocations.  Other allocations that happen to be that large
+// (vector growth in the parser's scratch stacks) will throw bad_alloc
+// from operator new; the test simply skips those cases, since they're
+// outside the arena's error handling.
+//
+extern "C" void *__libc_malloc(size_t);
+
+static int failCountdown = -1;
+
+extern "C" void *malloc(size_t n)
+{
+    if (n >= 4096 && failCountdown >= 0 && failCountdown-- == 0)
+        return nullptr;
+    return __libc_malloc(n);
+}
+
+static const char *testConfig = R"(
+// test config
+{
+    id: { unitNum: 1, unitName: "Test \"unit\"" },
+    outputs: [
+        { name: "one", device: { type: "gpio", gp: 5 }, gamma: true },
+        { name: "two\ttab", device: { type: "virtual" }, powerLimit: 128 },
+        [ 1, 2, [ 3, 4, [ ] ], { } ],
+    ],
+    numbers: [ 0x10, -5, 2.5, 1e3 ],
+}
+)";
+
+// make a big config, so that the parse spans many arena blocks
+static std::string MakeBigConfig()
+{
+    std::string s = "{ outputs: [\n";
+    char buf[256];
+    for (int i = 0 ; i < 400 ; ++i)
+    {
+        snprintf(buf, sizeof(buf), "{ name: \"port\\t%d\", device: { type: \"tlc59116\", chip: %d, port: %d }, list: [ %d, %d, \"x\\ny\" ] },\n",
+            i, i / 16, i % 16, i, i * 2);
+        s += buf;
+    }
+    s += "] }\n";
+    return s;
+}
+
+int main()
+{
+    // basic tree checks
+    {
+        JSONParser json;
+        json.Parse(testConfig, strlen(testConfig));
+        HT_CHECK(json.errors.size() == 0, "%zu errors", json.errors.size());
+        HT_CHECK(json.Get("id.unitNum")->Int(0) == 1, "unitNum");
+        HT_CHECK(json.Get("id.unitName")->String() == "Test \"unit\"", "unitName");
+        HT_CHECK(json.Get("outputs")->Length() == 3, "outputs length");
+        HT_CHECK(json.Get("outputs.0.device.gp")->Int(0) == 5, "outputs[0].device.gp");
+        HT_CHECK(json.Get("outputs.1.name")->String() == "two\ttab", "escaped string");
+        HT_CHECK(json.Get("outputs.2.2.2")->Length(99) == 0, "empty nested array");
+        HT_CHECK(json.Get("outputs.2.3")->IsObject(), "empty object");
+        HT_CHECK(json.Get("numbers.0")->Int(0) == 16, "hex number");
+        HT_CHECK(json.Get("numbers.3")->Int(0) == 1000, "exponent");
+    }
+
+    // allocation failure at each arena block in turn
+    std::string big = MakeBigConfig();
+    int nFailed = 0, nSkipped = 0;
+    for (int n = 0 ; ; ++n)
+    {
+        failCountdown = n;
+        bool completed = false;
+        try
+        {
+            JSONParser json;
+            json.Parse(big.data(), big.size());
+            completed = (failCountdown >= 0);
+            failCountdown = -1;
+
+            if (completed)
+            {
+                // the failure point is past the last block, so the parse succeeded
+                HT_CHECK(json.errors.size() == 0, "%zu errors with no failure", json.errors.size());
+                HT_CHECK(json.Get("outputs")->Length() == 400, "outputs length");
+            }
+            else
+            {
+                // the parse must report exactly one out-of-memory error and no tree
+                ++nFailed;
+                HT_CHECK(json.errors.size() == 1 && json.errors.front().message.find("Out of memory") != std::string::npos,
+                    "failure at block %d: %zu errors, first '%s'", n, json.errors.size(),
+                    json.errors.size() != 0 ? json.errors.front().message.c_str() : "");
+                HT_CHECK(json.rootValue.IsUndefined(), "failure at block %d: root value not undefined", n);
+            }
+        }
+        catch (std::bad_alloc&)
+        {
+            failCountdown = -1;
+            ++nSkipped;
+        }
+
+        if (completed)
+            break;
+    }
+    printf("allocation failure injection: %d arena failures tested, %d non-arena failures skipped\n", nFailed, nSkipped);
+    HT_CHECK(nFailed > 1, "expected failures at several blocks");
+
+    return HostTest::Summary("JSONTest");
+}
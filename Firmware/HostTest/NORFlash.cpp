@@ -0,0 +1,233 @@
+// Pinscape Pico - host-side NOR flash emulator
+// Copyright 2024, 2025 Michael J Roberts / BSD-3-Clause license / NO WARRANTY
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <hardware/flash.h>
+#include "NORFlash.h"
+
+// global singleton
+NORFlash norFlash;
+
+// flash contents, as seen through the XIP mapping
+static uint8_t *const flashBase = reinterpret_cast<uint8_t*>(XIP_BASE);
+
+// Fault handler for stray writes into the read-only flash mapping.  The
+// firmware must only change flash through the SDK functions, so a direct
+// store is a bug; report it before dying.
+static void FlashFaultHandler(int sig, siginfo_t *info, void*)
+{
+    uintptr_t addr = reinterpret_cast<uintptr_t>(info->si_addr);
+    if (addr >= XIP_BASE && addr < XIP_BASE + PICO_FLASH_SIZE_BYTES)
+    {
+        static const char msg[] = "NORFlash: direct write to flash through an XIP pointer\n";
+        write(2, msg, sizeof(msg) - 1);
+    }
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+bool NORFlash::Init()
+{
+    if (!mapped)
+    {
+        // map the flash at the XIP base address
+        void *p = mmap(flashBase, PICO_FLASH_SIZE_BYTES, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+        if (p != flashBase)
+        {
+            fprintf(stderr, "NORFlash: unable to map the flash at XIP_BASE (%08lx)\n", static_cast<unsigned long>(XIP_BASE));
+            if (p != MAP_FAILED)
+                munmap(p, PICO_FLASH_SIZE_BYTES);
+            return false;
+        }
+        mapped = true;
+
+        // install the stray write handler
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = FlashFaultHandler;
+        sa.sa_flags = SA_SIGINFO;
+        sigaction(SIGSEGV, &sa, nullptr);
+    }
+
+    Reset();
+    return true;
+}
+
+void NORFlash::Reset()
+{
+    Unlock();
+    memset(flashBase, 0xFF, PICO_FLASH_SIZE_BYTES);
+    Lock();
+    stats = Stats();
+    sectorErases.assign(PICO_FLASH_SIZE_BYTES / FLASH_SECTOR_SIZE, 0);
+    failArmed = false;
+}
+
+void NORFlash::Save(std::vector<uint8_t> &buf) const
+{
+    buf.assign(flashBase, flashBase + PICO_FLASH_SIZE_BYTES);
+}
+
+void NORFlash::Restore(const std::vector<uint8_t> &buf)
+{
+    Unlock();
+    memcpy(flashBase, buf.data(), PICO_FLASH_SIZE_BYTES);
+    Lock();
+}
+
+void NORFlash::Unlock()
+{
+    mprotect(flashBase, PICO_FLASH_SIZE_BYTES, PROT_READ | PROT_WRITE);
+}
+
+void NORFlash::Lock()
+{
+    mprotect(flashBase, PICO_FLASH_SIZE_BYTES, PROT_READ);
+}
+
+void NORFlash::FailAfter(uint64_t n, uint32_t seed)
+{
+    failArmed = true;
+    failCountdown = n;
+    failRand = seed != 0 ? seed : 1;
+}
+
+bool NORFlash::CheckFail()
+{
+    if (!failArmed)
+        return false;
+    if (failCountdown-- != 0)
+        return false;
+    failArmed = false;
+    return true;
+}
+
+void NORFlash::Program(uint32_t ofs, const uint8_t *data, size_t count)
+{
+    // the SDK requires page alignment for the offset and size
+    stats.nOps += 1;
+    if ((ofs % FLASH_PAGE_SIZE) != 0 || (count % FLASH_PAGE_SIZE) != 0 || ofs > PICO_FLASH_SIZE_BYTES || count > PICO_FLASH_SIZE_BYTES - ofs)
+    {
+        fprintf(stderr, "NORFlash: misaligned or out-of-range program, offset %08x, %zu bytes\n", ofs, count);
+        stats.nAlignmentErrors += 1;
+        return;
+    }
+
+    // If this operation is the power failure point, pick the page where
+    // it stops.  The pages before it are fully programmed; in the failed
+    // page, each bit that was being programmed from 1 to 0 randomly ends
+    // up in either state.
+    bool fail = CheckFail();
+    size_t nPages = count / FLASH_PAGE_SIZE;
+    size_t failPage = fail ? NextRand() % nPages : nPages;
+
+    Unlock();
+    bool violation = false;
+    for (size_t page = 0 ; page < nPages && page <= failPage ; ++page)
+    {
+        uint8_t *dst = flashBase + ofs + page*FLASH_PAGE_SIZE;
+        const uint8_t *src = data + page*FLASH_PAGE_SIZE;
+        for (size_t i = 0 ; i < FLASH_PAGE_SIZE ; ++i)
+        {
+            // Programming can only clear bits.  Writing 0xFF leaves the
+            // byte unchanged, which the file system relies on to update
+            // part of a page, so only a byte with some 0 bits that can't
+            // be stored as written counts as a violation.
+            if (src[i] != 0xFF && (dst[i] & src[i]) != src[i])
+                violation = true;
+
+            uint8_t newVal = dst[i] & src[i];
+            if (page == failPage)
+                newVal |= (dst[i] & ~src[i]) & static_cast<uint8_t>(NextRand());
+            dst[i] = newVal;
+        }
+
+        stats.nPagesProgrammed += 1;
+        stats.busyTime_us += PAGE_PROGRAM_TIME_US;
+    }
+    Lock();
+
+    if (violation)
+    {
+        fprintf(stderr, "NORFlash: program at %08x tries to set programmed (0) bits to 1\n", ofs);
+        stats.nRuleViolations += 1;
+    }
+
+    if (fail)
+        throw PowerFail{ static_cast<uint32_t>(ofs + failPage*FLASH_PAGE_SIZE), false };
+}
+
+void NORFlash::Erase(uint32_t ofs, size_t count)
+{
+    // the SDK requires sector alignment for the offset and size
+    stats.nOps += 1;
+    if ((ofs % FLASH_SECTOR_SIZE) != 0 || (count % FLASH_SECTOR_SIZE) != 0 || ofs > PICO_FLASH_SIZE_BYTES || count > PICO_FLASH_SIZE_BYTES - ofs)
+    {
+        fprintf(stderr, "NORFlash: misaligned or out-of-range erase, offset %08x, %zu bytes\n", ofs, count);
+        stats.nAlignmentErrors += 1;
+        return;
+    }
+
+    // If this operation is the power failure point, pick the sector where
+    // it stops.  The sectors before it are fully erased; in the failed
+    // sector, each programmed bit randomly ends up either erased or not.
+    bool fail = CheckFail();
+    size_t nSectors = count / FLASH_SECTOR_SIZE;
+    size_t failSector = fail ? NextRand() % nSectors : nSectors;
+
+    Unlock();
+    for (size_t sector = 0 ; sector < nSectors && sector <= failSector ; ++sector)
+    {
+        uint8_t *dst = flashBase + ofs + sector*FLASH_SECTOR_SIZE;
+        if (sector == failSector)
+        {
+            for (size_t i = 0 ; i < FLASH_SECTOR_SIZE ; ++i)
+                dst[i] |= static_cast<uint8_t>(NextRand());
+        }
+        else
+            memset(dst, 0xFF, FLASH_SECTOR_SIZE);
+
+        sectorErases[ofs/FLASH_SECTOR_SIZE + sector] += 1;
+        stats.nSectorsErased += 1;
+        stats.busyTime_us += SECTOR_ERASE_TIME_US;
+    }
+    Lock();
+
+    if (fail)
+        throw PowerFail{ static_cast<uint32_t>(ofs + failSector*FLASH_SECTOR_SIZE), true };
+}
+
+// ---------------------------------------------------------------------------
+//
+// SDK flash functions
+//
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count)
+{
+    norFlash.Program(flash_offs, data, count);
+}
+
+void flash_range_erase(uint32_t flash_offs, size_t count)
+{
+    norFlash.Erase(flash_offs, count);
+}
+
+// Send a raw command.  We answer the JEDEC ID query as the Pico's Winbond
+// W25Q16JV; everything else (including SFDP) reads as zeroes.
+void flash_do_cmd(const uint8_t *txbuf, uint8_t *rxbuf, size_t count)
+{
+    memset(rxbuf, 0, count);
+    if (count >= 4 && txbuf[0] == 0x9F)
+    {
+        rxbuf[1] = 0xEF;
+        rxbuf[2] = 0x40;
+        rxbuf[3] = 0x15;
+    }
+}
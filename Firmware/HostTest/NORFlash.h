@@ -0,0 +1,108 @@
+// Pinscape Pico - host-side NOR flash emulator
+// Copyright 2024, 2025 Michael J Roberts / BSD-3-Clause license / NO WARRANTY
+//
+// Emulates the Pico's QSPI NOR flash for host tests of the flash file
+// system.  The simulated flash is mapped read-only at the real XIP base
+// address, so that the firmware can read it through XIP pointers exactly
+// as it does on the Pico, and it can only be changed through the SDK
+// flash functions, which this module defines:
+//
+//  - flash_range_program() can only change bits from 1 to 0, so it
+//    stores the AND of the old and new data, as the real flash does.
+//    Writing 0xFF bytes is the file system's way of leaving bytes
+//    unchanged, but a byte written with any 0 bits must be stored
+//    exactly as written, so if that would need a 0 bit to change to 1,
+//    the program counts as a violation of the program rule.
+//
+//  - flash_range_erase() works in whole sectors, and counts the erases
+//    for each sector.
+//
+//  - Misaligned or out-of-range operations, which the SDK would reject
+//    with an assert, are counted as errors and ignored.
+//
+// The emulator can also inject a power failure at a chosen operation.
+// The interrupted operation leaves the bits it was changing in a random
+// state, and then throws NORFlash::PowerFail, which the test catches to
+// simulate a reboot.
+//
+// Stray writes through XIP pointers fault, since the mapping is read-only.
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+class NORFlash
+{
+public:
+    // Map the flash and erase it.  Returns false if the XIP address range
+    // isn't available in the host process.
+    bool Init();
+
+    // Reset the flash contents to all erased (0xFF) bytes, and clear the
+    // statistics and erase counters
+    void Reset();
+
+    // save/restore the flash contents
+    void Save(std::vector<uint8_t> &buf) const;
+    void Restore(const std::vector<uint8_t> &buf);
+
+    // Statistics.  The busy time is a simulated flash operation time,
+    // based on the typical page program and sector erase times for the
+    // Winbond W25Q16JV used on the Pico.
+    struct Stats
+    {
+        uint64_t nOps = 0;                  // program and erase calls
+        uint64_t nPagesProgrammed = 0;      // pages programmed
+        uint64_t nSectorsErased = 0;        // sectors erased
+        uint64_t nRuleViolations = 0;       // programs that tried to set 0 bits to 1
+        uint64_t nAlignmentErrors = 0;      // misaligned or out-of-range operations
+        uint64_t busyTime_us = 0;           // simulated busy time
+    };
+    Stats stats;
+
+    // typical operation times, microseconds
+    static const uint32_t PAGE_PROGRAM_TIME_US = 400;
+    static const uint32_t SECTOR_ERASE_TIME_US = 45000;
+
+    // Erase count per sector, since the last Reset()
+    std::vector<uint32_t> sectorErases;
+
+    // Power failure injection.  Arms a failure on the nth program or
+    // erase call from now (0 = the next call).  The random seed selects
+    // the point where the operation is interrupted and the state of the
+    // bits it leaves behind.
+    void FailAfter(uint64_t n, uint32_t seed);
+    void Disarm() { failArmed = false; }
+
+    // the exception thrown at the power failure
+    struct PowerFail
+    {
+        uint32_t flashOffset;       // offset of the interrupted page or sector
+        bool erase;                 // true if the operation was an erase
+    };
+
+    // SDK entrypoints
+    void Program(uint32_t ofs, const uint8_t *data, size_t count);
+    void Erase(uint32_t ofs, size_t count);
+
+protected:
+    // make the flash writable for the duration of an operation
+    void Unlock();
+    void Lock();
+
+    // check for an armed failure on this operation
+    bool CheckFail();
+
+    // failure injection state
+    bool failArmed = false;
+    uint64_t failCountdown = 0;
+    uint32_t failRand = 1;
+    uint32_t NextRand() { failRand ^= failRand << 13; failRand ^= failRand >> 17; failRand ^= failRand << 5; return failRand; }
+
+    // mapped?
+    bool mapped = false;
+};
+
+// global singleton
+extern NORFlash norFlash;
@@ -0,0 +1,19 @@
+// Pinscape Pico - host-side test shim: pre-included IR remote headers
+// Copyright 2024, 2025 Michael J Roberts / BSD-3-Clause license / NO WARRANTY
+//
+// Force-included (-include) ahead of the IR decoder tests, in the same
+// way as LoggerHeaders.h, for the pre-existing IR headers: the protocol
+// decoders' int/uint32_t comparisons and unparenthesized bit operators
+// in IRProtocols.h, and the memcpy() of non-trivial element types in
+// CircBuf.h.
+
+#pragma once
+#include "LoggerHeaders.h"
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-compare"
+#pragma GCC diagnostic ignored "-Wparentheses"
+#pragma GCC diagnostic ignored "-Wclass-memaccess"
+#include "../../IRRemote/CircBuf.h"
+#include "../../IRRemote/IRReceiver.h"
+#include "../../IRRemote/IRProtocols.h"
+#pragma GCC diagnostic pop
@@ -0,0 +1,19 @@
+// Pinscape Pico - host-side test shim: pre-included firmware headers
+// Copyright 2024, 2025 Michael J Roberts / BSD-3-Clause license / NO WARRANTY
+//
+// The Makefile force-includes this file (-include) ahead of the test
+// programs that pull in the logger, to compile these pre-existing
+// firmware headers with the specific warnings that they trigger on a
+// 64-bit host turned off.  The warnings come from int/size_t comparisons
+// (sizeof() is 64 bits here) and from the 32-bit "~0UL" mask in
+// Logger.h, neither of which is an issue on the Pico.  The headers'
+// #pragma once guards make the programs' own #includes of them no-ops,
+// so the suppressions don't reach any other code.
+
+#pragma once
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-compare"
+#pragma GCC diagnostic ignored "-Woverflow"
+#include "../../Logger.h"
+#include "../../CommandConsole.h"
+#pragma GCC diagnostic pop
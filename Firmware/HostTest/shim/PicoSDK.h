@@ -0,0 +1,61 @@
+// Pinscape Pico - host-side test shim for the Pico SDK
+// Copyright 2024, 2025 Michael J Roberts / BSD-3-Clause license / NO WARRANTY
+//
+// Just enough of the SDK's types and functions to compile the firmware
+// headers that the host tests pull in.  The header files in this
+// directory's pico/ and hardware/ subfolders all include this file, so
+// that the firmware's SDK #includes resolve here when the test build
+// puts this directory on the include path.  The functions are dummies,
+// except for time_us_64(), which each test program defines, so that it
+// can run the firmware code against a simulated clock, and the flash
+// functions, which the NOR flash emulator (NORFlash.cpp) defines.
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// function attributes
+#define __force_inline inline __attribute__((always_inline))
+
+// system clock - defined by each test program
+uint64_t time_us_64();
+
+// interrupts and locks (the tests are single-threaded)
+inline uint32_t save_and_disable_interrupts() { return 0; }
+inline void restore_interrupts(uint32_t) { }
+typedef struct { uint32_t dummy; } spin_lock_t;
+inline uint32_t spin_lock_blocking(spin_lock_t*) { return 0; }
+inline void spin_unlock(spin_lock_t*, uint32_t) { }
+typedef struct { uint32_t dummy; } mutex_t;
+inline void mutex_enter_blocking(mutex_t*) { }
+inline bool mutex_enter_timeout_us(mutex_t*, uint32_t) { return true; }
+inline void mutex_exit(mutex_t*) { }
+
+// peripheral instance types
+typedef struct pio_hw_t *PIO;
+typedef struct uart_inst uart_inst_t;
+
+// DMA channel registers
+struct dma_channel_hw_t { volatile uint32_t read_addr, write_addr, transfer_count, ctrl_trig, al1_ctrl; };
+inline dma_channel_hw_t *dma_channel_hw_addr(unsigned int) { static dma_channel_hw_t hw; return &hw; }
+#define DMA_CH0_CTRL_TRIG_CHAIN_TO_BITS 0x00007800
+#define DMA_CH0_CTRL_TRIG_CHAIN_TO_LSB 11
+
+// status codes
+#define PICO_OK 0
+#define PICO_ERROR_TIMEOUT (-1)
+
+// watchdog
+inline void watchdog_update() { }
+
+// Flash.  The NOR flash emulator maps the simulated flash at the real XIP
+// base address, so that firmware code can read it through XIP pointers.
+#ifndef PICO_FLASH_SIZE_BYTES
+#define PICO_FLASH_SIZE_BYTES (2 * 1024 * 1024)
+#endif
+#define XIP_BASE 0x10000000
+#define FLASH_PAGE_SIZE (1u << 8)
+#define FLASH_SECTOR_SIZE (1u << 12)
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count);
+void flash_do_cmd(const uint8_t *txbuf, uint8_t *rxbuf, size_t count);
@@ -646,6 +646,25 @@ void I2C::UnitTask()
         if (devices.size() == 0)
             return;
 
+        // Offer the bus first to any device with a priority service
+        // request.  The round-robin position moves to the priority device,
+        // so the normal rotation simply resumes from there afterwards.
+        {
+            bool started = false;
+            for (int i = 0 ; i < static_cast<int>(devices.size()) && !started ; ++i)
+            {
+                if (devices[i]->i2cPriorityRequest)
+                {
+                    devices[i]->i2cPriorityRequest = false;
+                    curDevice = i;
+                    I2CX i2cx(this);
+                    started = devices[i]->OnI2CReady(&i2cx);
+                }
+            }
+            if (started)
+                break;
+        }
+
         // Scan for a device with pending work, starting where we left
         // off from last time.
         for (int prvDevice = curDevice ; ; )
@@ -187,6 +187,13 @@ public:
         void Print(const ConsoleCommandContext *ctx);
     };
     I2CStats i2cStats;
+
+    // Priority service request.  A device can set this flag (including
+    // from IRQ context) when it has latency-sensitive work pending, such
+    // as an input-change interrupt signal from the chip.  The I2C manager
+    // offers the bus to flagged devices ahead of the normal round-robin
+    // order on the next Ready cycle, and clears the flag when it does.
+    volatile bool i2cPriorityRequest = false;
 };
 
 // I2C manager.  Each instance manages devices sharing one bus.
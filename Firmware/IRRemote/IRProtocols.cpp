@@ -4,6 +4,7 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <algorithm>
 
 #include <pico/stdlib.h>
 
@@ -42,6 +43,58 @@ void IRProtocol::AllocProtocols()
         protocols = new IRProtocols();
 }
 
+// Build the decoder dispatch table
+void IRRxDispatcher::Init()
+{
+    // add each protocol in the RX list
+    nRxDecoders = 0;
+    rxMinGap = UINT32_MAX;
+    auto Add = [this](IRProtocol *pro)
+    {
+        if (nRxDecoders < MAX_DECODERS)
+        {
+            rxDecoders[nRxDecoders++] = { pro, pro->MinRxGap() };
+            rxMinGap = std::min(rxMinGap, pro->MinRxGap());
+        }
+    };
+    #define IR_PROTOCOL_RX(cls) Add(&IRProtocol::protocols->s_##cls);
+    #include "IRProtocolList.h"
+
+    // all decoders start out idle
+    rxActiveMask = 0;
+}
+
+// Process a pulse through the protocol decoders
+void IRRxDispatcher::Dispatch(IRRecvProIfc *receiver, uint32_t t, bool mark)
+{
+    // Start with the decoders that are currently tracking a code.  If
+    // this is a space long enough to count as a gap for any decoder,
+    // add the idle decoders whose minimum gap it exceeds.
+    uint32_t callMask = rxActiveMask;
+    if (!mark && t > rxMinGap)
+    {
+        for (int i = 0 ; i < nRxDecoders ; ++i)
+        {
+            if (t > rxDecoders[i].minGap)
+                callMask |= (1UL << i);
+        }
+    }
+
+    // Call the selected decoders, noting which ones remain active.  The
+    // decoders we skip were idle, and remain idle, since idle decoders
+    // ignore pulses other than gaps.
+    uint32_t newActiveMask = 0;
+    for (uint32_t m = callMask ; m != 0 ; m &= m - 1)
+    {
+        int i = __builtin_ctz(m);
+        IRProtocol *pro = rxDecoders[i].pro;
+        pro->RxPulse(receiver, t, mark);
+        if (!pro->IsRxIdle())
+            newActiveMask |= (1UL << i);
+    }
+    rxActiveMask = newActiveMask;
+}
+
 // report code with a specific protocol
 void IRProtocol::ReportCode(IRRecvProIfc *receiver, const IRCommandReceived &cmd)
 {
@@ -154,7 +207,7 @@ void IRProtocol::CheckRepeatByTime(IRRecvProIfc *receiver, IRCommandReceived cmd
     uint64_t now = time_us_64();
     uint64_t dt = now - receiver->tLastCommand;
     auto &last = receiver->lastCommand;
-    if (dt < maxTime_us && cmd.proId == last.proId && cmd.code == last.code)
+    if (dt < static_cast<uint64_t>(maxTime_us) && cmd.proId == last.proId && cmd.code == last.code)
     {
         // consider it an auto-repeat
         cmd.isAutoRepeat = true;
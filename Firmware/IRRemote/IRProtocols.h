@@ -230,6 +230,17 @@ public:
 
     // parse a pulse on receive
     virtual void RxPulse(IRRecvProIfc *receiver, uint32_t t, bool mark) = 0;
+
+    // Minimum gap on receive (space before header)
+    virtual uint32_t MinRxGap() const = 0;
+
+    // Is the receiver idle?  A decoder in the idle state is waiting for
+    // an inter-code gap, so it ignores every pulse except a space longer
+    // than MinRxGap().  The receiver uses this to skip calling idle
+    // decoders for pulses that can't affect them.  Decoders that replace
+    // the standard RxPulse() state machine must preserve this rule: state
+    // 0 must ignore everything but a space longer than MinRxGap().
+    bool IsRxIdle() const { return rxState == 0; }
     
     // PWM carrier frequency used for the IR signal.  We use this to set
     // the appropriate PWM frequency for transmissions.  The most common
@@ -324,6 +335,9 @@ public:
     static void AllocProtocols();
         
 protected:
+    // Decoding state.  0 is the idle state, waiting for an inter-code gap.
+    uint8_t rxState = 0;
+
     // -----------------------------------------------------------------------
     //
     // Universal receiver operations.  These methods interface with the
@@ -392,9 +406,6 @@ public:
         code = 0;
     }
     
-    // Minimum gap on receive (space before header)
-    virtual uint32_t MinRxGap() const = 0;
-    
     // Gap time to send on transmit between before the first code, and
     // between repeats.  By default, we use the the generic TxGap() in
     // both cases.
@@ -1055,9 +1066,6 @@ protected:
             code |= mask;
     }
 
-    // decoding state   
-    uint8_t rxState; 
-
     // next bit position
     uint8_t bit;
     
@@ -3,19 +3,26 @@
 //
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <list>
 
 #include <pico/stdlib.h>
 #include <hardware/gpio.h>
 #include <hardware/irq.h>
+#include <hardware/pio.h>
+#include <hardware/dma.h>
+#include <hardware/clocks.h>
 
 #include "../Pinscape.h"
 #include "../JSON.h"
 #include "../Logger.h"
 #include "../GPIOManager.h"
+#include "../Config.h"
+#include "../CommandConsole.h"
 #include "IRReceiver.h"
 #include "IRTransmitter.h"
 #include "IRProtocols.h"
+#include "IRReceiver_pio.pio.h"
 
 // global singleton
 IRReceiver irReceiver;
@@ -49,6 +56,7 @@ void IRRecvProIfc::WriteCommand(const IRCommandReceived &cmd)
 // irRx: {
 //   gpio: <number>,         // GPIO port for TSOP384xx (or equivalent) IR receiver DATA/OUT pin
 //   bufferSize: <number>,   // pulse buffer size, in entries (optional)
+//   pioCapture: <bool>,     // use PIO + DMA pulse capture instead of GPIO edge interrupts (optional)
 // }
 //
 void IRReceiver::Configure(JSONParser &json)
@@ -57,11 +65,13 @@ void IRReceiver::Configure(JSONParser &json)
     bool ok = false;
     int rawBufSize = 128;
     int gpio = -1;
+    bool pioCapture = false;
     if (auto *val = json.Get("irRx") ; !val->IsUndefined())
     {
         // get the parameters
         gpio = val->Get("gpio")->Int(-1);
         rawBufSize = val->Get("bufferSize")->Int(rawBufSize);
+        pioCapture = val->Get("pioCapture")->Bool(false);
 
         // presume success
         ok = true;
@@ -96,22 +106,177 @@ void IRReceiver::Configure(JSONParser &json)
         // allocate the raw pulse buffer
         rawbuf.Alloc(rawBufSize);
         
-        // allocate the protocol singletons
+        // allocate the protocol singletons, and set up the dispatch table
         IRProtocol::AllocProtocols();
+        rxDispatcher.Init();
+
+        // load learned codes
+        if (!config.LoadStruct(LEARN_FILE_NAME, &learned, sizeof(learned)) || learned.nCodes > MAX_LEARNED)
+            learned.nCodes = 0;
+        subIndexDirty = true;
+
+        // set up our console command
+        CommandConsole::AddCommand(
+            "irlearn", "learn IR remote codes as aliases for configured codes",
+            "irlearn [options] [<code>]\n"
+            "  <code>          start learn mode; the next unrecognized code received is saved\n"
+            "                  as an alias for <code>, given in the 'pp.ff.cccc' format\n"
+            "options:\n"
+            "  -l, --list      list learned codes\n"
+            "  --delete <n>    delete learned code #n (as shown in the list)\n"
+            "  --clear         delete all learned codes\n"
+            "  --cancel        cancel learn mode\n",
+            [](const ConsoleCommandContext *c){ irReceiver.Command_irlearn(c); });
+
+        // Set up PIO capture if desired, otherwise set our GPIO interrupt
+        // handler.  If PIO capture fails for lack of resources, fall back
+        // on the interrupt handler.
+        if (pioCapture && InitPIOCapture())
+        {
+            Log(LOG_CONFIG, "IR Receiver configured on GP%d, PIO capture on PIO %d.%d@%u, DMA ch %d\n",
+                gpio, pio_get_index(pio), piosm, pioOffset, dmaChan);
+        }
+        else
+        {
+            gpio_add_raw_irq_handler(gpio, [](){ irReceiver.IRQHandler(); });
+            Log(LOG_CONFIG, "IR Receiver configured on GP%d\n", gpio);
+        }
+    }
+}
 
-        // set our interrupt handler
-        gpio_add_raw_irq_handler(gpio, [](){ irReceiver.IRQHandler(); });
+// Set up PIO capture
+bool IRReceiver::InitPIOCapture()
+{
+    // allocate the capture ring; the DMA ring-wrap feature requires
+    // the buffer to be aligned on its size
+    const size_t ringBytes = 1 << PIO_RING_BITS;
+    if ((pioRing = static_cast<volatile uint32_t*>(aligned_alloc(ringBytes, ringBytes))) == nullptr)
+        return Log(LOG_ERROR, "irRx: unable to allocate PIO capture buffer; using GPIO interrupts\n"), false;
+
+    // claim a DMA channel
+    if ((dmaChan = dma_claim_unused_channel(false)) < 0)
+        return Log(LOG_ERROR, "irRx: insufficient DMA channels for PIO capture; using GPIO interrupts\n"), false;
+
+    // try loading the program into each PIO in turn
+    auto TryClaimPIO = [this](PIO pio)
+    {
+        // make sure we can add our program to the PIO
+        if (!pio_can_add_program(pio, &IRReceiver_program))
+            return false;
+
+        // try claiming a state machine on this PIO
+        this->piosm = pio_claim_unused_sm(pio, false);
+        if (this->piosm < 0)
+            return false;
+
+        // success - add the program
+        this->pioOffset = pio_add_program(pio, &IRReceiver_program);
+        this->pio = pio;
+        return true;
+    };
+    if (!TryClaimPIO(pio0) && !TryClaimPIO(pio1))
+    {
+        dma_channel_unclaim(dmaChan);
+        dmaChan = -1;
+        return Log(LOG_ERROR, "irRx: insufficient PIO resources for PIO capture; using GPIO interrupts\n"), false;
+    }
+
+    // Set the PIO clock to 2 MHz.  Each counting loop iteration takes
+    // two PIO cycles, so this counts pulse time in 1us units.
+    const float pioClockDiv = static_cast<float>(clock_get_hz(clk_sys)) / 2000000.0f;
+
+    // Configure the state machine.  Note that we don't need to assign
+    // the GPIO to the PIO, since a PIO can read any GPIO input regardless
+    // of its function selection; leaving it as a plain GPIO input keeps
+    // it readable by the other shared-input subscribers.
+    pio_sm_set_enabled(pio, piosm, false);
+    auto piocfg = IRReceiver_program_get_default_config(pioOffset);
+    sm_config_set_jmp_pin(&piocfg, gpio);                // JMP pin: IR sensor data
+    sm_config_set_in_shift(&piocfg, false, true, 32);    // false=shift LEFT, true=auto-push ON, 32-bit push threshold
+    sm_config_set_fifo_join(&piocfg, PIO_FIFO_JOIN_RX);  // use the TX FIFO space to extend the RX FIFO
+    sm_config_set_clkdiv(&piocfg, pioClockDiv);          // PIO clock divider (see above)
+    pio_sm_init(pio, piosm, pioOffset, &piocfg);         // initialize with the configuration and starting program offset
+
+    // pre-load Y with the mark flag bit
+    pio_sm_exec(pio, piosm, pio_encode_set(pio_y, 1));
+
+    // Configure the DMA channel: PIO RX FIFO to the capture ring, with
+    // the write address wrapping at the ring size.  Enable() starts it.
+    auto dmaConf = dma_channel_get_default_config(dmaChan);
+    channel_config_set_read_increment(&dmaConf, false);
+    channel_config_set_write_increment(&dmaConf, true);
+    channel_config_set_transfer_data_size(&dmaConf, DMA_SIZE_32);
+    channel_config_set_ring(&dmaConf, true, PIO_RING_BITS);
+    channel_config_set_dreq(&dmaConf, pio_get_dreq(pio, piosm, false));
+    dma_channel_configure(dmaChan, &dmaConf, pioRing, &pio->rxf[piosm], 0xFFFFFFFF, false);
+
+    // success
+    return true;
+}
 
-        // done
-        Log(LOG_CONFIG, "IR Receiver configured on GP%d\n", gpio);
+// Read new pulses from the PIO capture ring
+void IRReceiver::ReadPIOCapture()
+{
+    // Restart the DMA channel if it has exhausted its transfer count.
+    // The count is the maximum, so this should never happen in practice,
+    // but it costs nothing to check.
+    if (!dma_channel_is_busy(dmaChan))
+        dma_channel_set_trans_count(dmaChan, 0xFFFFFFFF, true);
+
+    // get the current DMA write position as a ring index
+    uintptr_t writeAddr = dma_channel_hw_addr(dmaChan)->write_addr;
+    int writeIndex = static_cast<int>((writeAddr - reinterpret_cast<uintptr_t>(pioRing)) / sizeof(uint32_t)) & (PIO_RING_SIZE - 1);
+
+    // process new entries
+    uint64_t now = time_us_64();
+    while (pioRingRead != writeIndex)
+    {
+        // read the next measurement
+        uint32_t w = pioRing[pioRingRead];
+        pioRingRead = (pioRingRead + 1) & (PIO_RING_SIZE - 1);
+        tLastPIOPulse = now;
+
+        // decode it
+        bool mark = (w & 0x0001) != 0;
+        uint32_t time_us = 0x7FFFFFFF - (w >> 1);
+
+        // the next pulse is the opposite type
+        pulseState = !mark;
+
+        // If we already wrote this pulse at the timeout, skip it
+        if (pulseAtMax)
+        {
+            pulseAtMax = false;
+            continue;
+        }
+
+        // If the transmitter is sending, ignore the pulse, so that we
+        // don't try to read our own transmissions.
+        if (transmitter != nullptr && transmitter->IsSending())
+            continue;
+
+        // add it to the raw buffer
+        WriteRawPulse(time_us, mark);
+    }
+
+    // If the current pulse has run past the maximum length, write it out
+    // now, so that the protocol processor can read it, as in the interrupt
+    // handler version.
+    if (!pulseAtMax && now - tLastPIOPulse >= MAX_PULSE)
+    {
+        WriteRawPulse(MAX_PULSE, pulseState);
+        pulseAtMax = true;
     }
 }
 
 // Periodic tasks
 void IRReceiver::Task()
 {
-    // check for a pulse timeout
-    if (time_us_64() >= pulseTimeout)
+    // Collect new pulses from the PIO capture ring, or check for a pulse
+    // timeout in interrupt mode
+    if (pio != nullptr)
+        ReadPIOCapture();
+    else if (time_us_64() >= pulseTimeout)
         OnPulseTimeout();
 
     // process pulses from the raw buffer through the state machines
@@ -140,41 +305,212 @@ void IRReceiver::Task()
         ProcessProtocols(time_us, mark);
     }
 
+    // check for a learn mode timeout
+    if (learnMode && time_us_64() >= learnTimeout)
+    {
+        learnMode = false;
+        Log(LOG_INFO, "IR learn mode timed out\n");
+    }
+
     // if notifications are enabled, pass queued commands to event
     // subscribers
     if (notifyEnabled)
     {
+        // bring the subscriber index up to date
+        if (subIndexDirty)
+            RebuildIndex();
+
         // process all queued commands
         IRCommandReceived cmd;
         uint64_t dt;
         while (ReadCommand(cmd, dt))
         {
-            // notify all subscribers
-            for (auto &sub : subscribers)
+            // In learn mode, capture the first new code that doesn't
+            // already have filtered subscribers.  The user is pressing
+            // the key to teach it, not to activate anything, so don't
+            // pass it on as an alias for the target code.
+            bool learning = learnMode && !cmd.isAutoRepeat && !IsIndexed(cmd);
+            if (learning)
+                Learn(cmd);
+
+            // Notify the subscribers with no filter.  These see every
+            // command, including one captured in learn mode, since they
+            // aren't acting on particular codes (the host feedback
+            // controller reports all commands to the PC, for example).
+            for (auto *sub : unfilteredSubs)
+                sub->sub->OnIRCommandReceived(cmd, dt);
+
+            // that's all for a command captured in learn mode
+            if (learning)
+                continue;
+
+            // notify the subscribers with filters matching the command
+            IndexEntry key{ cmd.code, cmd.proId };
+            for (auto it = std::lower_bound(subIndex.begin(), subIndex.end(), key) ;
+                 it != subIndex.end() && it->proId == cmd.proId && it->code == cmd.code ; ++it)
             {
-                // If there's a filter, only notify this subscriber for commands
-                // listed.  A zero-length filter matches all commands.
-                bool matched = true;
-                if (sub.filter.size() != 0)
+                // for a learned alias, report the code it stands for
+                if (it->targetProId != cmd.proId || it->targetCode != cmd.code)
                 {
-                    // there's a filter - look for a matching command, and only
-                    // notify if there's a match
-                    matched = false;
-                    for (auto &f : sub.filter)
-                    {
-                        if (f == cmd)
-                        {
-                            matched = true;
-                            break;
-                        }
-                    }
+                    IRCommandReceived alias = cmd;
+                    alias.proId = it->targetProId;
+                    alias.code = it->targetCode;
+                    it->sub->sub->OnIRCommandReceived(alias, dt);
                 }
+                else
+                    it->sub->sub->OnIRCommandReceived(cmd, dt);
+            }
+        }
+    }
+}
+
+// Rebuild the subscriber index
+void IRReceiver::RebuildIndex()
+{
+    // add an entry for each filter code of each subscriber
+    subIndex.clear();
+    unfilteredSubs.clear();
+    for (auto &sub : subscribers)
+    {
+        if (sub.filter.size() == 0)
+            unfilteredSubs.push_back(&sub);
+        for (auto &f : sub.filter)
+            subIndex.push_back({ f.code, f.proId, f.proId, f.code, &sub });
+    }
+
+    // Add an entry for each learned alias, for each subscriber to its
+    // target.  Skip an alias that repeats an earlier one, since it would
+    // notify the same subscribers a second time.
+    size_t nDirect = subIndex.size();
+    for (int i = 0 ; i < learned.nCodes ; ++i)
+    {
+        const auto &l = learned.codes[i];
+        bool repeated = false;
+        for (int k = 0 ; k < i && !repeated ; ++k)
+        {
+            const auto &lk = learned.codes[k];
+            repeated = (lk.proId == l.proId && lk.code == l.code && lk.targetProId == l.targetProId && lk.targetCode == l.targetCode);
+        }
+        if (repeated)
+            continue;
+
+        for (size_t j = 0 ; j < nDirect ; ++j)
+        {
+            if (subIndex[j].proId == l.targetProId && subIndex[j].code == l.targetCode)
+                subIndex.push_back({ l.code, l.proId, l.targetProId, l.targetCode, subIndex[j].sub });
+        }
+    }
+
+    // sort by protocol and code, keeping subscription order within each code
+    std::stable_sort(subIndex.begin(), subIndex.end());
+    subIndexDirty = false;
+}
+
+// Is a command in the index?
+bool IRReceiver::IsIndexed(const IRCommandDesc &cmd) const
+{
+    IndexEntry key{ cmd.code, cmd.proId };
+    auto it = std::lower_bound(subIndex.begin(), subIndex.end(), key);
+    return it != subIndex.end() && it->proId == cmd.proId && it->code == cmd.code;
+}
+
+// Start learn mode
+void IRReceiver::StartLearn(const IRCommandDesc &target)
+{
+    learnTarget = target;
+    learnTimeout = time_us_64() + LEARN_TIMEOUT;
+    learnMode = true;
+}
+
+// Record a learned code
+void IRReceiver::Learn(const IRCommandReceived &cmd)
+{
+    // end learn mode
+    learnMode = false;
+
+    // make sure there's room
+    char buf[32], buf2[32];
+    if (learned.nCodes >= MAX_LEARNED)
+    {
+        Log(LOG_ERROR, "IR learn: learned code table is full; delete unused codes first\n");
+        return;
+    }
 
-                // Call the callback if we matched the filter
-                if (matched)
-                    sub.sub->OnIRCommandReceived(cmd, dt);
+    // add it and save the table
+    learned.codes[learned.nCodes++] = { cmd.code, learnTarget.code, cmd.proId, learnTarget.proId };
+    SaveLearned();
+    subIndexDirty = true;
+    Log(LOG_INFO, "IR learn: %s learned as an alias for %s\n",
+        cmd.ToString(buf, sizeof(buf)), learnTarget.ToString(buf2, sizeof(buf2)));
+}
+
+// Save the learned code table
+bool IRReceiver::SaveLearned()
+{
+    return config.SaveStruct(LEARN_FILE_NAME, &learned, sizeof(learned), sizeof(learned));
+}
+
+// Console command handler
+void IRReceiver::Command_irlearn(const ConsoleCommandContext *c)
+{
+    if (c->argc == 1)
+        return c->Usage();
+
+    for (int i = 1 ; i < c->argc ; ++i)
+    {
+        char buf[32], buf2[32];
+        const char *a = c->argv[i];
+        if (strcmp(a, "-l") == 0 || strcmp(a, "--list") == 0)
+        {
+            if (learned.nCodes == 0)
+                c->Print("No learned codes\n");
+            for (int j = 0 ; j < learned.nCodes ; ++j)
+            {
+                const auto &l = learned.codes[j];
+                c->Printf("  #%-2d  %s -> %s\n", j + 1,
+                    IRCommandDesc(l.proId, l.code, false).ToString(buf, sizeof(buf)),
+                    IRCommandDesc(l.targetProId, l.targetCode, false).ToString(buf2, sizeof(buf2)));
             }
         }
+        else if (strcmp(a, "--delete") == 0)
+        {
+            if (++i >= c->argc)
+                return c->Printf("Missing argument for --delete\n");
+
+            int n = atoi(c->argv[i]);
+            if (n < 1 || n > learned.nCodes)
+                return c->Printf("Invalid learned code number %s\n", c->argv[i]);
+
+            memmove(&learned.codes[n - 1], &learned.codes[n], (learned.nCodes - n) * sizeof(learned.codes[0]));
+            learned.nCodes -= 1;
+            subIndexDirty = true;
+            c->Printf(SaveLearned() ? "Learned code #%d deleted\n" : "Error saving learned code table\n", n);
+        }
+        else if (strcmp(a, "--clear") == 0)
+        {
+            learned.nCodes = 0;
+            subIndexDirty = true;
+            c->Print(SaveLearned() ? "All learned codes deleted\n" : "Error saving learned code table\n");
+        }
+        else if (strcmp(a, "--cancel") == 0)
+        {
+            CancelLearn();
+            c->Print("Learn mode canceled\n");
+        }
+        else if (a[0] == '-')
+        {
+            return c->Printf("Invalid option \"%s\"\n", a);
+        }
+        else
+        {
+            IRCommandDesc target;
+            if (!target.Parse(a))
+                return c->Printf("Invalid IR code \"%s\"; use the 'pp.ff.cccc' format\n", a);
+
+            StartLearn(target);
+            c->Printf("Learn mode started for %s; press the new remote's key within %d seconds\n",
+                target.ToString(buf, sizeof(buf)), static_cast<int>(LEARN_TIMEOUT / 1000000));
+        }
     }
 }
 
@@ -206,19 +542,46 @@ bool IRReceiver::ReadCommand(IRCommandReceived &cmd, uint64_t &dt)
 void IRReceiver::Subscribe(Subscriber *sub, bool rawPulses)
 {
     subscribers.emplace_back(sub, rawPulses);
+    subIndexDirty = true;
 }
 
 // add a subscriber, with a filter for specific command codes
 void IRReceiver::Subscribe(Subscriber *sub, std::initializer_list<IRCommandDesc> filters, bool rawPulses)
 {
-    subscribers.emplace_back(sub, filters, rawPulses);
+    // Add the subscriber, dropping any repeated codes from the filter.
+    // The index has an entry per filter code, so a repeated code would
+    // otherwise notify the subscriber more than once per command.
+    auto &es = subscribers.emplace_back(sub, rawPulses);
+    for (auto &f : filters)
+    {
+        if (std::find(es.filter.begin(), es.filter.end(), f) == es.filter.end())
+            es.filter.emplace_back(f);
+    }
+    subIndexDirty = true;
 }
 
 // Enable reception
 void IRReceiver::Enable()
 {
     // only proceed if we have a valid GPIO pin
-    if (gpio != -1)
+    if (gpio != -1 && pio != nullptr)
+    {
+        // Start the capture from the top of the program, which begins by
+        // timing a space, so take the current pin state as the initial
+        // state.  If a mark is in progress, the first reading is just a
+        // zero-length space.
+        pioRingRead = static_cast<int>((dma_channel_hw_addr(dmaChan)->write_addr - reinterpret_cast<uintptr_t>(pioRing)) / sizeof(uint32_t)) & (PIO_RING_SIZE - 1);
+        tLastPIOPulse = time_us_64();
+        pulseState = false;
+        pulseAtMax = false;
+        pio_sm_clear_fifos(pio, piosm);
+        pio_sm_restart(pio, piosm);
+        pio_sm_exec(pio, piosm, pio_encode_set(pio_y, 1));
+        pio_sm_exec(pio, piosm, pio_encode_jmp(pioOffset));
+        dma_channel_start(dmaChan);
+        pio_sm_set_enabled(pio, piosm, true);
+    }
+    else if (gpio != -1)
     {
         // start the pulse timers
         StartPulse(gpio_get(gpio) ? 0 : 1);
@@ -232,7 +595,12 @@ void IRReceiver::Enable()
 // Disable reception
 void IRReceiver::Disable()
 {
-    if (gpio != -1)
+    if (gpio != -1 && pio != nullptr)
+    {
+        // stop the PIO; the DMA channel just waits for more input
+        pio_sm_set_enabled(pio, piosm, false);
+    }
+    else if (gpio != -1)
     {
         // Shut down all of our asynchronous handlers: disable the pin edge
         // interrupts, stop the pulse timer, and cancel the maximum pulse 
@@ -262,32 +630,33 @@ void IRReceiver::EndPulse(bool lastPulseState)
     // Add the pulse to the buffer.  If the pulse already timed out,
     // we already wrote it, so there's no need to write it again.
     if (!pulseAtMax)
-    {
-        // get the time of the ending space
-        uint32_t t = GetPulseLength();
-        
-        // Scale by 2X to give us more range in a 16-bit int.  Since we're
-        // also discarding the low bit (for the mark/space indicator below),
-        // round to the nearest 4us by adding 2us before dividing.
-        t += 2;
-        t >>= 1;
-        
-        // limit the stored value to the uint16 maximum value
-        if (t > 65535)
-            t = 65535;
-            
-        // set the low bit if it's a mark, clear it if it's a space
-        t &= ~0x0001;
-        t |= lastPulseState;
-
-        // add it to the buffer
-        rawbuf.Write(uint16_t(t));
-    }
+        WriteRawPulse(GetPulseLength(), lastPulseState);
 
     // no pulse is active, so clear the pulse timeout
     ClearPulseTimeout();
 }
 
+// Add a pulse to the raw buffer
+void IRReceiver::WriteRawPulse(uint32_t t, bool mark)
+{
+    // Scale by 2X to give us more range in a 16-bit int.  Since we're
+    // also discarding the low bit (for the mark/space indicator below),
+    // round to the nearest 4us by adding 2us before dividing.
+    t += 2;
+    t >>= 1;
+    
+    // limit the stored value to the uint16 maximum value
+    if (t > 65535)
+        t = 65535;
+        
+    // set the low bit if it's a mark, clear it if it's a space
+    t &= ~0x0001;
+    t |= mark;
+
+    // add it to the buffer
+    rawbuf.Write(uint16_t(t));
+}
+
 // GPIO IRQ handler
 void IRReceiver::IRQHandler()
 {
@@ -420,11 +789,3 @@ bool IRReceiver::ProcessOne(uint32_t &t, bool &mark)
     // no sample
     return false;
 }
-
-// Process a pulse through the protocol handlers
-void IRReceiver::ProcessProtocols(uint32_t t, bool mark)
-{
-    // generate a call to each sender in the RX list
-    #define IR_PROTOCOL_RX(cls) IRProtocol::protocols->s_##cls.RxPulse(this, t, mark);
-    #include "IRProtocolList.h"
-}
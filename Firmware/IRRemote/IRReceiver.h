@@ -201,6 +201,19 @@
 // But in any case it's almost always so short that a user can't perceive
 // the delay, so for all practical purposes decoding is done in real time.
 //
+// Optionally, the receiver can use a PIO state machine instead of the
+// edge interrupts (irRx.pioCapture in the JSON configuration).  The PIO
+// program times each mark and space in hardware at 1us resolution, and
+// a DMA channel streams the measurements into a ring buffer, which
+// Task() drains into the same raw pulse queue that the interrupt
+// handlers use.  This eliminates the per-edge interrupts entirely, which
+// matters during long IR bursts (from a universal remote being used for
+// other equipment in the room, say), since every edge interrupt adds a
+// little latency to any other interrupt that happens to be pending at
+// the same time, such as I2C completions and image sensor DMA
+// completions.  It also makes the timing more accurate, since the PIO
+// timing isn't affected by interrupt latency.
+//
 //
 // How IR remotes work in general
 //
@@ -383,10 +396,12 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <list>
+#include <vector>
 #include <initializer_list>
 
 #include <pico/stdlib.h>
 #include <pico/time.h>
+#include <hardware/pio.h>
 
 #include "../Pinscape.h"
 #include "IRRemote.h"
@@ -395,6 +410,7 @@
 
 // external/forward declarations
 class JSONParser;
+class ConsoleCommandContext;
 
 // IR receiver protocol interface.  This contains functions that we only
 // want to make accessible to the protocol decoders.
@@ -431,6 +447,40 @@ protected:
     CircBuf<CmdInfo, 16> commands;
 };
 
+// Protocol decoder dispatcher.  Most of the time, nearly all of the
+// decoders are idle, waiting for a gap between codes: once the header
+// of a code arrives, every decoder whose protocol doesn't match the
+// header timing drops back to idle until the next gap.  An idle decoder
+// ignores everything except a long space, so we only need to call the
+// decoders that are still tracking the current code, plus the idle
+// decoders when a space exceeds their minimum gap time.
+class IRRxDispatcher
+{
+public:
+    // build the dispatch table from the receiver protocol list; the
+    // protocol singletons must already be allocated
+    void Init();
+
+    // process a pulse through the protocol decoders
+    void Dispatch(IRRecvProIfc *receiver, uint32_t t, bool mark);
+
+protected:
+    struct RxDecoder
+    {
+        class IRProtocol *pro;    // protocol decoder singleton
+        uint32_t minGap;          // minimum gap time that wakes the decoder from idle
+    };
+    static const int MAX_DECODERS = 32;
+    RxDecoder rxDecoders[MAX_DECODERS];
+    int nRxDecoders = 0;
+
+    // bit mask of the decoders that aren't idle
+    uint32_t rxActiveMask = 0;
+
+    // shortest minimum gap time among all decoders
+    uint32_t rxMinGap = UINT32_MAX;
+};
+
 // IR Remote Receiver
 class IRReceiver : protected IRRecvProIfc
 {
@@ -448,6 +498,9 @@ public:
     // been configured with a GPIO input.
     bool IsConfigured() const { return gpio >= 0; }
 
+    // Is the receiver using PIO pulse capture?
+    bool IsPIOCapture() const { return pio != nullptr; }
+
     // IR event subscriber.  Implement this abstract interface to define
     // an object that can subscribe for notifications when
     class Subscriber
@@ -531,6 +584,24 @@ public:
     
     // Is a command ready to read?
     bool IsCommandReady() { return commands.IsReadReady(); }
+
+    // Start learn mode.  In learn mode, the next command received that
+    // doesn't match any subscriber's filter is recorded as an alias for
+    // the target command.  The learned command is still passed to the
+    // subscribers with no filter, but not to the target's subscribers.  From then on, the receiver treats the learned
+    // code exactly like the target code, so any buttons or other
+    // subscribers set up for the target code respond to either one.  The
+    // learned codes are saved in flash, so they persist across resets.
+    // This lets the user substitute a new remote control for the one the
+    // configuration was written for, without editing the configuration.
+    // Learn mode ends when a code is learned, or after a timeout.
+    void StartLearn(const IRCommandDesc &target);
+
+    // cancel learn mode
+    void CancelLearn() { learnMode = false; }
+
+    // is learn mode active?
+    bool IsLearning() const { return learnMode; }
     
     // Process and retrieve one raw pulse.  The application main loop can
     // optionally call this, instead of Task(), if it wants to retrieve
@@ -622,8 +693,14 @@ private:
     // current state
     void EndPulse(bool lastPulseState);
 
+    // add a pulse to the raw buffer, in the 2us-units-plus-mark-bit format
+    void WriteRawPulse(uint32_t time_us, bool mark);
+
     // process a pulse through our protocol handlers
-    void ProcessProtocols(uint32_t t, bool mark);
+    void ProcessProtocols(uint32_t t, bool mark) { rxDispatcher.Dispatch(this, t, mark); }
+
+    // protocol decoder dispatcher
+    IRRxDispatcher rxDispatcher;
 
     // Base interrupt handler.  This reads the interrupt mask and
     // calls the appropriate rising-edge or falling-edge handler(s).
@@ -641,6 +718,41 @@ private:
 
     // timeout handler for a pulse (mark or space)
     void OnPulseTimeout();
+
+    // PIO pulse capture.  When this option is enabled, a PIO state
+    // machine measures the mark and space times in hardware, and DMA
+    // transfers the measurements into a ring buffer, so the CPU doesn't
+    // take an interrupt on every edge.  This takes load off of the CPU
+    // during IR bursts, and eliminates the timing jitter that the edge
+    // interrupts add to other interrupt handlers.  Task() drains the
+    // ring into the raw pulse buffer, so everything downstream works
+    // the same way in both modes.
+    PIO pio = nullptr;
+    int piosm = -1;
+    uint pioOffset = 0;
+    int dmaChan = -1;
+
+    // Capture ring.  The DMA channel writes here in a loop, using the
+    // DMA ring-wrap feature, so the buffer must be aligned on its size
+    // in bytes.  Each entry is a raw PIO measurement word (see the PIO
+    // program for the format).  At the minimum pulse length of about
+    // 250us in the common protocols, the ring holds about 30ms of
+    // continuous pulses, which is many main loop cycles.
+    static const int PIO_RING_BITS = 9;
+    static const int PIO_RING_SIZE = (1 << PIO_RING_BITS) / sizeof(uint32_t);
+    volatile uint32_t *pioRing = nullptr;
+
+    // ring read index
+    int pioRingRead = 0;
+
+    // time of the last pulse read from the ring
+    uint64_t tLastPIOPulse = 0;
+
+    // set up PIO capture; returns false if resources aren't available
+    bool InitPIOCapture();
+
+    // read new pulses from the PIO capture ring
+    void ReadPIOCapture();
     
     // Connected transmitter.  If this is set, we'll suppress reception
     // while the transmitter is sending a signal, to avoid receiving our
@@ -651,8 +763,6 @@ private:
     struct EventSub
     {
         EventSub(Subscriber *sub, bool rawPulses) : sub(sub), rawPulses(rawPulses) { }
-        EventSub(Subscriber *sub, std::initializer_list<IRCommandDesc> filters, bool rawPulses) :
-            sub(sub), filter(filters), rawPulses(rawPulses) { }
 
         // subscriber callback interface
         Subscriber *sub;
@@ -667,6 +777,70 @@ private:
     };
     std::list<EventSub> subscribers;
 
+    // Subscriber index.  This maps command codes to the subscribers
+    // with filters that match the codes, as a vector sorted by protocol
+    // and code, so finding the subscribers for a code is a binary search
+    // rather than a scan of every subscriber's filter list.  Subscribers
+    // with no filter receive all commands, so they're kept in a separate
+    // list.  The index is rebuilt when the subscriber list changes;
+    // subscriptions are normally all made during configuration, so that
+    // only happens once per session.
+    struct IndexEntry
+    {
+        uint64_t code;            // command code
+        uint8_t proId;            // protocol ID
+        uint8_t targetProId;      // protocol ID to report (differs from proId for a learned alias)
+        uint64_t targetCode;      // command code to report
+        EventSub *sub;            // subscriber
+
+        bool operator<(const IndexEntry &b) const { return proId < b.proId || (proId == b.proId && code < b.code); }
+    };
+    std::vector<IndexEntry> subIndex;
+    std::vector<EventSub*> unfilteredSubs;
+    bool subIndexDirty = true;
+
+    // rebuild the subscriber index
+    void RebuildIndex();
+
+    // is a command in the index?
+    bool IsIndexed(const IRCommandDesc &cmd) const;
+
+    // Learned code aliases.  This is the struct we store in flash.
+    struct LearnedCode
+    {
+        uint64_t code;            // learned command code
+        uint64_t targetCode;      // command code it's an alias for
+        uint8_t proId;            // learned protocol ID
+        uint8_t targetProId;      // target protocol ID
+        uint8_t reserved[6];
+    };
+    static const int MAX_LEARNED = 32;
+    struct LearnFile
+    {
+        uint16_t nCodes;
+        uint16_t reserved[3];
+        LearnedCode codes[MAX_LEARNED];
+    };
+    LearnFile learned;
+    static constexpr const char *LEARN_FILE_NAME = "irlearn.dat";
+
+    // save the learned codes to flash
+    bool SaveLearned();
+
+    // learn mode state
+    bool learnMode = false;
+    IRCommandDesc learnTarget;
+    uint64_t learnTimeout = 0;
+
+    // learn mode timeout, in microseconds
+    static const uint64_t LEARN_TIMEOUT = 30000000;
+
+    // record a learned code
+    void Learn(const IRCommandReceived &cmd);
+
+    // console command handler
+    void Command_irlearn(const ConsoleCommandContext *c);
+
     // are subscriber notifications enabled?
     bool notifyEnabled = true;
 };
@@ -10,6 +10,9 @@
 #include <ctype.h>
 #include <math.h>
 #include <limits.h>
+#include <stdlib.h>
+#include <new>
+#include <algorithm>
 
 // local project headers
 #include "JSON.h"
@@ -68,6 +71,31 @@ void JSONParser::Parse(const char *src, size_t len)
     Token tok;
     if (GetToken(tok, ts))
         errors.emplace_back(tok, "Extraneous text after top-level value definition\n");
+
+    // If we ran out of memory, the partial tree isn't usable, so discard
+    // it.  The parse stopped at the point of the failure, so drop any
+    // errors logged while unwinding from there (such as missing closing
+    // delimiters), since those are just artifacts of the early stop.
+    if (outOfMemory)
+    {
+        rootValue.Reset();
+        arrayScratch.clear();
+        arena.Clear();
+        while (errors.size() > outOfMemoryErrorIndex)
+            errors.pop_back();
+        errors.emplace_back(outOfMemoryTok, "Out of memory parsing JSON data");
+    }
+}
+
+void JSONParser::OutOfMemory(const Token &tok)
+{
+    // note the first failure only
+    if (!outOfMemory)
+    {
+        outOfMemory = true;
+        outOfMemoryTok = tok;
+        outOfMemoryErrorIndex = errors.size();
+    }
 }
 
 void JSONParser::SkipNewline(const char* &p, const char *endp)
@@ -80,6 +108,15 @@ void JSONParser::SkipNewline(const char* &p, const char *endp)
 
 bool JSONParser::ParseValue(Value &value, TokenizerState &ts)
 {
+    // If we've run out of memory, stop parsing: skip to the end of the
+    // source, so that all of the enclosing levels unwind immediately.
+    if (outOfMemory)
+    {
+        ts.src = ts.endp;
+        value.Set(Value::Type::Undefined);
+        return false;
+    }
+
     // check for an empty value
     Token tok;
     if (PeekToken(tok, ts))
@@ -119,6 +156,10 @@ bool JSONParser::ParseValue(Value &value, TokenizerState &ts)
             // consume the token
             GetToken(tok, ts);
             return true;
+
+        default:
+            // anything else starts a value; parse it below
+            break;
         }
     }
 
@@ -356,7 +397,7 @@ bool JSONParser::GetToken(Token &token, TokenizerState &ts)
                         // Add a new element containing the text of the string
                         // up to this point (the text preceding the first '\'),
                         // and remember it as the new pool string.
-                        poolEle = &stringPool.emplace_back(token.txt, ts.src - token.txt);
+                        poolEle = OpenPoolString(token.txt, ts.src - token.txt);
                     }
                     else
                     {
@@ -496,8 +537,14 @@ bool JSONParser::GetToken(Token &token, TokenizerState &ts)
                 poolEle->append(seg, ts.src - seg);
 
                 // set the token to point to the completed pool element
-                token.txt = poolEle->c_str();
                 token.len = poolEle->size();
+                if ((token.txt = ClosePoolString(poolEle)) == nullptr)
+                {
+                    token.txt = token.srcTxt;
+                    OutOfMemory(token);
+                    token.txt = "";
+                    token.len = 0;
+                }
 
                 // set the final length of the source text matched
                 token.srcLen = ts.src - token.srcTxt;
@@ -713,7 +760,7 @@ uint32_t JSONParser::ParseNumberToken(Token &token, TokenizerState &ts)
         case 'b':
         case 'B':
             // binary
-            for (ts.src ; ts.src < ts.endp && (*ts.src == '0' || *ts.src == '1') ; ++ts.src)
+            for ( ; ts.src < ts.endp && (*ts.src == '0' || *ts.src == '1') ; ++ts.src)
             {
                 i <<= 1;
                 i += *ts.src - '0';
@@ -856,7 +903,14 @@ uint32_t JSONParser::ParseNumberToken(Token &token, TokenizerState &ts)
 bool JSONParser::ParseObject(Value &value, TokenizerState &ts)
 {
     // initialize an empty object node
-    value.Set(Value::Type::Object);
+    if (!InitObject(value))
+    {
+        Token tok;
+        PeekToken(tok, ts);
+        OutOfMemory(tok);
+        ts.src = ts.endp;
+        return false;
+    }
     auto *obj = value.object;
 
     // iterate until we reach '}' or EOF
@@ -900,7 +954,14 @@ bool JSONParser::ParseObject(Value &value, TokenizerState &ts)
         // list is stored as a multimap, so we can store the new property even
         // if the name has already been defined in this object (which we just
         // flagged as an error if so).
-        PropValue *propVal = &obj->emplace(this, propName, propTok, Value::Type::Undefined)->val;
+        auto *prop = obj->emplace(this, propName, propTok, Value::Type::Undefined);
+        if (prop == nullptr)
+        {
+            OutOfMemory(propTok);
+            ts.src = ts.endp;
+            return false;
+        }
+        PropValue *propVal = &prop->val;
 
         // parse the ':', if we didn't find it already
         Token colonTok;
@@ -977,7 +1038,34 @@ bool JSONParser::ParseArray(Value &value, TokenizerState &ts)
     // initialize an empty array node
     value.Set(Value::Type::Array);
 
-    // iterate until we reach '}' or EOF
+#ifdef JSON_ARENA_ALLOCATOR
+    // Note where this array's elements start on the scratch stack, parse
+    // the elements, then move the finished list into the arena.  The
+    // element values are plain data in arena mode (they don't own their
+    // sub-objects), so they can be copied freely.
+    size_t base = arrayScratch.size();
+    bool ok = ParseArrayElements(value, ts);
+    size_t n = arrayScratch.size() - base;
+    if (!InitArray(value, n))
+    {
+        Token tok;
+        PeekToken(tok, ts);
+        OutOfMemory(tok);
+        ts.src = ts.endp;
+        ok = false;
+    }
+    for (size_t i = 0 ; i < value.array->size() ; ++i)
+        *value.array->Ele(i) = arrayScratch[base + i];
+    arrayScratch.resize(base);
+    return ok;
+#else
+    return ParseArrayElements(value, ts);
+#endif
+}
+
+bool JSONParser::ParseArrayElements(Value &value, TokenizerState &ts)
+{
+    // iterate until we reach ']' or EOF
     for (;;)
     {
         // peek to see if we're at the closing ']'
@@ -996,15 +1084,28 @@ bool JSONParser::ParseArray(Value &value, TokenizerState &ts)
             return true;
         }
 
-        // add a new slot to the array
+        // Add a new slot to the array.  In arena mode, parse into a
+        // temporary, and push it onto the scratch stack when done.  (We
+        // can't parse directly into the stack, since nested arrays push
+        // elements onto the same stack, which can move it in memory.)
+#ifdef JSON_ARENA_ALLOCATOR
+        ArrayEleValue tmp;
+        ArrayEleValue *ele = &tmp;
+#else
         ArrayEleValue *ele = value.array->emplace_back(new ArrayEleValue()).get();
+#endif
 
         // parse the value into the new slot
         TokenizerState tsPreValue = ts;
         ParseValue(*ele, ts);
         
         // the next token is the ending delimiter
-        PeekToken(ele->delimTok, ts);
+        IfValueKeepSourceRef(PeekToken(ele->delimTok, ts));
+
+#ifdef JSON_ARENA_ALLOCATOR
+        // stack the new element
+        arrayScratch.push_back(tmp);
+#endif
 
         // we should be at either a comma or the closing bracket
         Token sepTok;
@@ -1042,8 +1143,13 @@ bool JSONParser::ParseArray(Value &value, TokenizerState &ts)
 
 JSONParser::PropMap::Prop *JSONParser::AllocPropMapProp()
 {
+#ifdef JSON_ARENA_ALLOCATOR
+    // arena mode - allocate from the arena (the caller constructs the
+    // object in place)
+    return reinterpret_cast<PropMap::Prop*>(arena.Alloc(sizeof(PropMap::Prop), alignof(PropMap::Prop)));
+#else
     // allocate another pool block if needed
-    if (propMapPropPool == nullptr || propMapPropPool->nextFree >= _countof(PropMapPropPool::props))
+    if (propMapPropPool == nullptr || propMapPropPool->nextFree >= static_cast<int>(_countof(PropMapPropPool::props)))
     {
         auto *newPool = new PropMapPropPool();
         newPool->nxt = propMapPropPool;
@@ -1052,6 +1158,153 @@ JSONParser::PropMap::Prop *JSONParser::AllocPropMapProp()
 
     // allocate the next item
     return &propMapPropPool->props[propMapPropPool->nextFree++];
+#endif
+}
+
+std::string *JSONParser::OpenPoolString(const char *txt, size_t len)
+{
+#ifdef JSON_ARENA_ALLOCATOR
+    // build the string in the scratch buffer
+    stringScratch.assign(txt, len);
+    return &stringScratch;
+#else
+    // add a new element to the pool
+    return &stringPool.emplace_back(txt, len);
+#endif
+}
+
+const char *JSONParser::ClosePoolString(std::string *s)
+{
+#ifdef JSON_ARENA_ALLOCATOR
+    // copy the finished string into the arena
+    char *p = reinterpret_cast<char*>(arena.Alloc(s->size() + 1, 1));
+    if (p != nullptr)
+        memcpy(p, s->c_str(), s->size() + 1);
+    return p;
+#else
+    // the pool element is the permanent copy
+    return s->c_str();
+#endif
+}
+
+bool JSONParser::InitObject(Value &value)
+{
+#ifdef JSON_ARENA_ALLOCATOR
+    // allocate the object from the arena; on failure, leave the value
+    // as the shared (read-only) empty object
+    value.Reset();
+    void *mem = arena.Alloc(sizeof(PropMap), alignof(PropMap));
+    if (mem == nullptr)
+    {
+        value.Set(Value::Type::Object);
+        return false;
+    }
+    value.type = Value::Type::Object;
+    value.object = new (mem) PropMap();
+#else
+    value.Reset();
+    value.Set(Value::Type::Object);
+#endif
+    return true;
+}
+
+bool JSONParser::InitArray(Value &value, size_t n)
+{
+#ifdef JSON_ARENA_ALLOCATOR
+    // Allocate the array header and the contiguous element list.  On
+    // failure, leave the value as the shared (read-only) empty array.
+    value.Reset();
+    void *hdr = arena.Alloc(sizeof(Array), alignof(Array));
+    void *ele = n != 0 ? arena.Alloc(n * sizeof(ArrayEleValue), alignof(ArrayEleValue)) : nullptr;
+    if (hdr == nullptr || (n != 0 && ele == nullptr))
+    {
+        value.Set(Value::Type::Array);
+        return false;
+    }
+    value.type = Value::Type::Array;
+    value.array = new (hdr) Array();
+    if (n != 0)
+    {
+        value.array->ele = reinterpret_cast<ArrayEleValue*>(ele);
+        for (size_t i = 0 ; i < n ; ++i)
+            new (&value.array->ele[i]) ArrayEleValue();
+        value.array->n = n;
+    }
+#else
+    // allocate the vector, and populate it with new undefined elements
+    value.Reset();
+    value.Set(Value::Type::Array);
+    value.array->reserve(n);
+    for (size_t i = 0 ; i < n ; ++i)
+        value.array->emplace_back(new ArrayEleValue());
+#endif
+    return true;
+}
+
+void *JSONParser::Arena::Alloc(size_t size, size_t align)
+{
+    // figure the aligned offset of the next free byte in a block
+    auto AlignedOffset = [align](const Block *b) -> size_t {
+        uintptr_t base = reinterpret_cast<uintptr_t>(b + 1);
+        return ((base + b->used + align - 1) & ~static_cast<uintptr_t>(align - 1)) - base;
+    };
+
+    // try fitting the allocation into the current block
+    if (blocks != nullptr)
+    {
+        size_t ofs = AlignedOffset(blocks);
+        if (ofs + size <= blocks->size)
+        {
+            blocks->used = ofs + size;
+            bytesUsed += size;
+            return reinterpret_cast<uint8_t*>(blocks + 1) + ofs;
+        }
+    }
+
+    // Allocate a new block.  If the request is larger than the standard
+    // block size, give it a block of its own, and link it in behind the
+    // current block, so that the remaining space in the current block is
+    // still available for subsequent small allocations.
+    size_t blockDataSize = std::max(blockSize, size + align);
+    Block *b = reinterpret_cast<Block*>(malloc(sizeof(Block) + blockDataSize));
+    if (b == nullptr)
+        return nullptr;
+    b->size = blockDataSize;
+    b->used = 0;
+    bytesReserved += sizeof(Block) + blockDataSize;
+    nBlocks += 1;
+    if (size > blockSize / 2 && blocks != nullptr)
+    {
+        b->nxt = blocks->nxt;
+        blocks->nxt = b;
+    }
+    else
+    {
+        b->nxt = blocks;
+        blocks = b;
+    }
+
+    // allocate from the new block
+    size_t ofs = AlignedOffset(b);
+    b->used = ofs + size;
+    bytesUsed += size;
+    return reinterpret_cast<uint8_t*>(b + 1) + ofs;
+}
+
+void JSONParser::Arena::Clear()
+{
+    // free all blocks
+    for (Block *b = blocks, *nxt = nullptr ; b != nullptr ; b = nxt)
+    {
+        nxt = b->nxt;
+        free(b);
+    }
+
+    // reset statistics
+    blocks = nullptr;
+    bytesUsed = 0;
+    bytesReserved = 0;
+    nBlocks = 0;
 }
 
 const JSONParser::Value *JSONParser::Get(const char *expr) const
@@ -1065,15 +1318,33 @@ void JSONParser::Value::Set(Type type)
     this->type = type;
     switch (type)
     {
+#ifdef JSON_ARENA_ALLOCATOR
+    case Type::Array:
+        // arena mode - use the shared empty array
+        {
+            static Array emptyArray;
+            array = &emptyArray;
+        }
+        break;
+
+    case Type::Object:
+        // arena mode - use the shared empty object
+        {
+            static PropMap emptyObject;
+            object = &emptyObject;
+        }
+        break;
+#else
     case Type::Array:
         // instantiate the vector that will hold the array
-        array = new std::vector<std::unique_ptr<ArrayEleValue>>();
+        array = new Array();
         break;
 
     case Type::Object:
         // instantiate the map that will hold the property table
         object = new PropMap();
         break;
+#endif
 
     default:
         // no attached value; set the number field to zero so that it
@@ -1112,7 +1383,7 @@ const JSONParser::Value *JSONParser::Value::Get(const char *expr) const
             // indexed element; otherwise the result is 'undefined'.
             int idx = atoi(ele.txt);
             if (idx >= 0 && idx < static_cast<int>(array->size()))
-                return array->at(idx)->Get(expr);
+                return array->Ele(idx)->Get(expr);
             else
                 return &undefValue;
         }
@@ -1290,9 +1561,8 @@ void JSONParser::Value::ForEach(std::function<void(int, const Value*)> callback,
     if (type == Type::Array)
     {
         // array - invoke the callback for each array element, starting at index 0
-        int index = 0;
-        for (auto &ele : *array)
-            callback(index++, ele.get());
+        for (size_t i = 0, n = array->size() ; i < n ; ++i)
+            callback(static_cast<int>(i), array->Ele(i));
     }
     else if (implicitWrap)
     {
@@ -40,20 +40,84 @@
 
 // For the firmware build, don't keep source locations in the JSON
 // value tree, since we don't need them - they're meant for parsing
-// and diagnostic tools on the host side.
-#ifdef PICO_FIRMWARE_BUILD
+// and diagnostic tools on the host side.  Host programs that don't need
+// them either (such as the benchmarks in HostTest/, which measure the
+// firmware node layout) can define JSON_NO_SOURCE_REFS.
+#if defined(PICO_FIRMWARE_BUILD) || defined(JSON_NO_SOURCE_REFS)
 #define IfValueKeepSourceRef(...)
 #else
 #define JSON_VALUE_KEEP_SOURCE_REF
 #define IfValueKeepSourceRef(...) __VA_ARGS__
 #endif
 
+// For the firmware build, allocate the parse tree out of an arena
+// instead of the general malloc heap.  The firmware parses the config
+// once at startup and discards the whole tree as soon as configuration
+// is finished, so there's no need to free individual nodes.  The arena
+// packs the tree into a handful of large blocks, which avoids the
+// per-allocation malloc overhead, and more importantly avoids leaving
+// the heap fragmented with thousands of small holes when the tree is
+// deleted, just as the rest of the system is starting to allocate its
+// long-lived run-time objects.  In arena mode, array elements are also
+// stored contiguously, rather than as individually allocated nodes.
+//
+// Arena mode makes the tree read-only once parsed, since nodes can't be
+// individually reallocated, so the host tools that edit trees in place
+// (see GUIConfigTool/JSONExt.h) use the conventional heap mode.  Host
+// programs that only read trees can define JSON_ARENA_ALLOCATOR to use
+// arena mode as well.
+#if defined(PICO_FIRMWARE_BUILD) && !defined(JSON_ARENA_ALLOCATOR)
+#define JSON_ARENA_ALLOCATOR
+#endif
+
 class JSONParser
 {
 public:
     // destruction
     ~JSONParser();
 
+    // Arena allocator.  This is a simple bump allocator that carves
+    // allocations out of large blocks obtained from malloc.  Individual
+    // allocations can't be freed; the whole arena is released at once
+    // when the parser is destroyed.
+    class Arena
+    {
+    public:
+        Arena(size_t blockSize = 4096) : blockSize(blockSize) { }
+        ~Arena() { Clear(); }
+
+        // allocate memory, with the given alignment; returns null if
+        // the underlying malloc fails
+        void *Alloc(size_t size, size_t align = 8);
+
+        // release all blocks
+        void Clear();
+
+        // statistics - total bytes allocated to callers, total bytes
+        // obtained from malloc, number of blocks
+        size_t BytesUsed() const { return bytesUsed; }
+        size_t BytesReserved() const { return bytesReserved; }
+        int BlockCount() const { return nBlocks; }
+
+    protected:
+        // block header; the block's storage follows the header
+        struct Block
+        {
+            Block *nxt;       // next block in list
+            size_t size;      // size of the storage area
+            size_t used;      // bytes used so far
+        };
+        Block *blocks = nullptr;
+
+        // block allocation size
+        size_t blockSize;
+
+        // statistics
+        size_t bytesUsed = 0;
+        size_t bytesReserved = 0;
+        int nBlocks = 0;
+    };
+
     // Parse JSON source.  The source must consist entirely of single-byte
     // characters (pure ASCII or a single-byte code page such as Latin-1).
     //
@@ -134,6 +198,7 @@ public:
     // value node
     struct PropValue;
     struct ArrayEleValue;
+    struct Array;
     class PropMap;
     struct Value
     {
@@ -225,13 +290,10 @@ public:
         bool operator==(Type type) const { return type == this->type; }
 
         // array length; returns the default for non-array values
-        size_t Length(size_t defaultVal = 0) const { return type == Type::Array ? array->size() : defaultVal; }
+        inline size_t Length(size_t defaultVal = 0) const;
 
         // index an array element; returns undefined for non-arrays or for a non-existent element
-        const Value *Index(int i) const { 
-            return type == Type::Array && i >= 0 && i < static_cast<int>(array->size()) ?
-            (*array)[i].get() : &undefValue; 
-        }
+        inline const Value *Index(int i) const;
 
         // Array element iteration - invokes the callback for each array
         // element, in array order.  If 'this' isn't an array, the behavior
@@ -295,7 +357,9 @@ public:
         // reset to undefined, deleting any owned objects
         void Reset()
         {
-            // free any sub-object
+#ifndef JSON_ARENA_ALLOCATOR
+            // free any sub-object (in arena mode, sub-objects belong to
+            // the arena, so there's nothing to free here)
             switch (type)
             {
             case Type::Object:
@@ -307,7 +371,12 @@ public:
                 // delete the vector holding the array
                 delete array;
                 break;
+
+            default:
+                // other types have no separately allocated storage
+                break;
             }
+#endif
 
             // set to undefined, and clear the numeric value so that there's
             // no confusing cruft in debug views
@@ -315,7 +384,10 @@ public:
             number = 0;
         }
 
-        // set from various source types
+        // Set from various source types.  Note that in arena mode,
+        // Set(Type::Object) and Set(Type::Array) set the value to a shared
+        // empty container, which can't be modified; use JSONParser's
+        // InitObject() and InitArray() to create containers to populate.
         void Set(double d) { type = Type::Number; number = d; }
         void Set(const char *p, size_t len) { type = Type::String; string.Set(p, len); }
         void Set(Type type);
@@ -378,8 +450,8 @@ public:
             // object, as a property name/value hash table
             PropMap *object;
 
-            // array, as a vector of Value structs
-            std::vector<std::unique_ptr<ArrayEleValue>> *array;
+            // array
+            Array *array;
         };
     };
 
@@ -430,15 +502,22 @@ public:
                 hash = hf(name);
             }
 
+            // Note that the members are ordered to avoid alignment padding,
+            // since a large config file can have thousands of these.
             Value::StringWithLen name;
             int hash = 0;
-            PropValue val;
             Prop *nxt = nullptr;
+            PropValue val;
         };
 
+        // add a property; returns null if the allocation fails
         Prop *emplace(JSONParser *js, const Value::StringWithLen &name, const Token &tok, Value::Type type)
         {
-            Prop *prop = new (js->AllocPropMapProp()) Prop(name, tok, type);
+            void *mem = js->AllocPropMapProp();
+            if (mem == nullptr)
+                return nullptr;
+
+            Prop *prop = new (mem) Prop(name, tok, type);
             prop->nxt = this->props;
             this->props = prop;
             return prop;
@@ -469,8 +548,39 @@ public:
         ArrayEleValue(Type type) : Value(type) { }
 
         // ending delimiter token
-        Token delimTok;
+        IfValueKeepSourceRef(Token delimTok);
+    };
+
+    // Array element list.  Ele(i) returns a pointer to element i, which
+    // must be in range.
+#ifdef JSON_ARENA_ALLOCATOR
+    // In arena mode, the elements are stored contiguously in the arena.
+    struct Array
+    {
+        size_t size() const { return n; }
+        ArrayEleValue *Ele(size_t i) const { return &ele[i]; }
+
+        ArrayEleValue *ele = nullptr;
+        size_t n = 0;
+    };
+#else
+    // In heap mode, the elements are individually allocated, so that the
+    // host tools can insert elements into an existing array.
+    struct Array : std::vector<std::unique_ptr<ArrayEleValue>>
+    {
+        ArrayEleValue *Ele(size_t i) const { return (*this)[i].get(); }
     };
+#endif
+
+    // Initialize a value as an empty object, ready to be populated via
+    // object->emplace().  Returns false if the arena allocation fails,
+    // in which case the value is left as an empty, read-only object.
+    bool InitObject(Value &value);
+
+    // Initialize a value as an array of n undefined elements, ready to be
+    // populated via array->Ele(i).  Returns false if the arena allocation
+    // fails, in which case the value is left as an empty array.
+    bool InitArray(Value &value, size_t n);
 
     // Get a Value node by traversing an object/array dereference path
     // from the root node.  Use '.' for both property and array lookups;
@@ -509,6 +619,7 @@ public:
 
     // parse an array, within [ ] delimiters parsed by the caller
     bool ParseArray(Value &value, TokenizerState &ts);
+    bool ParseArrayElements(Value &value, TokenizerState &ts);
 
     // parse a token - returns false at eof
     bool GetToken(Token &token, TokenizerState &ts);
@@ -548,12 +659,24 @@ public:
     // this list, ensuring that each expanded string remains valid for
     // the life of the parse tree, and ensuring that it's deleted when
     // the parse tree is deleted.
+    //
+    // In arena mode, the expansion is built in stringScratch, and the
+    // finished string is copied into the arena.
     std::list<std::string> stringPool;
+    std::string stringScratch;
+
+    // Open a new pooled string, initialized with the given text, and
+    // close it out when complete.  Closing returns the final pointer to
+    // the string text, or null if the arena allocation fails.
+    std::string *OpenPoolString(const char *txt, size_t len);
+    const char *ClosePoolString(std::string *s);
 
     // Allocate a property object.  Since these objects are small, and we
     // might allocate a lot of them for a large JSON file, allocating them
     // as individual heap objects is inefficient.  Instead, we use a pooled
-    // allocator that allocates the objects out of fixed-size arrays.
+    // allocator that allocates the objects out of fixed-size arrays (in
+    // heap mode) or out of the arena (in arena mode).  Returns null if
+    // the arena allocation fails.
     PropMap::Prop *AllocPropMapProp();
 
     // PropMap::Prop pool
@@ -565,6 +688,27 @@ public:
     };
     PropMapPropPool *propMapPropPool = nullptr;
 
+    // Arena, for arena mode
+    Arena arena;
+
+    // Out-of-memory status.  If an arena allocation fails, we stop the
+    // parse and discard the partial tree, recording a single error at
+    // the point of the failure.  outOfMemoryErrorIndex is the size of
+    // the error list at the failure, so that we can remove any errors
+    // generated while unwinding the parse.
+    void OutOfMemory(const Token &tok);
+    bool outOfMemory = false;
+    Token outOfMemoryTok;
+    size_t outOfMemoryErrorIndex = 0;
+
+    // Array element scratch stack, for arena mode.  ParseArray() stacks
+    // each element here as it's parsed, since the element count isn't
+    // known until we reach the closing ']', then moves the finished
+    // element list into a contiguous block in the arena.  Nested arrays
+    // stack their elements above their parent's, so a single stack
+    // serves the whole parse.
+    std::vector<ArrayEleValue> arrayScratch;
+
     // Error list.  This captures a list of error messages generated
     // during parsing.
     struct Error
@@ -583,3 +727,16 @@ public:
     };
     std::list<Error> errors;
 };
+
+// Value array accessors.  These are defined out of line because they
+// need the complete Array type.
+inline size_t JSONParser::Value::Length(size_t defaultVal) const
+{
+    return type == Type::Array ? array->size() : defaultVal;
+}
+
+inline const JSONParser::Value *JSONParser::Value::Index(int i) const
+{
+    return type == Type::Array && i >= 0 && i < static_cast<int>(array->size()) ?
+        array->Ele(i) : &undefValue;
+}
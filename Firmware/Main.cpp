@@ -32,11 +32,14 @@
 #include "Pinscape.h"
 #include "PicoBoardType.h"
 #include "Main.h"
+#include "BootProfiler.h"
 #include "MultiCore.h"
 #include "FaultHandler.h"
 #include "Utils.h"
 #include "Config.h"
 #include "FlashStorage.h"
+#include "SettingsStore.h"
+#include "TaskScheduler.h"
 #include "USBIfc.h"
 #include "VendorIfc.h"
 #include "Version.h"
@@ -47,7 +50,7 @@
 #include "Nudge.h"
 #include "Accel.h"
 #include "NightMode.h"
-#include "crc32.h"
+#include "CRC32Engine.h"
 #include "Watchdog.h"
 #include "PicoLED.h"
 #include "StatusRGB.h"
@@ -121,6 +124,9 @@ static void Command_crashlog(const ConsoleCommandContext *ctx);
 //
 int main()
 {
+    // Initialize the boot profiler, to record the program entry time
+    bootProfiler.Init();
+
     // Initialize the fault handler
     faultHandler.Init();
 
@@ -144,7 +150,9 @@ int main()
     timeOfDay.RestoreAfterReset();
 
     // perform additional target board initialization
+    bootProfiler.Begin("Board init");
     PicoBoardType::Init();
+    bootProfiler.End();
 
     // Check for a watchdog reboot.  This indicates that the software
     // crashed or froze, and the watchdog intervened by resetting the
@@ -284,12 +292,21 @@ int main()
     // initialize our PIO helpers
     PIOHelper::Init();
 
+    // Initialize the CRC-32 engine, which we use to validate the flash
+    // file system directory and the config file
+    crc32Engine.Init();
+
     // Initialize the miniature flash file system
+    bootProfiler.Begin("Flash storage mount");
     flashStorage.Initialize();
     flashStorage.Mount(FLASHSTORAGE_CENTRAL_DIRECTORY_SIZE);
+    settingsStore.Mount();
+    bootProfiler.End();
 
     // Configure everything
+    bootProfiler.Begin("Configure");
     Configure(lastBootMode);
+    bootProfiler.End();
 
     // enable IRQ handling on the I2C bus controllers
     I2C::EnableIRQs(true);
@@ -308,7 +325,9 @@ int main()
     // against concurrent access.  So the ordering of the startup here
     // is critical, and this one small detail eliminates the need for
     // extra complexity and overhead elsewhere.
+    bootProfiler.Begin("Launch second core");
     LaunchSecondCore(SecondCoreMain);
+    bootProfiler.End();
 
     // Run the output manager task to apply the logical output state on
     // all ports to the physical device port states, then enable the
@@ -324,8 +343,10 @@ int main()
     // ensure glitch-free startup, with no ports randomly firing in the
     // brief time window between power-on and the completion of software
     // initialization.
+    bootProfiler.Begin("Enable outputs");
     OutputManager::Task();
     OutputManager::EnablePhysicalOutputs(true);
+    bootProfiler.End();
 
     // Set the main loop watchdog to a solenoid-friendly short timeout.  The
     // watchdog is an on-board Pico peripheral that runs a countdown timer,
@@ -370,6 +391,55 @@ int main()
     // if startup crashes, so that they don't have to reset it manually.
     WatchdogEnable(100);
 
+    // Initialize the task scheduler
+    taskScheduler.Init();
+
+    // Register the main loop tasks.  Tasks run in priority order, highest
+    // first, and in the order added here within a priority tier.  This
+    // isn't the order of the old fixed main loop: the tiers move the
+    // housekeeping tasks (Reset, Logger, IR Receiver) from the top and
+    // middle of the loop to after the latency-sensitive work.
+    //
+    // Priority 2 - every pass.  The host interfaces come first, to pick
+    // up incoming USB requests, followed by the input devices (nudge,
+    // plunger, and the axis accumulators that sample them), then ZB Launch
+    // and the buttons, which read the inputs just updated.  Outputs come
+    // after the buttons, so that a button-driven output change is applied
+    // on the same pass, and the I2C and 74HC595 bus schedulers come last,
+    // to send the device updates that the outputs just queued.
+    //
+    // Priority 1 - housekeeping that has pending work to carry out, run
+    // at a fixed interval or early when ready.  Reset only has to notice a
+    // requested reboot within a millisecond or so; the logger just drains
+    // its buffer to the host; and the IR receiver's pulses are buffered by
+    // the capture interrupt or DMA, so decoding can wait for the input
+    // tier without losing anything.  The flash writer carries out one step
+    // of a background save when one is queued.
+    //
+    // Priority 0 - cosmetic status indicators and the TV ON timer, which
+    // only need to run every few milliseconds.
+    taskScheduler.Add("USB", []() { usbIfc.Task(); }, 0, 2);
+    taskScheduler.Add("XInput", []() { xInput.Task(); }, 0, 2);
+    taskScheduler.Add("Vendor Ifc", []() { psVendorIfc.Task(); }, 0, 2);
+    taskScheduler.Add("Nudge", []() { nudgeDevice.Task(); }, 0, 2);
+    taskScheduler.Add("Plunger", []() { plunger.Task(); }, 0, 2);
+    taskScheduler.Add("Axis Accum", []() { AccumAxisSource::SampleAll(); }, 0, 2);
+    taskScheduler.Add("ZB Launch", []() { zbLaunchBall.Task(); }, 0, 2);
+    taskScheduler.Add("Buttons", []() { Button::Task(); }, 0, 2);
+    taskScheduler.Add("Outputs", []() { OutputManager::Task(); }, 0, 2);
+    taskScheduler.Add("I2C", []() { I2C::Task(); }, 0, 2);
+    taskScheduler.Add("74HC595", []() { C74HC595::Task(); }, 0, 2);
+    taskScheduler.Add("Reset", []() { picoReset.Task(); }, 1000, 1);
+    taskScheduler.Add("Logger", []() { logger.Task(); }, 1000, 1);
+    taskScheduler.Add("IR Receiver", []() { irReceiver.Task(); }, 2000, 1, []() { return irReceiver.IsReceiving(); });
+    taskScheduler.Add("Flash Writer", []() { flashStorage.Task(); }, 100000, 1, []() { return flashStorage.IsJobPending(); });
+    taskScheduler.Add("Pico LED", []() { picoLED.Task(); }, 10000, 0);
+    taskScheduler.Add("Status RGB", []() { statusRGB.Task(); }, 10000, 0);
+    taskScheduler.Add("TV ON", []() { tvOn.Task(); }, 5000, 0);
+
+    // Startup is complete - close out the boot profiler trace
+    bootProfiler.Finish();
+
     // Run the main loop
     MainLoop();
 
@@ -412,6 +482,7 @@ static void Configure(PicoReset::BootMode bootMode)
 
     // load the configuration file from flash
     JSONParser json;
+    bootProfiler.Begin("Config::Load");
     bool configValid = config.Load(bootMode, json);
 
     // collect statistics - memory usage after the JSON load
@@ -420,6 +491,7 @@ static void Configure(PicoReset::BootMode bootMode)
     // Configure the logger.  This is the first thing we configure
     // (after loading the configuration itself) so that the logger can
     // capture any error messages that occur during initialization.
+    bootProfiler.Next("Loggers");
     logger.Configure(json);
 
     // note the config status for the log
@@ -469,19 +541,24 @@ static void Configure(PicoReset::BootMode bootMode)
     uartLogger.Configure(json);
 
     // Configure the expansion board setup
+    bootProfiler.Next("Expansion board");
     expansionBoard.Configure(json);
 
     // Cycle power to the peripherals, if possible
+    bootProfiler.Next("Peripheral power cycle");
     expansionBoard.CyclePeripheralPower();
 
     // Configure the PWM manager
+    bootProfiler.Next("PWM manager");
     pwmManager.Configure(json);
 
     // Configure and initialize I2C and SPI buses.  Note that bus
     // configuration must happen before any devices on the respective buses
     // are configured, so that the bus manager objectss have been created
     // before the device objects are added to their respective bus managers.
+    bootProfiler.Next("I2C");
     I2C::Configure(json);
+    bootProfiler.Next("SPI");
     SPI::Configure(json);
 
     //
@@ -493,48 +570,71 @@ static void Configure(PicoReset::BootMode bootMode)
     //
 
     // Configure RTC clock/calendar chips
+    bootProfiler.Next("DS1307");
     DS1307::Configure(json);
+    bootProfiler.Next("DS3231M");
     DS3231M::Configure(json);
+    bootProfiler.Next("RV3032C7");
     RV3032C7::Configure(json);
 
     // Configure GPIO extenders.  These must go first, to allow them to
     // be used as control outputs or sense inputs connected to other
     // chips.
+    bootProfiler.Next("PCA9555");
     PCA9555::Configure(json);
 
     // Configure PWM controllers and shift-register output chips
+    bootProfiler.Next("TLC59116");
     TLC59116::Configure(json);
+    bootProfiler.Next("PCA9685");
     PCA9685::Configure(json);
+    bootProfiler.Next("TLC5940");
     TLC5940::Configure(json);
+    bootProfiler.Next("TLC5947");
     TLC5947::Configure(json);
+    bootProfiler.Next("74HC595");
     C74HC595::Configure(json);
+    bootProfiler.Next("PWMWorker");
     PWMWorker::Configure(json);
 
     // Configure shift-register input chips
+    bootProfiler.Next("74HC165");
     C74HC165::Configure(json);
 
     // Configure accelerometer devices
+    bootProfiler.Next("LIS3DH");
     LIS3DH::Configure(json);
+    bootProfiler.Next("LIS3DSH");
     LIS3DSH::Configure(json);
+    bootProfiler.Next("MC3416");
     MC3416::Configure(json);
+    bootProfiler.Next("MMA8451Q");
     MMA8451Q::Configure(json);
+    bootProfiler.Next("MXC6655XA");
     MXC6655XA::Configure(json);
 
     // Configure the ADC manager and outboard ADC chips
+    bootProfiler.Next("ADC manager");
     adcManager.Configure(json);
 
     // Configure distance sensor/proximity sensor chips
+    bootProfiler.Next("VL6180X");
     VL6180X::Configure(json);
+    bootProfiler.Next("VCNL4010");
     VCNL4010::Configure(json);
 
     // Configure quadrature encoder chips
+    bootProfiler.Next("AEDR8300");
     AEDR8300::Configure(json);
 
     // Configure image sensor chips
+    bootProfiler.Next("TCD1103");
     TCD1103::Configure(json);
+    bootProfiler.Next("TSL1410R");
     TSL1410R::Configure(json);
 
     // Get the configured virtual HID input devices
+    bootProfiler.Next("USB interfaces");
     bool useKb = keyboard.Configure(json);
     bool useGamepad = gamepad.Configure(json);
     bool useXInput = xInput.Configure(json);
@@ -628,6 +728,7 @@ static void Configure(PicoReset::BootMode bootMode)
     }
 
     // USB interfaces are configured - initialize the Tinyusb subsystem
+    bootProfiler.Next("USB init");
     usbIfc.Init();
 
     // Configure USB CDC (virtual COM port) logging
@@ -642,28 +743,36 @@ static void Configure(PicoReset::BootMode bootMode)
     //
 
     // configure the buttons inputs
+    bootProfiler.Next("Buttons");
     Button::Configure(json);
 
     // configure outputs
+    bootProfiler.Next("Outputs");
     OutputManager::Configure(json);
 
     // configure TV ON
+    bootProfiler.Next("TV ON");
     tvOn.Configure(json);
 
     // configure the IR remote control features
+    bootProfiler.Next("IR remote");
     irTransmitter.Configure(json);
     irReceiver.Configure(json);
     psVendorIfc.ConfigureIR(json);
 
     // configure the RGB status LED
+    bootProfiler.Next("Status LED");
     statusRGB.Configure(json);
 
     // configure the nudge device interface
+    bootProfiler.Next("Nudge");
     nudgeDevice.Configure(json);
 
     // configure the plunger sensor and ZB Launch
+    bootProfiler.Next("Plunger");
     plunger.Configure(json);
     zbLaunchBall.Configure(json);
+    bootProfiler.End();
 }
 
 // ---------------------------------------------------------------------------
@@ -707,49 +816,15 @@ static void MainLoop()
     // inputs can also benefit from fast polling, for local processing on the
     // device between USB HID updates.  Most other devices and tasks can
     // tolerate longer update cycles without any performance impact.
+    //
+    // The task list itself is kept in the task scheduler (TaskScheduler.h),
+    // which lets the housekeeping tasks run on longer periods than the
+    // latency-critical tasks.  The tasks are registered in main(), just
+    // before we enter the loop.
     for (uint64_t tTopOfLoop = time_us_64(), mainLoopSafeTime = tTopOfLoop + 120000000 ; ; )
     {
-        // check for a pending Pico reset
-        picoReset.Task();
-
-        // Run USB tasks on the main USB interface and our sub-interfaces
-        usbIfc.Task();
-        xInput.Task();
-        psVendorIfc.Task();
-
-        // Run logging tasks
-        logger.Task();
-
-        // run IR remote control tasks
-        irReceiver.Task();
-
-        // Blink the Pico's on-board LED, as a visual indication that the
-        // software is still running; and update the RGB status LED, if
-        // present.
-        picoLED.Task();
-        statusRGB.Task();
-
-        // Run nudge device tasks
-        nudgeDevice.Task();
-
-        // Run plunger tasks
-        plunger.Task();
-        zbLaunchBall.Task();
-
-        // Run button tasks
-        Button::Task();
-
-        // Run output manager tasks
-        OutputManager::Task();
-
-        // Run TV-ON tasks
-        tvOn.Task();
-
-        // Run I2C tasks (schedules bus access for all of the I2C devices)
-        I2C::Task();
-
-        // Run 74HC595 tasks
-        C74HC595::Task();
+        // Run all of the subsystem tasks that are due on this pass
+        taskScheduler.RunPass();
 
         // Update the watchdog counter.  This is our keep-alive signal
         // to the watchdog, letting the watchdog know that the main loop
@@ -823,14 +898,23 @@ static void SecondCoreMain()
     // initialize the fault handler on this core
     faultHandler.Init();
 
+    // set up per-task profiling for our loop
+    taskScheduler.InitCycleCounter();
+    int buttonTask = taskScheduler.AddSecondCoreTask("Button polling");
+    int c74hc165Task = taskScheduler.AddSecondCoreTask("74HC165");
+
     // enter our main loop
     for (uint64_t t0 = time_us_64() ; ; )
     {
         // run second-core button polling
+        uint32_t c0 = TaskScheduler::StartCycles();
         Button::SecondCoreDebouncedSource::SecondCoreTask();
+        taskScheduler.ProfileSecondCoreTask(buttonTask, TaskScheduler::ElapsedCycles(c0));
 
         // run 74HC165 second-core tasks
+        c0 = TaskScheduler::StartCycles();
         C74HC165::SecondCoreTask();
+        taskScheduler.ProfileSecondCoreTask(c74hc165Task, TaskScheduler::ElapsedCycles(c0));
 
         // update statistics
         uint64_t now = time_us_64();
@@ -860,6 +944,7 @@ static void SecondCoreMain()
         {
             secondCoreLoopStatsResetRequested = false;
             secondCoreLoopStats.Reset();
+            taskScheduler.ResetSecondCoreStats();
         }
     }
 }
@@ -968,6 +1053,10 @@ static void Command_loopstats(const ConsoleCommandContext *c)
             nf.Format("%llu", s2.nLoops),
             s2.totalTime / s2.nLoops,
             s2.maxTime);
+
+        // show the per-task statistics
+        c->Print("\n");
+        taskScheduler.ShowStats(c);
     };
 
     // with no arguments, just show the stats
@@ -985,6 +1074,7 @@ static void Command_loopstats(const ConsoleCommandContext *c)
         else if (strcmp(a, "-r") == 0 || strcmp(a, "--reset") == 0)
         {
             mainLoopStats.Reset();
+            taskScheduler.ResetStats();
             secondCoreLoopStatsResetRequested = true;            
             c->Print("Main loop statistics reset\n");
         }
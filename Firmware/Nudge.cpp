@@ -246,7 +246,7 @@ bool NudgeDevice::CommitSettings()
     // save it under the device name
     char fname[32];
     GetSettingsFilename(fname, sizeof(fname));
-    return config.SaveStruct(fname, &s, sizeof(s), FLASH_SECTOR_SIZE);
+    return config.SaveSettings(fname, &s, sizeof(s));
 }
 
 // restore settings from flash
@@ -259,7 +259,7 @@ bool NudgeDevice::RestoreSettings(bool *pFileExists)
     // load the settings file
     SettingsFile &s = settingsFile;
     bool fileExists = false;
-    bool loaded = config.LoadStruct(fname, &s, sizeof(s), &fileExists);
+    bool loaded = config.LoadSettings(fname, &s, sizeof(s), &fileExists);
 
     // pass back the file-exists status to the caller if desired
     if (pFileExists != nullptr)
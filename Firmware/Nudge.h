@@ -242,7 +242,9 @@ public:
     // Save/restore flash settings.  These return true on success, false
     // on failure.  Restore applies defaults and returns sucess (true)
     // if the settings file simply doesn't exist; fileExists can be used
-    // to distinguish that case from error conditions.
+    // to distinguish that case from error conditions.  Commit stores the
+    // settings as a record in the wear-levelled settings store, which
+    // normally takes a single flash page program.
     bool CommitSettings();
     bool RestoreSettings(bool *fileExists = nullptr);
 
@@ -74,6 +74,9 @@ std::unordered_map<std::string, OutputManager::Port*> OutputManager::portsByName
 // has the output manager been configured yet?
 bool OutputManager::isConfigured = false;
 
+// high-resolution source evaluation flag
+bool OutputManager::DataSource::calcHighRes = false;
+
 // is the output manager Task() routine suspended?
 bool OutputManager::isSuspended = false;
 
@@ -137,6 +140,7 @@ void OutputManager::SetLedWizPBA(int portNum, uint8_t profile)
 //     device: {  },                 // device specification - see DEVICE Below
 //     gamma: <bool>,                // apply gamma correction to the physical output level
 //     noisy: <bool>,                // disable the device when Night Mode is active
+//     highRes: <bool>,              // pass computed/waveform levels to the device at 16-bit resolution (for 12-bit PWM devices)
 //     inverted: <bool>,             // invert the logical PWM level at the physical port
 //     timeLimit: <milliseconds>,    // Flipper Logic limit time for high-level activation
 //     powerLimit: <number>,         // Flipper Logic power limit (0..255) after time limit expires
@@ -194,6 +198,7 @@ void OutputManager::SetLedWizPBA(int portNum, uint8_t profile)
 //                                    // assigned by the PWMWorker software on the other Pico, NOT the physical GPIO port numbers
 //                                    // on the other Pico; each physical GPIO used as a PWM output is assigned an abstract Worker
 //                                    // Pico port number 0-23)
+//     fadeTime: <milliseconds>,      // optional device-side fade time; the worker fades to each new level over this time
 //  
 //   type: "zblaunch",                // ZB Launch control virtual port; receives ZB launch mode status; no physical device attached
 //     
@@ -349,6 +354,7 @@ void OutputManager::Configure(JSONParser &json)
 
         // configure additional options
         port.noisy = value->Get("noisy")->Bool();
+        port.highRes = value->Get("highRes")->Bool();
         port.flipperLogic.dtHighPowerMax = value->Get("timeLimit")->UInt32(0) * 1000;
         port.flipperLogic.dtCooling = value->Get("coolingTime")->UInt32(0) * 1000;
         port.flipperLogic.reducedPowerLevel = value->Get("powerLimit")->UInt8(0);
@@ -430,7 +436,16 @@ void OutputManager::Configure(JSONParser &json)
                 // a hard error if the result is another type, but the
                 // conversions might not be what the user expected, so
                 // a warning might be helpful for troubleshooting.
-                if (auto t = source->Calc().type; t != SourceVal::Type::UInt8)
+                //
+                // High-resolution ports are the exception for float
+                // results, since they keep the fractional part of a
+                // float on the 0..255 scale.
+                if (portsByNumber[index + 1]->highRes)
+                {
+                    if (auto t = source->CalcHighRes().type; t == SourceVal::Type::RGB || t == SourceVal::Type::Vector)
+                        Log(LOG_WARNING, "outputs[%d].source: %s result will be clipped to 0..255 range\n", index, SourceVal::TypeName(t));
+                }
+                else if (auto t = source->Calc().type; t != SourceVal::Type::UInt8)
                     Log(LOG_WARNING, "outputs[%d].source: %s result will be clipped to 0..255 range\n", index, SourceVal::TypeName(t));
             }
 
@@ -1298,8 +1313,11 @@ void OutputManager::Port::SetLedWizPBA(uint8_t profile)
 }
 
 // set the logical port level
-void OutputManager::Port::SetLogicalLevel(uint8_t newLevel)
+void OutputManager::Port::SetLogicalLevel16(uint16_t newLevel16)
 {
+    // figure the 8-bit level, for the flipper logic thresholds
+    uint8_t newLevel = static_cast<uint8_t>(newLevel16 >> 8);
+
     // Update the flipper logic state, if enabled
     if (flipperLogic.enabled)
     {
@@ -1319,7 +1337,7 @@ void OutputManager::Port::SetLogicalLevel(uint8_t newLevel)
             // Switch to Ready state if the new level is zero.  Note that switching
             // to low power doesn't clear a triggered condition; the port must be
             // switched completely off.  This also starts the cooling-off period.
-            if (newLevel == 0)
+            if (newLevel16 == 0)
             {
                 flipperLogic.state = FlipperLogic::State::Ready;
                 flipperLogic.tCoolingEnd = time_us_64() + flipperLogic.dtCooling;
@@ -1330,6 +1348,7 @@ void OutputManager::Port::SetLogicalLevel(uint8_t newLevel)
     
     // remember the new logical level
     logLevel = newLevel;
+    logLevel16 = newLevel16;
 
     // apply the change to the underlying physical/virtual output
     Apply();
@@ -1544,20 +1563,86 @@ uint8_t OutputManager::Port::LedWizState::GetLiveLogLevel() const
     }
 }
 
+uint16_t OutputManager::Port::LedWizState::GetLiveLogLevel16() const
+{
+    // off if the mode isn't active or the SBA state is OFF
+    if (!mode || !on)
+        return 0;
+
+    // Figure the phase as a 16-bit fraction of the cycle.  This is the
+    // same fixed-point calculation as in GetLiveLogLevel() (see the
+    // explanation there), with the same 2^24/N multipliers, but keeping
+    // 16 bits of the fraction rather than 8.  The high byte of the
+    // result is the same as the 8-bit phase.
+    static const uint32_t inverseUsecPerQuantum[] = { // indexed by LedWiz speed value
+        0, 17172, 8590, 5726, 4295, 3436, 2863, 2454
+    };
+    auto Phase = [this]() -> uint32_t { return static_cast<uint16_t>((time_us_64() * inverseUsecPerQuantum[period]) >> 16); };
+
+    // Compute the ramp waveforms directly, as the 8-bit tables in
+    // GetLiveLogLevel() scaled to 16 bits, so that the result at each
+    // table point (phase N*256) is exactly the table entry N times 257.
+    // The rising ramps are 2N+1 (sawtooth) or 2N (ramp up/on) on the
+    // 8-bit scale, clipped at 255, and the falling ramps are 2*(255-N).
+    // Use the 8-bit level for the other profiles.
+    auto Rise = [](uint32_t phase, uint32_t ofs) -> uint16_t {
+        uint32_t v = ((phase*2 + ofs) * 257) >> 8;
+        return v > 65535 ? 65535 : static_cast<uint16_t>(v);
+    };
+    auto Fall = [](uint32_t phase) -> uint16_t {
+        return phase >= 65280 ? 0 : static_cast<uint16_t>(((65280 - phase) * 514) >> 8);
+    };
+    uint32_t phase;
+    switch (profile)
+    {
+    case 129:
+        // sawtooth
+        phase = Phase();
+        return phase < 32768 ? Rise(phase, 256) : Fall(phase);
+
+    case 131:
+        // on/ramp down
+        phase = Phase();
+        return phase < 32768 ? 65535 : Fall(phase);
+
+    case 132:
+        // ramp up/on
+        phase = Phase();
+        return phase < 32768 ? Rise(phase, 0) : 65535;
+
+    default:
+        // other profiles have no intermediate levels
+        return static_cast<uint16_t>(GetLiveLogLevel() * 257);
+    }
+}
+
 // Run periodic output port tasks
 void OutputManager::Port::Task()
 {
     // If we have a data source, update it, interpreting the computed
-    // value as an 8-bit integer.  Bypass the calculation and turn the
-    // port off if USB isn't active (connected and not suspended).
+    // value as an 8-bit integer, or as a 16-bit integer on a high-res
+    // port.  Bypass the calculation and turn the port off if USB isn't
+    // active (connected and not suspended).
     //
     // Otherwise, if the port is in LedWiz mode, compute the current
     // level from the LedWiz port state.  This might change dynmically,
     // since some LW port states are waveforms.
     if (source != nullptr)
-        SetLogicalLevel(usbIfc.IsConnectionActive() || enableSourceDuringSuspend ? source->Calc().AsUInt8() : 0);
+    {
+        if (!usbIfc.IsConnectionActive() && !enableSourceDuringSuspend)
+            SetLogicalLevel(0);
+        else if (highRes)
+            SetLogicalLevel16(source->CalcHighRes().AsUInt16());
+        else
+            SetLogicalLevel(source->Calc().AsUInt8());
+    }
     else if (lw.mode)
-        SetLogicalLevel(lw.GetLiveLogLevel());
+    {
+        if (highRes)
+            SetLogicalLevel16(lw.GetLiveLogLevel16());
+        else
+            SetLogicalLevel(lw.GetLiveLogLevel());
+    }
 
     // if flipper logic is armed, check timer expiration
     if (flipperLogic.state == FlipperLogic::State::Armed && time_us_64() >= flipperLogic.tHighPowerCutoff)
@@ -1574,13 +1659,14 @@ void OutputManager::Port::Task()
 // Apply the current nominal level to the physical output
 void OutputManager::Port::Apply()
 {
-    // start with the logical level
+    // start with the logical level, at 8-bit and 16-bit resolution
     uint8_t v = logLevel;
+    uint16_t v16 = logLevel16;
     
     // if this is a noisy output, and Night Mode is activated, disable it
     // entirely (set the effective output level to zero)
     if (noisy && nightModeControl.Get())
-        v = 0;
+        v = 0, v16 = 0;
 
     // Apply flipper logic if triggered.  Flipper logic sets a maximum level
     // for the output, so use the lesser of the current nominal level or the
@@ -1591,11 +1677,11 @@ void OutputManager::Port::Apply()
     {
         // attenuate if flipper logic is triggered
         if (flipperLogic.state == FlipperLogic::State::Triggered)
-            v = reduced;
+            v = reduced, v16 = reduced * 257;
 
         // attenuate during the cooling-off period
         if (now < flipperLogic.tCoolingEnd)
-            v = reduced;
+            v = reduced, v16 = reduced * 257;
     }
 
     // When the effective (physical) output level transitions from high
@@ -1615,9 +1701,14 @@ void OutputManager::Port::Apply()
     // at the low end of the scale, where 8-bit simply maps to zero.
     // Gamma correction is non-linear, so logic inversion must be
     // applied after gamma correction, so delegating gamma to the device
-    // handler also forces us to delegate inversion.
+    // handler also forces us to delegate inversion.  High-resolution
+    // ports pass the 16-bit level, so that the device can use any
+    // extra precision it has available.
     outLevel = v;
-    device->Set(v);
+    if (highRes)
+        device->Set16(v16);
+    else
+        device->Set(v);
 }
 
 // set the underlying physical device port to fully OFF
@@ -2019,6 +2110,11 @@ void OutputManager::PWMGPIODev::Set(uint8_t level)
     pwmManager.SetLevel(gp, ToFloatPhys(level));
 }
 
+void OutputManager::PWMGPIODev::Set16(uint16_t level)
+{
+    pwmManager.SetLevel(gp, ToFloatPhys16(level));
+}
+
 uint8_t OutputManager::PWMGPIODev::Get() const
 {
     return static_cast<uint8_t>(pwmManager.GetLevel(gp) * 255.0f);
@@ -2038,6 +2134,10 @@ void OutputManager::PWMWorkerDev::Configure(const JSONParser::Value *val)
 
     // delegate the gamma and logic inversion settings to the device
     worker->ConfigurePort(port, gamma, inverted);
+
+    // set the device-side fade time, if specified
+    if (int fadeTime = val->Get("fadeTime")->Int(0); fadeTime > 0)
+        worker->ConfigureFade(port, static_cast<uint16_t>(std::min(fadeTime, 65535)));
 }
 
 // apply port-level properties
@@ -2104,8 +2204,23 @@ void OutputManager::TLC59116Dev::Set(uint8_t level)
     // the same linear 8-bit duty cycle scale that we use internally, so
     // we can simply pass our abstract 0..255 level straight through to
     // the chip without any rescaling.  We just have to apply gamma and
-    // logic inversion as usual.
-    chip->Set(port, To8BitPhys(level));
+    // logic inversion as usual.  If the chip is dithering, apply gamma
+    // at 12-bit resolution instead, so that the chip can render the
+    // extra low-end steps through dithering.
+    if (chip->IsDithered())
+        chip->Set12(port, To12BitPhys(level));
+    else
+        chip->Set(port, To8BitPhys(level));
+}
+
+void OutputManager::TLC59116Dev::Set16(uint16_t level)
+{
+    // use the 16-bit level if the chip can render the extra precision
+    // through dithering, otherwise just use the 8-bit level
+    if (chip->IsDithered())
+        chip->Set12(port, To12BitPhys16(level));
+    else
+        chip->Set(port, To8BitPhys(static_cast<uint8_t>(level >> 8)));
 }
 
 uint8_t OutputManager::TLC59116Dev::Get() const
@@ -2147,6 +2262,12 @@ void OutputManager::TLC5940Dev::Set(uint8_t level)
     chain->Set(port, To12BitPhys(level));
 }
 
+void OutputManager::TLC5940Dev::Set16(uint16_t level)
+{
+    // set the port from the 16-bit level, rescaled to the chip's 12 bits
+    chain->Set(port, To12BitPhys16(level));
+}
+
 uint8_t OutputManager::TLC5940Dev::Get() const
 {
     // rescale from TLC5940 native 12-bit to DOF normalized 8-bit representation
@@ -2187,6 +2308,12 @@ void OutputManager::TLC5947Dev::Set(uint8_t level)
     chain->Set(port, To12BitPhys(level));
 }
 
+void OutputManager::TLC5947Dev::Set16(uint16_t level)
+{
+    // set the port from the 16-bit level, rescaled to the chip's 12 bits
+    chain->Set(port, To12BitPhys16(level));
+}
+
 uint8_t OutputManager::TLC5947Dev::Get() const
 {
     // rescale from TLC5947 native 12-bit to DOF normalized 8-bit representation
@@ -2223,8 +2350,13 @@ void OutputManager::C74HC595Dev::Set(uint8_t level)
 {
     // The chip can operate in digital mode or 8-bit PWM mode.  In either
     // case, we can set the DOF 8-bit level directly; if the chip is in
-    // digital mode, it will interpret any non-zero value as ON.
-    chain->Set(port, To8BitPhys(level));
+    // digital mode, it will interpret any non-zero value as ON.  In the
+    // wide (10- or 12-bit) PWM modes, apply gamma at 12-bit resolution,
+    // for smoother fades at the low end of the brightness range.
+    if (chain->IsWide())
+        chain->Set12(port, To12BitPhys(level));
+    else
+        chain->Set(port, To8BitPhys(level));
 }
 
 uint8_t OutputManager::C74HC595Dev::Get() const
@@ -2267,6 +2399,12 @@ void OutputManager::PCA9685Dev::Set(uint8_t level)
     chip->Set(port, To12BitPhys(level));
 }
 
+void OutputManager::PCA9685Dev::Set16(uint16_t level)
+{
+    // set the port from the 16-bit level, rescaled to the chip's 12 bits
+    chip->Set(port, To12BitPhys16(level));
+}
+
 uint8_t OutputManager::PCA9685Dev::Get() const
 {
     // rescale from the chip's native 12-bit PWM levels to DOF normalized 8-bit levels
@@ -3171,8 +3309,10 @@ OutputManager::SourceVal OutputManager::RampSource::Calc()
     // figure the time within our cycle
     float t = static_cast<float>(time_us_64() % period_us);
 
-    // figure a linear ramp within the cycle
-    return SourceVal::MakeUInt8(static_cast<uint8_t>(t / static_cast<float>(period_us) * 255.0f));
+    // figure a linear ramp within the cycle, keeping the fraction for
+    // a high-resolution port
+    float v = t / static_cast<float>(period_us) * 255.0f;
+    return calcHighRes ? SourceVal::MakeFloat(v) : SourceVal::MakeUInt8(static_cast<uint8_t>(v));
 }
 
 // ---------------------------------------------------------------------------
@@ -3185,8 +3325,10 @@ OutputManager::SourceVal OutputManager::SineSource::Calc()
     // figure the time within our cycle
     float t = static_cast<float>(time_us_64() % period_us);
 
-    // figure the position in the sine wave over this period
-    return SourceVal::MakeUInt8(static_cast<uint8_t>((sinf(6.28318531f * (t / static_cast<float>(period_us))) * 127.0f) + 127.0f));
+    // figure the position in the sine wave over this period, keeping
+    // the fraction for a high-resolution port
+    float v = (sinf(6.28318531f * (t / static_cast<float>(period_us))) * 127.0f) + 127.0f;
+    return calcHighRes ? SourceVal::MakeFloat(v) : SourceVal::MakeUInt8(static_cast<uint8_t>(v));
 }
 
 // ---------------------------------------------------------------------------
@@ -3201,8 +3343,10 @@ OutputManager::SourceVal OutputManager::SawtoothSource::Calc()
 
     // Figure a sawtooth ramp within the cycle.  The rising part is the
     // first half of the cycle, the falling part is the second half.
+    // Keep the fraction for a high-resolution port.
     float half = static_cast<float>(period_us) / 2.0f;
-    return SourceVal::MakeUInt8(static_cast<uint8_t>(t <= half ? (t/half * 255.0f) : (510.0f - (t/half * 255.0f))));
+    float v = t <= half ? (t/half * 255.0f) : (510.0f - (t/half * 255.0f));
+    return calcHighRes ? SourceVal::MakeFloat(v) : SourceVal::MakeUInt8(static_cast<uint8_t>(v));
 }
 
 // ---------------------------------------------------------------------------
@@ -3721,6 +3865,32 @@ uint8_t OutputManager::SourceVal::AsUInt8() const
     }
 }
 
+uint16_t OutputManager::SourceVal::AsUInt16() const
+{
+    // Convert to the 16-bit port level scale, 0..65535, where 65535
+    // corresponds to 255 on the 8-bit scale.  A float value keeps its
+    // fractional part on this scale.
+    switch (type)
+    {
+    case Type::UInt8:
+        // 0..255 -> 0..65535
+        return static_cast<uint16_t>(i * 257);
+
+    case Type::Float:
+        // rescale the float to 16 bits, clipping to the range
+        return f < 0 ? 0 : f >= 255 ? 65535 : static_cast<uint16_t>(f * 257.0f);
+
+    case Type::RGB:
+    case Type::Vector:
+        // use the 8-bit conversion
+        return static_cast<uint16_t>(AsUInt8() * 257);
+
+    default:
+        // unknown type; return 0
+        return 0;
+    }
+}
+
 float OutputManager::SourceVal::AsFloat() const
 {
     switch (type)
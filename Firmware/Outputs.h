@@ -340,6 +340,17 @@ public:
         // power level applied to a connected solenoid or motor.
         virtual void Set(uint8_t level) = 0;
 
+        // Set the PWM level on the high-resolution 16-bit scale,
+        // 0..65535.  This is used for ports configured with 'highRes',
+        // to carry fractional levels from computed sources and LedWiz
+        // waveforms through to devices with more than 8 bits of
+        // native PWM resolution.  The default implementation simply
+        // drops the low-order byte and uses the 8-bit Set(), which is
+        // the right thing for devices with 8 bits or less of native
+        // resolution.  Devices with finer resolution can override
+        // this to use the extra precision.
+        virtual void Set16(uint16_t level) { Set(static_cast<uint8_t>(level >> 8)); }
+
         // Get the current PWM level on the physical port
         virtual uint8_t Get() const = 0;
 
@@ -374,6 +385,45 @@ public:
             return conv_tables_float[mappingIndex][b];
         }
 
+        // Calculate the physical output for a 16-bit level, for
+        // devices with 12-bit and floating-point duty cycle scales.
+        // The level maps to a position l*255/65535 in the 8-bit
+        // mapping table, interpolating linearly between entries, so
+        // that 16-bit level L*257 (the 16-bit equivalent of 8-bit
+        // level L) lands exactly on entry L, and 65535 lands on entry
+        // 255.  This keeps the same gamma curve as the 8-bit path,
+        // while filling in the intermediate steps that the device can
+        // resolve but the 8-bit scale can't reach, which matters most
+        // at the low end of the gamma curve.
+        inline uint16_t To12BitPhys16(uint16_t l)
+        {
+            uint16_t v;
+            if (gamma)
+            {
+                // interpolate between adjacent gamma table entries
+                uint32_t pos = l * 255UL;
+                int idx = pos / 65535, frac = pos % 65535;
+                v = idx < 255 ? gamma_12bit[idx] + ((gamma_12bit[idx+1] - gamma_12bit[idx]) * frac) / 65535 : gamma_12bit[255];
+            }
+            else
+            {
+                // linear - just drop the low 4 bits
+                v = l >> 4;
+            }
+
+            // apply inversion
+            if (inverted) v = 4095 - v;
+            return v;
+        }
+        inline float ToFloatPhys16(uint16_t l)
+        {
+            // interpolate between adjacent entries in the mapping table
+            const float *t = conv_tables_float[mappingIndex];
+            uint32_t pos = l * 255UL;
+            int idx = pos / 65535, frac = pos % 65535;
+            return idx < 255 ? t[idx] + (t[idx+1] - t[idx]) * (static_cast<float>(frac) / 65535.0f) : t[255];
+        }
+
         // Linearly rescale a uint8_t to a notional "uint12_t" (unsigned
         // 12 bit integer, 0..4095, actually stored in a native
         // uint16_t).  This is a utility routine that we use for devices
@@ -706,6 +756,7 @@ public:
         virtual const char *Name() const { return "GPIO(PWM)"; }
         virtual const char *FullName(char *buf, size_t buflen) const override { snprintf(buf, buflen, "GP%d [PWM]", gp); return buf; }
         virtual void Set(uint8_t level) override;
+        virtual void Set16(uint16_t level) override;
         virtual uint8_t Get() const override;
     };
 
@@ -755,6 +806,7 @@ public:
         virtual const char *Name() const { return "TLC59116"; }
         virtual const char *FullName(char *buf, size_t buflen) const override;
         virtual void Set(uint8_t level) override;
+        virtual void Set16(uint16_t level) override;
         virtual uint8_t Get() const override;
         static void SetDevicePortLevel(int configIndex, int port, int pwmLevel);
         virtual void Populate(PinscapePico::OutputPortDesc *desc) const override;
@@ -773,6 +825,7 @@ public:
         virtual const char *Name() const { return "TLC5940"; }
         virtual const char *FullName(char *buf, size_t buflen) const override;
         virtual void Set(uint8_t level) override;
+        virtual void Set16(uint16_t level) override;
         virtual uint8_t Get() const override;
         static void SetDevicePortLevel(int configIndex, int port, int pwmLevel);
         virtual void Populate(PinscapePico::OutputPortDesc *desc) const override;
@@ -791,6 +844,7 @@ public:
         virtual const char *Name() const { return "TLC5947"; }
         virtual const char *FullName(char *buf, size_t buflen) const override;
         virtual void Set(uint8_t level) override;
+        virtual void Set16(uint16_t level) override;
         virtual uint8_t Get() const override;
         static void SetDevicePortLevel(int configIndex, int port, int pwmLevel);
         virtual void Populate(PinscapePico::OutputPortDesc *desc) const override;
@@ -809,6 +863,7 @@ public:
         virtual const char *Name() const { return "PCA9685"; }
         virtual const char *FullName(char *buf, size_t buflen) const override;
         virtual void Set(uint8_t level) override;
+        virtual void Set16(uint16_t level) override;
         virtual uint8_t Get() const override;
         static void SetDevicePortLevel(int configIndex, int port, int pwmLevel);
         virtual void Populate(PinscapePico::OutputPortDesc *desc) const override;
@@ -959,8 +1014,11 @@ public:
 
     protected:
         // Set the logical port level.  This is called from SetDOFevel()
-        // and from the derived data source calculator.
-        void SetLogicalLevel(uint8_t level);
+        // and from the derived data source calculator.  The 16-bit
+        // version takes the level on the 0..65535 scale, for ports
+        // with high-resolution output enabled.
+        void SetLogicalLevel(uint8_t level) { SetLogicalLevel16(static_cast<uint16_t>(level * 257)); }
+        void SetLogicalLevel16(uint16_t level);
 
         // Perform periodic device tasks.  This updates calculated values
         // for ports with non-host data sources, and applies the flipper
@@ -1008,6 +1066,14 @@ public:
         // Is this port's source formula enabled during USB suspend/disconnect?
         bool enableSourceDuringSuspend = false;
 
+        // High-resolution output mode.  If set, the port passes levels to
+        // the device on the 16-bit scale, preserving fractional levels
+        // from computed sources and LedWiz waveforms, so that devices
+        // with 12-bit PWM resolution can produce smoother fades.  The
+        // host (DOF) interface is still 8 bits, so this only makes a
+        // difference for computed and waveform levels.
+        bool highRes = false;
+
         // Flipper logic settings
         struct FlipperLogic
         {
@@ -1127,6 +1193,10 @@ public:
 
             // Compute the current PWM level for this state
             uint8_t GetLiveLogLevel() const;
+
+            // Compute the current PWM level on the 16-bit scale, 0..65535.
+            // This calculates the ramp waveforms at full resolution.
+            uint16_t GetLiveLogLevel16() const;
         } lw;
 
         // "Logical" level, 0..255.  This is the nominal level for the port,
@@ -1135,6 +1205,12 @@ public:
         // correction and flipper logic attenuation.
         uint8_t logLevel = 0;
 
+        // Logical level on the 16-bit scale.  This is the same as
+        // logLevel, with the additional fractional precision from the
+        // source when the port is in high-resolution mode.  logLevel
+        // is always the high byte of this value.
+        uint16_t logLevel16 = 0;
+
         // Device output level.  This is the final value, 0..255, sent to
         // the underlying physical device port.  This is the calculated
         // value, further adjusted by flipper logic time limitation and
@@ -1189,6 +1265,7 @@ public:
         static SourceVal MakeVector(int16_t x, int16_t y) { SourceVal v(Type::Vector); v.vec = { x, y }; return v; }
 
         uint8_t AsUInt8() const;
+        uint16_t AsUInt16() const;
         float AsFloat() const;
         SourceVal AsRGB() const;
         SourceVal AsVector() const;
@@ -1315,6 +1392,22 @@ public:
         // calculate the current value
         virtual SourceVal Calc() = 0;
 
+        // Calculate the current value for a high-resolution port.  This
+        // evaluates the same expression as Calc(), but the time-based
+        // waveform sources (ramp, sine, sawtooth) yield float results
+        // that keep their fractional part, rather than the UINT8 results
+        // they yield for ordinary ports.  The ordinary results are
+        // unchanged, since they affect type-sensitive comparisons and
+        // the per-operation 0..255 clipping of UINT8 arithmetic in
+        // existing formulas.
+        SourceVal CalcHighRes()
+        {
+            calcHighRes = true;
+            SourceVal val = Calc();
+            calcHighRes = false;
+            return val;
+        }
+
         // invoke a callback on this data source's sub-sources
         using TraverseFunc = std::function<void(DataSource*)>;
         virtual void Traverse(TraverseFunc func) = 0;
@@ -1323,6 +1416,10 @@ public:
         // which would unacceptably bloat the firmware image size)
         virtual ConstantSource *AsConstantSource() { return nullptr; }
         virtual PortSource *AsPortSource() { return nullptr; }
+
+    protected:
+        // true while CalcHighRes() is evaluating an expression
+        static bool calcHighRes;
     };
 
     // Constant value.  Uniquely, a constant node can be string-valued,
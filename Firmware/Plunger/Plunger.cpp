@@ -717,14 +717,14 @@ bool Plunger::CommitSettings()
 {
     // save the in-memory settings
     InitSettingsFileStructFromLive();
-    return config.SaveStruct(sensor->GetCalFileName(), &settingsFile, sizeof(settingsFile), FLASH_SECTOR_SIZE);
+    return config.SaveSettings(sensor->GetCalFileName(), &settingsFile, sizeof(settingsFile));
 }
 
 bool Plunger::RestoreSettings(bool *pFileExists)
 {
     // load the settings file
     bool fileExists = false;
-    bool loaded = config.LoadStruct(sensor->GetCalFileName(), &settingsFile, sizeof(settingsFile), &fileExists);
+    bool loaded = config.LoadSettings(sensor->GetCalFileName(), &settingsFile, sizeof(settingsFile), &fileExists);
 
     // return success if we loaded the struct OR the file doesn't exist;
     // the latter case still counts as success, since the absence of the
@@ -871,6 +871,8 @@ void Plunger::Command_plunger(const ConsoleCommandContext *c)
                 "Firing time limit:        %luus%s\n"
                 "Integration time:         %luus\n"
                 "Scan mode:                %d\n"
+                "Sensor scan time:         %luus\n"
+                "Sensor latency:           %luus\n"
                 "Calibration data:\n"
                 "   Min     %lu\n"
                 "   Zero    %lu\n"
@@ -892,6 +894,8 @@ void Plunger::Command_plunger(const ConsoleCommandContext *c)
                 firingTimeLimit == 0 ? " (Default)" : "",
                 integrationTime,
                 scanMode,
+                sensor->GetAvgScanTime(),
+                sensor->GetAvgLatency(),
                 cal.min, cal.zero, cal.max,
                 jitterFilter.window, jitterFilter.lo, jitterFilter.hi);
         }
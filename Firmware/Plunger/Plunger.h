@@ -186,7 +186,9 @@ public:
     // Commit the current run-time-adjustable settings (jitter window, firing
     // time limit, integration time).  Returns true on success, false on
     // failure.  The commit requires writing to flash, which can potentially
-    // fail.
+    // fail.  The settings are stored as a record in the wear-levelled
+    // settings store (see SettingsStore.h), which normally takes only a
+    // flash page program, with no sector erase.
     bool CommitSettings();
 
     // Initialize the in-memory settings file struct from the live settings
@@ -371,6 +373,11 @@ public:
         // Get the average sensor scan time in microseconds
         virtual uint32_t GetAvgScanTime() { return 0; }
 
+        // Get the average sensor latency in microseconds, from the time
+        // the sensor completes a measurement to the time we've read it
+        // into memory, or 0 if the sensor doesn't track this
+        virtual uint32_t GetAvgLatency() { return 0; }
+
         // Get/set the scan mode
         virtual void SetScanMode(uint8_t scanMode) { }
 
@@ -136,6 +136,10 @@ bool VCNL4010Plunger::ReadRaw(Plunger::RawSample &s)
     return isNew;
 }
 
+// sample timing statistics
+uint32_t VCNL4010Plunger::GetAvgScanTime() { return vcnl4010->GetAvgSampleTime(); }
+uint32_t VCNL4010Plunger::GetAvgLatency() { return vcnl4010->GetAvgLatency(); }
+
 // report sensor-specific data in the vendor interface
 size_t VCNL4010Plunger::ReportSensorData(uint8_t *buf, size_t maxSize)
 {
@@ -362,3 +366,7 @@ bool VL6180XPlunger::ReadRaw(Plunger::RawSample &s)
     // read a sample from the sensor
     return vl6180x->Read(s.rawPos, s.t);
 }
+
+// sample timing statistics
+uint32_t VL6180XPlunger::GetAvgScanTime() { return vl6180x->GetAvgSampleTime(); }
+uint32_t VL6180XPlunger::GetAvgLatency() { return vl6180x->GetAvgLatency(); }
@@ -81,6 +81,10 @@ public:
     // calibration file name
     virtual const char *GetCalFileName() const override { return "vcnl4010.cal"; }
 
+    // sample timing statistics
+    virtual uint32_t GetAvgScanTime() override;
+    virtual uint32_t GetAvgLatency() override;
+
     // sensor type for feedback controller reports
     virtual uint16_t GetTypeForFeedbackReport() const { return PinscapePico::FeedbackControllerReport::PLUNGER_VCNL4010; }
 
@@ -222,6 +226,10 @@ public:
     // calibration file name
     virtual const char *GetCalFileName() const override { return "vl6180x.cal"; }
 
+    // sample timing statistics
+    virtual uint32_t GetAvgScanTime() override;
+    virtual uint32_t GetAvgLatency() override;
+
     // sensor type for feedback controller reports
     virtual uint16_t GetTypeForFeedbackReport() const { return PinscapePico::FeedbackControllerReport::PLUNGER_VL6180X; }
 
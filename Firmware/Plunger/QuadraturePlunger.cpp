@@ -94,19 +94,30 @@ bool QuadraturePlungerSensor::ReadRaw(Plunger::RawSample &r)
     // Get the count from the underlying encoder, and add our
     // rest count (the calibrated Z-Axis zero point).  Constrain
     // the result to 0..nativeScale.
-    int pos = encoder->GetCount() + restCount;
+    int count = encoder->GetCount();
+    int pos = count + restCount;
     r.rawPos = static_cast<uint32_t>(pos < 0 ? 0 : pos > nativeScale ? nativeScale : pos);
     
     // The encoder's count is always instantaneously accurate, since
-    // it's updated in an interrupt handler on every state transition
-    // the encoder signals.  So every time we sample it, we know that
-    // this is the physical position of the plunger RIGHT NOW.  Note
-    // that it doesn't matter how long it's been since the last state
-    // transition occurred - the timestamp isn't for detecting when
-    // motion occurred, but is for determining when the position was
-    // measured.  Every time we check the count, we're measuring the
-    // position, so the time of this measurement is NOW.
-    r.t = time_us_64();
+    // it's updated on every state transition the encoder signals.  So
+    // every time we sample it, we know that this is the physical
+    // position of the plunger RIGHT NOW, and NOW is a valid timestamp
+    // for the sample.
+    //
+    // When the count has changed since the last sample, though, we can
+    // do better: the plunger crossed into the new count position at the
+    // time of the edge that changed the count, so that's an exact
+    // position/time point on the plunger's trajectory, where NOW only
+    // places it somewhere within the current count's span.  That makes
+    // the speed calculations more accurate during the fast release
+    // motion, when the count changes on every sample.  Only use the edge
+    // time if it's later than the previous sample, to keep the sample
+    // times in order.
+    uint64_t now = time_us_64();
+    uint64_t tEdge = encoder->GetCountTime();
+    r.t = (count != lastCount && tEdge > tLastSample && tEdge <= now) ? tEdge : now;
+    lastCount = count;
+    tLastSample = r.t;
 
     // a new sample is available ready
     return true;
@@ -113,4 +113,9 @@ protected:
     // generic interface are positive, which is required since they're
     // reported as UINT32 values.
     uint32_t restCount;
+
+    // Encoder count and timestamp of the last sample, for timing samples
+    // by the encoder's edge times
+    int lastCount = 0;
+    uint64_t tLastSample = 0;
 };
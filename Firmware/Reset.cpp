@@ -19,6 +19,7 @@
 #include "Config.h"
 #include "TimeOfDay.h"
 #include "StatusRGB.h"
+#include "FlashStorage.h"
 
 
 // global singleton
@@ -154,6 +155,10 @@ void PicoReset::PrepareForReboot()
 
     // turn off the status LED
     statusRGB.Enable(false);
+
+    // finish any queued background flash writes, so that a save that
+    // was just requested (a config update, say) isn't lost in the reset
+    flashStorage.CompleteJobs();
 }
 
 // create a reset lock
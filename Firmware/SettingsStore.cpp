@@ -0,0 +1,409 @@
+// Pinscape Pico - Settings record store
+// Copyright 2024, 2025 Michael J Roberts / BSD-3-Clause license / NO WARRANTY
+
+// standard library headers
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+// Pico SDK headers
+#include <pico/stdlib.h>
+#include <hardware/flash.h>
+
+// project headers
+#include "Pinscape.h"
+#include "CRC32Engine.h"
+#include "Logger.h"
+#include "CommandConsole.h"
+#include "FlashStorage.h"
+#include "SettingsStore.h"
+
+// global singleton
+SettingsStore settingsStore;
+
+bool SettingsStore::Mount()
+{
+    // set up our console command on the first mount
+    if (!commandAdded)
+    {
+        CommandConsole::AddCommand(
+            "settings", "show the settings record store status",
+            "settings  (no options)\n",
+            Command_settings);
+        commandAdded = true;
+    }
+
+    // reset the in-memory state
+    base = 0;
+    index.clear();
+    activeSector = -1;
+    activeSeq = 0;
+    writeOffset = 0;
+    memset(eraseCount, 0, sizeof(eraseCount));
+
+    // open the flash region
+    uint32_t regionOffset;
+    bool created;
+    if (!flashStorage.OpenRegion(REGION_NAME, NUM_SECTORS*FLASH_SECTOR_SIZE, regionOffset, created))
+    {
+        Log(LOG_ERROR, "Settings store: unable to open flash region\n");
+        return false;
+    }
+
+    // if the region is new, its contents are arbitrary, so erase all of the sectors
+    if (created)
+    {
+        for (int i = 0 ; i < NUM_SECTORS ; ++i)
+        {
+            if (!flashStorage.EraseRegionSector(regionOffset + i*FLASH_SECTOR_SIZE, REGION_NAME))
+                return false;
+        }
+    }
+
+    // find the active sector - the valid sector with the highest sequence number
+    base = regionOffset;
+    for (int i = 0 ; i < NUM_SECTORS ; ++i)
+    {
+        SectorHeader sh;
+        memcpy(&sh, FlashPtr(SectorOffset(i)), sizeof(sh));
+        if (sh.magic == SectorHeader::MAGIC
+            && sh.crc == crc32Engine.Calc(&sh, offsetof(SectorHeader, crc)))
+        {
+            eraseCount[i] = sh.eraseCount;
+            if (activeSector < 0 || sh.seq > activeSeq)
+            {
+                activeSector = i;
+                activeSeq = sh.seq;
+            }
+        }
+    }
+
+    // build the index
+    if (activeSector >= 0)
+        ScanActiveSector();
+
+    // success
+    Log(LOG_CONFIG, "Settings store mounted, %u record%s, active sector %d\n",
+        index.size(), index.size() == 1 ? "" : "s", activeSector);
+    return true;
+}
+
+void SettingsStore::ScanActiveSector()
+{
+    // scan records from the end of the sector header to the first erased slot
+    uint32_t ofs = SectorOffset(activeSector) + sizeof(SectorHeader);
+    uint32_t end = SectorOffset(activeSector) + FLASH_SECTOR_SIZE;
+    while (ofs + sizeof(RecordHeader) <= end)
+    {
+        // an erased magic word marks the end of the log
+        RecordHeader hdr;
+        memcpy(&hdr, FlashPtr(ofs), sizeof(hdr));
+        if (hdr.magic == 0xFFFFFFFF)
+            break;
+
+        // Validate the record.  A bad record is most likely the result of
+        // a write interrupted by a reset, which can only happen at the end
+        // of the log, so stop here.  We can't safely append after a
+        // damaged record, so treat the sector as full; the next Put() will
+        // compact into a fresh sector, dropping the damaged record.
+        if (hdr.magic != RecordHeader::MAGIC || hdr.size > MAX_DATA_SIZE
+            || ofs + RecordHeader::RecordSize(hdr.size) > end
+            || hdr.crc != RecordCRC(hdr, FlashPtr(ofs + sizeof(RecordHeader))))
+        {
+            Log(LOG_WARNING, "Settings store: invalid record at sector %d offset %u; ignoring remainder of log\n",
+                activeSector, ofs - SectorOffset(activeSector));
+            ofs = end;
+            break;
+        }
+
+        // add or update the index entry; later records supersede earlier ones
+        if (auto *ie = Find(hdr.key); ie != nullptr)
+        {
+            ie->flashOffset = ofs;
+            ie->version = hdr.version;
+            ie->size = hdr.size;
+        }
+        else
+        {
+            IndexEntry e;
+            memcpy(e.key, hdr.key, sizeof(e.key));
+            e.flashOffset = ofs;
+            e.version = hdr.version;
+            e.size = hdr.size;
+            index.push_back(e);
+        }
+
+        // advance to the next record
+        ofs += RecordHeader::RecordSize(hdr.size);
+    }
+
+    // the next record goes at the end of the log
+    writeOffset = ofs;
+}
+
+SettingsStore::IndexEntry *SettingsStore::Find(const char *key)
+{
+    for (auto &ie : index)
+    {
+        if (strncmp(ie.key, key, MAX_KEY_LEN) == 0)
+            return &ie;
+    }
+    return nullptr;
+}
+
+uint32_t SettingsStore::RecordCRC(const RecordHeader &hdr, const void *data)
+{
+    uint32_t crc = crc32Engine.Calc(&hdr, offsetof(RecordHeader, crc));
+    return crc32Engine.Calc(data, hdr.size, crc);
+}
+
+bool SettingsStore::IsErased(uint32_t ofs, size_t len)
+{
+    for (const uint8_t *p = FlashPtr(ofs), *endp = p + len ; p < endp ; ++p)
+    {
+        if (*p != 0xFF)
+            return false;
+    }
+    return true;
+}
+
+bool SettingsStore::Program(uint32_t ofs, const void *data, size_t len)
+{
+    // Program one page at a time, from a RAM copy of the page.  The parts
+    // of the page outside the target range are filled with 0xFF bytes,
+    // which leaves the existing flash contents there unchanged, since
+    // programming can only change '1' bits to '0' bits.  The RAM copy
+    // also ensures that we never program directly from the XIP window,
+    // which is inaccessible while the flash is being written.
+    const uint8_t *src = reinterpret_cast<const uint8_t*>(data);
+    while (len != 0)
+    {
+        uint32_t pageOfs = ofs & ~(FLASH_PAGE_SIZE - 1);
+        uint32_t ofsInPage = ofs - pageOfs;
+        size_t copyLen = std::min(len, static_cast<size_t>(FLASH_PAGE_SIZE - ofsInPage));
+
+        uint8_t buf[FLASH_PAGE_SIZE];
+        memset(buf, 0xFF, sizeof(buf));
+        memcpy(buf + ofsInPage, src, copyLen);
+        if (!flashStorage.ProgramRegion(pageOfs, buf, sizeof(buf), REGION_NAME))
+            return false;
+
+        ofs += copyLen;
+        src += copyLen;
+        len -= copyLen;
+    }
+
+    // success
+    return true;
+}
+
+bool SettingsStore::WriteRecord(uint32_t ofs, const char *key, uint32_t version, const void *data, size_t size)
+{
+    // build the record in RAM
+    std::vector<uint8_t> rec(RecordHeader::RecordSize(size), 0xFF);
+    RecordHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = RecordHeader::MAGIC;
+    strncpy(hdr.key, key, MAX_KEY_LEN);
+    hdr.version = version;
+    hdr.size = size;
+    hdr.crc = RecordCRC(hdr, data);
+    memcpy(rec.data(), &hdr, sizeof(hdr));
+    memcpy(rec.data() + sizeof(hdr), data, size);
+
+    // program it, and verify by reading it back
+    if (!Program(ofs, rec.data(), rec.size()) || memcmp(FlashPtr(ofs), rec.data(), sizeof(hdr) + size) != 0)
+    {
+        Log(LOG_ERROR, "Settings store: error writing record \"%.16s\"\n", key);
+        return false;
+    }
+
+    // success
+    return true;
+}
+
+bool SettingsStore::Get(const char *key, void *dst, size_t size) const
+{
+    // look up the key
+    const auto *ie = Find(key);
+    if (ie == nullptr || !IsMounted())
+        return false;
+
+    // copy the data, truncating or zero-padding to the caller's size
+    size_t copySize = std::min(size, static_cast<size_t>(ie->size));
+    memcpy(dst, FlashPtr(ie->flashOffset + sizeof(RecordHeader)), copySize);
+    if (copySize < size)
+        memset(static_cast<uint8_t*>(dst) + copySize, 0, size - copySize);
+
+    // success
+    return true;
+}
+
+bool SettingsStore::Put(const char *key, const void *data, size_t size)
+{
+    // validate the parameters
+    if (!IsMounted() || size > MAX_DATA_SIZE || strlen(key) > MAX_KEY_LEN)
+        return false;
+
+    // if the data are identical to the current version, there's nothing to do
+    auto *ie = Find(key);
+    if (ie != nullptr && ie->size == size && memcmp(FlashPtr(ie->flashOffset + sizeof(RecordHeader)), data, size) == 0)
+    {
+        nSkipped += 1;
+        return true;
+    }
+
+    // the new record supersedes the current version
+    nPuts += 1;
+    uint32_t version = (ie != nullptr) ? ie->version + 1 : 1;
+    size_t recSize = RecordHeader::RecordSize(size);
+
+    // Append the record to the active sector if there's room.  Check that
+    // the target space is actually erased before writing; if it's not,
+    // something went wrong with an earlier write, so compact instead.
+    if (activeSector >= 0 && writeOffset + recSize <= SectorOffset(activeSector) + FLASH_SECTOR_SIZE
+        && IsErased(writeOffset, recSize))
+    {
+        if (WriteRecord(writeOffset, key, version, data, size))
+        {
+            // update the index
+            if (ie != nullptr)
+            {
+                ie->flashOffset = writeOffset;
+                ie->version = version;
+                ie->size = size;
+            }
+            else
+            {
+                IndexEntry e;
+                memset(e.key, 0, sizeof(e.key));
+                strncpy(e.key, key, MAX_KEY_LEN);
+                e.flashOffset = writeOffset;
+                e.version = version;
+                e.size = size;
+                index.push_back(e);
+            }
+
+            // advance the write pointer
+            writeOffset += recSize;
+            return true;
+        }
+
+        // the write failed, so the log can't be extended past this point
+        writeOffset = SectorOffset(activeSector) + FLASH_SECTOR_SIZE;
+    }
+
+    // the active sector is full (or there isn't one yet), so compact
+    return Compact(key, version, data, size);
+}
+
+bool SettingsStore::Compact(const char *key, uint32_t version, const void *data, size_t size)
+{
+    // choose the spare sector with the lowest erase count
+    int target = -1;
+    for (int i = 0 ; i < NUM_SECTORS ; ++i)
+    {
+        if (i != activeSector && (target < 0 || eraseCount[i] < eraseCount[target]))
+            target = i;
+    }
+
+    // erase it
+    uint32_t sectorOfs = SectorOffset(target);
+    uint32_t sectorEnd = sectorOfs + FLASH_SECTOR_SIZE;
+    if (!flashStorage.EraseRegionSector(sectorOfs, REGION_NAME))
+        return false;
+
+    // Copy the current version of each record other than the one we're
+    // replacing.  Each record is staged in RAM by WriteRecord(), so it's
+    // safe to copy directly out of the old sector through the XIP window.
+    std::vector<IndexEntry> newIndex;
+    uint32_t ofs = sectorOfs + sizeof(SectorHeader);
+    for (const auto &ie : index)
+    {
+        if (strncmp(ie.key, key, MAX_KEY_LEN) == 0)
+            continue;
+
+        if (!WriteRecord(ofs, ie.key, ie.version, FlashPtr(ie.flashOffset + sizeof(RecordHeader)), ie.size))
+            return false;
+
+        newIndex.push_back(ie);
+        newIndex.back().flashOffset = ofs;
+        ofs += RecordHeader::RecordSize(ie.size);
+    }
+
+    // add the new record
+    if (ofs + RecordHeader::RecordSize(size) > sectorEnd)
+    {
+        Log(LOG_ERROR, "Settings store: no space for record \"%.16s\" (%u bytes)\n", key, size);
+        return false;
+    }
+    if (!WriteRecord(ofs, key, version, data, size))
+        return false;
+
+    IndexEntry e;
+    memset(e.key, 0, sizeof(e.key));
+    strncpy(e.key, key, MAX_KEY_LEN);
+    e.flashOffset = ofs;
+    e.version = version;
+    e.size = size;
+    newIndex.push_back(e);
+    ofs += RecordHeader::RecordSize(size);
+
+    // Write the sector header.  This is the commit point: until the header
+    // is written, the old sector is still the active one, so a reset at
+    // any earlier point leaves the store exactly as it was before the
+    // compaction started.
+    SectorHeader sh{ SectorHeader::MAGIC, activeSeq + 1, eraseCount[target] + 1, 0 };
+    sh.crc = crc32Engine.Calc(&sh, offsetof(SectorHeader, crc));
+    if (!Program(sectorOfs, &sh, sizeof(sh)) || memcmp(FlashPtr(sectorOfs), &sh, sizeof(sh)) != 0)
+    {
+        Log(LOG_ERROR, "Settings store: error writing sector header\n");
+        return false;
+    }
+
+    // switch to the new sector
+    Log(LOG_DEBUG, "Settings store: compacted sector %d into sector %d (%u records)\n",
+        activeSector, target, newIndex.size());
+    activeSector = target;
+    activeSeq = sh.seq;
+    eraseCount[target] = sh.eraseCount;
+    index = std::move(newIndex);
+    writeOffset = ofs;
+    nCompactions += 1;
+    return true;
+}
+
+// console command handler
+void SettingsStore::Command_settings(const ConsoleCommandContext *c)
+{
+    if (c->argc != 1)
+        return c->Usage();
+
+    const auto &s = settingsStore;
+    if (!s.IsMounted())
+        return c->Print("Settings store not mounted\n");
+
+    // show the sector status
+    c->Printf(
+        "Settings record store:\n"
+        "  Region:          %s, flash offset 0x%08lx, %d sectors\n"
+        "  Active sector:   %d (sequence %lu), %lu bytes free\n"
+        "  Erase counts:   ",
+        REGION_NAME, s.base, NUM_SECTORS,
+        s.activeSector, s.activeSeq,
+        s.activeSector >= 0 ? s.SectorOffset(s.activeSector) + FLASH_SECTOR_SIZE - s.writeOffset : 0);
+    for (int i = 0 ; i < NUM_SECTORS ; ++i)
+        c->Printf(" %lu", s.eraseCount[i]);
+    c->Printf(
+        "\n"
+        "  This session:    %lu writes, %lu unchanged (skipped), %lu compactions\n"
+        "\n"
+        "  Key               Version   Size\n",
+        s.nPuts, s.nSkipped, s.nCompactions);
+
+    // show the records
+    for (const auto &ie : s.index)
+        c->Printf("  %-16.16s  %7lu  %5lu\n", ie.key, ie.version, ie.size);
+}
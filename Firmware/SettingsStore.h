@@ -0,0 +1,190 @@
+// Pinscape Pico - Settings record store
+// Copyright 2024, 2025 Michael J Roberts / BSD-3-Clause license / NO WARRANTY
+//
+// The settings store is a log-structured, wear-levelled store for small
+// binary settings blobs that are committed frequently, such as the nudge
+// device and plunger calibration settings.  These are the sorts of
+// settings that users tune interactively, with a commit after each
+// adjustment, so they can be rewritten many times in a session.
+//
+// Storing each blob as its own FlashStorage file concentrates all of the
+// wear for a given file on the same sector, and a write interrupted at
+// the wrong moment (a power loss right after the sector is erased) loses
+// the file entirely.  The record store instead appends each new version
+// as a record at the end of a log, so a commit is just a page program
+// with no erase.  Each record carries a CRC covering its header and
+// data, so a torn write is detected and ignored, leaving the previous
+// version of the same record as the current one.
+//
+// Flash layout
+//
+// The store occupies a FlashStorage region (see FlashStorage::OpenRegion())
+// with NUM_SECTORS log sectors.  One sector at a time is active.  Each
+// sector starts with a SectorHeader containing a sequence number, which
+// increases each time a new sector is activated; the active sector is the
+// one with the highest sequence number and a valid header CRC.  Records
+// follow the header, each aligned on a 4-byte boundary.
+//
+// When the active sector fills, we compact into a spare sector: erase it,
+// copy the latest version of each record into it, add the new record,
+// and then program the new sector header as the last step.  The sector
+// header write is the commit point for the whole compaction, so if it's
+// interrupted, the old sector remains active, with all of its records
+// intact.  The spare sector chosen is the one with the lowest erase
+// count, which spreads erasures evenly across the sectors.
+//
+// At startup, we scan the active sector and build an in-RAM index of
+// the latest version of each record, so reads are just a memcpy from
+// the XIP flash window.
+
+#pragma once
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+#include <hardware/flash.h>
+
+// external declarations
+class ConsoleCommandContext;
+
+class SettingsStore
+{
+public:
+    // Mount the store.  Opens or creates the flash region and builds the
+    // record index.  Call after the FlashStorage file system is mounted,
+    // and again after any reformat.  Returns true on success.
+    bool Mount();
+
+    // is the store mounted?
+    bool IsMounted() const { return base != 0; }
+
+    // Get a record.  Copies the latest version of the record into the
+    // caller's buffer, truncating if the record is larger, and zeroing
+    // any excess buffer space if the record is smaller.  Returns true
+    // if the record was found.
+    bool Get(const char *key, void *dst, size_t size) const;
+
+    // Put a record.  Appends a new version of the record to the log,
+    // compacting into a spare sector first if the active sector is full.
+    // If the data are identical to the current version, this does nothing
+    // and returns true.  Returns true on success.
+    bool Put(const char *key, const void *data, size_t size);
+
+    // maximum key length
+    static const size_t MAX_KEY_LEN = 16;
+
+    // maximum record data size
+    static const size_t MAX_DATA_SIZE = 1024;
+
+    // number of log sectors
+    static const int NUM_SECTORS = 4;
+
+protected:
+    // flash region name
+    static constexpr const char *REGION_NAME = "settings.rec";
+
+    // Sector header
+    struct SectorHeader
+    {
+        uint32_t magic;
+        static const uint32_t MAGIC = 0x53525350;  // "PSRS" in little-endian byte order
+
+        // sequence number; the valid sector with the highest sequence number is active
+        uint32_t seq;
+
+        // number of times this sector has been erased
+        uint32_t eraseCount;
+
+        // CRC-32 of the preceding fields
+        uint32_t crc;
+    };
+
+    // Record header.  The record data immediately follow the header.
+    struct RecordHeader
+    {
+        uint32_t magic;
+        static const uint32_t MAGIC = 0x4352;  // "RC"
+
+        // key, null-padded (not necessarily null-terminated if the full length is used)
+        char key[MAX_KEY_LEN];
+
+        // record version, incremented on each Put() for the key
+        uint32_t version;
+
+        // data size in bytes
+        uint32_t size;
+
+        // CRC-32 of the preceding header fields plus the data
+        uint32_t crc;
+
+        // total record size, including the header, padded to a 4-byte boundary
+        static size_t RecordSize(size_t dataSize) { return (sizeof(RecordHeader) + dataSize + 3) & ~3; }
+    };
+
+    // In-memory index entry
+    struct IndexEntry
+    {
+        char key[MAX_KEY_LEN];
+        uint32_t flashOffset;      // flash offset of the current record's header
+        uint32_t version;          // current version
+        uint32_t size;             // data size
+    };
+    std::vector<IndexEntry> index;
+
+    // Flash offset of the first log sector, or 0 if not mounted
+    uint32_t base = 0;
+
+    // active sector index, or -1 if no sector is active (new store)
+    int activeSector = -1;
+
+    // active sector sequence number
+    uint32_t activeSeq = 0;
+
+    // next write offset in the active sector (flash offset)
+    uint32_t writeOffset = 0;
+
+    // per-sector erase counts, from the sector headers
+    uint32_t eraseCount[NUM_SECTORS]{ 0 };
+
+    // statistics for the session
+    uint32_t nPuts = 0;
+    uint32_t nSkipped = 0;
+    uint32_t nCompactions = 0;
+
+    // console command registered
+    bool commandAdded = false;
+
+    // get the flash offset of a sector
+    uint32_t SectorOffset(int sector) const { return base + sector*FLASH_SECTOR_SIZE; }
+
+    // get a flash pointer
+    static const uint8_t *FlashPtr(uint32_t ofs) { return reinterpret_cast<const uint8_t*>(XIP_BASE + ofs); }
+
+    // find an index entry by key
+    IndexEntry *Find(const char *key);
+    const IndexEntry *Find(const char *key) const { return const_cast<SettingsStore*>(this)->Find(key); }
+
+    // compute a record CRC
+    static uint32_t RecordCRC(const RecordHeader &hdr, const void *data);
+
+    // scan the active sector to build the index
+    void ScanActiveSector();
+
+    // check if a flash range is erased
+    static bool IsErased(uint32_t ofs, size_t len);
+
+    // Program an arbitrary byte range, which must be erased.  Pads the
+    // surrounding page space with 0xFF bytes, which leaves it unchanged.
+    bool Program(uint32_t ofs, const void *data, size_t len);
+
+    // write a record at the given flash offset
+    bool WriteRecord(uint32_t ofs, const char *key, uint32_t version, const void *data, size_t size);
+
+    // compact into a spare sector, adding the new record
+    bool Compact(const char *key, uint32_t version, const void *data, size_t size);
+
+    // console command handler
+    static void Command_settings(const ConsoleCommandContext *c);
+};
+
+// global singleton
+extern SettingsStore settingsStore;
@@ -0,0 +1,275 @@
+// Pinscape Pico - Main loop task scheduler
+// Copyright 2024, 2025 Michael J Roberts / BSD-3-Clause license / NO WARRANTY
+
+// standard library headers
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+// Pico SDK headers
+#include <pico/stdlib.h>
+#include <pico/time.h>
+#include <hardware/clocks.h>
+#include <hardware/structs/systick.h>
+
+// project headers
+#include "Main.h"
+#include "Utils.h"
+#include "TaskScheduler.h"
+#include "CommandConsole.h"
+#include "../USBProtocol/VendorIfcProtocol.h"
+
+// global singleton
+TaskScheduler taskScheduler;
+
+// CPU cycles per microsecond
+uint32_t TaskScheduler::cyclesPerUs = 125;
+
+void TaskScheduler::Init()
+{
+    // set up the main core's cycle counter
+    InitCycleCounter();
+
+    // set up our console command
+    CommandConsole::AddCommand(
+        "tasks", "show main loop per-task timing statistics",
+        "tasks [options]\n"
+        "options:\n"
+        "  -l, --list     list statistics (default if no options specified)\n"
+        "  -h, --hist     show run time histograms\n"
+        "  -r, --reset    reset the statistics counters",
+        Command_tasks);
+}
+
+void TaskScheduler::InitCycleCounter()
+{
+    // note the CPU clock speed
+    cyclesPerUs = std::max(clock_get_hz(clk_sys) / 1000000U, 1U);
+
+    // Set up SysTick as a free-running 24-bit down-counter on the
+    // processor clock, with no interrupt.  Nothing else in the firmware
+    // (or the SDK libraries we link) uses SysTick, so we can take it over.
+    // The register layout is the same on both chips, but the SDK names
+    // the bit fields after the core type.
+    systick_hw->csr = 0;
+    systick_hw->rvr = 0x00FFFFFF;
+    systick_hw->cvr = 0;
+#if PICO_RP2350
+    systick_hw->csr = M33_SYST_CSR_CLKSOURCE_BITS | M33_SYST_CSR_ENABLE_BITS;
+#else
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+#endif
+}
+
+void TaskScheduler::Add(const char *name, TaskFunc func, uint32_t period_us, int priority, ReadyFunc ready)
+{
+    // insert after the last task of equal or higher priority
+    auto it = std::find_if(tasks.begin(), tasks.end(), [priority](const Task &t) { return t.priority < priority; });
+    Task t{ name, func, ready, period_us, priority };
+    tasks.insert(it, t);
+}
+
+void TaskScheduler::RunPass()
+{
+    for (auto &t : tasks)
+    {
+        // skip the task if it's not due yet, and it's not ready for early service
+        uint64_t now = time_us_64();
+        if (now < t.tNext && (t.ready == nullptr || !t.ready()))
+        {
+            t.prof.nSkipped += 1;
+            continue;
+        }
+
+        // run the task
+        uint32_t c0 = StartCycles();
+        t.func();
+        uint32_t cycles = ElapsedCycles(c0);
+
+        // If the task ran long enough that the 24-bit cycle counter could
+        // have wrapped, use the microsecond clock instead
+        uint64_t dt = time_us_64() - now;
+        if (dt > 100000)
+            cycles = static_cast<uint32_t>(std::min<uint64_t>(dt * cyclesPerUs, 0xFFFFFFFF));
+
+        // collect statistics and schedule the next run
+        t.prof.AddSample(cycles);
+        t.tNext = now + t.period;
+    }
+}
+
+void TaskScheduler::TaskProfile::AddSample(uint32_t cycles) volatile
+{
+    nRuns += 1;
+    totalCycles += cycles;
+    if (cycles < minCycles)
+        minCycles = cycles;
+    if (cycles > maxCycles)
+        maxCycles = cycles;
+
+    // figure the histogram bucket: floor(log2(us)) + 1, or 0 for under 1us
+    uint32_t us = cycles / cyclesPerUs;
+    int bucket = us == 0 ? 0 : 32 - __builtin_clz(us);
+    hist[std::min(bucket, NUM_BUCKETS - 1)] += 1;
+}
+
+void TaskScheduler::TaskProfile::Reset() volatile
+{
+    nRuns = 0;
+    nSkipped = 0;
+    totalCycles = 0;
+    minCycles = 0xFFFFFFFF;
+    maxCycles = 0;
+    for (int i = 0 ; i < NUM_BUCKETS ; ++i)
+        hist[i] = 0;
+}
+
+int TaskScheduler::AddSecondCoreTask(const char *name)
+{
+    // make sure there's room
+    int n = nSecondCoreTasks;
+    if (n >= MAX_SECOND_CORE_TASKS)
+        return -1;
+
+    // Populate the new slot before publishing the new count, since the
+    // main core can read the table at any time
+    secondCoreTasks[n].name = name;
+    secondCoreTasks[n].prof.Reset();
+    nSecondCoreTasks = n + 1;
+    return n;
+}
+
+void TaskScheduler::ResetStats()
+{
+    for (auto &t : tasks)
+        t.prof.Reset();
+}
+
+void TaskScheduler::ResetSecondCoreStats()
+{
+    for (int i = 0, n = nSecondCoreTasks ; i < n ; ++i)
+        secondCoreTasks[i].prof.Reset();
+}
+
+size_t TaskScheduler::Query(uint8_t *buf, size_t bufSize) const
+{
+    // make sure there's room
+    int n2 = nSecondCoreTasks;
+    size_t numTasks = tasks.size() + n2;
+    size_t xferSize = sizeof(PinscapePico::TaskStatsList) + numTasks*sizeof(PinscapePico::TaskStats);
+    if (xferSize > bufSize)
+        return 0;
+
+    // populate the list header
+    memset(buf, 0, xferSize);
+    auto *hdr = reinterpret_cast<PinscapePico::TaskStatsList*>(buf);
+    hdr->cb = sizeof(PinscapePico::TaskStatsList);
+    hdr->cbTask = sizeof(PinscapePico::TaskStats);
+    hdr->numTasks = static_cast<uint16_t>(numTasks);
+    hdr->numBuckets = TaskProfile::NUM_BUCKETS;
+    hdr->cyclesPerUs = cyclesPerUs;
+
+    // populate a task entry
+    auto *dst = reinterpret_cast<PinscapePico::TaskStats*>(hdr + 1);
+    auto Populate = [&dst](const char *name, int core, int priority, uint32_t period, const TaskProfile &prof)
+    {
+        strncpy(dst->name, name, sizeof(dst->name) - 1);
+        dst->core = static_cast<uint8_t>(core);
+        dst->priority = static_cast<int8_t>(priority);
+        dst->period = period;
+        dst->nRuns = prof.nRuns;
+        dst->nSkipped = prof.nSkipped;
+        dst->totalCycles = prof.totalCycles;
+        dst->minCycles = prof.minCycles;
+        dst->maxCycles = prof.maxCycles;
+        static_assert(_countof(dst->hist) >= TaskProfile::NUM_BUCKETS);
+        memcpy(dst->hist, prof.hist, sizeof(prof.hist));
+        ++dst;
+    };
+
+    // populate the main core tasks, then the second core tasks
+    for (auto &t : tasks)
+        Populate(t.name, 0, t.priority, t.period, t.prof);
+    for (int i = 0 ; i < n2 ; ++i)
+        Populate(secondCoreTasks[i].name, 1, 0, 0, secondCoreTasks[i].prof);
+
+    // return the populated size
+    return xferSize;
+}
+
+// show the per-task statistics
+void TaskScheduler::ShowStats(const ConsoleCommandContext *c, bool hist) const
+{
+    // show one task
+    auto Show = [c, hist](const char *name, int core, int priority, uint32_t period, const TaskProfile &p)
+    {
+        float cpu = static_cast<float>(cyclesPerUs);
+        c->Printf("  %-18s  %d  %3d  %8lu  %10llu  %10llu  %9.2f  %9.2f  %9.2f\n",
+            name, core, priority, period, p.nRuns, p.nSkipped,
+            p.nRuns != 0 ? p.minCycles / cpu : 0.0f,
+            p.nRuns != 0 ? static_cast<float>(p.totalCycles) / static_cast<float>(p.nRuns) / cpu : 0.0f,
+            p.maxCycles / cpu);
+
+        // show the histogram if desired, omitting empty buckets
+        if (hist && p.nRuns != 0)
+        {
+            for (int i = 0 ; i < TaskProfile::NUM_BUCKETS ; ++i)
+            {
+                if (p.hist[i] == 0)
+                    continue;
+
+                if (i == 0)
+                    c->Printf("      < 1 us:           %10lu\n", p.hist[i]);
+                else if (i == TaskProfile::NUM_BUCKETS - 1)
+                    c->Printf("      >= %-5lu us:      %10lu\n", 1UL << (i - 1), p.hist[i]);
+                else
+                    c->Printf("      %5lu-%-5lu us:    %10lu\n", 1UL << (i - 1), 1UL << i, p.hist[i]);
+            }
+        }
+    };
+
+    c->Printf(
+        "Main loop tasks (times in us, CPU clock %lu MHz):\n"
+        "  Task               Core Pri  Period          Runs     Skipped        Min        Avg        Max\n",
+        cyclesPerUs);
+    for (auto &t : tasks)
+        Show(t.name, 0, t.priority, t.period, t.prof);
+    for (int i = 0, n = nSecondCoreTasks ; i < n ; ++i)
+        Show(secondCoreTasks[i].name, 1, 0, 0, secondCoreTasks[i].prof);
+}
+
+// console command handler
+void TaskScheduler::Command_tasks(const ConsoleCommandContext *c)
+{
+    // with no arguments, just show the stats
+    if (c->argc == 1)
+        return taskScheduler.ShowStats(c);
+
+    // parse options
+    for (int i = 1 ; i < c->argc ; ++i)
+    {
+        const char *a = c->argv[i];
+        if (strcmp(a, "-l") == 0 || strcmp(a, "--list") == 0)
+        {
+            taskScheduler.ShowStats(c);
+        }
+        else if (strcmp(a, "-h") == 0 || strcmp(a, "--hist") == 0)
+        {
+            taskScheduler.ShowStats(c, true);
+        }
+        else if (strcmp(a, "-r") == 0 || strcmp(a, "--reset") == 0)
+        {
+            // reset our counters, and ask the second core to reset its
+            // counters, via the same request flag as the loop stats
+            taskScheduler.ResetStats();
+            secondCoreLoopStatsResetRequested = true;
+            c->Print("Task statistics reset\n");
+        }
+        else
+        {
+            return c->Usage();
+        }
+    }
+}
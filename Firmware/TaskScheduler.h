@@ -0,0 +1,171 @@
+// Pinscape Pico - Main loop task scheduler
+// Copyright 2024, 2025 Michael J Roberts / BSD-3-Clause license / NO WARRANTY
+//
+// The task scheduler runs the main loop's periodic subsystem tasks.  Each
+// subsystem registers its Task() routine with a target period, a priority,
+// and an optional "ready" predicate.  On each main loop pass, the scheduler
+// runs each task whose period has elapsed, or whose ready predicate says
+// that it has new work, in priority order.
+//
+// This lets the latency-critical tasks (USB, plunger, buttons, outputs)
+// run on every pass, while housekeeping tasks (status LED blinking, TV-ON
+// timing) only run as often as they actually need to, which shortens the
+// average main loop time, and thus the polling interval for everything
+// that does run on every pass.
+//
+// The scheduler is cooperative, exactly like the fixed main loop it
+// replaces: each task still has to do a small increment of work and
+// return promptly.  A period of zero means "every pass".  For a task
+// with a ready predicate, the period serves as the maximum interval
+// between runs, so a task never runs less often than its period, even
+// if its predicate never fires.
+
+#pragma once
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+#include <hardware/structs/systick.h>
+
+// external declarations
+class ConsoleCommandContext;
+
+class TaskScheduler
+{
+public:
+    // task entrypoint and ready predicate types
+    using TaskFunc = void (*)();
+    using ReadyFunc = bool (*)();
+
+    // Add a task.  The name must be a string constant (or otherwise have
+    // static storage duration).  Tasks with higher priority values run
+    // first on each pass; tasks of equal priority run in the order added.
+    // 'period_us' is the target interval between runs, in microseconds;
+    // zero runs the task on every pass.  'ready' is an optional predicate
+    // that runs the task ahead of its period when it returns true.
+    void Add(const char *name, TaskFunc func, uint32_t period_us, int priority, ReadyFunc ready = nullptr);
+
+    // Initialize.  Sets up the cycle counter on the calling core, and
+    // adds the "tasks" console command.  Call from the main core.
+    void Init();
+
+    // Run one main loop pass
+    void RunPass();
+
+    // Per-task profile.  Run times are measured in CPU clock cycles,
+    // using the core's SysTick counter, which costs only a couple of
+    // register reads per task call, so profiling stays enabled in
+    // production builds.  The histogram buckets are powers of two in
+    // microseconds: bucket 0 counts runs under 1us, and bucket N counts
+    // runs from 2^(N-1) to 2^N us, with the last bucket collecting
+    // everything longer.
+    struct TaskProfile
+    {
+        // number of runs since the last reset
+        uint64_t nRuns = 0;
+
+        // number of passes skipped since the last reset, because the
+        // period hadn't elapsed and the task wasn't ready
+        uint64_t nSkipped = 0;
+
+        // total run time since the last reset, in CPU cycles
+        uint64_t totalCycles = 0;
+
+        // minimum and maximum single run times, in CPU cycles
+        uint32_t minCycles = 0xFFFFFFFF;
+        uint32_t maxCycles = 0;
+
+        // run time histogram
+        static const int NUM_BUCKETS = 16;
+        uint32_t hist[NUM_BUCKETS]{ 0 };
+
+        // add a time sample, in CPU cycles
+        void AddSample(uint32_t cycles) volatile;
+
+        // reset the counters
+        void Reset() volatile;
+    };
+
+    // Initialize the cycle counter for the calling core.  Each core has
+    // its own SysTick counter, so this must be called once on each core
+    // that profiles tasks.
+    void InitCycleCounter();
+
+    // read the cycle counter start point for a timed section
+    static uint32_t StartCycles() { return systick_hw->cvr; }
+
+    // Get the elapsed cycles since a StartCycles() reading.  SysTick is a
+    // 24-bit down-counter, so this wraps after 2^24 cycles (about 134ms
+    // at 125 MHz); callers timing anything that could run longer should
+    // cross-check against the microsecond clock.
+    static uint32_t ElapsedCycles(uint32_t start) { return (start - systick_hw->cvr) & 0x00FFFFFF; }
+
+    // CPU cycles per microsecond, for converting profile times
+    static uint32_t CyclesPerUs() { return cyclesPerUs; }
+
+    // Register a second-core task for profiling.  The second core's loop
+    // is a fixed sequence of polling calls rather than scheduled tasks,
+    // but we profile each call the same way, so that the "tasks" command
+    // covers both cores.  Call from the second core before entering its
+    // loop.  Returns a handle for ProfileSecondCoreTask(), or -1 if the
+    // table is full.
+    int AddSecondCoreTask(const char *name);
+
+    // Record a second-core task run, in CPU cycles.  Call from the second
+    // core only.
+    void ProfileSecondCoreTask(int handle, uint32_t cycles)
+    {
+        if (handle >= 0)
+            secondCoreTasks[handle].prof.AddSample(cycles);
+    }
+
+    // Reset statistics for all main-core tasks
+    void ResetStats();
+
+    // Reset the second-core task statistics.  Call from the second core
+    // only, since it has exclusive write access to its profiles.
+    void ResetSecondCoreStats();
+
+    // Populate a vendor interface task statistics query (CMD_STATS +
+    // SUBCMD_STATS_QUERY_TASK_STATS).  Returns the populated size, or
+    // 0 if the buffer is too small.
+    size_t Query(uint8_t *buf, size_t bufSize) const;
+
+    // Show the per-task statistics on a console, optionally with the
+    // run time histograms
+    void ShowStats(const ConsoleCommandContext *c, bool hist = false) const;
+
+protected:
+    // registered task
+    struct Task
+    {
+        const char *name;         // display name
+        TaskFunc func;            // task entrypoint
+        ReadyFunc ready;          // ready predicate, or null
+        uint32_t period;          // target period, microseconds
+        int priority;             // priority; higher runs first
+        uint64_t tNext = 0;       // next scheduled run time
+        TaskProfile prof;         // run time profile
+    };
+
+    // task list, in run order
+    std::vector<Task> tasks;
+
+    // second-core tasks
+    struct SecondCoreTask
+    {
+        const char *name = nullptr;
+        TaskProfile prof;
+    };
+    static const int MAX_SECOND_CORE_TASKS = 4;
+    SecondCoreTask secondCoreTasks[MAX_SECOND_CORE_TASKS];
+    volatile int nSecondCoreTasks = 0;
+
+    // CPU cycles per microsecond
+    static uint32_t cyclesPerUs;
+
+    // console command handler
+    static void Command_tasks(const ConsoleCommandContext *c);
+};
+
+// global singleton
+extern TaskScheduler taskScheduler;
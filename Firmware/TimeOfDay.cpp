@@ -12,7 +12,7 @@
 // local project headers
 #include "JSON.h"
 #include "TimeOfDay.h"
-#include "crc32.h"
+#include "CRC32Engine.h"
 #include "Logger.h"
 
 // global singleton
@@ -154,7 +154,7 @@ void TimeOfDay::SaveBeforeReset()
     crossResetData.dateTime = { dt.yyyy, dt.mon, dt.dd, dt.hh, dt.mm, dt.ss };
 
     // compute and store the CRC-32 value, for post-boot integrity checking
-    crossResetData.crc32 = CRC::Calculate(&crossResetData.dateTime, sizeof(crossResetData.dateTime), CRC::CRC_32());
+    crossResetData.crc32 = crc32Engine.Calc(&crossResetData.dateTime, sizeof(crossResetData.dateTime));
 }
 
 // restore the time of day from just before the reset, if available
@@ -182,7 +182,7 @@ void TimeOfDay::RestoreAfterReset()
     
     // calculate the CRC-32 of the stored DateTime information
     auto &crdt = crossResetData.dateTime;
-    uint32_t crc32 = CRC::Calculate(&crdt, sizeof(crdt), CRC::CRC_32());
+    uint32_t crc32 = crc32Engine.Calc(&crdt, sizeof(crdt));
 
     // Check our in-RAM time struct to see if we set that just before
     // the rest.  Validate the stored CRC-32, to validate that a time
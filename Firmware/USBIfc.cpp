@@ -1421,6 +1421,10 @@ std::unordered_map<std::string, LogicalAxis::CreateFunc> LogicalAxis::nameMap{
     { "offset",         [](const CtorParams &params, Strs &strs) -> LogicalAxis* { return new OffsetAxisSource(params, strs); } },
     { "scale",          [](const CtorParams &params, Strs &strs) -> LogicalAxis* { return new ScaleAxisSource(params, strs); } },
     { "abs",            [](const CtorParams &params, Strs &strs) -> LogicalAxis* { return new AbsAxisSource(params, strs); } },
+    { "average",        [](const CtorParams &params, Strs &strs) -> LogicalAxis* { return new AccumAxisSource(params, strs, AccumAxisSource::Mode::Average, "average"); } },
+    { "peak",           [](const CtorParams &params, Strs &strs) -> LogicalAxis* { return new AccumAxisSource(params, strs, AccumAxisSource::Mode::Peak, "peak"); } },
+    { "min",            [](const CtorParams &params, Strs &strs) -> LogicalAxis* { return new AccumAxisSource(params, strs, AccumAxisSource::Mode::Min, "min"); } },
+    { "max",            [](const CtorParams &params, Strs &strs) -> LogicalAxis* { return new AccumAxisSource(params, strs, AccumAxisSource::Mode::Max, "max"); } },
 };
 
 // Configure a logical axis from JSON data.  This is designed to be called
@@ -1762,3 +1766,92 @@ AbsAxisSource::AbsAxisSource(const CtorParams &params, std::vector<std::string>
     if (args.size() >= 2)
         Log(LOG_WARNING, "%s.%s: extra arguments to abs() ignored\n", params.deviceName, params.propName);
 }
+
+// ---------------------------------------------------------------------------
+//
+// Accumulating logical axis source
+//
+
+// list of active accumulators
+std::vector<AccumAxisSource*> AccumAxisSource::all;
+
+AccumAxisSource::AccumAxisSource(const CtorParams &params, std::vector<std::string> &args, Mode mode, const char *funcName) :
+    mode(mode)
+{
+    // args[0] (required) = underlying source expression
+    if (args.size() >= 1)
+        source = LogicalAxis::Configure(params, args[0].c_str(), params.propName);
+    else
+        Log(LOG_ERROR, "%s.%s: %s() source argument missing\n", params.deviceName, params.propName, funcName);
+
+    // warn on additional arguments
+    if (args.size() >= 2)
+        Log(LOG_WARNING, "%s.%s: extra arguments to %s() ignored\n", params.deviceName, params.propName, funcName);
+
+    // add myself to the active list for the main loop sampler
+    all.emplace_back(this);
+}
+
+void AccumAxisSource::SampleAll()
+{
+    for (auto *a : all)
+        a->Sample();
+}
+
+void AccumAxisSource::Sample()
+{
+    // Start a new period on the first sample after a report, or when
+    // the current period has run past its limits, which happens when
+    // reports stop (see the class notes).  The first sample in the
+    // period is the summary so far in every mode.
+    int16_t v = source->Read();
+    uint64_t now = time_us_64();
+    if (n == 0 || n >= MAX_SAMPLES || now - tStart > MAX_PERIOD_US)
+    {
+        sum = v;
+        acc = v;
+        n = 0;
+        tStart = now;
+    }
+    else
+    {
+        switch (mode)
+        {
+        case Mode::Average:
+            sum += v;
+            break;
+
+        case Mode::Peak:
+            if (abs(v) > abs(acc))
+                acc = v;
+            break;
+
+        case Mode::Min:
+            if (v < acc)
+                acc = v;
+            break;
+
+        case Mode::Max:
+            if (v > acc)
+                acc = v;
+            break;
+        }
+    }
+    ++n;
+}
+
+int16_t AccumAxisSource::Read()
+{
+    // If we haven't collected any samples since the last report (which
+    // can happen if the host polls faster than the main loop runs), take
+    // one now, so that we always report a current value.
+    if (n == 0)
+        Sample();
+
+    // figure the summary value for the period
+    int16_t result = (mode == Mode::Average) ? static_cast<int16_t>(sum / n) : acc;
+
+    // start a new period
+    n = 0;
+    return result;
+}
@@ -364,6 +364,71 @@ public:
     LogicalAxis *source = &nullAxisSource;
 };
 
+// Accumulating axis source.  This samples an underlying axis source
+// continuously between HID reports, and reports a summary of all of the
+// samples collected since the last report, rather than just the
+// instantaneous value at the moment the report is built.  The host
+// polls at a fixed interval (typically 1ms to 10ms), which is slow
+// compared to the rate at which fast-moving physical controls like the
+// plunger change, so a single sample per report aliases quick motion
+// and can miss brief peaks entirely.
+//
+// The summary mode is selected by the source name:
+//
+//   average(source)  - the mean of the samples since the last report
+//   peak(source)     - the sample with the largest magnitude, with its sign
+//   min(source)      - the minimum sample
+//   max(source)      - the maximum sample
+//
+// The underlying source is sampled on every main loop pass, via
+// SampleAll(), which runs as a main loop task.  Read() returns the
+// summary over the samples since the last Read(), and starts a new
+// accumulation period, so each source should be read exactly once per
+// report, which is how all of the USB device reports use their axis
+// sources.  A period is also cut off after MAX_PERIOD_US or MAX_SAMPLES,
+// whichever comes first, since reports stop while the USB connection is
+// suspended or the device is disabled; this keeps the sum in range, and
+// keeps a stale extreme from carrying into the first report after
+// reports resume.  (The nudge device axes are already averaged between reports
+// through the NudgeDevice::View mechanism, so there's no need to wrap
+// those in an accumulator.)
+class AccumAxisSource : public LogicalAxis
+{
+public:
+    enum class Mode { Average, Peak, Min, Max };
+    AccumAxisSource(const CtorParams &params, std::vector<std::string> &args, Mode mode, const char *funcName);
+    virtual int16_t Read() override;
+
+    // sample all active accumulators - called from the main loop
+    static void SampleAll();
+
+protected:
+    // take a sample from the underlying source
+    void Sample();
+
+    // underlying source
+    LogicalAxis *source = &nullAxisSource;
+
+    // summary mode
+    Mode mode;
+
+    // accumulators for the current period
+    int32_t sum = 0;        // sum of samples, for Average mode
+    int16_t acc = 0;        // peak/min/max so far, for the other modes
+    int n = 0;              // number of samples in the current period
+    uint64_t tStart = 0;    // time of the first sample in the current period
+
+    // Period limits.  The time limit is a little longer than the longest
+    // HID polling interval (8ms), so it never cuts off a period while
+    // reports are flowing normally.  The sample limit keeps the sum
+    // within 32 bits at any main loop speed.
+    static const uint32_t MAX_PERIOD_US = 10000;
+    static const int MAX_SAMPLES = 32768;
+
+    // list of all active accumulators, for SampleAll()
+    static std::vector<AccumAxisSource*> all;
+};
+
 // Sine wave control source.  This returns a generated sine wave,
 // which is useful mostly for testing.
 class SineAxisSource : public LogicalAxis
@@ -27,7 +27,7 @@
 #include "Version.h"
 #include "Logger.h"
 #include "USBCDC.h"
-#include "crc32.h"
+#include "CRC32Engine.h"
 #include "Buttons.h"
 #include "XInput.h"
 #include "Outputs.h"
@@ -36,6 +36,8 @@
 #include "Config.h"
 #include "Reset.h"
 #include "Main.h"
+#include "BootProfiler.h"
+#include "TaskScheduler.h"
 #include "FlashStorage.h"
 #include "JSON.h"
 #include "Nudge.h"
@@ -517,7 +519,7 @@ void PinscapeVendorIfc::ProcessRequest()
 
                 // calculate the CRC-32 of the data
                 auto &argsOut = resp.args.flash;
-                argsOut.crc32 = CRC::Calculate(flashPtr, copySize, CRC::CRC_32());
+                argsOut.crc32 = crc32Engine.Calc(flashPtr, copySize);
             }
             break;
 
@@ -1034,6 +1036,27 @@ void PinscapeVendorIfc::ProcessRequest()
             enterPollingMode = true;
             break;
 
+        case Request::SUBCMD_STATS_QUERY_BOOT_TRACE:
+            // get the startup timing trace
+            pXferOut = xferOut.data;
+            if ((resp.xferBytes = bootProfiler.Query(xferOut.data, sizeof(xferOut.data))) == 0)
+                resp.status = Response::ERR_FAILED;
+            break;
+
+        case Request::SUBCMD_STATS_QUERY_TASK_STATS:
+            // get the per-task main loop profile
+            pXferOut = xferOut.data;
+            if ((resp.xferBytes = taskScheduler.Query(xferOut.data, sizeof(xferOut.data))) == 0)
+                resp.status = Response::ERR_FAILED;
+
+            // if desired, reset the task counters on both cores
+            if ((curRequest.args.argBytes[1] & Request::QUERYSTATS_FLAG_RESET_COUNTERS) != 0)
+            {
+                taskScheduler.ResetStats();
+                secondCoreLoopStatsResetRequested = true;
+            }
+            break;
+
         default:
             // invalid subcommand
             resp.status = Response::ERR_BAD_SUBCMD;
@@ -1256,7 +1279,7 @@ void PinscapeVendorIfc::ProcessPutConfig(Response &resp)
     }
 
     // calculate the page checksum
-    uint32_t pageChecksum = CRC::Calculate(xferIn.data, xferIn.len, CRC::CRC_32());
+    uint32_t pageChecksum = crc32Engine.Calc(xferIn.data, xferIn.len);
 
     // If this is a repeat of the same page as last time, return success
     // without actually writing the page.  The host is allowed to send the
@@ -1282,8 +1305,8 @@ void PinscapeVendorIfc::ProcessPutConfig(Response &resp)
 
     // add this page into the CRC-32 calculation
     putConfigChecksum = (args.page == 0) ?
-        CRC::Calculate(xferIn.data, xferIn.len, CRC::CRC_32()) :
-        CRC::Calculate(xferIn.data, xferIn.len, CRC::CRC_32(), putConfigChecksum);
+        crc32Engine.Calc(xferIn.data, xferIn.len) :
+        crc32Engine.Calc(xferIn.data, xferIn.len, putConfigChecksum);
                          
     // update the internal counters for the page
     putConfigPrevPageNo = args.page;
@@ -68,6 +68,14 @@
 // 0x7D    LED23 power level limit register  0xFF on reset
 // 0x7E    LED23 time limit, low byte        } 0 on
 // 0x7F    LED23 time limit, high byte       }  reset
+//
+// 0x80    LED0 fade time, low byte          } 0 on
+// 0x81    LED0 fade time, high byte         }  reset
+// ...
+// 0xAE    LED23 fade time, low byte         } 0 on
+// 0xAF    LED23 fade time, high byte        }  reset
+//
+// 0xB0    Burst level update                write-only; see below
 // 
 //
 // Control register 0:  Global control bit map.  Initial value 0x00.
@@ -124,6 +132,37 @@
 // disables the limiter, since the value can never go above the limit
 // value and thus never trigger the timer.
 //
+// Fades: Each port has a 16-bit fade time register, in milliseconds.
+// When the fade time is zero (the default), a write to the port's level
+// register takes effect immediately, as usual.  When the fade time is
+// non-zero, the level register becomes the fade target: a write starts
+// a fade from the port's current brightness to the new level, spanning
+// the fade time, which we evaluate locally on every main loop pass.  A
+// new level written mid-fade starts a new fade from wherever the old
+// one got to.  This lets the host produce a smooth fade with a single
+// level write, where it would otherwise have to send a stream of
+// intermediate levels, tying up the I2C bus for the duration.  The fade
+// runs on a 12-bit level scale (8.4 fixed point), interpolating between
+// adjacent entries in the gamma table, so that a fade between nearby
+// levels doesn't step visibly through the coarse 8-bit gamma points.
+// The power limiter still applies to the fade target, and caps the
+// faded level when the timer expires.
+//
+// Burst level update: A write transaction addressed to 0xB0 carries a
+// 24-bit port mask, as three bytes in little-endian order (bit 0 of the
+// first byte is LED0), followed by one level byte for each port whose
+// mask bit is set, in ascending port order.  This lets the host update
+// a scattered set of ports in a single transaction, sending only the
+// changed levels, where a plain auto-increment write to the level
+// registers would have to send every level between the first and last
+// changed ports.  The new levels are staged in the interrupt handler and
+// only applied when the transaction ends, all at once, so the host gets
+// an atomic update of all of the ports in the mask.  (The PWM slices
+// latch new counter compare values at the end of the current PWM cycle,
+// so each output switches to its new level on a cycle boundary.)  Any
+// level bytes beyond the ports in the mask are ignored, and a
+// transaction that ends early applies only the levels received.
+//
 
 // Define as non-zero if USB logging is desired.  This will initialize
 // stdio on the USB connection, with the startup connection delay
@@ -146,6 +185,7 @@
 #include <ctype.h>
 #include <math.h>
 #include <list>
+#include <algorithm>
 
 // Pico SDK headers
 #include <pico/stdlib.h>
@@ -227,11 +267,13 @@ const int REG_CONFBLK_SIZE = 4;  // size in bytes of LEDn configuration register
 const int REG_CONF_OFS = 0;      // offset of CONF register in LEDn configuration group
 const int REG_LIMIT_OFS = 1;     // offset of LIMIT register in LEDn configuration group
 const int REG_TIMELIMIT_OFS = 2; // offset of TIMELIMIT register in LEDn configuration group
+const int REG_FADETIME0 = 0x80;  // fade time register for LED0 (16 bits; LED1-LED23 sequentially follow)
+const int REG_BURST = 0xB0;      // burst level update (port mask + changed levels)
 const int REG_SWRESET = 0xDD;    // software reset
 
 // Identification register values
 const uint8_t WHOAMI_ID = 0x24;   // arbitrary value to sanity-check the device type
-const uint8_t VERSION_ID = 0x01;  // software version; increment when making I2C interface changes
+const uint8_t VERSION_ID = 0x03;  // software version; increment when making I2C interface changes
 
 // Software Reset codes
 const uint8_t SWRESET_START = 0x11;  // write to SWRESET register to start a reset sequence
@@ -242,6 +284,7 @@ const uint8_t SWRESET_BOOTLOADER = 0x33; // write within 1 second of SWRESET_STA
 static inline int REG_CONF(int port) { return REG_CONF0_BASE + (port * REG_CONFBLK_SIZE); }
 static inline int REG_LIMIT(int port) { return REG_CONF(port) + REG_LIMIT_OFS; }
 static inline int REG_TIMELIMIT(int port) { return REG_CONF(port) + REG_TIMELIMIT_OFS; }
+static inline int REG_FADETIME(int port) { return REG_FADETIME0 + (port * 2); }
 
 // REG_CTRL0 - global configuration register bits
 const uint8_t CTRL0_ENABLE_OUTPUTS = 0x01;   // enable outputs (ports are in high-impedance state when not enabled)
@@ -273,9 +316,36 @@ struct ServiceContext
         uint64_t timeout = END_OF_TIME;
     };
     SWReset swReset;
+
+    // Burst level update state.  A write to REG_BURST diverts the rest
+    // of the transaction into this structure: the first three bytes
+    // are the port mask, and the remaining bytes are the levels for the
+    // ports in the mask, which we collect in levels[] until the end of
+    // the transaction.
+    struct Burst
+    {
+        bool active = false;          // burst transaction in progress
+        int nMaskBytes = 0;           // number of mask bytes received so far
+        uint32_t mask = 0;            // port mask received
+        uint32_t remaining = 0;       // ports in the mask still awaiting a level byte
+        uint32_t received = 0;        // ports that have received a level byte
+        uint8_t levels[24];           // levels received
+    };
+    Burst burst;
 };
 static volatile ServiceContext serviceContext;
 
+// Completed burst updates waiting for the main loop.  The interrupt
+// handler moves the levels here when a burst transaction ends, and
+// the main loop transfers them to the level registers as a group, with
+// interrupts disabled, so that it never sees a partial update.
+struct PendingBurst
+{
+    uint32_t mask = 0;                // ports with pending levels
+    uint8_t levels[24];               // pending levels
+};
+static volatile PendingBurst pendingBurst;
+
 // I2C interrupt callback
 static void __not_in_flash_func(I2CService)(i2c_inst_t *i2c, i2c_slave_event_t event)
 {
@@ -289,6 +359,37 @@ static void __not_in_flash_func(I2CService)(i2c_inst_t *i2c, i2c_slave_event_t e
             // start of transaction - first byte is the register address
             serviceContext.addr = i2c_read_byte(i2c);
             serviceContext.writeStarted = true;
+
+            // check for the start of a burst update
+            if (serviceContext.addr == REG_BURST)
+            {
+                auto &u = serviceContext.burst;
+                u.active = true;
+                u.nMaskBytes = 0;
+                u.mask = 0;
+                u.remaining = 0;
+                u.received = 0;
+            }
+        }
+        else if (auto &u = serviceContext.burst; u.active)
+        {
+            // Burst update in progress - the port mask comes first, then
+            // the levels for the ports in the mask, in port order
+            uint8_t b = i2c_read_byte(i2c);
+            if (u.nMaskBytes < 3)
+            {
+                u.mask |= static_cast<uint32_t>(b) << (8 * u.nMaskBytes);
+                u.nMaskBytes += 1;
+                if (u.nMaskBytes == 3)
+                    u.remaining = u.mask;
+            }
+            else if (u.remaining != 0)
+            {
+                int port = __builtin_ctz(u.remaining);
+                u.levels[port] = b;
+                u.received |= (1UL << port);
+                u.remaining &= u.remaining - 1;
+            }
         }
         else
         {
@@ -363,6 +464,18 @@ static void __not_in_flash_func(I2CService)(i2c_inst_t *i2c, i2c_slave_event_t e
     case I2C_SLAVE_FINISH:
         // master has signaled Stop/Restart - clear the register address counter
         serviceContext.writeStarted = false;
+
+        // if a burst update just finished, hand its levels off to the main loop
+        if (auto &u = serviceContext.burst; u.active)
+        {
+            for (uint32_t m = u.received ; m != 0 ; m &= m - 1)
+            {
+                int port = __builtin_ctz(m);
+                pendingBurst.levels[port] = u.levels[port];
+            }
+            pendingBurst.mask |= u.received;
+            u.active = false;
+        }
         break;
     }
 
@@ -479,13 +592,21 @@ static const float gammaDutyCycleMap[256] = {
 };
 
 //
-// Compute the new level for a port
+// Compute the new level for a port.  The level is on a 12-bit scale,
+// in 8.4 fixed-point format relative to the 8-bit register scale, so
+// the maximum is 255<<4 (0xFF0).  A fractional level interpolates
+// between the adjacent table entries.
 //
-static float CalcDutyCycle(int port, uint8_t level)
+static float CalcDutyCycle(int port, uint16_t level12)
 {
     // apply gamma correction or a simple linear mapping
     uint8_t conf = i2cReg[REG_CONF(port)];
-    float duty = ((conf & CONF_GAMMA_ENA) != 0) ? linearDutyCycleMap[level] : gammaDutyCycleMap[level];
+    const float *map = ((conf & CONF_GAMMA_ENA) != 0) ? linearDutyCycleMap : gammaDutyCycleMap;
+    int idx = level12 >> 4;
+    int frac = level12 & 0x0F;
+    float duty = map[idx];
+    if (frac != 0)
+        duty += (map[idx + 1] - map[idx]) * frac * (1.0f/16.0f);
 
     // invert the duty cycle if active-low
     if ((conf & CONF_ACTIVE_LOW) != 0)
@@ -526,6 +647,9 @@ static void InitRegs()
         *pConf++ = 0;
     }
 
+    // clear the fade time registers
+    memset(&i2cReg[REG_FADETIME0], 0x00, 24*2);
+
     // Set CTRL0 and CTRL1 to all bits 0.  Note that we set CTRL0 last,
     // so that we reset the CTRL0_RESET_REGS bit in this register as the
     // very last thing we do.  The host can poll this bit to determine
@@ -679,12 +803,46 @@ int main()
         // power level reduction time
         uint64_t tPowerTimeout = END_OF_TIME;
 
+        // Current logical level, on the 12-bit (8.4 fixed point) scale.
+        // This tracks the register level, except during a fade, when it
+        // moves from fadeFrom to fadeTo over the fade time.
+        uint16_t level12 = 0;
+
+        // fade in progress, if fadeTime is non-zero
+        uint16_t fadeFrom = 0;
+        uint16_t fadeTo = 0;
+        uint64_t tFadeStart = 0;
+        uint32_t fadeTime = 0;
+
+        // advance the fade to the given time
+        void UpdateFade(uint64_t now)
+        {
+            if (fadeTime != 0)
+            {
+                uint64_t dt = now - tFadeStart;
+                if (dt >= fadeTime)
+                {
+                    // fade completed
+                    level12 = fadeTo;
+                    fadeTime = 0;
+                }
+                else
+                {
+                    // interpolate linearly on the 12-bit logical scale
+                    int64_t delta = static_cast<int64_t>(fadeTo) - fadeFrom;
+                    level12 = static_cast<uint16_t>(fadeFrom + delta * static_cast<int64_t>(dt) / fadeTime);
+                }
+            }
+        }
+
         // reset the port
         void Reset()
         {
             lastRegLevel = 0;
             computedLevel = 0.0f;
             tPowerTimeout = END_OF_TIME;
+            level12 = 0;
+            fadeTime = 0;
         }
     };
     Port ports[24];
@@ -747,6 +905,18 @@ int main()
             watchdog_update();
         }
 
+        // apply any completed burst updates to the level registers
+        if (pendingBurst.mask != 0)
+        {
+            IRQDisabler irqd;
+            for (uint32_t m = pendingBurst.mask ; m != 0 ; m &= m - 1)
+            {
+                int port = __builtin_ctz(m);
+                i2cReg[REG_LED0 + port] = pendingBurst.levels[port];
+            }
+            pendingBurst.mask = 0;
+        }
+
         // check for level changes and timeouts
         Port *port = ports;
         uint8_t *pLevel = &i2cReg[REG_LED0];
@@ -760,8 +930,8 @@ int main()
             // get the time limit for the port; if it's locked out due to a write in
             // progress, take a miss on this port for this round, and just leave the
             // register updates pending for the next round
-            uint16_t timeLimit;
-            if (!GetReg16(REG_TIMELIMIT(i), timeLimit))
+            uint16_t timeLimit, fadeTime;
+            if (!GetReg16(REG_TIMELIMIT(i), timeLimit) || !GetReg16(REG_FADETIME(i), fadeTime))
                 continue;
 
             // check for a change in the I2C register setting
@@ -783,24 +953,46 @@ int main()
                     // since a level below the limit should be safe indefinitely
                     port->tPowerTimeout = END_OF_TIME;
                 }
+
+                // If the port has a fade time, start a fade from the
+                // current level (which might be partway through an earlier
+                // fade) to the new level.  Otherwise, jump straight to the
+                // new level.
+                port->UpdateFade(now);
+                if (fadeTime != 0)
+                {
+                    port->fadeFrom = port->level12;
+                    port->fadeTo = newRegLevel << 4;
+                    port->tFadeStart = now;
+                    port->fadeTime = fadeTime * 1000UL;
+                }
+                else
+                {
+                    port->level12 = newRegLevel << 4;
+                    port->fadeTime = 0;
+                }
                 
                 // remember the new register value
                 port->lastRegLevel = newRegLevel;
             }
 
+            // advance the fade in progress, if any
+            port->UpdateFade(now);
+
             // Calculate the new duty cycle based on current settings.
             // Calculate on every cycle even if the host port level
             // didn't change, since the duty cycle ALSO depends on the
             // configuration registers, so a chance in configuration
             // might change the physical port duty cycle even when
             // there's no change in the port's logical level.
-            float newComputedLevel = CalcDutyCycle(i, newRegLevel);
+            float newComputedLevel = CalcDutyCycle(i, port->level12);
 
             // check for power limit timeouts
             if (now > port->tPowerTimeout)
             {
-                // calculate the duty cycle at the reduced level
-                newComputedLevel = CalcDutyCycle(i, powerLimit);
+                // calculate the duty cycle at the reduced level, or at the
+                // current fade level, if the fade hasn't reached the limit yet
+                newComputedLevel = CalcDutyCycle(i, std::min<uint16_t>(port->level12, powerLimit << 4));
             }
 
             // if the computed level has changed, update the physical port
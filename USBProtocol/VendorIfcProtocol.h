@@ -620,10 +620,31 @@ namespace PinscapePico
         //   Pico, the immediate polling mode exits if no new command is
         //   received within a few milliseconds.
         //
+        // SUBCMD_STATS_QUERY_BOOT_TRACE
+        //   Query the startup timing trace.  The firmware records a list
+        //   of named, timestamped spans covering the initialization steps
+        //   from program entry to the start of the main loop: loading the
+        //   configuration, configuring each subsystem and peripheral device,
+        //   USB initialization, and so on.  The reply transfer data consists
+        //   of a BootTraceList struct as a list header, followed by an array
+        //   of BootTraceSpan structs.  The trace is recorded once per boot,
+        //   so the result is the same for every query within a session.
+        //
+        // SUBCMD_STATS_QUERY_TASK_STATS
+        //   Query the per-task main loop profile.  The reply transfer data
+        //   consists of a TaskStatsList struct as a list header, followed
+        //   by an array of TaskStats structs, one per main loop task on
+        //   each core.  The second byte of the arguments contains bit
+        //   flags, as for SUBCMD_STATS_QUERY_STATS; the only flag currently
+        //   defined is QUERYSTATS_FLAG_RESET_COUNTERS, which resets the
+        //   task counters after the query to start a new window.
+        //
         static const uint8_t CMD_STATS = 0x0B;
         static const uint8_t SUBCMD_STATS_QUERY_STATS = 0x01;
         static const uint8_t SUBCMD_STATS_QUERY_CLOCK = 0x02;
         static const uint8_t SUBCMD_STATS_PREP_QUERY_CLOCK = 0x03;
+        static const uint8_t SUBCMD_STATS_QUERY_BOOT_TRACE = 0x04;
+        static const uint8_t SUBCMD_STATS_QUERY_TASK_STATS = 0x05;
 
         // flags for CMD_STATE + SUBCMD_STATS_QUERY_STATS
         static const uint8_t QUERYSTATS_FLAG_RESET_COUNTERS = 0x01;
@@ -1642,6 +1663,131 @@ namespace PinscapePico
         uint32_t arenaFree;      // arena space not in use
     } __PackedEnd;
 
+    // Startup timing trace, for CMD_STATS + SUBCMD_STATS_QUERY_BOOT_TRACE.
+    // The reply transfer data starts with a BootTraceList struct, which
+    // serves as the list header.  This is followed by zero or more
+    // BootTraceSpan structs, one per recorded span:
+    //
+    //    BootTraceList              struct, BootTraceList::cb bytes
+    //    BootTraceSpan[]            array of struct, BootTraceList::numSpans elements x BootTraceList::cbSpan bytes
+    //
+    // All times are on the Pico system clock, in microseconds since the
+    // last Pico CPU reset.
+    struct __PackedBegin BootTraceList
+    {
+        // size in bytes of the BootTraceList struct
+        uint16_t cb;
+
+        // size in bytes of the BootTraceSpan struct
+        uint16_t cbSpan;
+
+        // number of BootTraceSpan structs that follow
+        uint16_t numSpans;
+
+        // Number of spans that couldn't be recorded because the trace
+        // buffer was full.  The list contains the earliest spans, so any
+        // dropped spans are the ones closest to the end of startup.
+        uint16_t numDropped;
+
+        // time of entry to the firmware main program
+        uint64_t tMain;
+
+        // time the main loop started, marking the end of startup
+        uint64_t tMainLoop;
+    } __PackedEnd;
+
+    // Startup timing trace span.  Spans are listed in order of their
+    // start times.  Spans can nest; a span at depth N+1 is contained
+    // within the nearest preceding span at depth N.  For example, the
+    // individual subsystem configuration steps are nested within an
+    // overall span for the configuration phase.
+    struct __PackedBegin BootTraceSpan
+    {
+        // span start and end times
+        uint64_t tStart;
+        uint64_t tEnd;
+
+        // nesting depth; 0 is a top-level span
+        uint8_t depth;
+
+        // reserved/padding
+        uint8_t reserved0[7];
+
+        // span name, as a null-terminated string, truncated to fit if
+        // necessary
+        char name[32];
+    } __PackedEnd;
+
+    // Main loop task profile, for CMD_STATS + SUBCMD_STATS_QUERY_TASK_STATS.
+    // The reply transfer data starts with a TaskStatsList struct, which
+    // serves as the list header.  This is followed by zero or more
+    // TaskStats structs, one per task:
+    //
+    //    TaskStatsList              struct, TaskStatsList::cb bytes
+    //    TaskStats[]                array of struct, TaskStatsList::numTasks elements x TaskStatsList::cbTask bytes
+    //
+    // Task run times are in CPU clock cycles.  Divide by cyclesPerUs to
+    // convert to microseconds.
+    struct __PackedBegin TaskStatsList
+    {
+        // size in bytes of the TaskStatsList struct
+        uint16_t cb;
+
+        // size in bytes of the TaskStats struct
+        uint16_t cbTask;
+
+        // number of TaskStats structs that follow
+        uint16_t numTasks;
+
+        // number of histogram buckets populated in each TaskStats
+        uint16_t numBuckets;
+
+        // CPU clock cycles per microsecond
+        uint32_t cyclesPerUs;
+
+        // reserved/padding
+        uint32_t reserved0;
+    } __PackedEnd;
+
+    // Main loop task profile entry
+    struct __PackedBegin TaskStats
+    {
+        // task name, as a null-terminated string, truncated to fit if
+        // necessary
+        char name[24];
+
+        // CPU core that runs the task (0 = main core, 1 = second core)
+        uint8_t core;
+
+        // scheduling priority; higher runs first within each pass
+        int8_t priority;
+
+        // reserved/padding
+        uint8_t reserved0[2];
+
+        // target period in microseconds; 0 runs on every main loop pass
+        uint32_t period;
+
+        // number of runs, and number of passes skipped because the task
+        // wasn't due, since the last statistics reset
+        uint64_t nRuns;
+        uint64_t nSkipped;
+
+        // total run time since the last statistics reset, in CPU cycles
+        uint64_t totalCycles;
+
+        // minimum and maximum single run time, in CPU cycles (minCycles
+        // is 0xFFFFFFFF if the task hasn't run since the last reset)
+        uint32_t minCycles;
+        uint32_t maxCycles;
+
+        // Run time histogram.  Bucket 0 counts runs under 1us, and bucket
+        // N counts runs from 2^(N-1) to 2^N us, with the last populated
+        // bucket (TaskStatsList::numBuckets - 1) collecting everything
+        // longer.
+        uint32_t hist[16];
+    } __PackedEnd;
+
     // CMD_QUERY_USBIFC response data struct, returned as the additional
     // transfer data.
     struct __PackedBegin USBInterfaces
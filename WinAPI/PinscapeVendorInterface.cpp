@@ -1189,6 +1189,99 @@ int VendorInterface::QueryStats(PinscapePico::Statistics *stats, size_t sizeofSt
 	return PinscapeResponse::OK;
 }
 
+int VendorInterface::QueryBootTrace(PinscapePico::BootTraceList &list, std::vector<PinscapePico::BootTraceSpan> &spans)
+{
+	// clear the caller's list header, to set defaults for unpopulated fields
+	memset(&list, 0, sizeof(list));
+	spans.clear();
+
+	// send the request
+	uint8_t args[1]{ PinscapeRequest::SUBCMD_STATS_QUERY_BOOT_TRACE };
+	std::vector<BYTE> xferIn;
+	int stat = SendRequestWithArgs(PinscapeRequest::CMD_STATS, args, nullptr, 0, &xferIn);
+	if (stat != PinscapeResponse::OK)
+		return stat;
+
+	// sanity-check the response
+	if (xferIn.size() < offsetnext(PinscapePico::BootTraceList, numSpans))
+		return PinscapeResponse::ERR_BAD_REPLY_DATA;
+
+	// Get the response header, and check that there's enough data to fill
+	// out the list with the size claimed in the header.
+	const auto *hdr = reinterpret_cast<const PinscapePico::BootTraceList*>(xferIn.data());
+	size_t minSize = hdr->cb + hdr->cbSpan*hdr->numSpans;
+	if (xferIn.size() < minSize)
+		return PinscapeResponse::ERR_BAD_REPLY_DATA;
+
+	// copy the header, up to the smaller of the two struct versions
+	memcpy(&list, hdr, min(sizeof(list), static_cast<size_t>(hdr->cb)));
+
+	// allocate the span list and clear it to all zero bytes
+	spans.resize(hdr->numSpans);
+	memset(spans.data(), 0, spans.size() * sizeof(PinscapePico::BootTraceSpan));
+
+	// populate the span list
+	const auto *src = reinterpret_cast<const uint8_t*>(xferIn.data() + hdr->cb);
+	size_t copySize = min(sizeof(PinscapePico::BootTraceSpan), static_cast<size_t>(hdr->cbSpan));
+	for (auto &span : spans)
+	{
+		memcpy(&span, src, copySize);
+		span.name[_countof(span.name) - 1] = 0;
+		src += hdr->cbSpan;
+	}
+
+	// success
+	return stat;
+}
+
+int VendorInterface::QueryTaskStats(PinscapePico::TaskStatsList &list, std::vector<PinscapePico::TaskStats> &tasks, bool resetCounters)
+{
+	// clear the caller's list header, to set defaults for unpopulated fields
+	memset(&list, 0, sizeof(list));
+	tasks.clear();
+
+	// send the request
+	uint8_t args[2]{
+		PinscapeRequest::SUBCMD_STATS_QUERY_TASK_STATS,
+		static_cast<uint8_t>(resetCounters ? PinscapeRequest::QUERYSTATS_FLAG_RESET_COUNTERS : 0)
+	};
+	std::vector<BYTE> xferIn;
+	int stat = SendRequestWithArgs(PinscapeRequest::CMD_STATS, args, nullptr, 0, &xferIn);
+	if (stat != PinscapeResponse::OK)
+		return stat;
+
+	// sanity-check the response
+	if (xferIn.size() < offsetnext(PinscapePico::TaskStatsList, numTasks))
+		return PinscapeResponse::ERR_BAD_REPLY_DATA;
+
+	// Get the response header, and check that there's enough data to fill
+	// out the list with the size claimed in the header.
+	const auto *hdr = reinterpret_cast<const PinscapePico::TaskStatsList*>(xferIn.data());
+	size_t minSize = hdr->cb + hdr->cbTask*hdr->numTasks;
+	if (xferIn.size() < minSize)
+		return PinscapeResponse::ERR_BAD_REPLY_DATA;
+
+	// copy the header, up to the smaller of the two struct versions
+	memcpy(&list, hdr, min(sizeof(list), static_cast<size_t>(hdr->cb)));
+
+	// allocate the task list and clear it to all zero bytes
+	tasks.resize(hdr->numTasks);
+	memset(tasks.data(), 0, tasks.size() * sizeof(PinscapePico::TaskStats));
+
+	// populate the task list
+	const auto *src = reinterpret_cast<const uint8_t*>(xferIn.data() + hdr->cb);
+	size_t copySize = min(sizeof(PinscapePico::TaskStats), static_cast<size_t>(hdr->cbTask));
+	for (auto &task : tasks)
+	{
+		memcpy(&task, src, copySize);
+		task.name[_countof(task.name) - 1] = 0;
+		src += hdr->cbTask;
+	}
+
+	// success
+	return stat;
+}
+
 int VendorInterface::QueryUSBInterfaceConfig(PinscapePico::USBInterfaces *ifcs, size_t sizeofIfcs)
 {
 	// zero the caller's struct, to set defaults for unpopulated fields
@@ -482,6 +482,19 @@ namespace PinscapePico
 		int QueryStats(PinscapePico::Statistics *stats, size_t sizeofStats,
 			bool resetCounters);
 
+		// Query the startup timing trace.  This retrieves the list of
+		// named, timestamped spans that the firmware recorded for its
+		// initialization steps, from program entry to the start of the
+		// main loop.  Returns a PinscapeResponse::OK or ERR_xxx code.
+		int QueryBootTrace(PinscapePico::BootTraceList &list, std::vector<PinscapePico::BootTraceSpan> &spans);
+
+		// Query the per-task main loop profile.  This retrieves the run
+		// counts, min/average/max run times, and run time histograms for
+		// each main loop task on both cores.  If resetCounters is true, the
+		// task counters are reset after the query.  Returns a
+		// PinscapeResponse::OK or ERR_xxx code.
+		int QueryTaskStats(PinscapePico::TaskStatsList &list, std::vector<PinscapePico::TaskStats> &tasks, bool resetCounters);
+
 		// Synchronize clocks with the Pico.  This uses the USB SOF (Start
 		// Of Frame) signal to create a fixed reference point in time shared
 		// between the Windows host and the Pico, so that the two systems